@@ -44,17 +44,30 @@ void set_compaction_manager(http_context& ctx, routes& r) {
         return ctx.db.map_reduce0([](database& db) {
             std::vector<cm::summary> summaries;
             const compaction_manager& cm = db.get_compaction_manager();
+            // Token range sub-jobs of the same compaction are reported as one.
+            std::unordered_map<utils::UUID, size_t> runs;
+            std::vector<std::pair<uint64_t, uint64_t>> progress;
 
             for (const auto& c : cm.get_compactions()) {
+                auto it = runs.find(c->run_id);
+                if (it != runs.end()) {
+                    progress[it->second].first += c->progress.bytes_done();
+                    progress[it->second].second += c->progress.total_bytes();
+                    continue;
+                }
+                runs.emplace(c->run_id, summaries.size());
+                progress.emplace_back(c->progress.bytes_done(), c->progress.total_bytes());
                 cm::summary s;
                 s.ks = c->ks;
                 s.cf = c->cf;
-                s.unit = "keys";
+                s.unit = "bytes";
                 s.task_type = sstables::compaction_name(c->type);
-                s.completed = c->total_keys_written;
-                s.total = c->total_partitions;
                 summaries.push_back(std::move(s));
             }
+            for (size_t i = 0; i < summaries.size(); ++i) {
+                summaries[i].completed = progress[i].first;
+                summaries[i].total = progress[i].second;
+            }
             return summaries;
         }, std::vector<cm::summary>(), concat<cm::summary>).then([](const std::vector<cm::summary>& res) {
             return make_ready_future<json::json_return_type>(res);
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2017 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <boost/range/algorithm/find.hpp>
+
+#include "byte_comparable.hh"
+
+namespace {
+
+using encoding = clustering_ordering_prefix::encoding;
+
+constexpr int8_t component_marker = 0x40;
+
+int8_t relation_marker(lexicographical_relation r) {
+    switch (r) {
+    case lexicographical_relation::before_all_prefixed: return 0x00;
+    case lexicographical_relation::before_all_strictly_prefixed: return 0x01;
+    case lexicographical_relation::after_all_prefixed: return int8_t(0xff);
+    }
+    abort();
+}
+
+bool is_reversed(encoding enc) {
+    return enc == encoding::reversed_unsigned_bytes || enc == encoding::reversed_signed_big_endian;
+}
+
+size_t encoded_size(encoding enc, bytes_view v) {
+    switch (enc) {
+    case encoding::unsigned_bytes:
+    case encoding::reversed_unsigned_bytes:
+        return 1 + v.size() + std::count(v.begin(), v.end(), 0) + 2;
+    case encoding::signed_big_endian:
+    case encoding::reversed_signed_big_endian:
+        return 1 + (v.empty() ? 1 : 1 + v.size());
+    case encoding::none:
+        break;
+    }
+    abort();
+}
+
+bytes::iterator encode_component(encoding enc, bytes_view v, bytes::iterator out) {
+    auto begin = out;
+    *out++ = component_marker;
+    switch (enc) {
+    case encoding::unsigned_bytes:
+    case encoding::reversed_unsigned_bytes:
+        for (auto b : v) {
+            *out++ = b;
+            if (!b) {
+                *out++ = int8_t(0xff);
+            }
+        }
+        *out++ = 0;
+        *out++ = 0;
+        break;
+    case encoding::signed_big_endian:
+    case encoding::reversed_signed_big_endian:
+        if (v.empty()) {
+            *out++ = 0;
+            break;
+        }
+        *out++ = 1;
+        *out++ = v[0] ^ int8_t(0x80);
+        out = std::copy(v.begin() + 1, v.end(), out);
+        break;
+    case encoding::none:
+        abort();
+    }
+    if (is_reversed(enc)) {
+        std::transform(begin, out, begin, [] (int8_t b) { return ~b; });
+    }
+    return out;
+}
+
+}
+
+byte_comparable_encoder::byte_comparable_encoder(const schema& s) {
+    _encodings.reserve(s.clustering_key_size());
+    for (auto&& cdef : s.clustering_key_columns()) {
+        _encodings.push_back(clustering_ordering_prefix::encoding_for(*cdef.type));
+    }
+}
+
+bool byte_comparable_encoder::supported() const {
+    return boost::find(_encodings, encoding::none) == _encodings.end();
+}
+
+stdx::optional<byte_comparable_encoder> byte_comparable_encoder::for_schema(const schema& s) {
+    byte_comparable_encoder enc(s);
+    if (!enc.supported()) {
+        return { };
+    }
+    return std::move(enc);
+}
+
+template<typename RangeOfValues>
+bytes byte_comparable_encoder::encode(partition_region region, const RangeOfValues& values, lexicographical_relation relation) const {
+    size_t size = 2;
+    auto enc = _encodings.begin();
+    for (bytes_view v : values) {
+        if (enc == _encodings.end()) {
+            break;
+        }
+        size += encoded_size(*enc++, v);
+    }
+
+    bytes b(bytes::initialized_later(), size);
+    auto out = b.begin();
+    *out++ = static_cast<int8_t>(region);
+    enc = _encodings.begin();
+    for (bytes_view v : values) {
+        if (enc == _encodings.end()) {
+            break;
+        }
+        out = encode_component(*enc++, v, out);
+    }
+    *out++ = relation_marker(relation);
+    return b;
+}
+
+bytes byte_comparable_encoder::encode(position_in_partition_view pos) const {
+    if (!pos.has_clustering_key()) {
+        auto region = pos.is_partition_start() ? partition_region::partition_start
+                    : pos.is_static_row() ? partition_region::static_row
+                    : partition_region::partition_end;
+        return bytes(1, static_cast<int8_t>(region));
+    }
+    return encode(partition_region::clustered, pos.key().components(), pos.relation());
+}
+
+bytes byte_comparable_encoder::encode(composite_view c) const {
+    if (c.empty()) {
+        return bytes();
+    }
+    if (c.is_static()) {
+        return bytes(1, static_cast<int8_t>(partition_region::static_row));
+    }
+    return encode(partition_region::clustered, c.values(), relation_for_lower_bound(c));
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2017 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "clustering_ordering_prefix.hh"
+#include "compound_compat.hh"
+#include "position_in_partition.hh"
+
+// Encodes clustering positions into byte strings whose order, as given by
+// compare_unsigned(), is the order of position_in_partition::composite_tri_compare.
+// Comparing encoded positions is a single memcmp(), instead of deserializing
+// each component and calling the type comparator, so it pays off when a
+// position is compared many times, like the starts of promoted index blocks.
+// It does not pay off where each position takes part in a few comparisons
+// only, like when merging fragment streams, nor where the encodings would
+// have to be kept for every row, like in rows_entry.
+//
+// The encoding of a position is:
+//
+//   <position>  ::= <region> ( <component> )* <relation>
+//   <component> ::= 0x40 <value>
+//   <relation>  ::= 0x00 (before all prefixed) | 0x01 (before all strictly prefixed) | 0xff (after all prefixed)
+//
+// and the encoding of <value> depends on the type:
+//
+//   - types which compare as unsigned bytes: the value with each 0x00 byte
+//     escaped as 0x00 0xff, terminated by 0x00 0x00,
+//   - fixed-width signed integers: 0x00 for an empty value, otherwise 0x01
+//     followed by the value with the sign bit flipped,
+//   - reversed types: the encoding of the underlying type, including the
+//     component marker, with all bits inverted.
+//
+// Static positions and positions without a key encode only the region.
+//
+// Not all types can be encoded (e.g. uuids and floating point numbers), so
+// users have to fall back to the regular comparators if supported() is false.
+class byte_comparable_encoder {
+    std::vector<clustering_ordering_prefix::encoding> _encodings;
+private:
+    template<typename RangeOfValues>
+    bytes encode(partition_region region, const RangeOfValues& values, lexicographical_relation relation) const;
+public:
+    explicit byte_comparable_encoder(const schema& s);
+
+    // Returns true if all clustering key types of the schema can be encoded.
+    bool supported() const;
+
+    // Returns a disengaged optional if !supported().
+    static stdx::optional<byte_comparable_encoder> for_schema(const schema& s);
+
+    // Must be called only if supported().
+    bytes encode(position_in_partition_view pos) const;
+    bytes encode(composite_view c) const;
+
+    static int compare(bytes_view a, bytes_view b) {
+        return compare_unsigned(a, b);
+    }
+};
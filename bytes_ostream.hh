@@ -336,6 +336,14 @@ class bytes_ostream {
         _current->offset = pos._offset;
     }
 
+    // Rollbacks the last n bytes written, which must all be in the last chunk,
+    // like the unused tail of a place holder.
+    void remove_suffix(size_type n) {
+        assert(_current && n <= _current->offset);
+        _current->offset -= n;
+        _size -= n;
+    }
+
     void reduce_chunk_count() {
         // FIXME: This is a simplified version. It linearizes the whole buffer
         // if its size is below max_chunk_size. We probably could also gain
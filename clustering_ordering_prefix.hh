@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2017 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "net/byteorder.hh"
+
+#include "schema.hh"
+#include "types.hh"
+
+// A fixed-length, order-preserving summary of a clustering key, derived from
+// its first component: for any two clustering positions a < b with non-empty
+// keys, prefix(a) <= prefix(b). Comparing prefixes, which are plain integers,
+// decides most comparisons without deserializing keys and going through the
+// type comparators. Only equal prefixes need the full comparison.
+//
+// How the prefix is computed depends on the type of the first clustering
+// column. Prefixes are comparable only if computed with the same encoding.
+class clustering_ordering_prefix {
+public:
+    using value_type = uint64_t;
+
+    enum class encoding : uint8_t {
+        none,               // no prefix, the type is not supported
+        unsigned_bytes,     // the type compares values as unsigned bytes
+        signed_big_endian,  // the type compares fixed-width two's complement integers
+        reversed_unsigned_bytes,
+        reversed_signed_big_endian,
+    };
+
+    // Returns how values of type t are turned into prefixes.
+    static encoding encoding_for(const abstract_type& t) {
+        if (t.is_reversed()) {
+            switch (encoding_for(*t.underlying_type())) {
+            case encoding::unsigned_bytes: return encoding::reversed_unsigned_bytes;
+            case encoding::signed_big_endian: return encoding::reversed_signed_big_endian;
+            default: return encoding::none;
+            }
+        }
+        // Not is_byte_order_comparable(): collections and tuples of such
+        // types answer like their elements, but compare element by element.
+        if (&t == bytes_type.get() || &t == ascii_type.get() || &t == utf8_type.get() || &t == inet_addr_type.get()
+                || &t == simple_date_type.get()) {
+            return encoding::unsigned_bytes;
+        }
+        if (&t == byte_type.get() || &t == short_type.get() || &t == int32_type.get() || &t == long_type.get()
+                || &t == timestamp_type.get() || &t == time_type.get()) {
+            return encoding::signed_big_endian;
+        }
+        return encoding::none;
+    }
+
+    static encoding for_schema(const schema& s) {
+        if (!s.clustering_key_size()) {
+            return encoding::none;
+        }
+        return encoding_for(*s.clustering_key_columns().begin()->type);
+    }
+
+    // Computes the prefix of a serialized value of the first clustering column.
+    static value_type of_value(encoding enc, bytes_view v) {
+        value_type p = 0;
+        auto n = std::min(v.size(), sizeof(p));
+        std::copy_n(v.begin(), n, reinterpret_cast<bytes_view::value_type*>(&p));
+        p = net::ntoh(p);
+        switch (enc) {
+        case encoding::none:
+            return 0;
+        case encoding::unsigned_bytes:
+            return p;
+        case encoding::signed_big_endian:
+            // Empty values sort before everything else.
+            return n ? p ^ (value_type(1) << 63) : 0;
+        case encoding::reversed_unsigned_bytes:
+            return ~p;
+        case encoding::reversed_signed_big_endian:
+            return ~(n ? p ^ (value_type(1) << 63) : 0);
+        }
+        abort();
+    }
+
+    // Computes the prefix of a serialized clustering key prefix. Returns false
+    // if the key has no components, and so no prefix.
+    static bool of_key(encoding enc, bytes_view key, value_type& out) {
+        if (key.size() < 2) {
+            return false;
+        }
+        size_t len = (uint8_t(key[0]) << 8) | uint8_t(key[1]);
+        key.remove_prefix(2);
+        out = of_value(enc, bytes_view(key.data(), std::min(len, key.size())));
+        return true;
+    }
+};
@@ -71,9 +71,18 @@ class compaction_strategy {
     // Return if optimization to rule out sstables based on clustering key filter should be applied.
     bool use_clustering_key_filter() const;
 
+    // Return if single-partition reads with a row limit should read sstables one
+    // at a time, newest first, and stop once the limit is provably satisfied.
+    // Pays off when sstables hold disjoint time windows of the clustering order.
+    bool use_time_ordered_reads() const;
+
     // An estimation of number of compaction for strategy to be satisfied.
     int64_t estimated_pending_compactions(column_family& cf) const;
 
+    // An estimation of the number of bytes compaction has to write for the
+    // strategy to be satisfied.
+    uint64_t estimated_backlog_bytes(column_family& cf) const;
+
     static sstring name(compaction_strategy_type type) {
         switch (type) {
         case compaction_strategy_type::null:
@@ -184,6 +184,7 @@ scylla_tests = [
     'tests/lsa_sync_eviction_test',
     'tests/row_cache_alloc_stress',
     'tests/perf_row_cache_update',
+    'tests/perf/perf_bloom_filter',
     'tests/perf/perf_hash',
     'tests/perf/perf_cql_parser',
     'tests/perf/perf_simple_query',
@@ -193,6 +194,13 @@ scylla_tests = [
     'tests/row_cache_stress_test',
     'tests/memory_footprint',
     'tests/perf/perf_sstable',
+    'tests/perf/perf_pending_ranges',
+    'tests/perf/perf_key_compare',
+    'tests/perf/perf_cql_response',
+    'tests/perf/perf_sstable_set',
+    'tests/perf/perf_indexed_select',
+    'tests/perf/perf_shard_hop',
+    'tests/perf/perf_write_coalescing',
     'tests/cql_query_test',
     'tests/storage_proxy_test',
     'tests/schema_change_test',
@@ -211,11 +219,14 @@ scylla_tests = [
     'tests/message',
     'tests/gossip',
     'tests/gossip_test',
+    'tests/messaging_service_test',
+    'tests/write_coalescer_test',
     'tests/compound_test',
     'tests/config_test',
     'tests/gossiping_property_file_snitch_test',
     'tests/ec2_snitch_test',
     'tests/snitch_reset_test',
+    'tests/dynamic_snitch_test',
     'tests/network_topology_strategy_test',
     'tests/query_processor_test',
     'tests/batchlog_manager_test',
@@ -334,10 +345,14 @@ scylla_core = (['database.cc',
                  'flat_mutation_reader.cc',
                  'mutation_query.cc',
                  'keys.cc',
+                 'byte_comparable.cc',
                  'counters.cc',
+                 'counter_cache.cc',
                  'sstables/sstables.cc',
                  'sstables/compress.cc',
                  'sstables/row.cc',
+                 'sstables/read_ahead.cc',
+                 'sstables/partition_index_model.cc',
                  'sstables/partition.cc',
                  'sstables/compaction.cc',
                  'sstables/compaction_strategy.cc',
@@ -413,6 +428,7 @@ scylla_core = (['database.cc',
                  'service/priority_manager.cc',
                  'service/migration_manager.cc',
                  'service/storage_proxy.cc',
+                 'service/write_coalescer.cc',
                  'cql3/operator.cc',
                  'cql3/relation.cc',
                  'cql3/column_identifier.cc',
@@ -488,6 +504,7 @@ scylla_core = (['database.cc',
                  'locator/token_metadata.cc',
                  'locator/locator.cc',
                  'locator/snitch_base.cc',
+                 'locator/dynamic_snitch.cc',
                  'locator/simple_snitch.cc',
                  'locator/rack_inferring_snitch.cc',
                  'locator/gossiping_property_file_snitch.cc',
@@ -646,6 +663,7 @@ tests_not_using_seastar_test_framework = set([
     'tests/lsa_sync_eviction_test',
     'tests/row_cache_alloc_stress',
     'tests/perf_row_cache_update',
+    'tests/perf/perf_bloom_filter',
     'tests/perf/perf_hash',
     'tests/perf/perf_cql_parser',
     'tests/message',
@@ -656,6 +674,13 @@ tests_not_using_seastar_test_framework = set([
     'tests/memory_footprint',
     'tests/gossip',
     'tests/perf/perf_sstable',
+    'tests/perf/perf_pending_ranges',
+    'tests/perf/perf_key_compare',
+    'tests/perf/perf_cql_response',
+    'tests/perf/perf_sstable_set',
+    'tests/perf/perf_indexed_select',
+    'tests/perf/perf_shard_hop',
+    'tests/perf/perf_write_coalescing',
 ]) | pure_boost_tests
 
 for t in tests_not_using_seastar_test_framework:
@@ -0,0 +1,334 @@
+/*
+ * Copyright (C) 2017 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "counter_cache.hh"
+#include "fnv1a_hasher.hh"
+#include "frozen_mutation.hh"
+#include "mutation_partition_visitor.hh"
+
+size_t counter_cache::cell_entry::hasher::operator()(const cell_address& ca) const {
+    fnv1a_hasher hasher;
+    ca.position.feed_hash(hasher, *_schema);
+    ::feed_hash(hasher, ca.id);
+    return hasher.finalize();
+}
+
+counter_cache::~counter_cache() {
+    for (auto&& pe : _partitions) {
+        for (auto&& c : pe.second->_cells) {
+            _tracker.account(-c.second->memory_usage());
+            _tracker._stats.cells--;
+        }
+        _tracker.account(-pe.second->memory_usage());
+    }
+}
+
+lw_shared_ptr<counter_cache::cell_entry>*
+counter_cache::find_cell(partition_entry& pe, position_in_partition_view pos, column_id id) {
+    auto it = pe._cells.find(cell_address { position_in_partition(pos), id });
+    return it == pe._cells.end() ? nullptr : &it->second;
+}
+
+void counter_cache::remove_cell(cell_entry& ce) noexcept {
+    auto& pe = ce._parent;
+    _tracker.account(-ce.memory_usage());
+    _tracker._stats.cells--;
+    // The keys are members of the entries, so erase by iterator. Erasing
+    // the entry may destroy it, so ce must not be used afterwards.
+    pe._cells.erase(pe._cells.find(ce._address));
+    if (pe._cells.empty()) {
+        _tracker.account(-pe.memory_usage());
+        _partitions.erase(_partitions.find(pe._key));
+    }
+}
+
+void counter_cache::invalidate_cell(cell_entry& ce) noexcept {
+    if (!ce._valid) {
+        return;
+    }
+    _tracker._stats.invalidations++;
+    ce._valid = false;
+    if (!ce._pending_writes) {
+        remove_cell(ce);
+    }
+}
+
+void counter_cache::invalidate_partition(partition_entry& pe) noexcept {
+    // invalidate_cell() may remove the cells and the partition_entry itself.
+    std::vector<lw_shared_ptr<cell_entry>> cells;
+    cells.reserve(pe._cells.size());
+    for (auto&& c : pe._cells) {
+        cells.emplace_back(c.second);
+    }
+    for (auto&& ce : cells) {
+        invalidate_cell(*ce);
+    }
+}
+
+void counter_cache::complete_write(cell_entry& ce, bool success) noexcept {
+    if (!success) {
+        invalidate_cell(ce);
+    }
+    if (--ce._pending_writes) {
+        return;
+    }
+    if (!ce._valid) {
+        if (ce._drained) {
+            ce._drained->set_value();
+        }
+        remove_cell(ce);
+        return;
+    }
+    _tracker.touch(ce);
+    _tracker.evict_if_needed();
+}
+
+stdx::optional<counter_cache::write> counter_cache::transform_counter_updates_to_shards(mutation& m, uint64_t clock_offset) {
+    auto& mp = m.partition();
+    auto pit = _partitions.find(m.decorated_key());
+    if (pit == _partitions.end() || mp.partition_tombstone() || !mp.row_tombstones().empty()) {
+        _tracker._stats.misses++;
+        return { };
+    }
+    auto& pe = *pit->second;
+
+    // First, check that all cells are cached...
+    std::vector<cell_entry*> cells;
+    bool hit = true;
+    auto find_cells = [&] (position_in_partition_view pos, const row& r) {
+        r.for_each_cell([&] (column_id id, const atomic_cell_or_collection& ac_o_c) {
+            if (!hit) {
+                return;
+            }
+            auto ce = find_cell(pe, pos, id);
+            if (!ce || !(*ce)->_valid || !ac_o_c.as_atomic_cell().is_live()) {
+                hit = false;
+                return;
+            }
+            cells.emplace_back(ce->get());
+        });
+    };
+    find_cells(position_in_partition_view(position_in_partition_view::static_row_tag_t()), mp.static_row());
+    for (auto&& cr : mp.clustered_rows()) {
+        if (!hit || cr.row().deleted_at()) {
+            hit = false;
+            break;
+        }
+        find_cells(position_in_partition_view(position_in_partition_view::clustering_row_tag_t(), cr.key()), cr.row().cells());
+    }
+    if (!hit) {
+        _tracker._stats.misses++;
+        return { };
+    }
+    _tracker._stats.hits++;
+
+    // ...then advance their shards. Nothing below may defer.
+    write w;
+    w._cache = this;
+    w._cells.reserve(cells.size());
+    auto cell = cells.begin();
+    auto transform_row = [&] (row& r) {
+        r.for_each_cell([&] (column_id, atomic_cell_or_collection& ac_o_c) {
+            auto& ce = **cell++;
+            auto acv = ac_o_c.as_atomic_cell();
+            ce._shard.update(acv.counter_update_value(), clock_offset + 1);
+            ac_o_c = counter_cell_builder::from_single_shard(acv.timestamp(), ce._shard);
+            ce._pending_writes++;
+            ce.unlink(); // not evictable while in flight
+            w._cells.emplace_back(ce.shared_from_this());
+        });
+    };
+    transform_row(mp.static_row());
+    for (auto&& cr : mp.clustered_rows()) {
+        transform_row(cr.row().cells());
+    }
+    return std::move(w);
+}
+
+future<> counter_cache::prepare_for_read(const mutation& m) {
+    auto& mp = m.partition();
+    auto pit = _partitions.find(m.decorated_key());
+    if (pit == _partitions.end()) {
+        return make_ready_future<>();
+    }
+    auto& pe = *pit->second;
+
+    std::vector<lw_shared_ptr<cell_entry>> cells;
+    auto has_tombstones = mp.partition_tombstone() || !mp.row_tombstones().empty();
+    if (has_tombstones) {
+        for (auto&& c : pe._cells) {
+            cells.emplace_back(c.second);
+        }
+    } else {
+        auto add_cells = [&] (position_in_partition_view pos, const row& r) {
+            r.for_each_cell([&] (column_id id, const atomic_cell_or_collection&) {
+                auto ce = find_cell(pe, pos, id);
+                if (ce) {
+                    cells.emplace_back(*ce);
+                }
+            });
+        };
+        add_cells(position_in_partition_view(position_in_partition_view::static_row_tag_t()), mp.static_row());
+        for (auto&& cr : mp.clustered_rows()) {
+            add_cells(position_in_partition_view(position_in_partition_view::clustering_row_tag_t(), cr.key()), cr.row().cells());
+        }
+    }
+
+    std::vector<future<>> drained;
+    for (auto&& ce : cells) {
+        invalidate_cell(*ce);
+        if (ce->_pending_writes) {
+            if (!ce->_drained) {
+                ce->_drained.emplace();
+            }
+            drained.emplace_back(ce->_drained->get_shared_future());
+        }
+    }
+    if (drained.empty()) {
+        return make_ready_future<>();
+    }
+    return when_all(drained.begin(), drained.end()).discard_result();
+}
+
+counter_cache::write counter_cache::populate(const mutation& m) {
+    write w;
+    w._cache = this;
+
+    auto& dk = m.decorated_key();
+    auto pit = _partitions.find(dk);
+    if (pit == _partitions.end()) {
+        auto pe = std::make_unique<partition_entry>(*this, *_key_schema, dk);
+        _tracker.account(pe->memory_usage());
+        pit = _partitions.emplace(dk, std::move(pe)).first;
+    }
+    auto& pe = *pit->second;
+
+    auto populate_row = [&] (position_in_partition_view pos, const row& r) {
+        r.for_each_cell([&] (column_id id, const atomic_cell_or_collection& ac_o_c) {
+            auto acv = ac_o_c.as_atomic_cell();
+            if (!acv.is_live()) {
+                return;
+            }
+            auto cs = counter_cell_view(acv).local_shard();
+            if (!cs) {
+                return;
+            }
+            auto address = cell_address { position_in_partition(pos), id };
+            auto it = pe._cells.find(address);
+            if (it != pe._cells.end()) {
+                // prepare_for_read() should have got rid of it, unless the
+                // caller did not hold the cell locks.
+                if (it->second->_pending_writes) {
+                    return;
+                }
+                _tracker.account(-it->second->memory_usage());
+                _tracker._stats.cells--;
+                pe._cells.erase(it);
+            }
+            auto ce = make_lw_shared<cell_entry>(pe, address, counter_shard(*cs));
+            _tracker.account(ce->memory_usage());
+            _tracker._stats.cells++;
+            ce->_pending_writes++;
+            w._cells.emplace_back(ce);
+            pe._cells.emplace(std::move(address), std::move(ce));
+        });
+    };
+    populate_row(position_in_partition_view(position_in_partition_view::static_row_tag_t()), m.partition().static_row());
+    for (auto&& cr : m.partition().clustered_rows()) {
+        populate_row(position_in_partition_view(position_in_partition_view::clustering_row_tag_t(), cr.key()), cr.row().cells());
+    }
+
+    if (pe._cells.empty()) {
+        _tracker.account(-pe.memory_usage());
+        _partitions.erase(pit);
+    }
+    return w;
+}
+
+namespace {
+
+// Detects whether a mutation contains any tombstones.
+class tombstone_detector final : public mutation_partition_visitor {
+    bool _found = false;
+public:
+    bool found() const { return _found; }
+
+    virtual void accept_partition_tombstone(tombstone t) override {
+        _found |= bool(t);
+    }
+    virtual void accept_static_cell(column_id, atomic_cell_view cell) override {
+        _found |= !cell.is_live();
+    }
+    virtual void accept_static_cell(column_id, collection_mutation_view) override { }
+    virtual void accept_row_tombstone(const range_tombstone&) override {
+        _found = true;
+    }
+    virtual void accept_row(position_in_partition_view, const row_tombstone& deleted_at, const row_marker&, is_dummy, is_continuous) override {
+        _found |= bool(deleted_at);
+    }
+    virtual void accept_row_cell(column_id, atomic_cell_view cell) override {
+        _found |= !cell.is_live();
+    }
+    virtual void accept_row_cell(column_id, collection_mutation_view) override { }
+};
+
+}
+
+void counter_cache::invalidate(const schema& s, const frozen_mutation& fm) {
+    if (_partitions.empty()) {
+        return;
+    }
+    auto dk = fm.decorated_key(s);
+    if (!_partitions.count(dk)) {
+        return;
+    }
+    tombstone_detector td;
+    fm.partition().accept(s, td);
+    if (td.found()) {
+        invalidate(dk);
+    }
+}
+
+void counter_cache::invalidate(const dht::decorated_key& dk) {
+    auto pit = _partitions.find(dk);
+    if (pit != _partitions.end()) {
+        invalidate_partition(*pit->second);
+    }
+}
+
+void counter_cache::invalidate() {
+    std::vector<partition_entry*> partitions;
+    partitions.reserve(_partitions.size());
+    for (auto&& pe : _partitions) {
+        partitions.emplace_back(pe.second.get());
+    }
+    for (auto pe : partitions) {
+        invalidate_partition(*pe);
+    }
+}
+
+void counter_cache_tracker::evict_if_needed() noexcept {
+    while (_stats.memory > _max_memory && !_lru.empty()) {
+        auto& ce = _lru.front();
+        _stats.evictions++;
+        ce._parent._cache.remove_cell(ce);
+    }
+}
@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2017 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unordered_map>
+#include <boost/intrusive/list.hpp>
+
+#include "core/shared_future.hh"
+#include "counters.hh"
+#include "mutation.hh"
+#include "position_in_partition.hh"
+
+struct counter_cache_stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t invalidations = 0;
+    uint64_t cells = 0;
+    uint64_t memory = 0;
+};
+
+class counter_cache_tracker;
+
+// Keeps the local counter shard (value and logical clock) of recently updated
+// counter cells of a table, so that a counter update which only touches
+// cached cells can be transformed into shards without reading the current
+// state of the cells, and without taking the cell locks.
+//
+// Correctness relies on the following invariants:
+//
+//  - An entry is created only by an update which holds the cell locks and
+//    has read the cell state, so at that point it reflects all the updates
+//    applied so far.
+//
+//  - Updates served from the cache (hits) advance the cached shard
+//    synchronously, so concurrent hits get consecutive logical clocks.
+//
+//  - An entry with updates in flight is never evicted. An entry can be
+//    invalidated at any time, but it is removed only once the updates in
+//    flight complete, and the slow path waits for that before reading the
+//    cell state, so that it observes them.
+//
+// Tombstones make an update go through the slow path and invalidate the
+// affected entries; tombstones applied by other means (e.g. counter deletes
+// coordinated by another replica) must be reported with invalidate().
+class counter_cache {
+    class partition_entry;
+
+    struct cell_address {
+        position_in_partition position;
+        column_id id;
+    };
+
+    class cell_entry : public bi::list_base_hook<bi::link_mode<bi::auto_unlink>>,
+                       public enable_lw_shared_from_this<cell_entry> {
+        partition_entry& _parent;
+        cell_address _address;
+        counter_shard _shard;
+        unsigned _pending_writes = 0;
+        bool _valid = true;
+        stdx::optional<shared_promise<>> _drained;
+
+        friend class counter_cache;
+        friend class counter_cache_tracker;
+    public:
+        cell_entry(partition_entry& parent, cell_address address, counter_shard shard)
+            : _parent(parent)
+            , _address(std::move(address))
+            , _shard(shard)
+        { }
+
+        size_t memory_usage() const {
+            auto& pos = _address.position;
+            return sizeof(cell_entry) + (pos.has_clustering_key() ? pos.key().external_memory_usage() : 0);
+        }
+
+        class hasher {
+            const schema* _schema;
+        public:
+            explicit hasher(const schema& s) : _schema(&s) { }
+            size_t operator()(const cell_address& ca) const;
+        };
+
+        class equal_compare {
+            position_in_partition::equal_compare _cmp;
+        public:
+            explicit equal_compare(const schema& s) : _cmp(s) { }
+            bool operator()(const cell_address& a, const cell_address& b) const {
+                return a.id == b.id && _cmp(a.position, b.position);
+            }
+        };
+    };
+
+    class partition_entry {
+        counter_cache& _cache;
+        dht::decorated_key _key;
+        std::unordered_map<cell_address, lw_shared_ptr<cell_entry>, cell_entry::hasher, cell_entry::equal_compare> _cells;
+
+        friend class counter_cache;
+    public:
+        partition_entry(counter_cache& cache, const schema& s, dht::decorated_key key)
+            : _cache(cache)
+            , _key(std::move(key))
+            , _cells(4, cell_entry::hasher(s), cell_entry::equal_compare(s))
+        { }
+
+        size_t memory_usage() const {
+            return sizeof(partition_entry) + _key.key().external_memory_usage();
+        }
+    };
+
+    struct partition_hasher {
+        size_t operator()(const dht::decorated_key& dk) const {
+            return std::hash<dht::decorated_key>()(dk);
+        }
+    };
+
+    // Clustering keys are hashed and compared with the schema the cache was
+    // created with. Key columns cannot change, so it is fine to keep using it
+    // after schema changes.
+    schema_ptr _key_schema;
+    schema_ptr _schema;
+    counter_cache_tracker& _tracker;
+    std::unordered_map<dht::decorated_key, std::unique_ptr<partition_entry>, partition_hasher, dht::decorated_key_equals_comparator> _partitions;
+private:
+    lw_shared_ptr<cell_entry>* find_cell(partition_entry& pe, position_in_partition_view pos, column_id id);
+    void invalidate_cell(cell_entry& ce) noexcept;
+    void invalidate_partition(partition_entry& pe) noexcept;
+    void remove_cell(cell_entry& ce) noexcept;
+    void complete_write(cell_entry& ce, bool success) noexcept;
+
+    friend class counter_cache_tracker;
+public:
+    // Tracks the cache entries used by a counter update until the update is
+    // applied to the memtable (or fails to be applied).
+    class write {
+        counter_cache* _cache = nullptr;
+        std::vector<lw_shared_ptr<cell_entry>> _cells;
+
+        friend class counter_cache;
+    public:
+        write() = default;
+        write(write&& o) noexcept
+            : _cache(std::exchange(o._cache, nullptr))
+            , _cells(std::move(o._cells))
+        { }
+        write& operator=(write&& o) noexcept {
+            if (this != &o) {
+                this->~write();
+                new (this) write(std::move(o));
+            }
+            return *this;
+        }
+        // If the update failed, the cached shards are ahead of what was
+        // applied, so the cells are invalidated.
+        void complete(bool success) noexcept {
+            if (_cache) {
+                for (auto&& ce : _cells) {
+                    _cache->complete_write(*ce, success);
+                }
+                _cells.clear();
+                _cache = nullptr;
+            }
+        }
+        ~write() {
+            complete(false);
+        }
+    };
+public:
+    counter_cache(schema_ptr s, counter_cache_tracker& tracker)
+        : _key_schema(s)
+        , _schema(std::move(s))
+        , _tracker(tracker)
+        , _partitions(16, partition_hasher(), dht::decorated_key_equals_comparator(*_key_schema))
+    { }
+    ~counter_cache();
+
+    counter_cache(const counter_cache&) = delete;
+    counter_cache(counter_cache&&) = delete;
+
+    // Column ids may change, so all cells are invalidated.
+    void set_schema(schema_ptr s) {
+        _schema = std::move(s);
+        invalidate();
+    }
+
+    // Fast path. If all cells of the counter update m are cached and m
+    // contains no tombstones, transforms counter deltas in m into local
+    // shards, as transform_counter_updates_to_shards() would have done, and
+    // returns the write which must be completed once m is applied.
+    // Otherwise, leaves m untouched and returns a disengaged optional.
+    stdx::optional<write> transform_counter_updates_to_shards(mutation& m, uint64_t clock_offset);
+
+    // Slow path, must be called with the cell locks of m held, before
+    // reading the current state of the cells. Invalidates all cached cells
+    // m may affect and waits for the updates in flight which use them.
+    future<> prepare_for_read(const mutation& m);
+
+    // Slow path, caches the local shards of m, which has been transformed
+    // to shards already.
+    write populate(const mutation& m);
+
+    // Invalidates cached cells a mutation with tombstones may have affected.
+    void invalidate(const schema& s, const frozen_mutation& fm);
+    void invalidate(const dht::decorated_key& dk);
+    void invalidate();
+};
+
+// Per-shard LRU and memory budget for the counter caches of all tables.
+class counter_cache_tracker {
+    using lru_type = bi::list<counter_cache::cell_entry,
+        bi::constant_time_size<false>>; // we need this to have bi::auto_unlink on hooks.
+
+    size_t _max_memory;
+    lru_type _lru;
+    counter_cache_stats _stats;
+
+    friend class counter_cache;
+private:
+    void touch(counter_cache::cell_entry& ce) noexcept {
+        ce.unlink();
+        _lru.push_back(ce);
+    }
+    void account(ssize_t delta) noexcept {
+        _stats.memory += delta;
+    }
+    void evict_if_needed() noexcept;
+public:
+    explicit counter_cache_tracker(size_t max_memory)
+        : _max_memory(max_memory)
+    { }
+
+    bool enabled() const {
+        return _max_memory;
+    }
+
+    const counter_cache_stats& stats() const {
+        return _stats;
+    }
+};
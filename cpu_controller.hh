@@ -86,4 +86,46 @@ class flush_cpu_controller {
     flush_cpu_controller(flush_cpu_controller&&) = default;
 };
 
+// Simple proportional controller to adjust shares of compaction.
+//
+// Compaction runs behind flushes: every flushed memtable adds work, which the compaction strategy
+// of the table can estimate as the number of bytes it has yet to write, its backlog. Running
+// compaction too slowly lets the backlog grow, and with it the number of sstables reads have to
+// touch. Running it too fast steals the CPU from incoming requests for no reason.
+//
+// The input of the controller is the backlog of all tables, normalized by the amount of memory
+// that can be flushed at once (i.e. how many memtables' worth of data are waiting for
+// compaction). Unlike with virtual dirty, there is no hard limit to protect, so the quota simply
+// grows with the backlog: it is a piecewise linear function of it, going through the control
+// points set in adjust(), and flat past the last one.
+class compaction_cpu_controller {
+    float _current_quota = 0.0f;
+    float _current_backlog = 0.0f;
+    std::function<float()> _backlog;
+    std::chrono::milliseconds _interval;
+    timer<> _update_timer;
+
+    seastar::thread_scheduling_group _scheduling_group;
+    seastar::thread_scheduling_group *_current_scheduling_group = nullptr;
+
+    void adjust();
+public:
+    seastar::thread_scheduling_group* scheduling_group() {
+        return _current_scheduling_group;
+    }
+    float current_quota() const {
+        return _current_quota;
+    }
+    float current_backlog() const {
+        return _current_backlog;
+    }
+
+    struct disabled {
+        seastar::thread_scheduling_group *backup;
+    };
+    compaction_cpu_controller(disabled d) : _scheduling_group(std::chrono::nanoseconds(0), 0), _current_scheduling_group(d.backup) {}
+    compaction_cpu_controller(std::chrono::milliseconds interval, std::function<float()> backlog);
+    compaction_cpu_controller(compaction_cpu_controller&&) = default;
+};
+
 
@@ -272,13 +272,28 @@ statement_restrictions::statement_restrictions(database& db,
     }
 
     if (_uses_secondary_indexing && !for_view) {
-        fail(unimplemented::cause::INDEXES);
-#if 0
+        // Only a single EQ restriction on an indexed column can be served
+        // from the index view so far.
+        bool supported = type.is_select()
+                && _partition_key_restrictions->empty()
+                && _clustering_columns_restrictions->empty()
+                && _nonprimary_key_restrictions->size() == 1
+                && get_index_restriction()->is_EQ()
+                && _nonprimary_key_restrictions->has_supporting_index(sim);
+        if (!supported) {
+            fail(unimplemented::cause::INDEXES);
+        }
         validate_secondary_index_selections(selects_only_static_columns);
-#endif
     }
 }
 
+::shared_ptr<single_column_restriction> statement_restrictions::get_index_restriction() const {
+    if (_nonprimary_key_restrictions->empty()) {
+        return {};
+    }
+    return _nonprimary_key_restrictions->restrictions().begin()->second;
+}
+
 void statement_restrictions::add_restriction(::shared_ptr<restriction> restriction) {
     if (restriction->is_multi_column()) {
         _clustering_columns_restrictions = _clustering_columns_restrictions->merge_to(_schema, restriction);
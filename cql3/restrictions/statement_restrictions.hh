@@ -152,6 +152,12 @@ class statement_restrictions {
         return _uses_secondary_indexing;
     }
 
+    /**
+     * Returns the restriction on a non-primary key column which the index is
+     * queried with, or null if there is none.
+     */
+    ::shared_ptr<single_column_restriction> get_index_restriction() const;
+
     ::shared_ptr<primary_key_restrictions<partition_key>> get_partition_key_restrictions() const {
         return _partition_key_restrictions;
     }
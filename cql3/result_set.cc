@@ -40,6 +40,7 @@
  */
 
 #include "cql3/result_set.hh"
+#include "net/byteorder.hh"
 
 namespace cql3 {
 
@@ -136,19 +137,21 @@ result_set::result_set(::shared_ptr<metadata> metadata)
 { }
 
 size_t result_set::size() const {
-    return _rows.size();
+    return _rows.size() + _serialized_row_count;
 }
 
 bool result_set::empty() const {
-    return _rows.empty();
+    return !size();
 }
 
 void result_set::add_row(std::vector<bytes_opt> row) {
     assert(row.size() == _metadata->value_count());
+    deserialize_rows();
     _rows.emplace_back(std::move(row));
 }
 
 void result_set::add_column_value(bytes_opt value) {
+    deserialize_rows();
     if (_rows.empty() || _rows.back().size() == _metadata->value_count()) {
         std::vector<bytes_opt> row;
         row.reserve(_metadata->value_count());
@@ -158,11 +161,57 @@ void result_set::add_column_value(bytes_opt value) {
     _rows.back().emplace_back(std::move(value));
 }
 
+void result_set::add_serialized_value(bytes_view value) {
+    auto size = net::hton(int32_t(value.size()));
+    _serialized_rows.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    _serialized_rows.write(value);
+}
+
+void result_set::add_serialized_null() {
+    auto size = net::hton(int32_t(-1));
+    _serialized_rows.write(reinterpret_cast<const char*>(&size), sizeof(size));
+}
+
+void result_set::add_serialized_row() {
+    assert(_rows.empty());
+    ++_serialized_row_count;
+}
+
+const bytes_ostream* result_set::serialized_rows() const {
+    return _serialized_row_count ? &_serialized_rows : nullptr;
+}
+
+void result_set::deserialize_rows() const {
+    if (!_serialized_row_count) {
+        return;
+    }
+    auto v = _serialized_rows.linearize();
+    auto value_count = _metadata->value_count();
+    for (size_t i = 0; i < _serialized_row_count; ++i) {
+        std::vector<bytes_opt> row;
+        row.reserve(value_count);
+        for (uint32_t j = 0; j < value_count; ++j) {
+            auto size = read_simple<int32_t>(v);
+            if (size < 0) {
+                row.emplace_back();
+            } else {
+                row.emplace_back(bytes(v.begin(), size));
+                v.remove_prefix(size);
+            }
+        }
+        _rows.emplace_back(std::move(row));
+    }
+    _serialized_rows = { };
+    _serialized_row_count = 0;
+}
+
 void result_set::reverse() {
+    deserialize_rows();
     std::reverse(_rows.begin(), _rows.end());
 }
 
 void result_set::trim(size_t limit) {
+    deserialize_rows();
     if (_rows.size() > limit) {
         _rows.resize(limit);
     }
@@ -177,6 +226,7 @@ const metadata& result_set::get_metadata() const {
 }
 
 const std::deque<std::vector<bytes_opt>>& result_set::rows() const {
+    deserialize_rows();
     return _rows;
 }
 
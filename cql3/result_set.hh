@@ -42,6 +42,7 @@
 #pragma once
 
 #include <deque>
+#include "bytes_ostream.hh"
 #include <vector>
 #include "enum_set.hh"
 #include "service/pager/paging_state.hh"
@@ -134,7 +135,16 @@ class prepared_metadata {
 class result_set {
 public:
     ::shared_ptr<metadata> _metadata;
-    std::deque<std::vector<bytes_opt>> _rows;
+    mutable std::deque<std::vector<bytes_opt>> _rows;
+private:
+    // Rows of trivial selections are written here by result_set_builder
+    // directly in the CQL wire format, i.e. as value_count() [bytes] values
+    // per row, so that they can be sent without deserializing each value.
+    // They are moved to _rows when something needs them in that form.
+    mutable bytes_ostream _serialized_rows;
+    mutable size_t _serialized_row_count = 0;
+private:
+    void deserialize_rows() const;
 public:
     result_set(std::vector<::shared_ptr<column_specification>> metadata_);
 
@@ -148,12 +158,23 @@ class result_set {
 
     void add_column_value(bytes_opt value);
 
+    // Append a value of the current serialized row. Rows must be
+    // completed with add_serialized_row().
+    void add_serialized_value(bytes_view value);
+    void add_serialized_null();
+    void add_serialized_row();
+
+    // Returns the rows in the CQL wire format, or nullptr if they are
+    // not kept in that form.
+    const bytes_ostream* serialized_rows() const;
+
     void reverse();
 
     void trim(size_t limit);
 
     template<typename RowComparator>
     void sort(const RowComparator& cmp) {
+        deserialize_rows();
         std::sort(_rows.begin(), _rows.end(), std::ref(cmp));
     }
 
@@ -105,6 +105,7 @@ class simple_selection : public selection {
     { }
 
     virtual bool is_wildcard() const override { return _is_wildcard; }
+    virtual bool is_trivial() const override { return true; }
     virtual bool is_aggregate() const override { return false; }
 protected:
     class simple_selectors : public selectors {
@@ -256,6 +257,9 @@ result_set_builder::result_set_builder(const selection& s, gc_clock::time_point
     , _selectors(s.new_selectors())
     , _now(now)
     , _cql_serialization_format(sf)
+    // Columns added for post-query ordering are not sent, so rows which have
+    // them cannot be serialized as they are built.
+    , _serialize(s.is_trivial() && _result_set->get_metadata().column_count() == s.get_column_count())
 {
     if (s._collect_timestamps) {
         _timestamps.resize(s._columns.size(), 0);
@@ -266,6 +270,10 @@ result_set_builder::result_set_builder(const selection& s, gc_clock::time_point
 }
 
 void result_set_builder::add_empty() {
+    if (_serialize) {
+        _result_set->add_serialized_null();
+        return;
+    }
     current->emplace_back();
     if (!_timestamps.empty()) {
         _timestamps[current->size() - 1] = api::missing_timestamp;
@@ -276,10 +284,30 @@ void result_set_builder::add_empty() {
 }
 
 void result_set_builder::add(bytes_opt value) {
+    if (_serialize) {
+        if (value) {
+            _result_set->add_serialized_value(*value);
+        } else {
+            _result_set->add_serialized_null();
+        }
+        return;
+    }
     current->emplace_back(std::move(value));
 }
 
+void result_set_builder::add_key_component(bytes_view value) {
+    if (_serialize) {
+        _result_set->add_serialized_value(value);
+        return;
+    }
+    current->emplace_back(to_bytes(value));
+}
+
 void result_set_builder::add(const column_definition& def, const query::result_atomic_cell_view& c) {
+    if (_serialize) {
+        _result_set->add_serialized_value(c.value());
+        return;
+    }
     current->emplace_back(get_value(def.type, c));
     if (!_timestamps.empty()) {
         _timestamps[current->size() - 1] = c.timestamp();
@@ -295,11 +323,22 @@ void result_set_builder::add(const column_definition& def, const query::result_a
 }
 
 void result_set_builder::add_collection(const column_definition& def, bytes_view c) {
+    if (_serialize) {
+        _result_set->add_serialized_value(c);
+        return;
+    }
     current->emplace_back(to_bytes(c));
     // timestamps, ttls meaningless for collections
 }
 
 void result_set_builder::new_row() {
+    if (_serialize) {
+        if (_in_row) {
+            _result_set->add_serialized_row();
+        }
+        _in_row = true;
+        return;
+    }
     if (current) {
         _selectors->add_input_row(_cql_serialization_format, *this);
         if (!_selectors->is_aggregate()) {
@@ -316,6 +355,13 @@ void result_set_builder::new_row() {
 }
 
 std::unique_ptr<result_set> result_set_builder::build() {
+    if (_serialize) {
+        if (_in_row) {
+            _result_set->add_serialized_row();
+            _in_row = false;
+        }
+        return std::move(_result_set);
+    }
     if (current) {
         _selectors->add_input_row(_cql_serialization_format, *this);
         _result_set->add_row(_selectors->get_output_row(_cql_serialization_format));
@@ -366,8 +412,9 @@ void result_set_builder::visitor::accept_new_partition(uint32_t row_count) {
 void result_set_builder::visitor::accept_new_row(const clustering_key& key,
         const query::result_row_view& static_row,
         const query::result_row_view& row) {
-    _clustering_key = key.explode(_schema);
+    _clustering_key.assign(key.begin(_schema), key.end(_schema));
     accept_new_row(static_row, row);
+    _clustering_key.clear();
 }
 
 void result_set_builder::visitor::accept_new_row(
@@ -379,11 +426,11 @@ void result_set_builder::visitor::accept_new_row(
     for (auto&& def : _selection.get_columns()) {
         switch (def->kind) {
         case column_kind::partition_key:
-            _builder.add(_partition_key[def->component_index()]);
+            _builder.add_key_component(_partition_key[def->component_index()]);
             break;
         case column_kind::clustering_key:
             if (_clustering_key.size() > def->component_index()) {
-                _builder.add(_clustering_key[def->component_index()]);
+                _builder.add_key_component(_clustering_key[def->component_index()]);
             } else {
                 _builder.add({});
             }
@@ -407,7 +454,7 @@ void result_set_builder::visitor::accept_partition_end(
         auto static_row_iterator = static_row.iterator();
         for (auto&& def : _selection.get_columns()) {
             if (def->is_partition_key()) {
-                _builder.add(_partition_key[def->component_index()]);
+                _builder.add_key_component(_partition_key[def->component_index()]);
             } else if (def->is_static()) {
                 add_value(*def, static_row_iterator);
             } else {
@@ -98,6 +98,12 @@ class selection {
         return false;
     }
 
+    // Returns true if the selection outputs the selected columns as they are,
+    // without applying any functions to them.
+    virtual bool is_trivial() const {
+        return false;
+    }
+
     /**
      * Checks if this selection contains static columns.
      * @return <code>true</code> if this selection contains static columns, <code>false</code> otherwise;
@@ -237,10 +243,16 @@ class result_set_builder {
     std::vector<int32_t> _ttls;
     const gc_clock::time_point _now;
     cql_serialization_format _cql_serialization_format;
+    // For trivial selections, values are not collected in current and passed
+    // through the selectors, but written directly to the result set in the
+    // CQL wire format.
+    const bool _serialize;
+    bool _in_row = false;
 public:
     result_set_builder(const selection& s, gc_clock::time_point now, cql_serialization_format sf);
     void add_empty();
     void add(bytes_opt value);
+    void add_key_component(bytes_view value);
     void add(const column_definition& def, const query::result_atomic_cell_view& c);
     void add_collection(const column_definition& def, bytes_view c);
     void new_row();
@@ -256,7 +268,8 @@ class result_set_builder {
         const selection& _selection;
         uint32_t _row_count;
         std::vector<bytes> _partition_key;
-        std::vector<bytes> _clustering_key;
+        // Valid only while the row is being accepted.
+        std::vector<bytes_view> _clustering_key;
     public:
         visitor(cql3::selection::result_set_builder& builder, const schema& s, const selection&);
         visitor(visitor&&) = default;
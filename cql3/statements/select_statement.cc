@@ -50,7 +50,11 @@
 #include "query_result_merger.hh"
 #include "service/pager/query_pagers.hh"
 #include <seastar/core/execution_stage.hh>
+#include <boost/range/adaptor/transformed.hpp>
+#include <boost/range/algorithm/find.hpp>
+#include <boost/range/algorithm/find_if.hpp>
 #include "view_info.hh"
+#include "index/secondary_index_manager.hh"
 
 namespace cql3 {
 
@@ -244,6 +248,10 @@ select_statement::do_execute(distributed<service::storage_proxy>& proxy,
 
     ++_stats.reads;
 
+    if (_restrictions->uses_secondary_indexing()) {
+        return execute_indexed(proxy, state, options, limit, now);
+    }
+
     auto command = ::make_lw_shared<query::read_command>(_schema->id(), _schema->version(),
         make_partition_slice(options), limit, now, tracing::make_trace_info(state.get_trace_state()), query::max_partitions, options.get_timestamp(state));
 
@@ -341,8 +349,8 @@ select_statement::execute_internal(distributed<service::storage_proxy>& proxy,
                                    service::query_state& state,
                                    const query_options& options)
 {
-    if (options.get_specific_options().page_size > 0) {
-        // need page, use regular execute
+    if (options.get_specific_options().page_size > 0 || _restrictions->uses_secondary_indexing()) {
+        // need page or index, use regular execute
         return do_execute(proxy, state, options);
     }
     int32_t limit = get_limit(options);
@@ -374,6 +382,259 @@ select_statement::execute_internal(distributed<service::storage_proxy>& proxy,
     }
 }
 
+namespace {
+
+// Collects the clustering keys of the rows of the index view, which are the
+// primary keys of the base rows.
+struct index_view_rows_collector {
+    std::vector<clustering_key>& rows;
+
+    void accept_new_partition(const partition_key&, uint32_t) { }
+    void accept_new_partition(uint32_t) { }
+    void accept_new_row(const clustering_key& key, const query::result_row_view&, const query::result_row_view&) {
+        rows.push_back(key);
+    }
+    void accept_new_row(const query::result_row_view&, const query::result_row_view&) { }
+    void accept_partition_end(const query::result_row_view&) { }
+};
+
+// Passes on to the result set the base rows which still match the
+// restriction on the indexed column. The view backing the index is updated
+// asynchronously, so it may still list rows whose indexed column has since
+// changed, or which are gone.
+class indexed_rows_filter : public cql3::selection::result_set_builder::visitor {
+    const query::partition_slice& _slice;
+    const column_definition& _column;
+    bytes_view _value;
+    uint32_t _matched = 0;
+private:
+    bool matches(const query::result_row_view& static_row, const query::result_row_view& row) const {
+        auto& columns = _column.is_static() ? _slice.static_columns : _slice.regular_columns;
+        auto i = _column.is_static() ? static_row.iterator() : row.iterator();
+        for (auto id : columns) {
+            if (id == _column.id) {
+                auto cell = i.next_atomic_cell();
+                return cell && _column.type->equal(cell->value(), _value);
+            }
+            if (_schema.column_at(_column.kind, id).type->is_multi_cell()) {
+                i.next_collection_cell();
+            } else {
+                i.next_atomic_cell();
+            }
+        }
+        return false;
+    }
+public:
+    indexed_rows_filter(cql3::selection::result_set_builder& builder, const schema& s, const cql3::selection::selection& selection,
+            const query::partition_slice& slice, const column_definition& column, bytes_view value)
+        : visitor(builder, s, selection), _slice(slice), _column(column), _value(value) { }
+
+    void accept_new_row(const clustering_key& key, const query::result_row_view& static_row, const query::result_row_view& row) {
+        if (matches(static_row, row)) {
+            ++_matched;
+            visitor::accept_new_row(key, static_row, row);
+        }
+    }
+    void accept_new_row(const query::result_row_view& static_row, const query::result_row_view& row) {
+        if (matches(static_row, row)) {
+            ++_matched;
+            visitor::accept_new_row(static_row, row);
+        }
+    }
+    // A partition without rows has no row matching the restriction.
+    void accept_partition_end(const query::result_row_view&) { }
+
+    uint32_t matched() const {
+        return _matched;
+    }
+};
+
+// Base partitions are read this many at a time.
+static constexpr size_t max_concurrent_indexed_reads = 16;
+
+}
+
+std::pair<partition_key, clustering_key>
+select_statement::base_key_of(const schema& view, const clustering_key& view_row) const {
+    // The view is clustered by the base partition key columns, followed by
+    // the base clustering key columns.
+    auto components = view_row.explode(view);
+    auto pk_end = components.begin() + _schema->partition_key_size();
+    return std::make_pair(partition_key::from_exploded(*_schema, std::vector<bytes>(components.begin(), pk_end)),
+            clustering_key::from_exploded(*_schema, std::vector<bytes>(pk_end, components.end())));
+}
+
+future<shared_ptr<cql_transport::messages::result_message>>
+select_statement::execute_indexed(distributed<service::storage_proxy>& proxy,
+                                  service::query_state& state,
+                                  const query_options& options,
+                                  uint32_t limit,
+                                  gc_clock::time_point now)
+{
+    auto restriction = _restrictions->get_index_restriction();
+    auto& cdef = restriction->get_column_def();
+    auto values = restriction->values(options);
+    if (values.size() != 1 || !values[0]) {
+        throw exceptions::invalid_request_exception(sprint("Unsupported null value for indexed column %s", cdef.name_as_text()));
+    }
+
+    auto& db = proxy.local().get_db().local();
+    auto indexes = db.find_column_family(_schema).get_index_manager().list_indexes();
+    auto index = boost::find_if(indexes, [&] (const secondary_index::index& index) {
+        return restriction->is_supported_by(index);
+    });
+    if (index == indexes.end()) {
+        throw exceptions::invalid_request_exception(sprint("No supporting index found for column %s", cdef.name_as_text()));
+    }
+    auto view = db.find_schema(_schema->ks_name(), secondary_index::index_table_name(index->metadata().name()));
+    auto view_key = dht::global_partitioner().decorate_key(*view, partition_key::from_single_value(*view, *values[0]));
+
+    int32_t page_size = options.get_page_size();
+    auto aggregate = _selection->is_aggregate();
+    if (aggregate && page_size <= 0) {
+        page_size = DEFAULT_COUNT_PAGE_SIZE;
+    }
+
+    // Resume after the last base row returned in the previous page.
+    stdx::optional<clustering_key> last;
+    auto paging_state = options.get_paging_state();
+    if (paging_state) {
+        limit = paging_state->get_remaining();
+        auto components = paging_state->get_partition_key().explode(*_schema);
+        if (paging_state->get_clustering_key()) {
+            auto ck = paging_state->get_clustering_key()->explode(*_schema);
+            std::move(ck.begin(), ck.end(), std::back_inserter(components));
+        }
+        last = clustering_key::from_exploded(*view, components);
+    }
+
+    auto cmd = ::make_lw_shared<query::read_command>(_schema->id(), _schema->version(),
+        make_partition_slice(options), query::max_rows, now, tracing::make_trace_info(state.get_trace_state()), query::max_partitions, options.get_timestamp(state));
+    // Base rows are checked against the restriction, so the indexed column
+    // is read even if not selected. It goes last, after the selected ones.
+    auto& indexed_columns = cdef.is_static() ? cmd->slice.static_columns : cmd->slice.regular_columns;
+    if (boost::find(indexed_columns, cdef.id) == indexed_columns.end()) {
+        indexed_columns.push_back(cdef.id);
+    }
+
+    struct indexed_read {
+        dht::decorated_key view_key;
+        cql3::selection::result_set_builder builder;
+        stdx::optional<clustering_key> last;
+        uint32_t remaining;
+        bool exhausted = false;
+    };
+    auto builder = cql3::selection::result_set_builder(*_selection, now, options.get_cql_serialization_format());
+    return do_with(indexed_read{std::move(view_key), std::move(builder), std::move(last), limit},
+            [this, &proxy, &state, &options, cmd, view, page_size, aggregate, now] (indexed_read& r) {
+        // Aggregates read all pages of the index, other queries just one.
+        return repeat([this, &proxy, &state, &options, cmd, view, page_size, aggregate, now, &r] {
+            if (r.exhausted || !r.remaining) {
+                return make_ready_future<stop_iteration>(stop_iteration::yes);
+            }
+            uint32_t rows_to_fetch = page_size > 0 ? std::min<uint32_t>(page_size, r.remaining) : r.remaining;
+            auto range = r.last ? query::clustering_range::make_starting_with({*r.last, false}) : query::clustering_range::make_open_ended_both_sides();
+            query::partition_slice::option_set opts;
+            opts.set<query::partition_slice::option::send_clustering_key>();
+            auto view_cmd = ::make_lw_shared<query::read_command>(view->id(), view->version(),
+                query::partition_slice({ std::move(range) }, { }, { }, opts), rows_to_fetch, now,
+                tracing::make_trace_info(state.get_trace_state()), 1, options.get_timestamp(state));
+            return proxy.local().query(view, view_cmd, { dht::partition_range::make_singular(r.view_key) }, options.get_consistency(), state.get_trace_state())
+                    .then([this, &proxy, &state, &options, cmd, view, view_cmd, rows_to_fetch, aggregate, &r] (foreign_ptr<lw_shared_ptr<query::result>> result) {
+                std::vector<clustering_key> rows;
+                query::result_view::consume(*result, view_cmd->slice, index_view_rows_collector{rows});
+                r.exhausted = rows.size() < rows_to_fetch;
+                if (!rows.empty()) {
+                    r.last = rows.back();
+                }
+                return read_indexed_rows(proxy, state, options, cmd, *view, std::move(rows), r.builder).then([aggregate, &r] (uint32_t matched) {
+                    r.remaining -= matched;
+                    return aggregate ? stop_iteration::no : stop_iteration::yes;
+                });
+            });
+        }).then([this, &r, view, aggregate] {
+            auto rs = r.builder.build();
+            if (!aggregate && !r.exhausted && r.remaining && r.last) {
+                auto keys = base_key_of(*view, *r.last);
+                stdx::optional<clustering_key> ck;
+                if (_schema->clustering_key_size()) {
+                    ck = std::move(keys.second);
+                }
+                rs->get_metadata().set_has_more_pages(::make_shared<service::pager::paging_state>(std::move(keys.first), std::move(ck), r.remaining));
+            }
+            return ::shared_ptr<cql_transport::messages::result_message>(::make_shared<cql_transport::messages::result_message::rows>(std::move(rs)));
+        });
+    });
+}
+
+future<uint32_t> select_statement::read_indexed_rows(distributed<service::storage_proxy>& proxy,
+                                             service::query_state& state,
+                                             const query_options& options,
+                                             lw_shared_ptr<query::read_command> cmd,
+                                             const schema& view,
+                                             std::vector<clustering_key> view_rows,
+                                             cql3::selection::result_set_builder& builder)
+{
+    // Group the rows by partition, in token order, so that each base
+    // partition is read once, with a slice selecting just the matching rows.
+    std::map<dht::decorated_key, query::clustering_row_ranges, dht::decorated_key::less_comparator> partitions(
+            dht::decorated_key::less_comparator(_schema));
+    for (auto&& view_row : view_rows) {
+        auto keys = base_key_of(view, view_row);
+        auto dk = dht::global_partitioner().decorate_key(*_schema, std::move(keys.first));
+        partitions[std::move(dk)].push_back(query::clustering_range::make_singular(std::move(keys.second)));
+    }
+    using partition = std::pair<dht::decorated_key, query::clustering_row_ranges>;
+    auto to_read = boost::copy_range<std::vector<partition>>(partitions | boost::adaptors::transformed([] (auto& p) {
+        return partition(p.first, std::move(p.second));
+    }));
+
+    auto restriction = _restrictions->get_index_restriction();
+    auto value = *restriction->values(options)[0];
+    auto& cdef = restriction->get_column_def();
+
+    // The results of a batch are consumed in order once all its reads
+    // complete, so that rows are returned in token order.
+    return do_with(std::move(to_read), size_t(0), std::move(value), uint32_t(0),
+            [this, &proxy, &state, &options, cmd, &builder, &cdef] (std::vector<partition>& to_read, size_t& next, bytes& value, uint32_t& matched) {
+        return do_until([&] { return next == to_read.size(); }, [this, &proxy, &state, &options, cmd, &builder, &cdef, &to_read, &next, &value, &matched] {
+            auto end = std::min(next + max_concurrent_indexed_reads, to_read.size());
+            std::vector<future<foreign_ptr<lw_shared_ptr<query::result>>>> reads;
+            reads.reserve(end - next);
+            for (; next != end; ++next) {
+                auto& p = to_read[next];
+                auto command = ::make_lw_shared<query::read_command>(*cmd);
+                if (_schema->clustering_key_size()) {
+                    command->slice.set_range(*_schema, p.first.key(), std::move(p.second));
+                }
+                reads.push_back(proxy.local().query(_schema, command, { dht::partition_range::make_singular(p.first) },
+                        options.get_consistency(), state.get_trace_state()));
+            }
+            return when_all(reads.begin(), reads.end()).then([this, cmd, &builder, &cdef, &value, &matched] (auto results) {
+                std::exception_ptr ex;
+                for (auto&& f : results) {
+                    if (f.failed()) {
+                        auto e = f.get_exception();
+                        if (!ex) {
+                            ex = std::move(e);
+                        }
+                    } else if (!ex) {
+                        auto result = f.get0();
+                        indexed_rows_filter filter(builder, *_schema, *_selection, cmd->slice, cdef, value);
+                        query::result_view::consume(*result, cmd->slice, filter);
+                        matched += filter.matched();
+                    }
+                }
+                if (ex) {
+                    std::rethrow_exception(std::move(ex));
+                }
+            });
+        }).then([&matched] {
+            return matched;
+        });
+    });
+}
+
 shared_ptr<cql_transport::messages::result_message>
 select_statement::process_results(foreign_ptr<lw_shared_ptr<query::result>> results,
                                   lw_shared_ptr<query::read_command> cmd,
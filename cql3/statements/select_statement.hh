@@ -138,6 +138,18 @@ class select_statement : public cql_statement {
 private:
     int32_t get_limit(const query_options& options) const;
     bool needs_post_query_ordering() const;
+
+    // Executes a query restricted on an indexed column: reads the primary
+    // keys of the matching rows from the view backing the index, then the
+    // rows themselves from the base table.
+    future<::shared_ptr<cql_transport::messages::result_message>> execute_indexed(distributed<service::storage_proxy>& proxy,
+        service::query_state& state, const query_options& options, uint32_t limit, gc_clock::time_point now);
+    // Reads the base rows given by view_rows into builder, dropping those
+    // which no longer match the restriction. Returns how many were kept.
+    future<uint32_t> read_indexed_rows(distributed<service::storage_proxy>& proxy, service::query_state& state,
+        const query_options& options, lw_shared_ptr<query::read_command> cmd, const schema& view,
+        std::vector<clustering_key> view_rows, selection::result_set_builder& builder);
+    std::pair<partition_key, clustering_key> base_key_of(const schema& view, const clustering_key& view_row) const;
 };
 
 }
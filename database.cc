@@ -53,6 +53,7 @@
 #include <boost/range/algorithm/find.hpp>
 #include <boost/range/algorithm/find_if.hpp>
 #include <boost/range/algorithm/sort.hpp>
+#include <boost/range/algorithm/max_element.hpp>
 #include <boost/range/adaptor/map.hpp>
 #include "frozen_mutation.hh"
 #include "mutation_partition_applier.hh"
@@ -68,6 +69,7 @@
 #include "schema_registry.hh"
 #include "service/priority_manager.hh"
 #include "cell_locking.hh"
+#include "counter_cache.hh"
 #include <seastar/core/execution_stage.hh>
 #include "view_info.hh"
 #include "memtable-sstable.hh"
@@ -160,6 +162,9 @@ column_family::column_family(schema_ptr schema, config config, db::commitlog* cl
     , _index_manager(*this)
     , _counter_cell_locks(std::make_unique<cell_locker>(_schema, cl_stats))
 {
+    if (_schema->is_counter() && _config.counter_cache_tracker && _config.counter_cache_tracker->enabled()) {
+        _counter_cache = std::make_unique<counter_cache>(_schema, *_config.counter_cache_tracker);
+    }
     if (!_config.enable_disk_writes) {
         dblog.warn("Writes disabled, column family no durable.");
     }
@@ -475,6 +480,114 @@ class incremental_reader_selector : public reader_selector {
     }
 };
 
+// Returns a lower bound of the clustering positions the sstable may contain,
+// if its metadata tells. Components after the first one bound the key only
+// while all the preceding ones are fixed.
+static stdx::optional<position_in_partition>
+clustering_lower_bound(const schema& s, const sstables::sstable& sst) {
+    auto& ranges = sst.clustering_components_ranges();
+    if (ranges.empty()) {
+        return { };
+    }
+    std::vector<bytes> prefix;
+    for (auto& r : ranges) {
+        prefix.emplace_back(to_bytes(r.start()->value()));
+        if (r.start()->value() != r.end()->value()) {
+            break;
+        }
+    }
+    auto ckp = clustering_key_prefix::from_exploded(s, std::move(prefix));
+    return position_in_partition(position_in_partition::range_tag_t(), bound_view(ckp, bound_kind::incl_start));
+}
+
+// Merges a partition from sstables which hold disjoint parts of the clustering
+// order, like the time windows of TWCS, opening the pending ones only once the
+// merge reaches their clustering lower bound. A read which stops early, e.g.
+// at its row limit, does not touch the sstables past the point it stopped at.
+//
+// Only sstables without tombstones can be pending: partition and range
+// tombstones are not covered by the min/max column names the lower bound is
+// derived from. Static rows aren't either, so the schema must have none.
+class lazy_sstable_partition_merger final : public streamed_mutation::impl {
+public:
+    struct pending_sstable {
+        position_in_partition lower_bound;
+        sstables::shared_sstable sst;
+    };
+    using opener = std::function<future<streamed_mutation_opt> (const sstables::shared_sstable&)>;
+private:
+    streamed_mutation _merged;
+    // Sorted by lower_bound.
+    std::deque<pending_sstable> _pending;
+    opener _open;
+    streamed_mutation::forwarding _fwd;
+    position_range _range;
+    position_in_partition::less_compare _less;
+    ::cf_stats* _stats;
+private:
+    future<> open_next() {
+        auto sst = std::move(_pending.front().sst);
+        _pending.pop_front();
+        return _open(sst).then([this] (streamed_mutation_opt smo) {
+            if (!smo) {
+                return make_ready_future<>();
+            }
+            auto f = _fwd ? smo->fast_forward_to(_range) : make_ready_future<>();
+            return f.then([this, sm = std::move(*smo)] () mutable {
+                std::vector<streamed_mutation> sms;
+                sms.emplace_back(std::move(_merged));
+                sms.emplace_back(std::move(sm));
+                _merged = merge_mutations(std::move(sms));
+            });
+        });
+    }
+public:
+    lazy_sstable_partition_merger(streamed_mutation merged, std::deque<pending_sstable> pending, opener open,
+                                  streamed_mutation::forwarding fwd, ::cf_stats* stats)
+        : streamed_mutation::impl(merged.schema(), merged.decorated_key(), merged.partition_tombstone())
+        , _merged(std::move(merged))
+        , _pending(std::move(pending))
+        , _open(std::move(open))
+        , _fwd(fwd)
+        , _range(fwd ? position_range::for_static_row() : position_range::full())
+        , _less(*_schema)
+        , _stats(stats)
+    { }
+
+    ~lazy_sstable_partition_merger() {
+        _stats->sstables_skipped_by_time_ordered_reads += _pending.size();
+    }
+
+    virtual future<> fill_buffer() override {
+        return repeat([this] {
+            while (!is_buffer_full() && !_merged.is_buffer_empty()) {
+                if (!_pending.empty() && !_less(_merged.peek_buffer().position(), _pending.front().lower_bound)) {
+                    return open_next().then([] { return stop_iteration::no; });
+                }
+                push_mutation_fragment(_merged.pop_mutation_fragment());
+            }
+            if (is_buffer_full()) {
+                return make_ready_future<stop_iteration>(stop_iteration::yes);
+            }
+            if (!_merged.is_end_of_stream()) {
+                return _merged.fill_buffer().then([] { return stop_iteration::no; });
+            }
+            if (!_pending.empty() && _less(_pending.front().lower_bound, _range.end())) {
+                return open_next().then([] { return stop_iteration::no; });
+            }
+            _end_of_stream = true;
+            return make_ready_future<stop_iteration>(stop_iteration::yes);
+        });
+    }
+
+    virtual future<> fast_forward_to(position_range pr) override {
+        forward_buffer_to(pr.start());
+        _end_of_stream = false;
+        _range = pr;
+        return _merged.fast_forward_to(std::move(pr));
+    }
+};
+
 class single_key_sstable_reader final : public mutation_reader::impl {
     column_family* _cf;
     schema_ptr _schema;
@@ -491,6 +604,23 @@ class single_key_sstable_reader final : public mutation_reader::impl {
     reader_resource_tracker _resource_tracker;
     tracing::trace_state_ptr _trace_state;
     streamed_mutation::forwarding _fwd;
+    std::deque<lazy_sstable_partition_merger::pending_sstable> _lazy;
+private:
+    // Reverse reads consume the whole partition before emitting anything.
+    bool can_open_lazily() const {
+        return _cf->get_compaction_strategy().use_time_ordered_reads()
+            && !_schema->has_static_columns()
+            && !_slice.options.contains(query::partition_slice::option::reversed);
+    }
+
+    // The merger may outlive the reader, so the opener must not refer to it.
+    lazy_sstable_partition_merger::opener make_opener() const {
+        return [s = _schema, pos = _pr.start()->value(), &slice = _slice, &pc = _pc, resource_tracker = _resource_tracker,
+                trace_state = _trace_state, fwd = _fwd] (const sstables::shared_sstable& sst) {
+            tracing::trace(trace_state, "Reading key {} from sstable {}", pos, seastar::value_of([&sst] { return sst->get_filename(); }));
+            return sst->read_row(s, pos, slice, pc, resource_tracker, fwd);
+        };
+    }
 public:
     single_key_sstable_reader(column_family* cf,
                               schema_ptr schema,
@@ -520,21 +650,55 @@ class single_key_sstable_reader final : public mutation_reader::impl {
             return make_ready_future<streamed_mutation_opt>();
         }
         auto candidates = filter_sstable_for_reader(_sstables->select(_pr), *_cf, _schema, _key, _slice);
-        return parallel_for_each(std::move(candidates),
-            [this](const sstables::shared_sstable& sstable) {
-                tracing::trace(_trace_state, "Reading key {} from sstable {}", _pr, seastar::value_of([&sstable] { return sstable->get_filename(); }));
-                return sstable->read_row(_schema, _pr.start()->value(), _slice, _pc, _resource_tracker, _fwd).then([this](auto smo) {
+        if (can_open_lazily()) {
+            auto eager_end = boost::remove_if(candidates, [this] (const sstables::shared_sstable& sst) {
+                if (sst->get_stats_metadata().estimated_tombstone_drop_time.bin.size()) {
+                    return false;
+                }
+                auto lower_bound = clustering_lower_bound(*_schema, *sst);
+                if (!lower_bound) {
+                    return false;
+                }
+                _lazy.push_back({std::move(*lower_bound), sst});
+                return true;
+            });
+            candidates.erase(eager_end, candidates.end());
+            position_in_partition::less_compare less(*_schema);
+            std::sort(_lazy.begin(), _lazy.end(), [&less] (auto& a, auto& b) {
+                return less(a.lower_bound, b.lower_bound);
+            });
+        }
+        auto open = make_opener();
+        return parallel_for_each(std::move(candidates), [this, open] (const sstables::shared_sstable& sstable) {
+            return open(sstable).then([this] (auto smo) {
+                if (smo) {
+                    _mutations.emplace_back(std::move(*smo));
+                }
+            });
+        }).then([this, open] {
+            // The partition may not be in any sstable, so open the pending
+            // ones, in order, until one has it.
+            return do_until([this] { return !_mutations.empty() || _lazy.empty(); }, [this, open] {
+                auto sst = std::move(_lazy.front().sst);
+                _lazy.pop_front();
+                return open(sst).then([this] (auto smo) {
                     if (smo) {
                         _mutations.emplace_back(std::move(*smo));
                     }
                 });
-        }).then([this] () -> streamed_mutation_opt {
+            });
+        }).then([this, open] () -> streamed_mutation_opt {
             _done = true;
             if (_mutations.empty()) {
                 return { };
             }
             _sstable_histogram.add(_mutations.size());
-            return merge_mutations(std::move(_mutations));
+            auto merged = merge_mutations(std::move(_mutations));
+            if (_lazy.empty()) {
+                return std::move(merged);
+            }
+            _cf->cf_stats()->time_ordered_reads++;
+            return make_streamed_mutation<lazy_sstable_partition_merger>(std::move(merged), std::move(_lazy), open, _fwd, _cf->cf_stats());
         });
     }
 };
@@ -581,7 +745,7 @@ column_family::make_sstable_reader(schema_ptr s,
         }
     } else {
         if (config.resources_sem) {
-            auto ms = mutation_source([&config, sstables=std::move(sstables)] (
+            auto ms = mutation_source([&config, sstables=std::move(sstables), this] (
                         schema_ptr s,
                         const dht::partition_range& pr,
                         const query::partition_slice& slice,
@@ -589,17 +753,13 @@ column_family::make_sstable_reader(schema_ptr s,
                         tracing::trace_state_ptr trace_state,
                         streamed_mutation::forwarding fwd,
                         mutation_reader::forwarding fwd_mr) {
-                    return make_mutation_reader<combined_mutation_reader>(
-                            std::make_unique<incremental_reader_selector>(std::move(s), std::move(sstables), pr, slice, pc,
-                                    reader_resource_tracker(config.resources_sem), std::move(trace_state), fwd, fwd_mr),
-                            fwd_mr);
+                    return make_range_sstable_reader(std::move(s), std::move(sstables), pr, slice, pc,
+                            reader_resource_tracker(config.resources_sem), std::move(trace_state), fwd, fwd_mr, _config.sstable_scan_prefetch_memory);
                 });
             return make_restricted_reader(config, std::move(ms), std::move(s), pr, slice, pc, std::move(trace_state), fwd, fwd_mr);
         } else {
-            return make_mutation_reader<combined_mutation_reader>(
-                    std::make_unique<incremental_reader_selector>(std::move(s), std::move(sstables), pr, slice, pc,
-                            no_resource_tracking(), std::move(trace_state), fwd, fwd_mr),
-                    fwd_mr);
+            return make_range_sstable_reader(std::move(s), std::move(sstables), pr, slice, pc,
+                    no_resource_tracking(), std::move(trace_state), fwd, fwd_mr, _config.sstable_scan_prefetch_memory);
         }
     }
 }
@@ -1377,6 +1537,60 @@ void column_family::remove_ancestors_needed_rewrite(std::unordered_set<uint64_t>
     rebuild_sstable_list({}, old_sstables);
 }
 
+// Splits the token range covered by sstables into at most max_jobs ranges
+// holding about the same amount of data, as estimated from the key samples of
+// the largest sstable. Each sub-job writes at least one sstable, so inputs
+// are not split into pieces smaller than min_bytes_per_job.
+static std::vector<dht::token_range>
+compaction_sub_ranges(const schema& s, const std::vector<sstables::shared_sstable>& sstables, unsigned max_jobs) {
+    static constexpr uint64_t min_bytes_per_job = 256 << 20;
+    auto full_range = std::vector<dht::token_range>{dht::token_range::make_open_ended_both_sides()};
+
+    uint64_t bytes = 0;
+    for (auto& sst : sstables) {
+        bytes += sst->data_size();
+    }
+    auto jobs = std::min<uint64_t>(max_jobs, bytes / min_bytes_per_job);
+    if (jobs <= 1) {
+        return full_range;
+    }
+    auto& largest = *boost::max_element(sstables, [] (const sstables::shared_sstable& a, const sstables::shared_sstable& b) {
+        return a->data_size() < b->data_size();
+    });
+    auto samples = largest->get_key_samples(s, dht::token_range::make_open_ended_both_sides());
+    if (samples.size() < jobs) {
+        return full_range;
+    }
+
+    std::vector<dht::token_range> ranges;
+    stdx::optional<dht::token_range::bound> start;
+    for (auto i : boost::irange<uint64_t>(1, jobs)) {
+        auto& t = samples[i * samples.size() / jobs].token();
+        if (start && !(start->value() < t)) {
+            continue;
+        }
+        ranges.emplace_back(start, dht::token_range::bound(t, true));
+        start = dht::token_range::bound(t, false);
+    }
+    ranges.emplace_back(start, stdx::nullopt);
+    return ranges;
+}
+
+// Merges the results of the sub-jobs of a compaction split by token range.
+// Each of them accounts only for its part of the input.
+static sstables::compaction_info merge_compaction_infos(std::vector<stdx::optional<sstables::compaction_info>>& infos) {
+    auto info = std::move(*infos.front());
+    for (auto& i : boost::make_iterator_range(std::next(infos.begin()), infos.end())) {
+        info.start_size += i->start_size;
+        info.end_size += i->end_size;
+        info.total_partitions += i->total_partitions;
+        info.total_keys_written += i->total_keys_written;
+        info.ended_at = std::max(info.ended_at, i->ended_at);
+        std::move(i->new_sstables.begin(), i->new_sstables.end(), std::back_inserter(info.new_sstables));
+    }
+    return info;
+}
+
 future<>
 column_family::compact_sstables(sstables::compaction_descriptor descriptor, bool cleanup) {
     if (!descriptor.sstables.size()) {
@@ -1386,6 +1600,9 @@ column_family::compact_sstables(sstables::compaction_descriptor descriptor, bool
 
     return with_lock(_sstables_lock.for_read(), [this, descriptor = std::move(descriptor), cleanup] {
         auto sstables_to_compact = make_lw_shared<std::vector<sstables::shared_sstable>>(std::move(descriptor.sstables));
+        auto ranges = descriptor.split_by_token_range && _config.compaction_sub_jobs > 1
+                ? compaction_sub_ranges(*_schema, *sstables_to_compact, _config.compaction_sub_jobs)
+                : std::vector<dht::token_range>{dht::token_range::make_open_ended_both_sides()};
 
         auto create_sstable = [this] {
                 auto gen = this->calculate_generation_for_new_table();
@@ -1395,8 +1612,37 @@ column_family::compact_sstables(sstables::compaction_descriptor descriptor, bool
                 sst->set_unshared();
                 return sst;
         };
-        return sstables::compact_sstables(*sstables_to_compact, *this, create_sstable, descriptor.max_sstable_bytes, descriptor.level,
-                cleanup, _config.background_writer_scheduling_group).then([this, sstables_to_compact] (auto info) {
+        if (ranges.size() > 1) {
+            dblog.debug("Splitting compaction of {}.{} into {} sub-jobs", _schema->ks_name(), _schema->cf_name(), ranges.size());
+        }
+        // Sub-jobs read disjoint token ranges of the same sstables, so their
+        // outputs together replace the input, and only once all of them succeed.
+        auto infos = make_lw_shared<std::vector<stdx::optional<sstables::compaction_info>>>(ranges.size());
+        auto max_sstable_bytes = descriptor.max_sstable_bytes;
+        auto level = descriptor.level;
+        auto run_id = utils::make_random_uuid();
+        return do_with(std::move(ranges), [this, sstables_to_compact, create_sstable, max_sstable_bytes, level, cleanup, infos, run_id] (auto& ranges) {
+            return parallel_for_each(boost::irange<size_t>(0, ranges.size()),
+                    [this, &ranges, sstables_to_compact, create_sstable, max_sstable_bytes, level, cleanup, infos, run_id] (size_t i) {
+                return sstables::compact_sstables(*sstables_to_compact, *this, create_sstable, max_sstable_bytes, level,
+                        cleanup, _config.compaction_scheduling_group, ranges[i], run_id).then([infos, i] (auto info) {
+                    (*infos)[i] = std::move(info);
+                });
+            });
+        }).then_wrapped([infos] (future<> f) {
+            if (f.failed()) {
+                // Sub-jobs which failed cleaned up after themselves.
+                for (auto& info : *infos) {
+                    if (info) {
+                        for (auto& sst : info->new_sstables) {
+                            sst->mark_for_deletion();
+                        }
+                    }
+                }
+                return make_exception_future<sstables::compaction_info>(f.get_exception());
+            }
+            return make_ready_future<sstables::compaction_info>(merge_compaction_infos(*infos));
+        }).then([this, sstables_to_compact] (auto info) {
             _compaction_strategy.notify_completion(*sstables_to_compact, info.new_sstables);
             this->rebuild_sstable_list(info.new_sstables, *sstables_to_compact);
             return info;
@@ -1452,7 +1698,9 @@ future<> column_family::cleanup_sstables(sstables::compaction_descriptor descrip
             static thread_local semaphore sem(1);
 
             return with_semaphore(sem, 1, [this, &sst] {
-                return this->compact_sstables(sstables::compaction_descriptor({ sst }, sst->get_sstable_level()), true);
+                auto descriptor = sstables::compaction_descriptor({ sst }, sst->get_sstable_level());
+                descriptor.split_by_token_range = true;
+                return this->compact_sstables(std::move(descriptor), true);
             });
         });
     });
@@ -2044,6 +2292,26 @@ make_flush_cpu_controller(db::config& cfg, seastar::thread_scheduling_group* bac
     return flush_cpu_controller(flush_cpu_controller::disabled{backup});
 }
 
+inline
+compaction_cpu_controller
+make_compaction_cpu_controller(db::config& cfg, seastar::thread_scheduling_group* backup, std::function<float()> fn) {
+    if (cfg.auto_adjust_compaction_quota()) {
+        return compaction_cpu_controller(1s, std::move(fn));
+    }
+    return compaction_cpu_controller(compaction_cpu_controller::disabled{backup});
+}
+
+// Unless configured, allow enough concurrent flushes to keep this shard's
+// I/O queue busy, with each flush keeping up to 10 (its write-behind) writes
+// in flight. Slow disks get a single flush, as before.
+static unsigned memtable_flush_concurrency(const db::config& cfg) {
+    if (cfg.memtable_flush_writers()) {
+        return cfg.memtable_flush_writers();
+    }
+    auto capacity = engine().get_io_queue().capacity();
+    return std::max<unsigned>(1, std::min<unsigned>(capacity / 10, 4));
+}
+
 utils::UUID database::empty_version = utils::UUID_gen::get_name_UUID(bytes{});
 
 database::database() : database(db::config())
@@ -2052,15 +2320,19 @@ database::database() : database(db::config())
 database::database(const db::config& cfg)
     : _stats(make_lw_shared<db_stats>())
     , _cl_stats(std::make_unique<cell_locker_stats>())
+    , _counter_cache_tracker(std::make_unique<counter_cache_tracker>((size_t(cfg.counter_cache_size_in_mb()) << 20) / smp::count))
     , _cfg(std::make_unique<db::config>(cfg))
     // Allow system tables a pool of 10 MB memory to write, but never block on other regions.
     , _system_dirty_memory_manager(*this, 10 << 20, cfg.virtual_dirty_soft_limit())
-    , _dirty_memory_manager(*this, memory::stats().total_memory() * 0.45, cfg.virtual_dirty_soft_limit())
-    , _streaming_dirty_memory_manager(*this, memory::stats().total_memory() * 0.10, cfg.virtual_dirty_soft_limit())
+    , _dirty_memory_manager(*this, memory::stats().total_memory() * 0.45, cfg.virtual_dirty_soft_limit(), memtable_flush_concurrency(cfg))
+    , _streaming_dirty_memory_manager(*this, memory::stats().total_memory() * 0.10, cfg.virtual_dirty_soft_limit(), memtable_flush_concurrency(cfg))
     , _background_writer_scheduling_group(1ms, _cfg->background_writer_scheduling_quota())
     , _memtable_cpu_controller(make_flush_cpu_controller(*_cfg, &_background_writer_scheduling_group, [this, limit = 2.0f * _dirty_memory_manager.throttle_threshold()] {
         return (_dirty_memory_manager.virtual_dirty_memory()) / limit;
     }))
+    , _compaction_cpu_controller(make_compaction_cpu_controller(*_cfg, &_background_writer_scheduling_group, [this, limit = float(_dirty_memory_manager.throttle_threshold())] {
+        return _compaction_manager->backlog() / limit;
+    }))
     , _version(empty_version)
     , _compaction_manager(std::make_unique<compaction_manager>())
     , _enable_incremental_backups(cfg.incremental_backups())
@@ -2087,6 +2359,42 @@ void flush_cpu_controller::adjust() {
     _scheduling_group.update_usage(_current_quota);
 }
 
+void compaction_cpu_controller::adjust() {
+    struct control_point {
+        float backlog;
+        float quota;
+    };
+    static const std::array<control_point, 3> control_points = {{
+        { 0.0f, 0.05f },
+        { 1.0f, 0.2f },
+        { 10.0f, 1.0f },
+    }};
+
+    _current_backlog = _backlog();
+    auto next = boost::find_if(control_points, [this] (const control_point& cp) { return _current_backlog < cp.backlog; });
+    if (next == control_points.begin()) {
+        _current_quota = next->quota;
+    } else if (next == control_points.end()) {
+        _current_quota = control_points.back().quota;
+    } else {
+        auto prev = std::prev(next);
+        _current_quota = prev->quota + (_current_backlog - prev->backlog) * (next->quota - prev->quota) / (next->backlog - prev->backlog);
+    }
+
+    dblog.trace("compaction backlog {}, quota {}", _current_backlog, _current_quota);
+    _scheduling_group.update_usage(_current_quota);
+}
+
+compaction_cpu_controller::compaction_cpu_controller(std::chrono::milliseconds interval, std::function<float()> backlog)
+    : _backlog(std::move(backlog))
+    , _interval(interval)
+    , _update_timer([this] { adjust(); })
+    , _scheduling_group(1ms, 0.0f)
+    , _current_scheduling_group(&_scheduling_group)
+{
+    _update_timer.arm_periodic(_interval);
+}
+
 flush_cpu_controller::flush_cpu_controller(std::chrono::milliseconds interval, float soft_limit, std::function<float()> current_dirty)
     : _goal(soft_limit / 2)
     , _current_dirty(std::move(current_dirty))
@@ -2110,6 +2418,17 @@ dirty_memory_manager::setup_collectd(sstring namestr) {
 
         sm::make_gauge(namestr +"_virtual_dirty_bytes", [this] { return virtual_dirty_memory(); },
                        sm::description("Holds the size of used memory in bytes. Compare it to \"dirty_bytes\" to see how many memory is wasted (neither used nor available).")),
+
+        sm::make_gauge(namestr + "_flush_concurrency", [this] { return flush_concurrency(); },
+                       sm::description("Holds the maximum number of memtables written to sstables at the same time.")),
+
+        sm::make_gauge(namestr + "_flushes_in_progress", [this] { return flushes_in_progress(); },
+                       sm::description("Holds the number of memtables being written to sstables.")),
+
+        sm::make_derive(namestr + "_writes_blocked_us", [this] {
+                           return std::chrono::duration_cast<std::chrono::microseconds>(writes_blocked_time()).count();
+                       },
+                       sm::description("Counts the time, in microseconds, during which writes were blocked because dirty memory reached its hard limit.")),
     });
 }
 
@@ -2173,6 +2492,12 @@ database::setup_metrics() {
                        sm::description("Counts sstables that survived the clustering key filtering. "
                                        "High value indicates that bloom filter is not very efficient and still have to access a lot of sstables to get data.")),
 
+        sm::make_derive("time_ordered_reads", _cf_stats.time_ordered_reads,
+                       sm::description("Counts single-partition reads which deferred opening some sstables until the read reached their clustering range.")),
+
+        sm::make_derive("time_ordered_reads_skipped_sstables", _cf_stats.sstables_skipped_by_time_ordered_reads,
+                       sm::description("Counts sstables which time-ordered reads never opened because the read stopped before their clustering range.")),
+
         sm::make_derive("total_writes", _stats->total_writes,
                        sm::description("Counts the total number of successful write operations performed by this shard.")),
 
@@ -2243,6 +2568,12 @@ database::setup_metrics() {
         sm::make_gauge("cpu_flush_quota", [this] { return _memtable_cpu_controller.current_quota(); },
                              sm::description("The current quota for memtable CPU scheduling group")),
 
+        sm::make_gauge("cpu_compaction_quota", [this] { return _compaction_cpu_controller.current_quota(); },
+                             sm::description("The current quota for compaction CPU scheduling group")),
+
+        sm::make_gauge("compaction_backlog_normalized", [this] { return _compaction_cpu_controller.current_backlog(); },
+                             sm::description("The compaction backlog the compaction CPU quota was last derived from, in units of the dirty memory limit")),
+
         sm::make_derive("short_data_queries", _stats->short_data_queries,
                        sm::description("The rate of data queries (data or digest reads) that returned less rows than requested due to result size limiting.")),
 
@@ -2254,6 +2585,24 @@ database::setup_metrics() {
 
         sm::make_queue_length("counter_cell_lock_pending", _cl_stats->operations_waiting_for_lock,
                              sm::description("The number of counter updates waiting for a lock.")),
+
+        sm::make_derive("counter_cache_hits", [this] { return _counter_cache_tracker->stats().hits; },
+                       sm::description("The number of counter updates which were transformed to shards using the counter cache only.")),
+
+        sm::make_derive("counter_cache_misses", [this] { return _counter_cache_tracker->stats().misses; },
+                       sm::description("The number of counter updates which had to lock cells and read their current state.")),
+
+        sm::make_derive("counter_cache_evictions", [this] { return _counter_cache_tracker->stats().evictions; },
+                       sm::description("The number of counter cells evicted from the counter cache.")),
+
+        sm::make_derive("counter_cache_invalidations", [this] { return _counter_cache_tracker->stats().invalidations; },
+                       sm::description("The number of counter cells invalidated in the counter cache.")),
+
+        sm::make_gauge("counter_cache_cells", [this] { return _counter_cache_tracker->stats().cells; },
+                       sm::description("The number of counter cells in the counter cache.")),
+
+        sm::make_gauge("counter_cache_bytes", [this] { return _counter_cache_tracker->stats().memory; },
+                       sm::description("The amount of memory used by the counter cache.")),
     });
 }
 
@@ -2712,10 +3061,14 @@ keyspace::make_column_family_config(const schema& s, const db::config& db_config
     cfg.read_concurrency_config = _config.read_concurrency_config;
     cfg.streaming_read_concurrency_config = _config.streaming_read_concurrency_config;
     cfg.cf_stats = _config.cf_stats;
+    cfg.counter_cache_tracker = _config.counter_cache_tracker;
     cfg.enable_incremental_backups = _config.enable_incremental_backups;
     cfg.background_writer_scheduling_group = _config.background_writer_scheduling_group;
     cfg.memtable_scheduling_group = _config.memtable_scheduling_group;
+    cfg.compaction_scheduling_group = _config.compaction_scheduling_group;
+    cfg.compaction_sub_jobs = _config.compaction_sub_jobs;
     cfg.enable_metrics_reporting = db_config.enable_keyspace_column_family_metrics();
+    cfg.sstable_scan_prefetch_memory = size_t(db_config.sstable_scan_prefetch_memory_in_kb()) * 1024;
 
     return cfg;
 }
@@ -3127,6 +3480,24 @@ future<mutation> database::do_apply_counter_update(column_family& cf, const froz
     auto m = fm.unfreeze(m_schema);
     m.upgrade(cf.schema());
 
+    auto cc = cf.get_counter_cache();
+    if (cc) {
+        // If we know the current state of our shard of all the affected
+        // cells, there is no need to lock and read them.
+        auto w = cc->transform_counter_updates_to_shards(m, cf.failed_counter_applies_to_memtable());
+        if (w) {
+            tracing::trace(trace_state, "Counter cache hit, applying counter update");
+            return do_with(std::move(m), std::move(*w), [this, &cf, timeout] (mutation& m, counter_cache::write& w) {
+                return this->apply_with_commitlog(cf, m, timeout).then_wrapped([&m, &w] (future<> f) {
+                    w.complete(!f.failed());
+                    return f.then([&m] {
+                        return std::move(m);
+                    });
+                });
+            });
+        }
+    }
+
     // prepare partition slice
     std::vector<column_id> static_columns;
     static_columns.reserve(m.partition().static_row().size());
@@ -3153,27 +3524,38 @@ future<mutation> database::do_apply_counter_update(column_family& cf, const froz
     auto slice = query::partition_slice(std::move(cr_ranges), std::move(static_columns),
         std::move(regular_columns), { }, { }, cql_serialization_format::internal(), query::max_rows);
 
-    return do_with(std::move(slice), std::move(m), std::vector<locked_cell>(),
-                   [this, &cf, timeout, trace_state = std::move(trace_state)] (const query::partition_slice& slice, mutation& m, std::vector<locked_cell>& locks) mutable {
+    return do_with(std::move(slice), std::move(m), std::vector<locked_cell>(), counter_cache::write(),
+                   [this, &cf, cc, timeout, trace_state = std::move(trace_state)] (const query::partition_slice& slice, mutation& m, std::vector<locked_cell>& locks,
+                                                                                  counter_cache::write& w) mutable {
         tracing::trace(trace_state, "Acquiring counter locks");
-        return cf.lock_counter_cells(m, timeout).then([&, m_schema = cf.schema(), trace_state = std::move(trace_state), timeout, this] (std::vector<locked_cell> lcs) mutable {
+        return cf.lock_counter_cells(m, timeout).then([&, cc, m_schema = cf.schema(), trace_state = std::move(trace_state), timeout, this] (std::vector<locked_cell> lcs) mutable {
             locks = std::move(lcs);
 
-            // Before counter update is applied it needs to be transformed from
-            // deltas to counter shards. To do that, we need to read the current
-            // counter state for each modified cell...
-
-            tracing::trace(trace_state, "Reading counter values from the CF");
-            return counter_write_query(m_schema, cf.as_mutation_source(), m.decorated_key(), slice, trace_state)
-                    .then([this, &cf, &m, m_schema, timeout, trace_state] (auto mopt) {
+            // Updates served from the counter cache don't take the locks, so
+            // we need to wait for those in flight to be applied before reading.
+            auto f = cc ? cc->prepare_for_read(m) : make_ready_future<>();
+            return f.then([&, cc, m_schema, trace_state, timeout, this] {
+                // Before counter update is applied it needs to be transformed from
+                // deltas to counter shards. To do that, we need to read the current
+                // counter state for each modified cell...
+
+                tracing::trace(trace_state, "Reading counter values from the CF");
+                return counter_write_query(m_schema, cf.as_mutation_source(), m.decorated_key(), slice, trace_state);
+            }).then([this, &cf, &m, &w, cc, m_schema, timeout, trace_state] (auto mopt) {
                 // ...now, that we got existing state of all affected counter
                 // cells we can look for our shard in each of them, increment
                 // its clock and apply the delta.
                 transform_counter_updates_to_shards(m, mopt ? &*mopt : nullptr, cf.failed_counter_applies_to_memtable());
+                if (cc) {
+                    w = cc->populate(m);
+                }
                 tracing::trace(trace_state, "Applying counter update");
                 return this->apply_with_commitlog(cf, m, timeout);
-            }).then([&m] {
-                return std::move(m);
+            }).then_wrapped([&m, &w] (future<> f) {
+                w.complete(!f.failed());
+                return f.then([&m] {
+                    return std::move(m);
+                });
             });
         });
     });
@@ -3183,6 +3565,10 @@ void column_family::apply_streaming_mutation(schema_ptr m_schema, utils::UUID pl
     if (dblog.is_enabled(logging::log_level::trace)) {
         dblog.trace("streaming apply {}", m.pretty_printer(m_schema));
     }
+    if (_counter_cache) {
+        // Streamed data may contain our own counter shards.
+        _counter_cache->invalidate(m.decorated_key(*m_schema));
+    }
     if (fragmented) {
         apply_streaming_big_mutation(std::move(m_schema), plan_id, m);
         return;
@@ -3216,6 +3602,7 @@ db::replay_position column_family::set_low_replay_position_mark() {
 future<> dirty_memory_manager::shutdown() {
     _db_shutdown_requested = true;
     _should_flush.signal();
+    _flush_done.broadcast();
     return std::move(_waiting_flush).then([this] {
         return _region_group.shutdown();
     });
@@ -3252,6 +3639,7 @@ future<flush_permit> flush_permit::reacquire_sstable_write_permit() && {
 
 future<> dirty_memory_manager::flush_one(memtable_list& mtlist, flush_permit&& permit) {
     return mtlist.seal_active_memtable_immediate(std::move(permit)).then_wrapped([this, schema = mtlist.back()->schema()] (auto f) {
+        _flush_done.broadcast();
         if (f.failed()) {
             dblog.error("Failed to flush memtable, {}:{}", schema->ks_name(), schema->cf_name());
         }
@@ -3259,6 +3647,15 @@ future<> dirty_memory_manager::flush_one(memtable_list& mtlist, flush_permit&& p
     });
 }
 
+memtable_list* dirty_memory_manager::memtable_list_to_flush() {
+    // The memtables being flushed still hold their memory, and are usually the largest ones, but
+    // flushing their lists again would only seal the small memtables which replaced them.
+    auto* region = _region_group.get_largest_region([] (logalloc::region& r) {
+        return !memtable::from_region(r).get_memtable_list()->flush_in_progress();
+    });
+    return region ? memtable::from_region(*region).get_memtable_list() : nullptr;
+}
+
 future<> dirty_memory_manager::flush_when_needed() {
     if (!_db) {
         return make_ready_future<>();
@@ -3285,11 +3682,15 @@ future<> dirty_memory_manager::flush_when_needed() {
                 // memtable. The advantage of doing this is that this is objectively the one that will
                 // release the biggest amount of memory and is less likely to be generating tiny
                 // SSTables.
-                memtable& candidate_memtable = memtable::from_region(*(this->_region_group.get_largest_region()));
+                auto* candidate = this->memtable_list_to_flush();
+                if (!candidate) {
+                    // All of them are already being flushed.
+                    return _flush_done.wait();
+                }
                 // Do not wait. The semaphore will protect us against a concurrent flush. But we
                 // want to start a new one as soon as the permits are destroyed and the semaphore is
                 // made ready again, not when we are done with the current one.
-                this->flush_one(*(candidate_memtable.get_memtable_list()), std::move(permit));
+                this->flush_one(*candidate, std::move(permit));
                 return make_ready_future<>();
             });
         });
@@ -3309,7 +3710,8 @@ void dirty_memory_manager::start_reclaiming() noexcept {
 
 future<> database::apply_in_memory(const frozen_mutation& m, schema_ptr m_schema, db::rp_handle&& h, timeout_clock::time_point timeout) {
     auto& cf = find_column_family(m.column_family_id());
-    return cf.dirty_memory_region_group().run_when_memory_available([this, &m, m_schema = std::move(m_schema), h = std::move(h)]() mutable {
+    auto& dmm = dirty_memory_manager::from_region_group(&cf.dirty_memory_region_group());
+    return dmm.run_when_memory_available([this, &m, m_schema = std::move(m_schema), h = std::move(h)]() mutable {
         try {
             auto& cf = find_column_family(m.column_family_id());
             cf.apply(m, m_schema, std::move(h));
@@ -3320,7 +3722,8 @@ future<> database::apply_in_memory(const frozen_mutation& m, schema_ptr m_schema
 }
 
 future<> database::apply_in_memory(const mutation& m, column_family& cf, db::rp_handle&& h, timeout_clock::time_point timeout) {
-    return cf.dirty_memory_region_group().run_when_memory_available([this, &m, &cf, h = std::move(h)]() mutable {
+    auto& dmm = dirty_memory_manager::from_region_group(&cf.dirty_memory_region_group());
+    return dmm.run_when_memory_available([this, &m, &cf, h = std::move(h)]() mutable {
         cf.apply(m, std::move(h));
     }, timeout);
 }
@@ -3385,6 +3788,10 @@ future<> database::do_apply(schema_ptr s, const frozen_mutation& m, timeout_cloc
         throw std::runtime_error(sprint("attempted to mutate using not synced schema of %s.%s, version=%s",
                                  s->ks_name(), s->cf_name(), s->version()));
     }
+    if (auto cc = cf.get_counter_cache()) {
+        // Counter deletes coordinated by other replicas.
+        cc->invalidate(*s, m);
+    }
     if (cf.views().empty()) {
         return apply_with_commitlog(std::move(s), cf, std::move(uuid), m, timeout);
     }
@@ -3430,7 +3837,7 @@ future<> database::apply_streaming_mutation(schema_ptr s, utils::UUID plan_id, c
         throw std::runtime_error(sprint("attempted to mutate using not synced schema of %s.%s, version=%s",
                                  s->ks_name(), s->cf_name(), s->version()));
     }
-    return _streaming_dirty_memory_manager.region_group().run_when_memory_available([this, &m, plan_id, fragmented, s = std::move(s)] {
+    return _streaming_dirty_memory_manager.run_when_memory_available([this, &m, plan_id, fragmented, s = std::move(s)] {
         auto uuid = m.column_family_id();
         auto& cf = find_column_family(uuid);
         cf.apply_streaming_mutation(s, plan_id, std::move(m), fragmented);
@@ -3457,6 +3864,7 @@ database::make_keyspace_config(const keyspace_metadata& ksm) {
     }
     cfg.dirty_memory_manager = &_dirty_memory_manager;
     cfg.streaming_dirty_memory_manager = &_streaming_dirty_memory_manager;
+    cfg.counter_cache_tracker = _counter_cache_tracker.get();
     cfg.read_concurrency_config.resources_sem = &_read_concurrency_sem;
     cfg.read_concurrency_config.active_reads = &_stats->active_reads;
     cfg.read_concurrency_config.timeout = _cfg->read_request_timeout_in_ms() * 1ms;
@@ -3475,7 +3883,9 @@ database::make_keyspace_config(const keyspace_metadata& ksm) {
     if (_cfg->background_writer_scheduling_quota() < 1.0f) {
         cfg.background_writer_scheduling_group = &_background_writer_scheduling_group;
         cfg.memtable_scheduling_group = _memtable_cpu_controller.scheduling_group();
+        cfg.compaction_scheduling_group = _compaction_cpu_controller.scheduling_group();
     }
+    cfg.compaction_sub_jobs = std::max(_cfg->compaction_sub_jobs(), 1u);
     cfg.enable_metrics_reporting = _cfg->enable_keyspace_column_family_metrics();
     return cfg;
 }
@@ -3636,6 +4046,9 @@ future<> database::truncate(const keyspace& ks, column_family& cf, timestamp_fun
                 f = cf.clear();
             }
             return f.then([&cf, auto_snapshot, tsf = std::move(tsf), low_mark] {
+                if (auto cc = cf.get_counter_cache()) {
+                    cc->invalidate();
+                }
                 dblog.debug("Discarding sstable data for truncated CF + indexes");
                 // TODO: notify truncation
 
@@ -4137,6 +4550,9 @@ void column_family::set_schema(schema_ptr s) {
 
     _cache.set_schema(s);
     _counter_cell_locks->set_schema(s);
+    if (_counter_cache) {
+        _counter_cache->set_schema(s);
+    }
     _schema = std::move(s);
 
     set_compaction_strategy(_schema->compaction_strategy());
@@ -4295,17 +4711,27 @@ mutation_reader make_range_sstable_reader(schema_ptr s,
         reader_resource_tracker resource_tracker,
         tracing::trace_state_ptr trace_state,
         streamed_mutation::forwarding fwd,
-        mutation_reader::forwarding fwd_mr)
+        mutation_reader::forwarding fwd_mr,
+        size_t prefetch_memory)
 {
+    // The sstable readers are given copies of the range and slice, which
+    // buffers filled ahead of time keep alive after the reader is gone.
+    combined_reader_prefetch prefetch;
+    if (prefetch_memory) {
+        prefetch.budget = prefetch_memory;
+        prefetch.resources_sem = resource_tracker.get_semaphore();
+        prefetch.range = make_lw_shared<const dht::partition_range>(pr);
+        prefetch.slice = make_lw_shared<const query::partition_slice>(slice);
+    }
     return make_mutation_reader<combined_mutation_reader>(std::make_unique<incremental_reader_selector>(std::move(s),
                 std::move(sstables),
-                pr,
-                slice,
+                prefetch.range ? *prefetch.range : pr,
+                prefetch.slice ? *prefetch.slice : slice,
                 pc,
                 std::move(resource_tracker),
                 std::move(trace_state),
                 fwd,
-                fwd_mr), fwd_mr);
+                fwd_mr), fwd_mr, std::move(prefetch));
 }
 
 future<>
@@ -83,6 +83,8 @@
 
 class cell_locker;
 class cell_locker_stats;
+class counter_cache;
+class counter_cache_tracker;
 class locked_cell;
 
 class frozen_mutation;
@@ -185,6 +187,11 @@ class memtable_list {
         return bool(_seal_immediate_fn);
     }
 
+    // Sealed memtables stay in the list until they are written to an sstable.
+    bool flush_in_progress() const {
+        return _memtables.size() > 1;
+    }
+
     shared_memtable back() {
         return _memtables.back();
     }
@@ -267,6 +274,11 @@ struct cf_stats {
     int64_t clustering_filter_fast_path_count = 0;
     // how many sstables survived the clustering key checks
     int64_t surviving_sstables_after_clustering_filter = 0;
+
+    // number of single-partition reads which read sstables newest first and stopped early when possible
+    int64_t time_ordered_reads = 0;
+    // sstables such reads did not have to read because the row limit was already satisfied
+    int64_t sstables_skipped_by_time_ordered_reads = 0;
 };
 
 class cache_temperature {
@@ -299,9 +311,13 @@ class column_family : public enable_lw_shared_from_this<column_family> {
         restricted_mutation_reader_config read_concurrency_config;
         restricted_mutation_reader_config streaming_read_concurrency_config;
         ::cf_stats* cf_stats = nullptr;
+        ::counter_cache_tracker* counter_cache_tracker = nullptr;
         seastar::thread_scheduling_group* background_writer_scheduling_group = nullptr;
         seastar::thread_scheduling_group* memtable_scheduling_group = nullptr;
+        seastar::thread_scheduling_group* compaction_scheduling_group = nullptr;
+        unsigned compaction_sub_jobs = 1;
         bool enable_metrics_reporting = false;
+        size_t sstable_scan_prefetch_memory = 0;
     };
     struct no_commitlog {};
     struct stats {
@@ -425,6 +441,8 @@ class column_family : public enable_lw_shared_from_this<column_family> {
     std::vector<view_ptr> _views;
 
     std::unique_ptr<cell_locker> _counter_cell_locks;
+    // Engaged for counter tables when the counter cache is enabled.
+    std::unique_ptr<counter_cache> _counter_cache;
     void set_metrics();
     seastar::metrics::metric_groups _metrics;
 
@@ -617,6 +635,10 @@ class column_family : public enable_lw_shared_from_this<column_family> {
 
     future<std::vector<locked_cell>> lock_counter_cells(const mutation& m, timeout_clock::time_point timeout);
 
+    ::counter_cache* get_counter_cache() {
+        return _counter_cache.get();
+    }
+
     logalloc::occupancy_stats occupancy() const;
 private:
     column_family(schema_ptr schema, config cfg, db::commitlog* cl, compaction_manager&, cell_locker_stats& cl_stats);
@@ -852,7 +874,8 @@ mutation_reader make_range_sstable_reader(schema_ptr s,
         reader_resource_tracker resource_tracker,
         tracing::trace_state_ptr trace_state,
         streamed_mutation::forwarding fwd,
-        mutation_reader::forwarding fwd_mr);
+        mutation_reader::forwarding fwd_mr,
+        size_t prefetch_memory = 0);
 
 class user_types_metadata {
     std::unordered_map<bytes, user_type> _user_types;
@@ -947,8 +970,11 @@ class keyspace {
         restricted_mutation_reader_config read_concurrency_config;
         restricted_mutation_reader_config streaming_read_concurrency_config;
         ::cf_stats* cf_stats = nullptr;
+        ::counter_cache_tracker* counter_cache_tracker = nullptr;
         seastar::thread_scheduling_group* background_writer_scheduling_group = nullptr;
         seastar::thread_scheduling_group* memtable_scheduling_group = nullptr;
+        seastar::thread_scheduling_group* compaction_scheduling_group = nullptr;
+        unsigned compaction_sub_jobs = 1;
         bool enable_metrics_reporting = false;
     };
 private:
@@ -1053,6 +1079,7 @@ class database {
 
     lw_shared_ptr<db_stats> _stats;
     std::unique_ptr<cell_locker_stats> _cl_stats;
+    std::unique_ptr<counter_cache_tracker> _counter_cache_tracker;
 
     std::unique_ptr<db::config> _cfg;
 
@@ -1062,6 +1089,7 @@ class database {
 
     seastar::thread_scheduling_group _background_writer_scheduling_group;
     flush_cpu_controller _memtable_cpu_controller;
+    compaction_cpu_controller _compaction_cpu_controller;
 
     semaphore _read_concurrency_sem{max_memory_concurrent_reads()};
     semaphore _streaming_concurrency_sem{max_memory_streaming_concurrent_reads()};
@@ -114,6 +114,9 @@ class config : public utils::config_file {
     val(auto_adjust_flush_quota, bool, false, Used, \
             "true: auto-adjust quota for flush processes. false: put everyone together in the static background writer group - if background writer group is enabled. Not intended for setting in normal operations" \
     )   \
+    val(auto_adjust_compaction_quota, bool, false, Used, \
+            "true: auto-adjust quota for compaction processes from the compaction backlog. false: put everyone together in the static background writer group - if background writer group is enabled. Not intended for setting in normal operations" \
+    )   \
     /* Initialization properties */             \
     /* The minimal properties needed for configuring a cluster. */  \
     val(cluster_name, sstring, "", Used,   \
@@ -269,6 +272,9 @@ class config : public utils::config_file {
     val(concurrent_compactors, uint32_t, 0, Invalid,     \
             "Sets the number of concurrent compaction processes allowed to run simultaneously on a node, not including validation compactions for anti-entropy repair. Simultaneous compactions help preserve read performance in a mixed read-write workload by mitigating the tendency of small SSTables to accumulate during a single long-running compaction. If compactions run too slowly or too fast, change compaction_throughput_mb_per_sec first."  \
     )                                                   \
+    val(compaction_sub_jobs, uint32_t, 4, Used,     \
+            "Sets the number of token range sub-jobs, running concurrently on each shard, a major compaction or cleanup of a large table is split into. Each one writes its own sstables. Set to 1 to compact the whole table in a single job."  \
+    )                                                   \
     val(in_memory_compaction_limit_in_mb, uint32_t, 64, Invalid,     \
             "Size limit for rows being compacted in memory. Larger rows spill to disk and use a slower two-pass compaction process. When this occurs, a message is logged specifying the row key. The recommended value is 5 to 10 percent of the available Java heap size."  \
     )                                                   \
@@ -296,8 +302,8 @@ class config : public utils::config_file {
             "The number of full memtables to allow pending flush (memtables waiting for a write thread). At a minimum, set to the maximum number of indexes created on a single table.\n"  \
             "Related information: Flushing data from the memtable"  \
     )   \
-    val(memtable_flush_writers, uint32_t, 1, Invalid,     \
-            "Sets the number of memtable flush writer threads. These threads are blocked by disk I/O, and each one holds a memtable in memory while blocked. If you have a large Java heap size and many data directories, you can increase the value for better flush performance."  \
+    val(memtable_flush_writers, uint32_t, 1, Used,     \
+            "Sets the number of memtables each shard may write to sstables at the same time. Each one holds a memtable in memory until it is flushed. Fast disks may need more than one concurrent flush to keep up with writes. If set to 0, it is derived from the capacity of the shard's I/O queue, up to 4."  \
     )   \
     val(memtable_heap_space_in_mb, uint32_t, 0, Unused,     \
             "Total permitted memory to use for memtables. Triggers a flush based on memtable_cleanup_threshold. Cassandra stops accepting writes when the limit is exceeded until a flush completes. If unset, sets to default."  \
@@ -380,6 +386,9 @@ class config : public utils::config_file {
     val(storage_port, uint16_t, 7000, Used,                \
             "The port for inter-node communication."  \
     )                                                   \
+    val(shard_aware_storage_port, uint16_t, 0, Used,                \
+            "The first of the ports, one per shard, on which each shard listens for inter-node communication. Replica requests sent to these ports are served by the shard owning the data, without hopping between shards. Unused with encryption. 0 disables it."  \
+    )                                                   \
     /* Advanced automatic backup setting */ \
     val(auto_snapshot, bool, true, Used,     \
             "Enable or disable whether a snapshot is taken of the data before keyspace truncation or dropping of tables. To prevent data loss, using the default setting is strongly advised. If you set to false, you will lose data on truncation or drop."  \
@@ -416,8 +425,8 @@ class config : public utils::config_file {
     /* Counter caches properties */ \
     /* Counter cache helps to reduce counter locks' contention for hot counter cells. In case of RF = 1 a counter cache hit will cause Cassandra to skip the read before write entirely. With RF > 1 a counter cache hit will still help to reduce the duration of the lock hold, helping with hot counter cell updates, but will not allow skipping the read entirely. Only the local (clock, count) tuple of a counter cell is kept in memory, not the whole counter, so it's relatively cheap. */    \
     /* Note: Reducing the size counter cache may result in not getting the hottest keys loaded on start-up. */  \
-    val(counter_cache_size_in_mb, uint32_t, 0, Unused,     \
-            "When no value is specified a minimum of 2.5% of Heap or 50MB. If you perform counter deletes and rely on low gc_grace_seconds, you should disable the counter cache. To disable, set to 0"  \
+    val(counter_cache_size_in_mb, uint32_t, 0, Used,     \
+            "Size of the counter cache, split evenly between shards. A counter update which only touches cached cells is applied without locking and reading them. If you perform counter deletes and rely on low gc_grace_seconds, you should disable the counter cache. To disable, set to 0"  \
     )   \
     val(counter_cache_save_period, uint32_t, 7200, Unused,     \
             "Duration after which Cassandra should save the counter cache (keys only). Caches are saved to saved_caches_directory."  \
@@ -454,6 +463,12 @@ class config : public utils::config_file {
             "The time in milliseconds that the coordinator waits for write operations to complete.\n"  \
             "Related information: About hinted handoff writes"  \
     )   \
+    val(write_coalescing_window_in_us, uint32_t, 0, Used,     \
+            "The time in microseconds that the coordinator holds small writes to a replica shard, so that they are sent together in one message. Only writes which are neither forwarded to another datacenter nor traced are held. All nodes must support the MUTATIONS message. 0 disables coalescing."  \
+    )   \
+    val(write_coalescing_max_bytes, uint32_t, 65536, Used,     \
+            "The size in bytes at which the writes held for a replica shard are sent without waiting for the end of write_coalescing_window_in_us. Writes of this size or bigger are never held."  \
+    )   \
     val(request_timeout_in_ms, uint32_t, 10000, Unused,     \
             "The default timeout for other, miscellaneous operations.\n"  \
             "Related information: About hinted handoff writes"  \
@@ -551,13 +566,16 @@ class config : public utils::config_file {
     ) \
     /* Advanced fault detection settings */ \
     /* Settings to handle poorly performing or failing nodes. */    \
-    val(dynamic_snitch_badness_threshold, double, 0, Unused,     \
+    val(dynamic_snitch, bool, true, Used,     \
+            "Whether reads are routed away from replicas which respond slowly, see dynamic_snitch_badness_threshold. Replicas are only reordered within a datacenter."  \
+    )   \
+    val(dynamic_snitch_badness_threshold, double, 0.1, Used,     \
             "Sets the performance threshold for dynamically routing requests away from a poorly performing node. A value of 0.2 means Cassandra continues to prefer the static snitch values until the node response time is 20% worse than the best performing node. Until the threshold is reached, incoming client requests are statically routed to the closest replica (as determined by the snitch). Having requests consistently routed to a given replica can help keep a working set of data hot when read repair is less than 1."  \
     )   \
-    val(dynamic_snitch_reset_interval_in_ms, uint32_t, 60000, Unused,     \
+    val(dynamic_snitch_reset_interval_in_ms, uint32_t, 60000, Used,     \
             "Time interval in milliseconds to reset all node scores, which allows a bad node to recover."  \
     )   \
-    val(dynamic_snitch_update_interval_in_ms, uint32_t, 100, Unused,     \
+    val(dynamic_snitch_update_interval_in_ms, uint32_t, 100, Used,     \
             "The time interval for how often the snitch calculates node scores. Because score calculation is CPU intensive, be careful when reducing this interval."  \
     )   \
     val(hinted_handoff_enabled, bool, true, Unused,     \
@@ -704,6 +722,7 @@ class config : public utils::config_file {
     val(skip_wait_for_gossip_to_settle, int32_t, -1, Used, "An integer to configure the wait for gossip to settle. -1: wait normally, 0: do not wait at all, n: wait for at most n polls. Same as -Dcassandra.skip_wait_for_gossip_to_settle in cassandra.") \
     val(experimental, bool, false, Used, "Set to true to unlock experimental features.") \
     val(lsa_reclamation_step, size_t, 1, Used, "Minimum number of segments to reclaim in a single step") \
+    val(lsa_idle_reserve_segments, size_t, 0, Used, "Number of segments worth of free memory to keep available by reclaiming when the cpu is idle, so that allocations rarely have to reclaim synchronously. Zero (the default) disables it.") \
     val(prometheus_port, uint16_t, 9180, Used, "Prometheus port, set to zero to disable") \
     val(prometheus_address, sstring, "0.0.0.0", Used, "Prometheus listening address") \
     val(prometheus_prefix, sstring, "scylla", Used, "Set the prefix of the exported Prometheus metrics. Changing this will break Scylla's dashboard compatibility, do not change unless you know what you are doing.") \
@@ -712,6 +731,13 @@ class config : public utils::config_file {
     val(virtual_dirty_soft_limit, double, 0.6, Used, "Soft limit of virtual dirty memory expressed as a portion of the hard limit") \
     val(sstable_summary_ratio, double, 0.0005, Used, "Enforces that 1 byte of summary is written for every N (2000 by default) " \
         "bytes written to data file. Value must be between 0 and 1.") \
+    val(sstable_scan_prefetch_memory_in_kb, uint32_t, 0, Used, "The memory, per range scan, used to fill ahead of time the buffers of the partitions " \
+        "which are next in each sstable, so that the reads from all sstables overlap. 0 disables prefetching.") \
+    val(enable_sstable_blocked_bloom_filter, bool, false, Used, "Write sstable bloom filters in which the bits of a key all fall in one cache line, " \
+        "so that a lookup takes a single cache miss. They need slightly more bits for the same false positive chance. They are kept in a separate component, " \
+        "which older versions ignore, reading such sstables without a filter, so they are only written once every node in the cluster supports them.") \
+    val(enable_sstable_partition_index_model, bool, false, Used, "Keep in memory, for each sstable, a model of its partition index which lets single-partition reads " \
+        "parse a few index entries instead of a whole index page, for about one byte per partition. Built when sstables are written or loaded.") \
     val(large_memory_allocation_warning_threshold, size_t, size_t(1) << 20, Used, "Warn about memory allocations above this size; set to zero to disable") \
     val(enable_deprecated_partitioners, bool, false, Used, "Enable the byteordered and murmurs partitioners. These partitioners are deprecated and will be removed in a future version.") \
     val(enable_keyspace_column_family_metrics, bool, false, Used, "Enable per keyspace and per column family metrics reporting") \
@@ -350,6 +350,13 @@ class i_partitioner {
         return _shard_count;
     }
 
+    /**
+     * @return number of most significant token bits ignored when sharding
+     */
+    virtual unsigned sharding_ignore_msb() const {
+        return 0;
+    }
+
     friend bool operator==(const token& t1, const token& t2);
     friend bool operator<(const token& t1, const token& t2);
     friend int tri_compare(const token& t1, const token& t2);
@@ -559,6 +566,7 @@ class ring_position_view {
         , _weight(weight)
     { }
 
+    const dht::token& token() const { return *_token; }
     const partition_key* key() const { return _key; }
 
     friend std::ostream& operator<<(std::ostream&, ring_position_view);
@@ -595,6 +603,8 @@ std::ostream& operator<<(std::ostream& out, const token& t);
 std::ostream& operator<<(std::ostream& out, const decorated_key& t);
 
 void set_global_partitioner(const sstring& class_name, unsigned ignore_msb = 0);
+// Creates a partitioner sharding tokens as a node with shard_count shards would.
+std::unique_ptr<i_partitioner> make_partitioner(const sstring& class_name, unsigned shard_count, unsigned ignore_msb);
 i_partitioner& global_partitioner();
 
 unsigned shard_of(const token&);
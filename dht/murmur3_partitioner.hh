@@ -51,6 +51,7 @@ class murmur3_partitioner final : public i_partitioner {
     virtual dht::token from_bytes(bytes_view bytes) const override;
 
     virtual unsigned shard_of(const token& t) const override;
+    virtual unsigned sharding_ignore_msb() const override { return _sharding_ignore_msb_bits; }
     virtual token token_for_next_shard(const token& t, shard_id shard, unsigned spans) const override;
 private:
     using uint128_t = unsigned __int128;
@@ -21,6 +21,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <boost/intrusive/parent_from_member.hpp>
 #include <seastar/core/condition-variable.hh>
 #include <seastar/core/future.hh>
@@ -79,11 +80,15 @@ class dirty_memory_manager: public logalloc::region_group_reclaimer {
     database* _db;
     logalloc::region_group _region_group;
 
-    // We would like to serialize the flushing of memtables. While flushing many memtables
-    // simultaneously can sustain high levels of throughput, the memory is not freed until the
-    // memtable is totally gone. That means that if we have throttled requests, they will stay
+    // We would like to limit the number of memtables being flushed at a time. While flushing many
+    // memtables simultaneously can sustain high levels of throughput, the memory is not freed until
+    // the memtable is totally gone. That means that if we have throttled requests, they will stay
     // throttled for a long time. Even when we have virtual dirty, that only provides a rough
-    // estimate, and we can't release requests that early.
+    // estimate, and we can't release requests that early. On the other hand, a single flush may
+    // not be able to keep a fast disk busy, so a few of them are allowed to write concurrently.
+    // They all run in the same scheduling group, so the flush CPU controller shares its quota
+    // among them.
+    unsigned _flush_concurrency;
     semaphore _flush_serializer;
     // We will accept a new flush before another one ends, once it is done with the data write.
     // That is so we can keep the disk always busy. But there is still some background work that is
@@ -94,6 +99,8 @@ class dirty_memory_manager: public logalloc::region_group_reclaimer {
     static constexpr unsigned _max_background_work = 20;
     semaphore _background_work_flush_serializer = { _max_background_work };
     condition_variable _should_flush;
+    // Signalled whenever a flush started by flush_one() completes.
+    condition_variable _flush_done;
     int64_t _dirty_bytes_released_pre_accounted = 0;
 
     future<> flush_when_needed();
@@ -101,6 +108,24 @@ class dirty_memory_manager: public logalloc::region_group_reclaimer {
     future<> _waiting_flush;
     virtual void start_reclaiming() noexcept override;
 
+    using clock = std::chrono::steady_clock;
+    // Writes waiting for dirty memory to go below the hard limit, and the time during which
+    // there was at least one.
+    unsigned _blocked_writes = 0;
+    clock::time_point _blocked_since;
+    clock::duration _blocked_time = clock::duration::zero();
+
+    void on_write_blocked() {
+        if (!_blocked_writes++) {
+            _blocked_since = clock::now();
+        }
+    }
+    void on_write_unblocked() {
+        if (!--_blocked_writes) {
+            _blocked_time += clock::now() - _blocked_since;
+        }
+    }
+
     bool has_pressure() const {
         return over_soft_limit();
     }
@@ -143,16 +168,23 @@ class dirty_memory_manager: public logalloc::region_group_reclaimer {
     //
     // We then set the soft limit to 80 % of the virtual dirty hard limit, which is equal to 40 % of
     // the user-supplied threshold.
-    dirty_memory_manager(database& db, size_t threshold, double soft_limit)
+    //
+    // Flush Concurrency
+    // -----------------
+    // Up to flush_concurrency memtables are written to sstables at the same time. A flush gives up
+    // its slot once its data is written, before the sstable is sealed and the cache is updated.
+    dirty_memory_manager(database& db, size_t threshold, double soft_limit, unsigned flush_concurrency = 1)
         : logalloc::region_group_reclaimer(threshold / 2, threshold * soft_limit / 2)
         , _db(&db)
         , _region_group(*this)
-        , _flush_serializer(1)
+        , _flush_concurrency(flush_concurrency)
+        , _flush_serializer(flush_concurrency)
         , _waiting_flush(flush_when_needed()) {}
 
     dirty_memory_manager() : logalloc::region_group_reclaimer()
         , _db(nullptr)
         , _region_group(*this)
+        , _flush_concurrency(1)
         , _flush_serializer(1)
         , _waiting_flush(make_ready_future<>()) {}
 
@@ -186,8 +218,42 @@ class dirty_memory_manager: public logalloc::region_group_reclaimer {
         return _region_group.memory_used();
     }
 
+    unsigned flush_concurrency() const {
+        return _flush_concurrency;
+    }
+
+    // Number of memtables being written to sstables.
+    unsigned flushes_in_progress() const {
+        return _flush_concurrency - _flush_serializer.available_units();
+    }
+
+    // Total time during which writes were blocked by the hard limit.
+    clock::duration writes_blocked_time() const {
+        return _blocked_time + (_blocked_writes ? clock::now() - _blocked_since : clock::duration::zero());
+    }
+
+    // Runs func once dirty memory is below the hard limit, like
+    // logalloc::region_group::run_when_memory_available(), accounting for
+    // the time writes spend blocked.
+    template <typename Func>
+    futurize_t<std::result_of_t<Func()>> run_when_memory_available(Func&& func,
+            lowres_clock::time_point timeout = lowres_clock::time_point::max()) {
+        auto f = _region_group.run_when_memory_available(std::forward<Func>(func), timeout);
+        if (f.available()) {
+            return f;
+        }
+        on_write_blocked();
+        return f.finally([this] {
+            on_write_unblocked();
+        });
+    }
+
     future<> flush_one(memtable_list& cf, flush_permit&& permit);
 
+    // Returns the list of the largest memtable, skipping lists which already have a flush in
+    // progress, or nullptr if there is none.
+    memtable_list* memtable_list_to_flush();
+
     future<flush_permit> get_flush_permit() {
         return get_units(_background_work_flush_serializer, 1).then([this] (auto&& units) {
             return this->get_flush_permit(std::move(units));
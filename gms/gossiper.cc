@@ -151,6 +151,14 @@ gossiper::gossiper() {
                     return 0;
                 }
             }, sm::description("Heartbeat of the current Node.")),
+        sm::make_gauge("round_duration", [this] { return _stats.last_round_duration.count(); },
+            sm::description("Duration of the last gossip round in microseconds, including the replication of its changes to all shards.")),
+        sm::make_derive("replications", _stats.replications,
+            sm::description("Number of times changes to the gossip state were replicated to all shards.")),
+        sm::make_derive("replicated_changes", _stats.replicated_changes,
+            sm::description("Number of endpoint states, evictions and endpoint lists replicated to all shards.")),
+        sm::make_derive("replication_time", [this] { return _stats.replication_time.count(); },
+            sm::description("Total time spent replicating changes to the gossip state to all shards, in microseconds.")),
     });
 }
 
@@ -432,66 +440,42 @@ void gossiper::notify_failure_detector(inet_address endpoint, const endpoint_sta
 
 future<> gossiper::apply_state_locally(std::map<inet_address, endpoint_state> map) {
     auto start = std::chrono::steady_clock::now();
-    auto endpoints = boost::copy_range<std::vector<inet_address>>(map | boost::adaptors::map_keys);
+    auto endpoints = boost::copy_range<std::vector<inet_address>>(map | boost::adaptors::map_keys | boost::adaptors::filtered([this] (inet_address ep) {
+        if (ep == this->get_broadcast_address() && !this->is_in_shadow_round()) {
+            return false;
+        }
+        if (_just_removed_endpoints.count(ep)) {
+            logger.trace("Ignoring gossip for {} because it is quarantined", ep);
+            return false;
+        }
+        return true;
+    }));
+    // The endpoints stay locked until listeners are notified of all changes
+    // from the message. They are locked in address order, as map keeps them,
+    // so that messages with endpoints in common don't deadlock.
+    auto locked = endpoints;
     std::shuffle(endpoints.begin(), endpoints.end(), _random_engine);
     auto node_is_seed = [this] (gms::inet_address ip) { return is_seed(ip); };
     boost::partition(endpoints, node_is_seed);
     logger.debug("apply_state_locally_endpoints={}", endpoints);
 
-    return do_with(std::move(endpoints), std::move(map), [this] (auto&& endpoints, auto&& map) {
-        return parallel_for_each(endpoints, [this, &map] (auto&& ep) -> future<> {
-            if (ep == this->get_broadcast_address() && !this->is_in_shadow_round()) {
-                return make_ready_future<>();
-            }
-            if (_just_removed_endpoints.count(ep)) {
-                logger.trace("Ignoring gossip for {} because it is quarantined", ep);
-                return make_ready_future<>();
+    return do_with(std::move(endpoints), std::move(map), std::move(locked), std::vector<endpoint_permit>(), applied_changes(),
+            [this] (auto&& endpoints, auto&& map, auto&& locked, auto&& permits, auto&& changes) {
+        return do_for_each(locked, [this, &permits] (inet_address ep) {
+            return this->lock_endpoint(ep).then([&permits] (endpoint_permit permit) {
+                permits.push_back(std::move(permit));
+            });
+        }).then([this, &endpoints, &map, &changes] {
+            // Applying the states doesn't wait for anything; only
+            // replication and listeners do.
+            for (auto&& ep : endpoints) {
+                this->apply_state_locally(ep, map[ep], changes);
             }
-          return seastar::with_semaphore(_apply_state_locally_semaphore, 1, [this, &ep, &map] () mutable {
-            return seastar::async([this, &ep, &map] () mutable {
-                /*
-                   If state does not exist just add it. If it does then add it if the remote generation is greater.
-                   If there is a generation tie, attempt to break it by heartbeat version.
-                   */
-                auto permit = this->lock_endpoint(ep).get0();
-                const endpoint_state& remote_state = map[ep];
-                auto es = this->get_endpoint_state_for_endpoint_ptr(ep);
-                if (es) {
-                    endpoint_state& local_ep_state_ptr = *es;
-                    int local_generation = local_ep_state_ptr.get_heart_beat_state().get_generation();
-                    int remote_generation = remote_state.get_heart_beat_state().get_generation();
-                    logger.trace("{} local generation {}, remote generation {}", ep, local_generation, remote_generation);
-                    if (local_generation != 0 && remote_generation > local_generation + MAX_GENERATION_DIFFERENCE) {
-                        // assume some peer has corrupted memory and is broadcasting an unbelievable generation about another peer (or itself)
-                        logger.warn("received an invalid gossip generation for peer {}; local generation = {}, received generation = {}",
-                            ep, local_generation, remote_generation);
-                    } else if (remote_generation > local_generation) {
-                        logger.trace("Updating heartbeat state generation to {} from {} for {}", remote_generation, local_generation, ep);
-                        // major state change will handle the update by inserting the remote state directly
-                        this->handle_major_state_change(ep, remote_state);
-                    } else if (remote_generation == local_generation) {  //generation has not changed, apply new states
-                        /* find maximum state */
-                        int local_max_version = this->get_max_endpoint_state_version(local_ep_state_ptr);
-                        int remote_max_version = this->get_max_endpoint_state_version(remote_state);
-                        if (remote_max_version > local_max_version) {
-                            // apply states, but do not notify since there is no major change
-                            this->apply_new_states(ep, local_ep_state_ptr, remote_state);
-                        } else {
-                            logger.trace("Ignoring remote version {} <= {} for {}", remote_max_version, local_max_version, ep);
-                        }
-                        if (!local_ep_state_ptr.is_alive() && !this->is_dead_state(local_ep_state_ptr)) { // unless of course, it was dead
-                            this->mark_alive(ep, local_ep_state_ptr);
-                        }
-                    } else {
-                        logger.trace("Ignoring remote generation {} < {}", remote_generation, local_generation);
-                    }
-                } else {
-                    // this is a new node, report it to the FD in case it is the first time we are seeing it AND it's not alive
-                    get_local_failure_detector().report(ep);
-                    this->handle_major_state_change(ep, remote_state);
-                }
+        }).finally([this, &changes] {
+            // Changes applied before a failure must reach the other shards too.
+            return seastar::async([this, &changes] {
+                this->replicate_and_notify(std::move(changes));
             });
-          });
         });
     }).then([start] {
             logger.debug("apply_state_locally() took {} ms", std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -499,6 +483,51 @@ future<> gossiper::apply_state_locally(std::map<inet_address, endpoint_state> ma
     });
 }
 
+void gossiper::apply_state_locally(inet_address ep, const endpoint_state& remote_state, applied_changes& changes) {
+    /*
+       If state does not exist just add it. If it does then add it if the remote generation is greater.
+       If there is a generation tie, attempt to break it by heartbeat version.
+       */
+    auto es = this->get_endpoint_state_for_endpoint_ptr(ep);
+    if (es) {
+        endpoint_state& local_ep_state_ptr = *es;
+        int local_generation = local_ep_state_ptr.get_heart_beat_state().get_generation();
+        int remote_generation = remote_state.get_heart_beat_state().get_generation();
+        logger.trace("{} local generation {}, remote generation {}", ep, local_generation, remote_generation);
+        if (local_generation != 0 && remote_generation > local_generation + MAX_GENERATION_DIFFERENCE) {
+            // assume some peer has corrupted memory and is broadcasting an unbelievable generation about another peer (or itself)
+            logger.warn("received an invalid gossip generation for peer {}; local generation = {}, received generation = {}",
+                ep, local_generation, remote_generation);
+        } else if (remote_generation > local_generation) {
+            logger.trace("Updating heartbeat state generation to {} from {} for {}", remote_generation, local_generation, ep);
+            // major state change will handle the update by inserting the remote state directly
+            this->handle_major_state_change(ep, remote_state, changes);
+        } else if (remote_generation == local_generation) {  //generation has not changed, apply new states
+            /* find maximum state */
+            int local_max_version = this->get_max_endpoint_state_version(local_ep_state_ptr);
+            int remote_max_version = this->get_max_endpoint_state_version(remote_state);
+            if (remote_max_version > local_max_version) {
+                // apply states, but do not notify since there is no major change
+                this->apply_new_states(ep, local_ep_state_ptr, remote_state, changes);
+            } else {
+                logger.trace("Ignoring remote version {} <= {} for {}", remote_max_version, local_max_version, ep);
+            }
+            changes.notifications.push_back([this, ep] {
+                auto es = this->get_endpoint_state_for_endpoint_ptr(ep);
+                if (es && !es->is_alive() && !this->is_dead_state(*es)) { // unless of course, it was dead
+                    this->mark_alive(ep, *es);
+                }
+            });
+        } else {
+            logger.trace("Ignoring remote generation {} < {}", remote_generation, local_generation);
+        }
+    } else {
+        // this is a new node, report it to the FD in case it is the first time we are seeing it AND it's not alive
+        get_local_failure_detector().report(ep);
+        this->handle_major_state_change(ep, remote_state, changes);
+    }
+}
+
 // Runs inside seastar::async context
 void gossiper::remove_endpoint(inet_address endpoint) {
     // do subscribers first so anything in the subscriber that depends on gossiper state won't get confused
@@ -551,7 +580,7 @@ void gossiper::do_status_check() {
             && ((now - ep_state.get_update_timestamp()) > fat_client_timeout)) {
             logger.info("FatClient {} has been silent for {}ms, removing from gossip", endpoint, fat_client_timeout.count());
             remove_endpoint(endpoint); // will put it in _just_removed_endpoints to respect quarantine delay
-            evict_from_membership(endpoint); // can get rid of the state immediately
+            evict_from_membership(endpoint, _round_delta); // can get rid of the state immediately
         }
 
         // check for dead state removal
@@ -559,7 +588,7 @@ void gossiper::do_status_check() {
         if (!is_alive && (now > expire_time)
              && (!service::get_local_storage_service().get_token_metadata().is_member(endpoint))) {
             logger.debug("time is expiring for endpoint : {} ({})", endpoint, expire_time.time_since_epoch().count());
-            evict_from_membership(endpoint);
+            evict_from_membership(endpoint, _round_delta);
         }
     }
 
@@ -589,6 +618,7 @@ void gossiper::run() {
     timer_callback_lock().then([this, g = this->shared_from_this()] {
         return seastar::async([this, g] {
             logger.trace("=== Gossip round START");
+            auto round_start = std::chrono::steady_clock::now();
 
             //wait on messaging service to start listening
             // MessagingService.instance().waitUntilListening();
@@ -673,35 +703,22 @@ void gossiper::run() {
             //
             // Gossiper task runs only on CPU0:
             //
-            //    - If endpoint_state_map or _live_endpoints have changed - duplicate
-            //      them across all other shards.
+            //    - Changes made by the round (evictions, _live_endpoints and
+            //      _unreachable_endpoints) are replicated to all other shards
+            //      at once.
             //    - Reschedule the gossiper only after execution on all nodes is done.
             //
-            bool live_endpoint_changed = (_live_endpoints != _shadow_live_endpoints);
-            bool unreachable_endpoint_changed = (_unreachable_endpoints != _shadow_unreachable_endpoints);
-
-            if (live_endpoint_changed || unreachable_endpoint_changed) {
-                if (live_endpoint_changed) {
-                    _shadow_live_endpoints = _live_endpoints;
-                }
-
-                if (unreachable_endpoint_changed) {
-                    _shadow_unreachable_endpoints = _unreachable_endpoints;
-                }
-
-                _the_gossiper.invoke_on_all([this, live_endpoint_changed, unreachable_endpoint_changed] (gossiper& local_gossiper) {
-                    // Don't copy gossiper(CPU0) maps into themselves!
-                    if (engine().cpu_id() != 0) {
-                        if (live_endpoint_changed) {
-                            local_gossiper._live_endpoints = _shadow_live_endpoints;
-                        }
-
-                        if (unreachable_endpoint_changed) {
-                            local_gossiper._unreachable_endpoints = _shadow_unreachable_endpoints;
-                        }
-                    }
-                }).get();
+            if (_live_endpoints != _shadow_live_endpoints) {
+                _shadow_live_endpoints = _live_endpoints;
+                _round_delta.set_live_endpoints(_live_endpoints);
+            }
+            if (_unreachable_endpoints != _shadow_unreachable_endpoints) {
+                _shadow_unreachable_endpoints = _unreachable_endpoints;
+                _round_delta.set_unreachable_endpoints(_unreachable_endpoints);
             }
+            replicate(std::exchange(_round_delta, state_delta())).get();
+
+            _stats.last_round_duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - round_start);
         });
     }).then_wrapped([this] (auto&& f) {
         try {
@@ -828,10 +845,15 @@ int gossiper::get_max_endpoint_state_version(endpoint_state state) {
 
 // Runs inside seastar::async context
 void gossiper::evict_from_membership(inet_address endpoint) {
+    state_delta delta;
+    evict_from_membership(endpoint, delta);
+    replicate(std::move(delta)).get();
+}
+
+void gossiper::evict_from_membership(inet_address endpoint, state_delta& delta) {
     _unreachable_endpoints.erase(endpoint);
-    container().invoke_on_all([endpoint] (auto& g) {
-        g.endpoint_state_map.erase(endpoint);
-    }).get();
+    endpoint_state_map.erase(endpoint);
+    delta.evict(endpoint);
     _expire_time_endpoint_map.erase(endpoint);
     get_local_failure_detector().remove(endpoint);
     quarantine_endpoint(endpoint);
@@ -891,30 +913,103 @@ void gossiper::make_random_gossip_digest(std::vector<gossip_digest>& g_digests)
 #endif
 }
 
-future<> gossiper::replicate(inet_address ep, const endpoint_state& es) {
-    return container().invoke_on_all([ep, es, orig = engine().cpu_id(), self = shared_from_this()] (gossiper& g) {
-        if (engine().cpu_id() != orig) {
-            g.endpoint_state_map[ep].apply_application_state(es);
-        }
-    });
+void gossiper::state_delta::add_state(inet_address ep, const endpoint_state& es) {
+    _states[ep].apply_application_state(es);
 }
 
-future<> gossiper::replicate(inet_address ep, const std::map<application_state, versioned_value>& src, const std::vector<application_state>& changed) {
-    return container().invoke_on_all([ep, &src, &changed, orig = engine().cpu_id(), self = shared_from_this()] (gossiper& g) {
-        if (engine().cpu_id() != orig) {
-            for (auto&& key : changed) {
-                g.endpoint_state_map[ep].apply_application_state(key, src.at(key));
-            }
+void gossiper::state_delta::add_state(inet_address ep, application_state key, const versioned_value& value) {
+    _states[ep].apply_application_state(key, value);
+}
+
+void gossiper::state_delta::evict(inet_address ep) {
+    _states.erase(ep);
+    _evicted.insert(ep);
+}
+
+void gossiper::state_delta::set_live_endpoints(const std::vector<inet_address>& eps) {
+    _live_endpoints = eps;
+}
+
+void gossiper::state_delta::set_unreachable_endpoints(const std::unordered_map<inet_address, clk::time_point>& eps) {
+    _unreachable_endpoints = eps;
+}
+
+bool gossiper::state_delta::empty() const {
+    return !size();
+}
+
+size_t gossiper::state_delta::size() const {
+    return _evicted.size() + _states.size() + bool(_live_endpoints) + bool(_unreachable_endpoints);
+}
+
+void gossiper::state_delta::apply_to(gossiper& g) const {
+    for (auto&& ep : _evicted) {
+        g.endpoint_state_map.erase(ep);
+    }
+    for (auto&& x : _states) {
+        g.endpoint_state_map[x.first].apply_application_state(x.second);
+    }
+    if (_live_endpoints) {
+        g._live_endpoints = *_live_endpoints;
+    }
+    if (_unreachable_endpoints) {
+        g._unreachable_endpoints = *_unreachable_endpoints;
+    }
+}
+
+future<> gossiper::replicate(state_delta delta) {
+    // Evictions of the round in progress must reach the other shards before
+    // the states which follow them.
+    for (auto&& x : delta._states) {
+        if (_round_delta._evicted.erase(x.first)) {
+            delta._evicted.insert(x.first);
         }
+    }
+    if (delta.empty()) {
+        return make_ready_future<>();
+    }
+    _stats.replications++;
+    _stats.replicated_changes += delta.size();
+    auto start = std::chrono::steady_clock::now();
+    return do_with(std::move(delta), [this, orig = engine().cpu_id()] (const state_delta& delta) {
+        return container().invoke_on_all([&delta, orig] (gossiper& g) {
+            if (engine().cpu_id() != orig) {
+                delta.apply_to(g);
+            }
+        });
+    }).finally([this, start, self = shared_from_this()] {
+        _stats.replication_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
     });
 }
 
+future<> gossiper::replicate(inet_address ep, const endpoint_state& es) {
+    state_delta delta;
+    delta.add_state(ep, es);
+    return replicate(std::move(delta));
+}
+
 future<> gossiper::replicate(inet_address ep, application_state key, const versioned_value& value) {
-    return container().invoke_on_all([ep, key, &value, orig = engine().cpu_id(), self = shared_from_this()] (gossiper& g) {
-        if (engine().cpu_id() != orig) {
-            g.endpoint_state_map[ep].apply_application_state(key, value);
+    state_delta delta;
+    delta.add_state(ep, key, value);
+    return replicate(std::move(delta));
+}
+
+void gossiper::replicate_and_notify(applied_changes changes) {
+    // Exceptions during replication will cause abort because node's state
+    // would be inconsistent across shards. Changes listeners depend on state
+    // being replicated to all shards.
+    [&] () noexcept {
+        replicate(std::move(changes.delta)).get();
+    }();
+    // Exceptions thrown from listeners will result in abort because that could leave the node in a bad
+    // state indefinitely. Unless the value changes again, we wouldn't retry notifications.
+    // Some values are set only once, so listeners would never be re-run.
+    // Listeners should decide which failures are non-fatal and swallow them.
+    [&] () noexcept {
+        for (auto&& notify : changes.notifications) {
+            notify();
         }
-    });
+    }();
 }
 
 future<> gossiper::advertise_removing(inet_address endpoint, utils::UUID host_id, utils::UUID local_host_id) {
@@ -1297,6 +1392,12 @@ void gossiper::mark_dead(inet_address addr, endpoint_state& local_state) {
 
 // Runs inside seastar::async context
 void gossiper::handle_major_state_change(inet_address ep, const endpoint_state& eps) {
+    applied_changes changes;
+    handle_major_state_change(ep, eps, changes);
+    replicate_and_notify(std::move(changes));
+}
+
+void gossiper::handle_major_state_change(inet_address ep, const endpoint_state& eps, applied_changes& changes) {
     auto eps_old = get_endpoint_state_for_endpoint(ep);
     if (!is_dead_state(eps) && !_in_shadow_round) {
         if (endpoint_state_map.count(ep))  {
@@ -1307,7 +1408,7 @@ void gossiper::handle_major_state_change(inet_address ep, const endpoint_state&
     }
     logger.trace("Adding endpoint state for {}, status = {}", ep, get_gossip_status(eps));
     endpoint_state_map[ep] = eps;
-    replicate(ep, eps).get();
+    changes.delta.add_state(ep, eps);
 
     if (_in_shadow_round) {
         // In shadow round, we only interested in the peer's endpoint_state,
@@ -1319,31 +1420,37 @@ void gossiper::handle_major_state_change(inet_address ep, const endpoint_state&
         return;
     }
 
-    if (eps_old) {
-        // the node restarted: it is up to the subscriber to take whatever action is necessary
-        _subscribers.for_each([ep, eps_old] (auto& subscriber) {
-            subscriber->on_restart(ep, *eps_old);
-        });
-    }
+    changes.notifications.push_back([this, ep, eps_old = std::move(eps_old)] {
+        if (eps_old) {
+            // the node restarted: it is up to the subscriber to take whatever action is necessary
+            _subscribers.for_each([ep, &eps_old] (auto& subscriber) {
+                subscriber->on_restart(ep, *eps_old);
+            });
+        }
 
-    auto& ep_state = endpoint_state_map.at(ep);
-    if (!is_dead_state(ep_state)) {
-        mark_alive(ep, ep_state);
-    } else {
-        logger.debug("Not marking {} alive due to dead state {}", ep, get_gossip_status(eps));
-        mark_dead(ep, ep_state);
-    }
+        auto* ep_state = get_endpoint_state_for_endpoint_ptr(ep);
+        if (!ep_state) {
+            logger.debug("Node {} is not in endpoint_state_map anymore", ep);
+            return;
+        }
+        if (!is_dead_state(*ep_state)) {
+            mark_alive(ep, *ep_state);
+        } else {
+            logger.debug("Not marking {} alive due to dead state {}", ep, get_gossip_status(*ep_state));
+            mark_dead(ep, *ep_state);
+        }
 
-    auto* eps_new = get_endpoint_state_for_endpoint_ptr(ep);
-    if (eps_new) {
-        _subscribers.for_each([ep, eps_new] (auto& subscriber) {
-            subscriber->on_join(ep, *eps_new);
-        });
-    }
-    // check this at the end so nodes will learn about the endpoint
-    if (is_shutdown(ep)) {
-        mark_as_shutdown(ep);
-    }
+        auto* eps_new = get_endpoint_state_for_endpoint_ptr(ep);
+        if (eps_new) {
+            _subscribers.for_each([ep, eps_new] (auto& subscriber) {
+                subscriber->on_join(ep, *eps_new);
+            });
+        }
+        // check this at the end so nodes will learn about the endpoint
+        if (is_shutdown(ep)) {
+            mark_as_shutdown(ep);
+        }
+    });
 }
 
 bool gossiper::is_dead_state(const endpoint_state& eps) const {
@@ -1374,8 +1481,7 @@ bool gossiper::is_silent_shutdown_state(const endpoint_state& ep_state) const{
     return false;
 }
 
-// Runs inside seastar::async context
-void gossiper::apply_new_states(inet_address addr, endpoint_state& local_state, const endpoint_state& remote_state) {
+void gossiper::apply_new_states(inet_address addr, endpoint_state& local_state, const endpoint_state& remote_state, applied_changes& changes) {
     // don't assert here, since if the node restarts the version will go back to zero
     //int oldVersion = local_state.get_heart_beat_state().get_heart_beat_version();
 
@@ -1385,30 +1491,23 @@ void gossiper::apply_new_states(inet_address addr, endpoint_state& local_state,
     //     local_state.get_heart_beat_state().get_heart_beat_version(), oldVersion, addr);
     // }
 
-    std::vector<application_state> changed;
-    auto&& remote_map = remote_state.get_application_state_map();
+    std::vector<std::pair<application_state, versioned_value>> changed;
 
-    // Exceptions thrown from listeners will result in abort because that could leave the node in a bad
-    // state indefinitely. Unless the value changes again, we wouldn't retry notifications.
-    // Some values are set only once, so listeners would never be re-run.
-    // Listeners should decide which failures are non-fatal and swallow them.
-    auto run_listeners = seastar::defer([&] () noexcept {
-        for (auto&& key : changed) {
-            do_on_change_notifications(addr, key, remote_map.at(key));
+    // Changes applied before an exception are still replicated, and
+    // listeners notified of them.
+    auto notify_changes = seastar::defer([&] () noexcept {
+        if (!changed.empty()) {
+            changes.notifications.push_back([this, addr, changed = std::move(changed)] {
+                for (auto&& x : changed) {
+                    do_on_change_notifications(addr, x.first, x.second);
+                }
+            });
         }
     });
 
-    // We must replicate endpoint states before listeners run.
-    // Exceptions during replication will cause abort because node's state
-    // would be inconsistent across shards. Changes listeners depend on state
-    // being replicated to all shards.
-    auto replicate_changes = seastar::defer([&] () noexcept {
-        replicate(addr, remote_map, changed).get();
-    });
-
     // we need to make two loops here, one to apply, then another to notify,
     // this way all states in an update are present and current when the notifications are received
-    for (const auto& remote_entry : remote_map) {
+    for (const auto& remote_entry : remote_state.get_application_state_map()) {
         const auto& remote_key = remote_entry.first;
         const auto& remote_value = remote_entry.second;
         auto remote_gen = remote_state.get_heart_beat_state().get_generation();
@@ -1421,8 +1520,9 @@ void gossiper::apply_new_states(inet_address addr, endpoint_state& local_state,
 
         const versioned_value* local_val = local_state.get_application_state_ptr(remote_key);
         if (!local_val || remote_value.version > local_val->version) {
-            changed.push_back(remote_key);
+            changed.emplace_back(remote_key, remote_value);
             local_state.add_application_state(remote_key, remote_value);
+            changes.delta.add_state(addr, remote_key, remote_value);
         }
     }
 }
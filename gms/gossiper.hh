@@ -55,6 +55,7 @@
 #include <experimental/optional>
 #include <algorithm>
 #include <chrono>
+#include <functional>
 #include <set>
 #include <seastar/core/condition-variable.hh>
 #include <seastar/core/metrics_registration.hh>
@@ -106,7 +107,6 @@ class gossiper : public i_failure_detection_event_listener, public seastar::asyn
     std::set<inet_address> _seeds_from_config;
     sstring _cluster_name;
     semaphore _callback_running{1};
-    semaphore _apply_state_locally_semaphore{100};
 public:
     future<> timer_callback_lock() { return _callback_running.wait(); }
     void timer_callback_unlock() { _callback_running.signal(); }
@@ -222,13 +222,59 @@ class gossiper : public i_failure_detection_event_listener, public seastar::asyn
     std::unordered_map<inet_address, clk::time_point> _shadow_unreachable_endpoints;
     std::vector<inet_address> _shadow_live_endpoints;
 
+    // Changes to the gossip state of this shard, replicated to all other
+    // shards in a single cross-shard call. A delta does not change while it
+    // is being applied; the other shards read it from this one.
+    class state_delta {
+        // Applied before states, so that a state added after the eviction
+        // of its endpoint survives it.
+        std::unordered_set<inet_address> _evicted;
+        // Application states, merged by version.
+        std::unordered_map<inet_address, endpoint_state> _states;
+        stdx::optional<std::vector<inet_address>> _live_endpoints;
+        stdx::optional<std::unordered_map<inet_address, clk::time_point>> _unreachable_endpoints;
+
+        friend class gossiper;
+    public:
+        void add_state(inet_address ep, const endpoint_state& es);
+        void add_state(inet_address ep, application_state key, const versioned_value& value);
+        void evict(inet_address ep);
+        void set_live_endpoints(const std::vector<inet_address>& eps);
+        void set_unreachable_endpoints(const std::unordered_map<inet_address, clk::time_point>& eps);
+        bool empty() const;
+        size_t size() const;
+        void apply_to(gossiper& g) const;
+    };
+
+    struct stats {
+        std::chrono::microseconds last_round_duration{0};
+        uint64_t replications = 0;
+        uint64_t replicated_changes = 0;
+        std::chrono::microseconds replication_time{0};
+    } _stats;
+
+    // Changes made by the gossip round in progress, replicated at its end.
+    state_delta _round_delta;
+
+    // Changes applied from a gossip message. They are replicated to the
+    // other shards at once, then listeners are notified of them, in the
+    // order the changes were applied.
+    struct applied_changes {
+        state_delta delta;
+        // Run in seastar::async context.
+        std::vector<std::function<void()>> notifications;
+    };
+    // Replicates changes, then runs their notifications.
+    // Runs inside seastar::async context.
+    void replicate_and_notify(applied_changes changes);
+
     void run();
+    // Replicates delta to all other shards. Evictions recorded in
+    // _round_delta for the endpoints delta changes are replicated along.
+    future<> replicate(state_delta delta);
     // Replicates given endpoint_state to all other shards.
     // The state state doesn't have to be kept alive around until completes.
     future<> replicate(inet_address, const endpoint_state&);
-    // Replicates "states" from "src" to all other shards.
-    // "src" and "states" must be kept alive until completes and must not change.
-    future<> replicate(inet_address, const std::map<application_state, versioned_value>& src, const std::vector<application_state>& states);
     // Replicates given value to all other shards.
     // The value must be kept alive until completes and not change.
     future<> replicate(inet_address, application_state key, const versioned_value& value);
@@ -294,6 +340,9 @@ class gossiper : public i_failure_detection_event_listener, public seastar::asyn
      * @param endpoint endpoint to be removed from the current membership.
      */
     void evict_from_membership(inet_address endpoint);
+    // Evicts endpoint on this shard; the other shards do so when delta is
+    // replicated.
+    void evict_from_membership(inet_address endpoint, state_delta& delta);
 public:
     /**
      * Removes the endpoint from Gossip but retains endpoint state
@@ -448,6 +497,9 @@ class gossiper : public i_failure_detection_event_listener, public seastar::asyn
      * @param ep_state EndpointState for the endpoint
      */
     void handle_major_state_change(inet_address ep, const endpoint_state& eps);
+    // Applies the change to this shard, leaving its replication and
+    // notifications in changes.
+    void handle_major_state_change(inet_address ep, const endpoint_state& eps, applied_changes& changes);
 
 public:
     bool is_alive(inet_address ep) const;
@@ -456,7 +508,9 @@ class gossiper : public i_failure_detection_event_listener, public seastar::asyn
     future<> apply_state_locally(std::map<inet_address, endpoint_state> map);
 
 private:
-    void apply_new_states(inet_address addr, endpoint_state& local_state, const endpoint_state& remote_state);
+    void apply_state_locally(inet_address ep, const endpoint_state& remote_state, applied_changes& changes);
+
+    void apply_new_states(inet_address addr, endpoint_state& local_state, const endpoint_state& remote_state, applied_changes& changes);
 
     // notify that a local application state is going to change (doesn't get triggered for remote changes)
     void do_before_change_notifications(inet_address addr, const endpoint_state& ep_state, const application_state& ap_state, const versioned_value& new_value);
@@ -51,6 +51,10 @@
 
 namespace secondary_index {
 
+sstring index_table_name(const sstring& index_name) {
+    return sprint("%s_index", index_name);
+}
+
 index::index(const sstring& target_column, const index_metadata& im)
     : _target_column{target_column}
     , _im{im}
@@ -61,7 +65,7 @@ bool index::depends_on(const column_definition& cdef) const {
 }
 
 bool index::supports_expression(const column_definition& cdef, const cql3::operator_type op) const {
-    return false;
+    return depends_on(cdef) && op == cql3::operator_type::EQ;
 }
 
 const index_metadata& index::metadata() const {
@@ -95,9 +99,8 @@ void secondary_index_manager::add_index(const index_metadata& im) {
 
 view_ptr secondary_index_manager::create_view_for_index(const index_metadata& im) const {
     auto schema = _cf.schema();
-    sstring index_table_name = sprint("%s_index", im.name());
     sstring index_target_name = im.options().at(cql3::statements::index_target::target_option_name);
-    schema_builder builder{schema->ks_name(), index_table_name};
+    schema_builder builder{schema->ks_name(), index_table_name(im.name())};
     auto target = target_parser::parse(schema, im);
     const auto* index_target = std::get<const column_definition*>(target);
     auto target_type = std::get<cql3::statements::index_target::target_type>(target);
@@ -50,6 +50,9 @@
 
 namespace secondary_index {
 
+/// Returns the name of the materialized view backing the index.
+sstring index_table_name(const sstring& index_name);
+
 class index {
     sstring _target_column;
     index_metadata _im;
@@ -23,6 +23,7 @@
 #include "utils/class_registrator.hh"
 #include "exceptions/exceptions.hh"
 #include "stdx.hh"
+#include "core/thread.hh"
 
 namespace locator {
 
@@ -180,6 +181,23 @@ abstract_replication_strategy::get_address_ranges(token_metadata& tm) const {
     return ret;
 }
 
+dht::token_range_vector
+abstract_replication_strategy::get_address_ranges(token_metadata& tm, inet_address ep, can_yield cy) const {
+    dht::token_range_vector ret;
+    for (auto& t : tm.sorted_tokens()) {
+        auto eps = calculate_natural_endpoints(t, tm);
+        if (std::find(eps.begin(), eps.end(), ep) != eps.end()) {
+            for (auto&& rng : tm.get_primary_ranges_for(t)) {
+                ret.push_back(std::move(rng));
+            }
+        }
+        if (cy && seastar::thread::should_yield()) {
+            seastar::thread::yield();
+        }
+    }
+    return ret;
+}
+
 std::unordered_multimap<dht::token_range, inet_address>
 abstract_replication_strategy::get_range_addresses(token_metadata& tm) const {
     std::unordered_multimap<dht::token_range, inet_address> ret;
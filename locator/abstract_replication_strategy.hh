@@ -100,6 +100,7 @@ class abstract_replication_strategy {
     virtual size_t get_replication_factor() const = 0;
     uint64_t get_cache_hits_count() const { return _cache_hits_count; }
     replication_strategy_type get_type() const { return _my_type; }
+    const std::map<sstring, sstring>& get_config_options() const { return _config_options; }
 
     // get_ranges() returns the list of ranges held by the given endpoint.
     // The list is sorted, and its elements are non overlapping and non wrap-around.
@@ -116,6 +117,12 @@ class abstract_replication_strategy {
 
     std::unordered_multimap<inet_address, dht::token_range> get_address_ranges(token_metadata& tm) const;
 
+    // Returns the ranges get_address_ranges(tm) would map to ep, without
+    // building the map for all endpoints. With can_yield::yes it must be
+    // called from a seastar thread, as it yields between tokens, so tm must
+    // not be modified concurrently.
+    dht::token_range_vector get_address_ranges(token_metadata& tm, inet_address ep, can_yield cy) const;
+
     std::unordered_multimap<dht::token_range, inet_address> get_range_addresses(token_metadata& tm) const;
 
     dht::token_range_vector get_pending_address_ranges(token_metadata& tm, token pending_token, inet_address pending_address);
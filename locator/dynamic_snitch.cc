@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2017 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <boost/range/algorithm/min_element.hpp>
+#include <boost/range/adaptor/map.hpp>
+#include <boost/range/iterator_range.hpp>
+#include <seastar/core/metrics.hh>
+#include "locator/dynamic_snitch.hh"
+#include "locator/snitch_base.hh"
+
+namespace locator {
+
+// Weight of the latest sample in the moving average of latencies.
+static constexpr double latency_alpha = 0.25;
+
+static seastar::metrics::label endpoint_label("endpoint");
+
+dynamic_snitch::dynamic_snitch(config cfg)
+    : _cfg(std::move(cfg))
+    , _update_timer([this] { update_scores(); })
+    , _reset_timer([this] { reset(); })
+{
+    if (_cfg.enabled) {
+        _update_timer.arm_periodic(_cfg.update_interval);
+        _reset_timer.arm_periodic(_cfg.reset_interval);
+    }
+}
+
+dynamic_snitch::endpoint_state& dynamic_snitch::get_endpoint(gms::inet_address ep) {
+    auto& e = _endpoints[ep];
+    if (!e) {
+        namespace sm = seastar::metrics;
+        e = std::make_unique<endpoint_state>();
+        auto& s = *e;
+        s.metrics.add_group("dynamic_snitch", {
+            sm::make_gauge("score", [&s] { return s.score; },
+                           sm::description("badness score of a replica, used to order reads among the replicas of a datacenter, lower is better"), {endpoint_label(ep)}),
+            sm::make_gauge("latency", [&s] { return s.latency_us; },
+                           sm::description("moving average of the response latency of a replica, in microseconds"), {endpoint_label(ep)}),
+            sm::make_gauge("in_flight", [&s] { return s.in_flight; },
+                           sm::description("number of requests sent to a replica and not completed yet"), {endpoint_label(ep)}),
+        });
+    }
+    return *e;
+}
+
+dynamic_snitch::clock_type::time_point dynamic_snitch::request_started(gms::inet_address ep) {
+    if (!_cfg.enabled) {
+        return clock_type::time_point();
+    }
+    get_endpoint(ep).in_flight++;
+    return clock_type::now();
+}
+
+void dynamic_snitch::request_completed(gms::inet_address ep, clock_type::time_point started) {
+    if (!_cfg.enabled) {
+        return;
+    }
+    // ep may have been removed while the request was in flight.
+    auto it = _endpoints.find(ep);
+    if (it == _endpoints.end()) {
+        return;
+    }
+    auto& e = *it->second;
+    if (e.in_flight) {
+        e.in_flight--;
+    }
+    auto latency = std::chrono::duration<double, std::micro>(clock_type::now() - started).count();
+    e.latency_us = e.latency_us ? e.latency_us + latency_alpha * (latency - e.latency_us) : latency;
+}
+
+void dynamic_snitch::remove_endpoint(gms::inet_address ep) {
+    _endpoints.erase(ep);
+}
+
+double dynamic_snitch::score(gms::inet_address ep) const {
+    auto it = _endpoints.find(ep);
+    return it == _endpoints.end() ? 0 : it->second->score;
+}
+
+void dynamic_snitch::update_scores() {
+    for (auto&& e : _endpoints) {
+        auto& s = *e.second;
+        s.score = s.latency_us * (1 + s.in_flight);
+    }
+}
+
+void dynamic_snitch::reset() {
+    for (auto&& e : _endpoints) {
+        e.second->latency_us = 0;
+    }
+    update_scores();
+}
+
+void dynamic_snitch::sort_datacenter(std::vector<gms::inet_address>::iterator begin, std::vector<gms::inet_address>::iterator end) const {
+    if (end - begin < 2) {
+        return;
+    }
+    std::unordered_map<gms::inet_address, double> scores;
+    std::vector<double> measured;
+    for (auto ep : boost::make_iterator_range(begin, end)) {
+        auto s = score(ep);
+        scores.emplace(ep, s);
+        if (s > 0) {
+            measured.push_back(s);
+        }
+    }
+    if (measured.empty()) {
+        return;
+    }
+    // A replica without a score would otherwise look like the best one.
+    auto median = measured.begin() + measured.size() / 2;
+    std::nth_element(measured.begin(), median, measured.end());
+    for (auto&& e : scores) {
+        if (!e.second) {
+            e.second = *median;
+        }
+    }
+    auto best = *boost::min_element(scores | boost::adaptors::map_values);
+    // The static order may prefer the local node or rack for good reasons,
+    // so it is kept unless the replica it puts first is clearly worse.
+    if (scores[*begin] <= best * (1 + _cfg.badness_threshold)) {
+        return;
+    }
+    std::stable_sort(begin, end, [&scores] (gms::inet_address a, gms::inet_address b) {
+        return scores[a] < scores[b];
+    });
+}
+
+void dynamic_snitch::sort_by_score(std::vector<gms::inet_address>& addresses) const {
+    if (!_cfg.enabled || addresses.size() < 2) {
+        return;
+    }
+    auto& snitch = i_endpoint_snitch::get_local_snitch_ptr();
+    auto begin = addresses.begin();
+    while (begin != addresses.end()) {
+        auto dc = snitch->get_datacenter(*begin);
+        auto end = std::find_if(begin + 1, addresses.end(), [&] (gms::inet_address ep) {
+            return snitch->get_datacenter(ep) != dc;
+        });
+        sort_datacenter(begin, end);
+        begin = end;
+    }
+}
+
+}
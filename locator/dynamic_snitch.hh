@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2017 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "core/timer.hh"
+#include <seastar/core/metrics_registration.hh>
+#include "gms/inet_address.hh"
+
+namespace locator {
+
+// Refines the static ordering of replicas by the snitch with how fast they
+// have been responding to this shard, so that reads move away from a
+// replica which is slow, e.g. because it is busy compacting.
+//
+// Each endpoint gets a badness score, the moving average of its response
+// latency scaled by the number of requests it has in flight; lower is
+// better. Scores are recomputed every update_interval, and latencies are
+// forgotten every reset_interval, so that a replica which was slow gets
+// another chance. A replica with no latency measured yet is taken to score
+// like the median measured replica of its datacenter. Replicas are only
+// reordered within a datacenter, and only when the one the static order
+// prefers scores worse than the best one by more than badness_threshold
+// (0.1 means 10%).
+class dynamic_snitch {
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    struct config {
+        bool enabled = true;
+        std::chrono::milliseconds update_interval = std::chrono::milliseconds(100);
+        std::chrono::milliseconds reset_interval = std::chrono::milliseconds(60000);
+        double badness_threshold = 0.1;
+    };
+private:
+    struct endpoint_state {
+        double latency_us = 0; // moving average, 0 until measured
+        unsigned in_flight = 0;
+        double score = 0;
+        seastar::metrics::metric_groups metrics;
+    };
+
+    config _cfg;
+    std::unordered_map<gms::inet_address, std::unique_ptr<endpoint_state>> _endpoints;
+    timer<lowres_clock> _update_timer;
+    timer<lowres_clock> _reset_timer;
+private:
+    endpoint_state& get_endpoint(gms::inet_address ep);
+    double score(gms::inet_address ep) const;
+    void sort_datacenter(std::vector<gms::inet_address>::iterator begin, std::vector<gms::inet_address>::iterator end) const;
+    void update_scores();
+    void reset();
+
+    friend class dynamic_snitch_test;
+public:
+    explicit dynamic_snitch(config cfg);
+    dynamic_snitch(const dynamic_snitch&) = delete;
+    dynamic_snitch(dynamic_snitch&&) = delete;
+
+    // Must be called around each request to ep whose latency is to be
+    // accounted, with the time returned by request_started() passed to
+    // request_completed(), whether the request succeeded or not.
+    clock_type::time_point request_started(gms::inet_address ep);
+    void request_completed(gms::inet_address ep, clock_type::time_point started);
+
+    // Forgets ep, e.g. because it left the cluster, and drops its metrics.
+    void remove_endpoint(gms::inet_address ep);
+
+    // Reorders addresses, sorted by the static snitch already, by score
+    // within each run of endpoints of the same datacenter.
+    void sort_by_score(std::vector<gms::inet_address>& addresses) const;
+};
+
+}
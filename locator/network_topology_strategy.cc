@@ -120,20 +120,20 @@ network_topology_strategy::calculate_natural_endpoints(
         skipped_dc_endpoints[dc_name] = {};
     }
 
-    topology& tp = tm.get_topology();
+    const topology& tp = tm.get_topology();
 
     //
     // all endpoints in each DC, so we can check when we have exhausted all
     // the members of a DC
     //
-    std::unordered_map<sstring,
+    const std::unordered_map<sstring,
                        std::unordered_set<inet_address>>&
         all_endpoints = tp.get_datacenter_endpoints();
     //
     // all racks in a DC so we can check when we have exhausted all racks in a
     // DC
     //
-    std::unordered_map<sstring,
+    const std::unordered_map<sstring,
                        std::unordered_map<sstring,
                                           std::unordered_set<inet_address>>>&
         racks = tp.get_datacenter_racks();
@@ -151,7 +151,9 @@ network_topology_strategy::calculate_natural_endpoints(
         sstring dc = _snitch->get_datacenter(ep);
 
         auto& seen_racks_dc_set = seen_racks[dc];
-        auto& racks_dc_map = racks[dc];
+        static const std::unordered_map<sstring, std::unordered_set<inet_address>> no_racks;
+        auto racks_it = racks.find(dc);
+        auto& racks_dc_map = racks_it == racks.end() ? no_racks : racks_it->second;
         auto& skipped_dc_endpoints_set = skipped_dc_endpoints[dc];
         auto& dc_replicas_dc_set = dc_replicas[dc];
 
@@ -218,17 +220,21 @@ inline bool network_topology_strategy::has_sufficient_replicas(
         const sstring& dc,
         std::unordered_map<sstring,
                            std::unordered_set<inet_address>>& dc_replicas,
-        std::unordered_map<sstring,
+        const std::unordered_map<sstring,
                            std::unordered_set<inet_address>>& all_endpoints) const {
 
+        // all_endpoints belongs to the token metadata, which may be shared
+        // with other shards, so it must not be modified.
+        auto it = all_endpoints.find(dc);
+        size_t dc_endpoints = it == all_endpoints.end() ? 0 : it->second.size();
         return dc_replicas[dc].size() >=
-            std::min(all_endpoints[dc].size(), get_replication_factor(dc));
+            std::min(dc_endpoints, get_replication_factor(dc));
 }
 
 inline bool network_topology_strategy::has_sufficient_replicas(
         std::unordered_map<sstring,
                            std::unordered_set<inet_address>>& dc_replicas,
-        std::unordered_map<sstring,
+        const std::unordered_map<sstring,
                            std::unordered_set<inet_address>>& all_endpoints) const {
 
         for (auto& dc : get_datacenters()) {
@@ -83,13 +83,13 @@ class network_topology_strategy : public abstract_replication_strategy {
         const sstring& dc,
         std::unordered_map<sstring,
                            std::unordered_set<inet_address>>& dc_replicas,
-        std::unordered_map<sstring,
+        const std::unordered_map<sstring,
                            std::unordered_set<inet_address>>& all_endpoints) const;
 
     bool has_sufficient_replicas(
         std::unordered_map<sstring,
                            std::unordered_set<inet_address>>& dc_replicas,
-        std::unordered_map<sstring,
+        const std::unordered_map<sstring,
                            std::unordered_set<inet_address>>& all_endpoints) const;
 
 private:
@@ -31,6 +31,10 @@
 #include <algorithm>
 #include <boost/icl/interval.hpp>
 #include <boost/icl/interval_map.hpp>
+#include <boost/algorithm/cxx11/any_of.hpp>
+#include <boost/range/algorithm/find_if.hpp>
+#include "core/thread.hh"
+#include "core/reactor.hh"
 
 namespace locator {
 
@@ -47,12 +51,28 @@ static void remove_by_value(C& container, V value) {
     }
 }
 
-token_metadata::token_metadata(std::map<token, inet_address> token_to_endpoint_map, std::unordered_map<inet_address, utils::UUID> endpoints_map, topology topology) :
+// A version is destroyed on the shard which created it, as it may have been
+// shared with other shards.
+template <typename... Args>
+token_metadata token_metadata::make(Args&&... args) {
+    auto impl = new token_metadata_impl(std::forward<Args>(args)...);
+    return token_metadata(std::shared_ptr<token_metadata_impl>(impl, [owner = engine().cpu_id()] (token_metadata_impl* impl) {
+        if (engine().cpu_id() == owner) {
+            delete impl;
+        } else {
+            smp::submit_to(owner, [impl] {
+                delete impl;
+            });
+        }
+    }));
+}
+
+token_metadata_impl::token_metadata_impl(std::map<token, inet_address> token_to_endpoint_map, std::unordered_map<inet_address, utils::UUID> endpoints_map, topology topology) :
     _token_to_endpoint_map(token_to_endpoint_map), _endpoint_to_host_id_map(endpoints_map), _topology(topology) {
     _sorted_tokens = sort_tokens();
 }
 
-std::vector<token> token_metadata::sort_tokens() {
+std::vector<token> token_metadata_impl::sort_tokens() {
     std::vector<token> sorted;
     sorted.reserve(_token_to_endpoint_map.size());
 
@@ -63,11 +83,11 @@ std::vector<token> token_metadata::sort_tokens() {
     return sorted;
 }
 
-const std::vector<token>& token_metadata::sorted_tokens() const {
+const std::vector<token>& token_metadata_impl::sorted_tokens() const {
     return _sorted_tokens;
 }
 
-std::vector<token> token_metadata::get_tokens(const inet_address& addr) const {
+std::vector<token> token_metadata_impl::get_tokens(const inet_address& addr) const {
     std::vector<token> res;
     for (auto&& i : _token_to_endpoint_map) {
         if (i.second == addr) {
@@ -79,12 +99,12 @@ std::vector<token> token_metadata::get_tokens(const inet_address& addr) const {
 /**
  * Update token map with a single token/endpoint pair in normal state.
  */
-void token_metadata::update_normal_token(token t, inet_address endpoint)
+void token_metadata_impl::update_normal_token(token t, inet_address endpoint)
 {
     update_normal_tokens(std::unordered_set<token>({t}), endpoint);
 }
 
-void token_metadata::update_normal_tokens(std::unordered_set<token> tokens, inet_address endpoint) {
+void token_metadata_impl::update_normal_tokens(std::unordered_set<token> tokens, inet_address endpoint) {
     if (tokens.empty()) {
         return;
     }
@@ -100,7 +120,7 @@ void token_metadata::update_normal_tokens(std::unordered_set<token> tokens, inet
  *
  * @param endpointTokens
  */
-void token_metadata::update_normal_tokens(std::unordered_map<inet_address, std::unordered_set<token>>& endpoint_tokens) {
+void token_metadata_impl::update_normal_tokens(std::unordered_map<inet_address, std::unordered_set<token>>& endpoint_tokens) {
     if (endpoint_tokens.empty()) {
         return;
     }
@@ -144,7 +164,7 @@ void token_metadata::update_normal_tokens(std::unordered_map<inet_address, std::
     }
 }
 
-size_t token_metadata::first_token_index(const token& start) const {
+size_t token_metadata_impl::first_token_index(const token& start) const {
     if (_sorted_tokens.empty()) {
         auto msg = sprint("sorted_tokens is empty in first_token_index!");
         tlogger.error("{}", msg);
@@ -158,11 +178,11 @@ size_t token_metadata::first_token_index(const token& start) const {
     }
 }
 
-const token& token_metadata::first_token(const token& start) const {
+const token& token_metadata_impl::first_token(const token& start) const {
     return _sorted_tokens[first_token_index(start)];
 }
 
-std::experimental::optional<inet_address> token_metadata::get_endpoint(const token& token) const {
+std::experimental::optional<inet_address> token_metadata_impl::get_endpoint(const token& token) const {
     auto it = _token_to_endpoint_map.find(token);
     if (it == _token_to_endpoint_map.end()) {
         return std::experimental::nullopt;
@@ -171,26 +191,7 @@ std::experimental::optional<inet_address> token_metadata::get_endpoint(const tok
     }
 }
 
-void token_metadata::debug_show() {
-    auto reporter = std::make_shared<timer<lowres_clock>>();
-    reporter->set_callback ([reporter, this] {
-        print("Endpoint -> Token\n");
-        for (auto x : _token_to_endpoint_map) {
-            print("inet_address=%s, token=%s\n", x.second, x.first);
-        }
-        print("Endpoint -> UUID\n");
-        for (auto x : _endpoint_to_host_id_map) {
-            print("inet_address=%s, uuid=%s\n", x.first, x.second);
-        }
-        print("Sorted Token\n");
-        for (auto x : _sorted_tokens) {
-            print("token=%s\n", x);
-        }
-    });
-    reporter->arm_periodic(std::chrono::seconds(1));
-}
-
-void token_metadata::update_host_id(const UUID& host_id, inet_address endpoint) {
+void token_metadata_impl::update_host_id(const UUID& host_id, inet_address endpoint) {
 #if 0
     assert host_id != null;
     assert endpoint != null;
@@ -212,14 +213,14 @@ void token_metadata::update_host_id(const UUID& host_id, inet_address endpoint)
     _endpoint_to_host_id_map[endpoint] = host_id;
 }
 
-utils::UUID token_metadata::get_host_id(inet_address endpoint) {
+utils::UUID token_metadata_impl::get_host_id(inet_address endpoint) const {
     if (!_endpoint_to_host_id_map.count(endpoint)) {
         throw std::runtime_error(sprint("host_id for endpoint %s is not found", endpoint));
     }
     return _endpoint_to_host_id_map.at(endpoint);
 }
 
-std::experimental::optional<inet_address> token_metadata::get_endpoint_for_host_id(UUID host_id) {
+std::experimental::optional<inet_address> token_metadata_impl::get_endpoint_for_host_id(UUID host_id) const {
     auto beg = _endpoint_to_host_id_map.cbegin();
     auto end = _endpoint_to_host_id_map.cend();
     auto it = std::find_if(beg, end, [host_id] (auto x) {
@@ -232,21 +233,21 @@ std::experimental::optional<inet_address> token_metadata::get_endpoint_for_host_
     }
 }
 
-const std::unordered_map<inet_address, utils::UUID>& token_metadata::get_endpoint_to_host_id_map_for_reading() const{
+const std::unordered_map<inet_address, utils::UUID>& token_metadata_impl::get_endpoint_to_host_id_map_for_reading() const{
     return _endpoint_to_host_id_map;
 }
 
-bool token_metadata::is_member(inet_address endpoint) {
+bool token_metadata_impl::is_member(inet_address endpoint) const {
     return _topology.has_endpoint(endpoint);
 }
 
-void token_metadata::add_bootstrap_token(token t, inet_address endpoint) {
+void token_metadata_impl::add_bootstrap_token(token t, inet_address endpoint) {
     std::unordered_set<token> tokens{t};
     add_bootstrap_tokens(tokens, endpoint);
 }
 
-boost::iterator_range<token_metadata::tokens_iterator>
-token_metadata::ring_range(
+boost::iterator_range<token_metadata_impl::tokens_iterator>
+token_metadata_impl::ring_range(
     const std::experimental::optional<dht::partition_range::bound>& start,
     bool include_min) const
 {
@@ -266,7 +267,7 @@ token_metadata::ring_range(
     return r;
 }
 
-void token_metadata::add_bootstrap_tokens(std::unordered_set<token> tokens, inet_address endpoint) {
+void token_metadata_impl::add_bootstrap_tokens(std::unordered_set<token> tokens, inet_address endpoint) {
     for (auto t : tokens) {
         auto old_endpoint = _bootstrap_tokens.find(t);
         if (old_endpoint != _bootstrap_tokens.end() && (*old_endpoint).second != endpoint) {
@@ -293,9 +294,10 @@ void token_metadata::add_bootstrap_tokens(std::unordered_set<token> tokens, inet
     for (auto t : tokens) {
         _bootstrap_tokens[t] = endpoint;
     }
+    ++_pending_ops_version;
 }
 
-void token_metadata::remove_bootstrap_tokens(std::unordered_set<token> tokens) {
+void token_metadata_impl::remove_bootstrap_tokens(std::unordered_set<token> tokens) {
     if (tokens.empty()) {
         auto msg = sprint("tokens is empty in remove_bootstrap_tokens!");
         tlogger.error("{}", msg);
@@ -304,13 +306,14 @@ void token_metadata::remove_bootstrap_tokens(std::unordered_set<token> tokens) {
     for (auto t : tokens) {
         _bootstrap_tokens.erase(t);
     }
+    ++_pending_ops_version;
 }
 
-bool token_metadata::is_leaving(inet_address endpoint) {
+bool token_metadata_impl::is_leaving(inet_address endpoint) const {
     return _leaving_endpoints.count(endpoint);
 }
 
-void token_metadata::remove_endpoint(inet_address endpoint) {
+void token_metadata_impl::remove_endpoint(inet_address endpoint) {
     remove_by_value(_bootstrap_tokens, endpoint);
     remove_by_value(_token_to_endpoint_map, endpoint);
     _topology.remove_endpoint(endpoint);
@@ -320,12 +323,12 @@ void token_metadata::remove_endpoint(inet_address endpoint) {
     invalidate_cached_rings();
 }
 
-void token_metadata::remove_from_moving(inet_address endpoint) {
+void token_metadata_impl::remove_from_moving(inet_address endpoint) {
     remove_by_value(_moving_endpoints, endpoint);
     invalidate_cached_rings();
 }
 
-token token_metadata::get_predecessor(token t) {
+token token_metadata_impl::get_predecessor(token t) const {
     auto& tokens = sorted_tokens();
     auto it = std::lower_bound(tokens.begin(), tokens.end(), t);
     if (it == tokens.end() || *it != t) {
@@ -341,7 +344,7 @@ token token_metadata::get_predecessor(token t) {
     }
 }
 
-dht::token_range_vector token_metadata::get_primary_ranges_for(std::unordered_set<token> tokens) {
+dht::token_range_vector token_metadata_impl::get_primary_ranges_for(std::unordered_set<token> tokens) const {
     dht::token_range_vector ranges;
     ranges.reserve(tokens.size() + 1); // one of the ranges will wrap
     for (auto right : tokens) {
@@ -354,12 +357,12 @@ dht::token_range_vector token_metadata::get_primary_ranges_for(std::unordered_se
     return ranges;
 }
 
-dht::token_range_vector token_metadata::get_primary_ranges_for(token right) {
+dht::token_range_vector token_metadata_impl::get_primary_ranges_for(token right) const {
     return get_primary_ranges_for(std::unordered_set<token>{right});
 }
 
 boost::icl::interval<token>::interval_type
-token_metadata::range_to_interval(range<dht::token> r) {
+token_metadata_impl::range_to_interval(range<dht::token> r) {
     bool start_inclusive = false;
     bool end_inclusive = false;
     token start = dht::minimum_token();
@@ -387,7 +390,7 @@ token_metadata::range_to_interval(range<dht::token> r) {
 }
 
 range<dht::token>
-token_metadata::interval_to_range(boost::icl::interval<token>::interval_type i) {
+token_metadata_impl::interval_to_range(boost::icl::interval<token>::interval_type i) {
     bool start_inclusive;
     bool end_inclusive;
     auto bounds = i.bounds().bits();
@@ -409,8 +412,9 @@ token_metadata::interval_to_range(boost::icl::interval<token>::interval_type i)
     return range<dht::token>({{i.lower(), start_inclusive}}, {{i.upper(), end_inclusive}});
 }
 
-void token_metadata::set_pending_ranges(const sstring& keyspace_name,
+void token_metadata_impl::set_pending_ranges(const sstring& keyspace_name,
         std::unordered_multimap<range<token>, inet_address> new_pending_ranges) {
+    _pending_ranges_sources.erase(keyspace_name);
     if (new_pending_ranges.empty()) {
         _pending_ranges.erase(keyspace_name);
         _pending_ranges_map.erase(keyspace_name);
@@ -432,20 +436,23 @@ void token_metadata::set_pending_ranges(const sstring& keyspace_name,
     _pending_ranges_map[keyspace_name] = std::move(map);
 }
 
-std::unordered_multimap<range<token>, inet_address>&
-token_metadata::get_pending_ranges_mm(sstring keyspace_name) {
-    return _pending_ranges[keyspace_name];
-}
-
+// Readers must not insert missing keyspaces: a version may be read by all
+// shards at the same time.
 const std::unordered_map<range<token>, std::unordered_set<inet_address>>&
-token_metadata::get_pending_ranges(sstring keyspace_name) {
-    return _pending_ranges_map[keyspace_name];
+token_metadata_impl::get_pending_ranges(const sstring& keyspace_name) const {
+    static const std::unordered_map<range<token>, std::unordered_set<inet_address>> empty;
+    auto it = _pending_ranges_map.find(keyspace_name);
+    return it == _pending_ranges_map.end() ? empty : it->second;
 }
 
 std::vector<range<token>>
-token_metadata::get_pending_ranges(sstring keyspace_name, inet_address endpoint) {
+token_metadata_impl::get_pending_ranges(const sstring& keyspace_name, inet_address endpoint) const {
     std::vector<range<token>> ret;
-    for (auto x : get_pending_ranges_mm(keyspace_name)) {
+    auto it = _pending_ranges.find(keyspace_name);
+    if (it == _pending_ranges.end()) {
+        return ret;
+    }
+    for (auto& x : it->second) {
         auto& range_token = x.first;
         auto& ep = x.second;
         if (ep == endpoint) {
@@ -455,103 +462,136 @@ token_metadata::get_pending_ranges(sstring keyspace_name, inet_address endpoint)
     return ret;
 }
 
-void token_metadata::calculate_pending_ranges(abstract_replication_strategy& strategy, const sstring& keyspace_name) {
-    std::unordered_multimap<range<token>, inet_address> new_pending_ranges;
-
-    if (_bootstrap_tokens.empty() && _leaving_endpoints.empty() && _moving_endpoints.empty()) {
-        tlogger.debug("No bootstrapping, leaving or moving nodes -> empty pending ranges for {}", keyspace_name);
-        set_pending_ranges(keyspace_name, std::move(new_pending_ranges));
-        return;
+std::unordered_multimap<range<token>, inet_address> token_metadata_impl::pending_ranges_parts::assemble() const {
+    auto ret = leaving;
+    for (auto& x : bootstrapping) {
+        for (auto& r : x.second.second) {
+            ret.emplace(r, x.first);
+        }
+    }
+    for (auto& x : moving) {
+        for (auto& r : x.second.second) {
+            ret.emplace(r, x.second.first);
+        }
     }
+    return ret;
+}
 
-    std::unordered_multimap<inet_address, dht::token_range> address_ranges = strategy.get_address_ranges(*this);
+// Calculates the parts which are not in old, or were calculated against a
+// different topology, and takes the rest from old. Returns old itself if
+// nothing changed.
+std::shared_ptr<const token_metadata_impl::pending_ranges_parts>
+token_metadata_impl::calculate_pending_ranges_parts(abstract_replication_strategy& strategy,
+        std::shared_ptr<const pending_ranges_parts> old, can_yield cy) const {
+    if (old && old->topology_version != _topology_version) {
+        old = nullptr;
+    }
+    auto parts = std::make_shared<pending_ranges_parts>();
+    parts->topology_version = _topology_version;
+    bool changed = !old;
 
-    // FIMXE
     // Copy of metadata reflecting the situation after all leave operations are finished.
-    auto all_left_metadata = clone_after_all_left();
-
-    // get all ranges that will be affected by leaving nodes
-    std::unordered_set<range<token>> affected_ranges;
-    for (auto endpoint : _leaving_endpoints) {
-        auto r = address_ranges.equal_range(endpoint);
-        for (auto x = r.first; x != r.second; x++) {
-            affected_ranges.emplace(x->second);
+    // Only made if there is something to calculate.
+    std::experimental::optional<token_metadata> all_left;
+    auto all_left_metadata = [&] () -> token_metadata& {
+        if (!all_left) {
+            all_left = clone_after_all_left();
         }
-    }
-    // for each of those ranges, find what new nodes will be responsible for the range when
-    // all leaving nodes are gone.
-    auto metadata = clone_only_token_map(); // don't do this in the loop! #7758
-    for (const auto& r : affected_ranges) {
-        auto t = r.end() ? r.end()->value() : dht::maximum_token();
-        auto current_endpoints = strategy.calculate_natural_endpoints(t, metadata);
-        auto new_endpoints = strategy.calculate_natural_endpoints(t, all_left_metadata);
-        std::vector<inet_address> diff;
-        std::sort(current_endpoints.begin(), current_endpoints.end());
-        std::sort(new_endpoints.begin(), new_endpoints.end());
-        std::set_difference(new_endpoints.begin(), new_endpoints.end(),
-            current_endpoints.begin(), current_endpoints.end(), std::back_inserter(diff));
-        for (auto& ep : diff) {
-            new_pending_ranges.emplace(r, ep);
+        return *all_left;
+    };
+
+    // Find all ranges that will be affected by leaving nodes and, for each of those
+    // ranges, find what new nodes will be responsible for the range when all leaving
+    // nodes are gone.
+    if (old) {
+        parts->leaving = old->leaving;
+    } else if (!_leaving_endpoints.empty()) {
+        auto metadata = clone_only_token_map(); // don't do this in the loop! #7758
+        for (auto& t : metadata.sorted_tokens()) {
+            auto current_endpoints = strategy.calculate_natural_endpoints(t, metadata);
+            auto affected = boost::algorithm::any_of(current_endpoints, [&] (const inet_address& ep) {
+                return _leaving_endpoints.count(ep);
+            });
+            if (affected) {
+                auto new_endpoints = strategy.calculate_natural_endpoints(t, all_left_metadata());
+                std::vector<inet_address> diff;
+                std::sort(current_endpoints.begin(), current_endpoints.end());
+                std::sort(new_endpoints.begin(), new_endpoints.end());
+                std::set_difference(new_endpoints.begin(), new_endpoints.end(),
+                    current_endpoints.begin(), current_endpoints.end(), std::back_inserter(diff));
+                for (auto&& r : metadata.get_primary_ranges_for(t)) {
+                    for (auto& ep : diff) {
+                        parts->leaving.emplace(r, ep);
+                    }
+                }
+            }
+            if (cy && seastar::thread::should_yield()) {
+                seastar::thread::yield();
+            }
         }
     }
 
-    // At this stage newPendingRanges has been updated according to leave operations. We can
-    // now continue the calculation by checking bootstrapping nodes.
-
     // For each of the bootstrapping nodes, simply add and remove them one by one to
-    // allLeftMetadata and check in between what their ranges would be.
-    std::unordered_multimap<inet_address, token> bootstrap_addresses;
+    // allLeftMetadata and check in between what their ranges would be. Nodes whose
+    // tokens did not change keep the ranges calculated before.
+    std::unordered_map<inet_address, std::unordered_set<token>> bootstrap_addresses;
     for (auto& x : _bootstrap_tokens) {
-        bootstrap_addresses.emplace(x.second, x.first);
+        bootstrap_addresses[x.second].insert(x.first);
     }
-
-    // TODO: share code with unordered_multimap_to_unordered_map
-    std::unordered_map<inet_address, std::unordered_set<token>> tmp;
     for (auto& x : bootstrap_addresses) {
-        auto& addr = x.first;
-        auto& t = x.second;
-        tmp[addr].insert(t);
-    }
-    for (auto& x : tmp) {
         auto& endpoint = x.first;
         auto& tokens = x.second;
-        all_left_metadata.update_normal_tokens(tokens, endpoint);
-        for (auto& x : strategy.get_address_ranges(all_left_metadata)) {
-            if (x.first == endpoint) {
-                new_pending_ranges.emplace(x.second, endpoint);
+        if (old) {
+            auto it = old->bootstrapping.find(endpoint);
+            if (it != old->bootstrapping.end() && it->second.first == tokens) {
+                parts->bootstrapping.emplace(endpoint, it->second);
+                continue;
             }
         }
-        all_left_metadata.remove_endpoint(endpoint);
+        changed = true;
+        auto& tm = all_left_metadata();
+        tm.update_normal_tokens(tokens, endpoint);
+        auto ranges = strategy.get_address_ranges(tm, endpoint, cy);
+        tm.remove_endpoint(endpoint);
+        parts->bootstrapping.emplace(endpoint, std::make_pair(std::move(tokens), std::move(ranges)));
     }
 
-    // At this stage newPendingRanges has been updated according to leaving and bootstrapping nodes.
-    // We can now finish the calculation by checking moving nodes.
-
-    // For each of the moving nodes, we do the same thing we did for bootstrapping:
-    // simply add and remove them one by one to allLeftMetadata and check in between what their ranges would be.
+    // For each of the moving nodes, we do the same thing we did for bootstrapping,
+    // restoring the node's current tokens afterwards, so that the ranges of one move
+    // do not depend on which other moves were calculated before it.
     for (auto& moving : _moving_endpoints) {
         auto& t = moving.first;
         auto& endpoint = moving.second; // address of the moving node
-
-        // moving.left is a new token of the endpoint
-        all_left_metadata.update_normal_token(t, endpoint);
-
-        for (auto& x : strategy.get_address_ranges(all_left_metadata)) {
-            if (x.first == endpoint) {
-                new_pending_ranges.emplace(x.second, endpoint);
+        if (old) {
+            auto it = old->moving.find(t);
+            if (it != old->moving.end() && it->second.first == endpoint) {
+                parts->moving.emplace(t, it->second);
+                continue;
             }
         }
+        changed = true;
+        auto& tm = all_left_metadata();
+        auto current_tokens = tm.get_tokens(endpoint);
 
-        all_left_metadata.remove_endpoint(endpoint);
+        // moving.left is a new token of the endpoint
+        tm.update_normal_token(t, endpoint);
+        auto ranges = strategy.get_address_ranges(tm, endpoint, cy);
+        if (current_tokens.empty()) {
+            tm.remove_endpoint(endpoint);
+        } else {
+            tm.update_normal_tokens(std::unordered_set<token>(current_tokens.begin(), current_tokens.end()), endpoint);
+        }
+        parts->moving.emplace(t, std::make_pair(endpoint, std::move(ranges)));
     }
 
-    set_pending_ranges(keyspace_name, std::move(new_pending_ranges));
-
-    if (tlogger.is_enabled(logging::log_level::debug)) {
-        tlogger.debug("Pending ranges: {}", (_pending_ranges.empty() ? "<empty>" : print_pending_ranges()));
+    // Parts of operations which finished are simply not carried over.
+    if (!changed && parts->bootstrapping.size() == old->bootstrapping.size() && parts->moving.size() == old->moving.size()) {
+        return old;
     }
+    return parts;
 }
-sstring token_metadata::print_pending_ranges() {
+
+sstring token_metadata_impl::print_pending_ranges() const {
     std::stringstream ss;
 
     for (auto& x : _pending_ranges) {
@@ -566,11 +606,27 @@ sstring token_metadata::print_pending_ranges() {
     return sstring(ss.str());
 }
 
-void token_metadata::add_leaving_endpoint(inet_address endpoint) {
+void token_metadata_impl::add_leaving_endpoint(inet_address endpoint) {
      _leaving_endpoints.emplace(endpoint);
+     ++_topology_version;
+     ++_pending_ops_version;
+}
+
+token_metadata token_metadata_impl::clone_only_token_map() const {
+    return token_metadata::make(_token_to_endpoint_map, _endpoint_to_host_id_map, _topology);
 }
 
-token_metadata token_metadata::clone_after_all_settled() {
+token_metadata token_metadata_impl::clone_after_all_left() const {
+    auto all_left_metadata = clone_only_token_map();
+
+    for (auto endpoint : _leaving_endpoints) {
+        all_left_metadata.remove_endpoint(endpoint);
+    }
+
+    return all_left_metadata;
+}
+
+token_metadata token_metadata_impl::clone_after_all_settled() const {
     token_metadata metadata = clone_only_token_map();
 
     for (auto endpoint : _leaving_endpoints) {
@@ -585,39 +641,41 @@ token_metadata token_metadata::clone_after_all_settled() {
     return metadata;
 }
 
-void token_metadata::add_moving_endpoint(token t, inet_address endpoint) {
+void token_metadata_impl::add_moving_endpoint(token t, inet_address endpoint) {
     _moving_endpoints[t] = endpoint;
+    ++_pending_ops_version;
 }
 
-std::vector<gms::inet_address> token_metadata::pending_endpoints_for(const token& token, const sstring& keyspace_name) {
+std::vector<gms::inet_address> token_metadata_impl::pending_endpoints_for(const token& token, const sstring& keyspace_name) const {
     // Fast path 0: no pending ranges at all
     if (_pending_ranges_interval_map.empty()) {
         return {};
     }
 
     // Fast path 1: no pending ranges for this keyspace_name
-    if (_pending_ranges_interval_map[keyspace_name].empty()) {
+    auto ks_it = _pending_ranges_interval_map.find(keyspace_name);
+    if (ks_it == _pending_ranges_interval_map.end() || ks_it->second.empty()) {
         return {};
     }
 
     // Slow path: lookup pending ranges
     std::vector<gms::inet_address> endpoints;
     auto interval = range_to_interval(range<dht::token>(token));
-    auto it = _pending_ranges_interval_map[keyspace_name].find(interval);
-    if (it != _pending_ranges_interval_map[keyspace_name].end()) {
+    auto it = ks_it->second.find(interval);
+    if (it != ks_it->second.end()) {
         // interval_map does not work with std::vector, convert to std::vector of ips
         endpoints = std::vector<gms::inet_address>(it->second.begin(), it->second.end());
     }
     return endpoints;
 }
 
-std::map<token, inet_address> token_metadata::get_normal_and_bootstrapping_token_to_endpoint_map() {
+std::map<token, inet_address> token_metadata_impl::get_normal_and_bootstrapping_token_to_endpoint_map() const {
     std::map<token, inet_address> ret(_token_to_endpoint_map.begin(), _token_to_endpoint_map.end());
     ret.insert(_bootstrap_tokens.begin(), _bootstrap_tokens.end());
     return ret;
 }
 
-std::multimap<inet_address, token> token_metadata::get_endpoint_to_token_map_for_reading() {
+std::multimap<inet_address, token> token_metadata_impl::get_endpoint_to_token_map_for_reading() const {
     std::multimap<inet_address, token> cloned;
     for (const auto& x : _token_to_endpoint_map) {
         cloned.emplace(x.second, x.first);
@@ -625,6 +683,85 @@ std::multimap<inet_address, token> token_metadata::get_endpoint_to_token_map_for
     return cloned;
 }
 
+/////////////////// class token_metadata ///////////////////////////////////////
+token_metadata::token_metadata() : _impl(make()._impl) {
+}
+
+token_metadata_impl& token_metadata::mutable_impl() {
+    // Nobody can start sharing a version we hold the only reference to, so
+    // use_count() cannot go up behind our back. It can go down, in which
+    // case we make a copy we did not need; that is fine.
+    if (_impl.use_count() > 1) {
+        _impl = make(*_impl)._impl;
+    }
+    return *_impl;
+}
+
+void token_metadata::debug_show() {
+    auto reporter = std::make_shared<timer<lowres_clock>>();
+    reporter->set_callback ([reporter, this] {
+        auto& impl = *_impl;
+        print("Endpoint -> Token\n");
+        for (auto x : impl._token_to_endpoint_map) {
+            print("inet_address=%s, token=%s\n", x.second, x.first);
+        }
+        print("Endpoint -> UUID\n");
+        for (auto x : impl._endpoint_to_host_id_map) {
+            print("inet_address=%s, uuid=%s\n", x.first, x.second);
+        }
+        print("Sorted Token\n");
+        for (auto x : impl._sorted_tokens) {
+            print("token=%s\n", x);
+        }
+    });
+    reporter->arm_periodic(std::chrono::seconds(1));
+}
+
+void token_metadata::calculate_pending_ranges(abstract_replication_strategy& strategy, const sstring& keyspace_name, can_yield cy) {
+    // The calculation may yield, and the token metadata may change meanwhile,
+    // so it works on the version current when it started.
+    auto version = _impl;
+    token_metadata_impl::pending_ranges_key key(strategy.get_type(), strategy.get_config_options());
+
+    std::shared_ptr<const token_metadata_impl::pending_ranges_parts> parts;
+    if (version->_bootstrap_tokens.empty() && version->_leaving_endpoints.empty() && version->_moving_endpoints.empty()) {
+        tlogger.debug("No bootstrapping, leaving or moving nodes -> empty pending ranges for {}", keyspace_name);
+    } else {
+        auto it = version->_pending_ranges_parts.find(key);
+        parts = version->calculate_pending_ranges_parts(strategy,
+                it != version->_pending_ranges_parts.end() ? it->second : nullptr, cy);
+    }
+
+    auto src = version->_pending_ranges_sources.find(keyspace_name);
+    if (src != version->_pending_ranges_sources.end() ? src->second == parts : !parts) {
+        tlogger.debug("Pending operations and replication strategy unchanged -> keeping pending ranges for {}", keyspace_name);
+        return;
+    }
+
+    // A topology change which raced with the calculation triggers another one,
+    // which will see it; the ranges calculated here may already be wrong.
+    if (_impl->_topology_version != version->_topology_version
+            || _impl->_pending_ops_version != version->_pending_ops_version) {
+        tlogger.debug("Topology changed during the calculation -> dropping pending ranges for {}", keyspace_name);
+        return;
+    }
+    // Drop the pin, so that the version is not copied needlessly below.
+    version = nullptr;
+
+    auto& impl = mutable_impl();
+    if (parts) {
+        impl.set_pending_ranges(keyspace_name, parts->assemble());
+        impl._pending_ranges_parts[key] = parts;
+        impl._pending_ranges_sources.emplace(keyspace_name, std::move(parts));
+    } else {
+        impl.set_pending_ranges(keyspace_name, {});
+        impl._pending_ranges_parts.erase(key);
+    }
+
+    if (tlogger.is_enabled(logging::log_level::debug)) {
+        tlogger.debug("Pending ranges: {}", (impl._pending_ranges.empty() ? "<empty>" : impl.print_pending_ranges()));
+    }
+}
 
 /////////////////// class topology /////////////////////////////////////////////
 inline void topology::clear() {
@@ -39,6 +39,7 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <unordered_set>
 #include <unordered_map>
 #include "gms/inet_address.hh"
@@ -50,6 +51,7 @@
 #include <boost/icl/interval_map.hpp>
 #include "query-request.hh"
 #include "range.hh"
+#include <seastar/util/bool_class.hh>
 
 // forward declaration since database.hh includes this file
 class keyspace;
@@ -57,10 +59,13 @@ class keyspace;
 namespace locator {
 
 class abstract_replication_strategy;
+enum class replication_strategy_type;
 
 using inet_address = gms::inet_address;
 using token = dht::token;
 
+using can_yield = bool_class<class can_yield_tag>;
+
 // Endpoint Data Center and Rack names
 struct endpoint_dc_rack {
     sstring dc;
@@ -114,6 +119,13 @@ class topology {
         return _dc_racks;
     }
 
+    const std::unordered_map<sstring,
+                       std::unordered_map<sstring,
+                                          std::unordered_set<inet_address>>>&
+    get_datacenter_racks() const {
+        return _dc_racks;
+    }
+
 private:
     /** multi-map: DC -> endpoints in that DC */
     std::unordered_map<sstring,
@@ -130,7 +142,10 @@ class topology {
     std::unordered_map<inet_address, endpoint_dc_rack> _current_locations;
 };
 
-class token_metadata final {
+class token_metadata;
+
+// The contents of a version of the token metadata, see token_metadata.
+class token_metadata_impl final {
 public:
     using UUID = utils::UUID;
     using inet_address = gms::inet_address;
@@ -154,11 +169,36 @@ class token_metadata final {
     std::unordered_map<sstring, std::unordered_map<range<token>, std::unordered_set<inet_address>>> _pending_ranges_map;
     std::unordered_map<sstring, boost::icl::interval_map<token, std::unordered_set<inet_address>>> _pending_ranges_interval_map;
 
+    // Pending ranges of a replication strategy, kept per operation they come
+    // from, so that calculate_pending_ranges() only has to compute the ranges
+    // of operations which started since it last ran.
+    struct pending_ranges_parts {
+        // The _topology_version all parts were calculated against.
+        long topology_version;
+        std::unordered_multimap<range<token>, inet_address> leaving;
+        // Bootstrapping endpoint -> its tokens and the ranges they give it.
+        std::unordered_map<inet_address, std::pair<std::unordered_set<token>, dht::token_range_vector>> bootstrapping;
+        // New token of a moving endpoint -> the endpoint and the ranges the token gives it.
+        std::unordered_map<token, std::pair<inet_address, dht::token_range_vector>> moving;
+
+        std::unordered_multimap<range<token>, inet_address> assemble() const;
+    };
+    using pending_ranges_key = std::pair<replication_strategy_type, std::map<sstring, sstring>>;
+    std::map<pending_ranges_key, std::shared_ptr<const pending_ranges_parts>> _pending_ranges_parts;
+    // The parts the pending ranges of each keyspace were assembled from.
+    std::unordered_map<sstring, std::shared_ptr<const pending_ranges_parts>> _pending_ranges_sources;
+
     std::vector<token> _sorted_tokens;
 
     topology _topology;
 
     long _ring_version = 0;
+    // Bumped on every change to normal tokens, leaving endpoints and DC/rack
+    // placement, i.e. whenever all pending ranges have to be recalculated.
+    long _topology_version = 0;
+    // Bumped with _topology_version, and when a node starts or stops
+    // bootstrapping or moving, which only affects that node's pending ranges.
+    long _pending_ops_version = 0;
 
     std::vector<token> sort_tokens();
 
@@ -169,7 +209,7 @@ class token_metadata final {
         : _cur_it(it), _ring_pos(pos), _insert_min(false) {}
 
     public:
-        tokens_iterator(const token& start, const token_metadata* token_metadata, bool include_min = false)
+        tokens_iterator(const token& start, const token_metadata_impl* token_metadata, bool include_min = false)
         : _token_metadata(token_metadata) {
             _cur_it = _token_metadata->sorted_tokens().begin() + _token_metadata->first_token_index(start);
             _insert_min = include_min && *_token_metadata->sorted_tokens().begin() != dht::minimum_token();
@@ -223,14 +263,15 @@ class token_metadata final {
         bool _insert_min;
         bool _min = false;
         const token _min_token = dht::minimum_token();
-        const token_metadata* _token_metadata = nullptr;
+        const token_metadata_impl* _token_metadata = nullptr;
 
-        friend class token_metadata;
+        friend class token_metadata_impl;
     };
 
-    token_metadata(std::map<token, inet_address> token_to_endpoint_map, std::unordered_map<inet_address, utils::UUID> endpoints_map, topology topology);
+    friend class token_metadata;
 public:
-    token_metadata() {};
+    token_metadata_impl() {};
+    token_metadata_impl(std::map<token, inet_address> token_to_endpoint_map, std::unordered_map<inet_address, utils::UUID> endpoints_map, topology topology);
     const std::vector<token>& sorted_tokens() const;
     void update_normal_token(token token, inet_address endpoint);
     void update_normal_tokens(std::unordered_set<token> tokens, inet_address endpoint);
@@ -256,6 +297,8 @@ class token_metadata final {
 
     void update_topology(inet_address ep) {
         _topology.update_endpoint(ep);
+        ++_topology_version;
+        ++_pending_ops_version;
     }
 
     tokens_iterator tokens_end() const {
@@ -279,15 +322,10 @@ class token_metadata final {
     boost::iterator_range<tokens_iterator> ring_range(
         const std::experimental::optional<dht::partition_range::bound>& start, bool include_min = false) const;
 
-    topology& get_topology() {
-        return _topology;
-    }
-
     const topology& get_topology() const {
         return _topology;
     }
 
-    void debug_show();
 #if 0
     private static final Logger logger = LoggerFactory.getLogger(TokenMetadata.class);
 
@@ -467,10 +505,10 @@ class token_metadata final {
     void update_host_id(const UUID& host_id, inet_address endpoint);
 
     /** Return the unique host ID for an end-point. */
-    UUID get_host_id(inet_address endpoint);
+    UUID get_host_id(inet_address endpoint) const;
 
     /** Return the end-point for a unique host ID */
-    std::experimental::optional<inet_address> get_endpoint_for_host_id(UUID host_id);
+    std::experimental::optional<inet_address> get_endpoint_for_host_id(UUID host_id) const;
 
     /** @return a copy of the endpoint-to-id map for read-only operations */
     const std::unordered_map<inet_address, utils::UUID>& get_endpoint_to_host_id_map_for_reading() const;
@@ -524,11 +562,11 @@ class token_metadata final {
 
 #endif
 
-    bool is_member(inet_address endpoint);
+    bool is_member(inet_address endpoint) const;
 
-    bool is_leaving(inet_address endpoint);
+    bool is_leaving(inet_address endpoint) const;
 
-    bool is_moving(inet_address endpoint) {
+    bool is_moving(inet_address endpoint) const {
         for (auto x : _moving_endpoints) {
             if (x.second == endpoint) {
                 return true;
@@ -545,9 +583,7 @@ class token_metadata final {
      * Create a copy of TokenMetadata with only tokenToEndpointMap. That is, pending ranges,
      * bootstrap tokens and leaving endpoints are not included in the copy.
      */
-    token_metadata clone_only_token_map() {
-        return token_metadata(this->_token_to_endpoint_map, this->_endpoint_to_host_id_map, this->_topology);
-    }
+    token_metadata clone_only_token_map() const;
 #if 0
 
     /**
@@ -581,15 +617,7 @@ class token_metadata final {
      *
      * @return new token metadata
      */
-    token_metadata clone_after_all_left() {
-        auto all_left_metadata = clone_only_token_map();
-
-        for (auto endpoint : _leaving_endpoints) {
-            all_left_metadata.remove_endpoint(endpoint);
-        }
-
-        return all_left_metadata;
-    }
+    token_metadata clone_after_all_left() const;
 
 public:
     /**
@@ -598,7 +626,7 @@ class token_metadata final {
      *
      * @return new token metadata
      */
-    token_metadata clone_after_all_settled();
+    token_metadata clone_after_all_settled() const;
 #if 0
     public InetAddress getEndpoint(Token token)
     {
@@ -614,48 +642,24 @@ class token_metadata final {
     }
 #endif
 public:
-    dht::token_range_vector get_primary_ranges_for(std::unordered_set<token> tokens);
+    dht::token_range_vector get_primary_ranges_for(std::unordered_set<token> tokens) const;
 
-    dht::token_range_vector get_primary_ranges_for(token right);
+    dht::token_range_vector get_primary_ranges_for(token right) const;
     static boost::icl::interval<token>::interval_type range_to_interval(range<dht::token> r);
     static range<dht::token> interval_to_range(boost::icl::interval<token>::interval_type i);
 
 private:
-    std::unordered_multimap<range<token>, inet_address>& get_pending_ranges_mm(sstring keyspace_name);
     void set_pending_ranges(const sstring& keyspace_name, std::unordered_multimap<range<token>, inet_address> new_pending_ranges);
+    std::shared_ptr<const pending_ranges_parts> calculate_pending_ranges_parts(abstract_replication_strategy& strategy,
+            std::shared_ptr<const pending_ranges_parts> old, can_yield cy) const;
 
 public:
-    /** a mutable map may be returned but caller should not modify it */
-    const std::unordered_map<range<token>, std::unordered_set<inet_address>>& get_pending_ranges(sstring keyspace_name);
+    const std::unordered_map<range<token>, std::unordered_set<inet_address>>& get_pending_ranges(const sstring& keyspace_name) const;
 
-    std::vector<range<token>> get_pending_ranges(sstring keyspace_name, inet_address endpoint);
-     /**
-     * Calculate pending ranges according to bootsrapping and leaving nodes. Reasoning is:
-     *
-     * (1) When in doubt, it is better to write too much to a node than too little. That is, if
-     * there are multiple nodes moving, calculate the biggest ranges a node could have. Cleaning
-     * up unneeded data afterwards is better than missing writes during movement.
-     * (2) When a node leaves, ranges for other nodes can only grow (a node might get additional
-     * ranges, but it will not lose any of its current ranges as a result of a leave). Therefore
-     * we will first remove _all_ leaving tokens for the sake of calculation and then check what
-     * ranges would go where if all nodes are to leave. This way we get the biggest possible
-     * ranges with regard current leave operations, covering all subsets of possible final range
-     * values.
-     * (3) When a node bootstraps, ranges of other nodes can only get smaller. Without doing
-     * complex calculations to see if multiple bootstraps overlap, we simply base calculations
-     * on the same token ring used before (reflecting situation after all leave operations have
-     * completed). Bootstrapping nodes will be added and removed one by one to that metadata and
-     * checked what their ranges would be. This will give us the biggest possible ranges the
-     * node could have. It might be that other bootstraps make our actual final ranges smaller,
-     * but it does not matter as we can clean up the data afterwards.
-     *
-     * NOTE: This is heavy and ineffective operation. This will be done only once when a node
-     * changes state in the cluster, so it should be manageable.
-     */
-    void calculate_pending_ranges(abstract_replication_strategy& strategy, const sstring& keyspace_name);
+    std::vector<range<token>> get_pending_ranges(const sstring& keyspace_name, inet_address endpoint) const;
 public:
 
-    token get_predecessor(token t);
+    token get_predecessor(token t) const;
 
 #if 0
     public Token getSuccessor(Token token)
@@ -882,9 +886,9 @@ class token_metadata final {
         return sb.toString();
     }
 #endif
-    sstring print_pending_ranges();
+    sstring print_pending_ranges() const;
 public:
-    std::vector<gms::inet_address> pending_endpoints_for(const token& token, const sstring& keyspace_name);
+    std::vector<gms::inet_address> pending_endpoints_for(const token& token, const sstring& keyspace_name) const;
 #if 0
     /**
      * @deprecated retained for benefit of old tests
@@ -897,12 +901,12 @@ class token_metadata final {
 
 public:
     /** @return an endpoint to token multimap representation of tokenToEndpointMap (a copy) */
-    std::multimap<inet_address, token> get_endpoint_to_token_map_for_reading();
+    std::multimap<inet_address, token> get_endpoint_to_token_map_for_reading() const;
     /**
      * @return a (stable copy, won't be modified) Token to Endpoint map for all the normal and bootstrapping nodes
      *         in the cluster.
      */
-    std::map<token, inet_address> get_normal_and_bootstrapping_token_to_endpoint_map();
+    std::map<token, inet_address> get_normal_and_bootstrapping_token_to_endpoint_map() const;
 
 #if 0
     /**
@@ -1026,10 +1030,238 @@ class token_metadata final {
         return _ring_version;
     }
 
+    long get_topology_version() const {
+        return _topology_version;
+    }
+
     void invalidate_cached_rings() {
         ++_ring_version;
+        ++_topology_version;
+        ++_pending_ops_version;
         //cachedTokenMap.set(null);
     }
 };
 
+// A version of the token metadata.
+//
+// Copying a token_metadata is cheap: the copy shares the version with the
+// original, and the version is never modified while shared; a change made
+// through either of them first copies the version (copy-on-write). This is
+// how shard 0 publishes the token metadata to the other shards without
+// copying it for each of them, and how a reader which yields pins the
+// version it works on: it copies the token_metadata.
+//
+// A version may be shared by all shards, so it is reference counted
+// atomically, and it is destroyed on the shard which created it. Only the
+// version is shared, not the token_metadata object: each shard must use
+// its own copy.
+class token_metadata final {
+    std::shared_ptr<token_metadata_impl> _impl;
+private:
+    explicit token_metadata(std::shared_ptr<token_metadata_impl> impl) : _impl(std::move(impl)) { }
+    token_metadata_impl& mutable_impl();
+
+    template <typename... Args>
+    static token_metadata make(Args&&... args);
+
+    friend class token_metadata_impl;
+public:
+    using UUID = utils::UUID;
+    using inet_address = gms::inet_address;
+    using tokens_iterator = token_metadata_impl::tokens_iterator;
+
+    token_metadata();
+
+    const std::vector<token>& sorted_tokens() const {
+        return _impl->sorted_tokens();
+    }
+    void update_normal_token(token token, inet_address endpoint) {
+        mutable_impl().update_normal_token(std::move(token), endpoint);
+    }
+    void update_normal_tokens(std::unordered_set<token> tokens, inet_address endpoint) {
+        mutable_impl().update_normal_tokens(std::move(tokens), endpoint);
+    }
+    void update_normal_tokens(std::unordered_map<inet_address, std::unordered_set<token>>& endpoint_tokens) {
+        mutable_impl().update_normal_tokens(endpoint_tokens);
+    }
+    const token& first_token(const token& start) const {
+        return _impl->first_token(start);
+    }
+    size_t first_token_index(const token& start) const {
+        return _impl->first_token_index(start);
+    }
+    std::experimental::optional<inet_address> get_endpoint(const token& token) const {
+        return _impl->get_endpoint(token);
+    }
+    std::vector<token> get_tokens(const inet_address& addr) const {
+        return _impl->get_tokens(addr);
+    }
+    const std::map<token, inet_address>& get_token_to_endpoint() const {
+        return _impl->get_token_to_endpoint();
+    }
+    const std::unordered_set<inet_address>& get_leaving_endpoints() const {
+        return _impl->get_leaving_endpoints();
+    }
+    const std::unordered_map<token, inet_address>& get_moving_endpoints() const {
+        return _impl->get_moving_endpoints();
+    }
+    const std::unordered_map<token, inet_address>& get_bootstrap_tokens() const {
+        return _impl->get_bootstrap_tokens();
+    }
+    void update_topology(inet_address ep) {
+        mutable_impl().update_topology(ep);
+    }
+    tokens_iterator tokens_end() const {
+        return _impl->tokens_end();
+    }
+    // The iterators refer to the current version, so they are invalidated
+    // by changes.
+    auto ring_range(const token& start, bool include_min = false) const {
+        return _impl->ring_range(start, include_min);
+    }
+    boost::iterator_range<tokens_iterator> ring_range(
+        const std::experimental::optional<dht::partition_range::bound>& start, bool include_min = false) const {
+        return _impl->ring_range(start, include_min);
+    }
+    const topology& get_topology() const {
+        return _impl->get_topology();
+    }
+    void debug_show();
+    void update_host_id(const UUID& host_id, inet_address endpoint) {
+        mutable_impl().update_host_id(host_id, endpoint);
+    }
+    UUID get_host_id(inet_address endpoint) const {
+        return _impl->get_host_id(endpoint);
+    }
+    std::experimental::optional<inet_address> get_endpoint_for_host_id(UUID host_id) const {
+        return _impl->get_endpoint_for_host_id(host_id);
+    }
+    const std::unordered_map<inet_address, utils::UUID>& get_endpoint_to_host_id_map_for_reading() const {
+        return _impl->get_endpoint_to_host_id_map_for_reading();
+    }
+    void add_bootstrap_token(token t, inet_address endpoint) {
+        mutable_impl().add_bootstrap_token(std::move(t), endpoint);
+    }
+    void add_bootstrap_tokens(std::unordered_set<token> tokens, inet_address endpoint) {
+        mutable_impl().add_bootstrap_tokens(std::move(tokens), endpoint);
+    }
+    void remove_bootstrap_tokens(std::unordered_set<token> tokens) {
+        mutable_impl().remove_bootstrap_tokens(std::move(tokens));
+    }
+    void add_leaving_endpoint(inet_address endpoint) {
+        mutable_impl().add_leaving_endpoint(endpoint);
+    }
+    void add_moving_endpoint(token t, inet_address endpoint) {
+        mutable_impl().add_moving_endpoint(std::move(t), endpoint);
+    }
+    void remove_endpoint(inet_address endpoint) {
+        mutable_impl().remove_endpoint(endpoint);
+    }
+    void remove_from_moving(inet_address endpoint) {
+        mutable_impl().remove_from_moving(endpoint);
+    }
+    bool is_member(inet_address endpoint) const {
+        return _impl->is_member(endpoint);
+    }
+    bool is_leaving(inet_address endpoint) const {
+        return _impl->is_leaving(endpoint);
+    }
+    bool is_moving(inet_address endpoint) const {
+        return _impl->is_moving(endpoint);
+    }
+    token_metadata clone_only_token_map() const {
+        return _impl->clone_only_token_map();
+    }
+    token_metadata clone_after_all_left() const {
+        return _impl->clone_after_all_left();
+    }
+    token_metadata clone_after_all_settled() const {
+        return _impl->clone_after_all_settled();
+    }
+    dht::token_range_vector get_primary_ranges_for(std::unordered_set<token> tokens) const {
+        return _impl->get_primary_ranges_for(std::move(tokens));
+    }
+    dht::token_range_vector get_primary_ranges_for(token right) const {
+        return _impl->get_primary_ranges_for(std::move(right));
+    }
+    static boost::icl::interval<token>::interval_type range_to_interval(range<dht::token> r) {
+        return token_metadata_impl::range_to_interval(std::move(r));
+    }
+    static range<dht::token> interval_to_range(boost::icl::interval<token>::interval_type i) {
+        return token_metadata_impl::interval_to_range(std::move(i));
+    }
+    const std::unordered_map<range<token>, std::unordered_set<inet_address>>& get_pending_ranges(const sstring& keyspace_name) const {
+        return _impl->get_pending_ranges(keyspace_name);
+    }
+    std::vector<range<token>> get_pending_ranges(const sstring& keyspace_name, inet_address endpoint) const {
+        return _impl->get_pending_ranges(keyspace_name, endpoint);
+    }
+     /**
+     * Calculate pending ranges according to bootsrapping and leaving nodes. Reasoning is:
+     *
+     * (1) When in doubt, it is better to write too much to a node than too little. That is, if
+     * there are multiple nodes moving, calculate the biggest ranges a node could have. Cleaning
+     * up unneeded data afterwards is better than missing writes during movement.
+     * (2) When a node leaves, ranges for other nodes can only grow (a node might get additional
+     * ranges, but it will not lose any of its current ranges as a result of a leave). Therefore
+     * we will first remove _all_ leaving tokens for the sake of calculation and then check what
+     * ranges would go where if all nodes are to leave. This way we get the biggest possible
+     * ranges with regard current leave operations, covering all subsets of possible final range
+     * values.
+     * (3) When a node bootstraps, ranges of other nodes can only get smaller. Without doing
+     * complex calculations to see if multiple bootstraps overlap, we simply base calculations
+     * on the same token ring used before (reflecting situation after all leave operations have
+     * completed). Bootstrapping nodes will be added and removed one by one to that metadata and
+     * checked what their ranges would be. This will give us the biggest possible ranges the
+     * node could have. It might be that other bootstraps make our actual final ranges smaller,
+     * but it does not matter as we can clean up the data afterwards.
+     *
+     * The ranges of each bootstrapping and moving node, and those of the leaving nodes,
+     * are kept per replication strategy and options. When a node starts bootstrapping or
+     * moving only its own ranges are calculated; everything is recalculated only when
+     * normal tokens, leaving nodes or the DC/rack placement change. Keyspaces with the
+     * same replication strategy and options share the result.
+     *
+     * NOTE: This is still a heavy operation on large vnode clusters. With can_yield::yes
+     * it must be called from a seastar thread and yields between ring tokens, working on
+     * the version current when it started; the result is dropped if the topology changed
+     * meanwhile, as that change triggers a new calculation. Yielding callers must
+     * serialize calls to it.
+     */
+    void calculate_pending_ranges(abstract_replication_strategy& strategy, const sstring& keyspace_name, can_yield cy);
+    token get_predecessor(token t) const {
+        return _impl->get_predecessor(std::move(t));
+    }
+    size_t number_of_endpoints() const {
+        return _impl->number_of_endpoints();
+    }
+    std::vector<inet_address> get_all_endpoints() const {
+        return _impl->get_all_endpoints();
+    }
+    size_t get_all_endpoints_count() const {
+        return _impl->get_all_endpoints_count();
+    }
+    sstring print_pending_ranges() const {
+        return _impl->print_pending_ranges();
+    }
+    std::vector<gms::inet_address> pending_endpoints_for(const token& token, const sstring& keyspace_name) const {
+        return _impl->pending_endpoints_for(token, keyspace_name);
+    }
+    std::multimap<inet_address, token> get_endpoint_to_token_map_for_reading() const {
+        return _impl->get_endpoint_to_token_map_for_reading();
+    }
+    std::map<token, inet_address> get_normal_and_bootstrapping_token_to_endpoint_map() const {
+        return _impl->get_normal_and_bootstrapping_token_to_endpoint_map();
+    }
+    long get_ring_version() const {
+        return _impl->get_ring_version();
+    }
+    long get_topology_version() const {
+        return _impl->get_topology_version();
+    }
+    void invalidate_cached_rings() {
+        mutable_impl().invalidate_cached_rings();
+    }
+};
+
 }
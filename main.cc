@@ -510,6 +510,9 @@ int main(int ac, char** av) {
                     , cluster_name
                     , phi
                     , cfg->listen_on_broadcast_address());
+            netw::get_messaging_service().invoke_on_all([port = cfg->shard_aware_storage_port()] (auto& ms) {
+                ms.set_shard_port(port);
+            }).get();
             supervisor::notify("starting messaging service");
             supervisor::notify("starting storage proxy");
             proxy.start(std::ref(db)).get();
@@ -636,16 +639,24 @@ int main(int ac, char** av) {
             if (start_thrift) {
                 service::get_local_storage_service().start_rpc_server().get();
             }
-            if (cfg->defragment_memory_on_idle()) {
-                smp::invoke_on_all([] () {
-                    engine().set_idle_cpu_handler([] (reactor::work_waiting_on_reactor check_for_work) {
-                        return logalloc::shard_tracker().compact_on_idle(check_for_work);
+            smp::invoke_on_all([&cfg] () {
+                logalloc::shard_tracker().set_reclamation_step(cfg->lsa_reclamation_step());
+                logalloc::shard_tracker().set_idle_reserve(cfg->lsa_idle_reserve_segments());
+            }).get();
+            if (cfg->defragment_memory_on_idle() || cfg->lsa_idle_reserve_segments()) {
+                smp::invoke_on_all([defragment = cfg->defragment_memory_on_idle()] () {
+                    engine().set_idle_cpu_handler([defragment] (reactor::work_waiting_on_reactor check_for_work) {
+                        auto& tracker = logalloc::shard_tracker();
+                        // Topping up the reserve comes first, it is what saves
+                        // allocations from reclaiming synchronously.
+                        auto r = tracker.reclaim_on_idle(check_for_work);
+                        if (r == reactor::idle_cpu_handler_result::interrupted_by_higher_priority_task || !defragment) {
+                            return r;
+                        }
+                        return tracker.compact_on_idle(check_for_work);
                     });
                 }).get();
             }
-            smp::invoke_on_all([&cfg] () {
-                return logalloc::shard_tracker().set_reclamation_step(cfg->lsa_reclamation_step());
-            }).get();
             if (cfg->abort_on_lsa_bad_alloc()) {
                 smp::invoke_on_all([&cfg]() {
                     return logalloc::shard_tracker().enable_abort_on_bad_alloc();
@@ -173,6 +173,10 @@ size_t msg_addr::hash::operator()(const msg_addr& id) const {
     return std::hash<uint32_t>()(id.addr.raw_addr());
 }
 
+size_t messaging_service::client_key_hash::operator()(const msg_addr& id) const {
+    return std::hash<uint32_t>()(id.addr.raw_addr()) * 31 + id.cpu_id;
+}
+
 messaging_service::shard_info::shard_info(shared_ptr<rpc_protocol_client_wrapper>&& client)
     : rpc_client(std::move(client)) {
 }
@@ -197,6 +201,13 @@ void messaging_service::foreach_server_connection_stats(std::function<void(const
             });
         }
     }
+    for (auto&& s : _shard_server) {
+        if (s) {
+            s->foreach_connection([f](const rpc_protocol::server::connection& c) {
+                f(c.info(), c.get_stats());
+            });
+        }
+    }
 }
 
 void messaging_service::increment_dropped_messages(messaging_verb verb) {
@@ -250,6 +261,10 @@ rpc_resource_limits() {
     return limits;
 }
 
+void messaging_service::set_shard_port(uint16_t base_port) {
+    _shard_port = base_port;
+}
+
 void messaging_service::start_listen() {
     bool listen_to_bc = _should_listen_to_broadcast_address && _listen_address != utils::fb_utilities::get_broadcast_address();
     rpc::server_options so;
@@ -290,12 +305,25 @@ void messaging_service::start_listen() {
             _server_tls[1] = listen(utils::fb_utilities::get_broadcast_address());
         }
     }
+    if (_shard_port && !_shard_server[0]) {
+        auto listen = [&] (const gms::inet_address& a) {
+            auto addr = ipv4_addr{a.raw_addr(), uint16_t(_shard_port + engine().cpu_id())};
+            return std::make_unique<rpc_protocol_server_wrapper>(*_rpc, so, addr, rpc_resource_limits());
+        };
+        _shard_server[0] = listen(_listen_address);
+        if (listen_to_bc) {
+            _shard_server[1] = listen(utils::fb_utilities::get_broadcast_address());
+        }
+    }
     // Do this on just cpu 0, to avoid duplicate logs.
     if (engine().cpu_id() == 0) {
         if (_server_tls[0]) {
             mlogger.info("Starting Encrypted Messaging Service on SSL port {}", _ssl_port);
         }
         mlogger.info("Starting Messaging Service on port {}", _port);
+        if (_shard_server[0]) {
+            mlogger.info("Starting Messaging Service on per-shard ports {}-{}", _shard_port, _shard_port + smp::count - 1);
+        }
     }
 }
 
@@ -327,6 +355,11 @@ messaging_service::messaging_service(gms::inet_address ip
         ci.attach_auxiliary("max_result_size", max_result_size.value_or(query::result_memory_limiter::maximum_result_size));
         return rpc::no_wait;
     });
+    register_handler(this, messaging_verb::SHARDING_INFO, [this] (const rpc::client_info& ci, uint32_t shard_count, uint32_t ignore_msb, sstring partitioner, uint16_t shard_port) {
+        cache_remote_sharding(get_source(ci).addr, shard_count, ignore_msb, partitioner, shard_port);
+        auto& p = dht::global_partitioner();
+        return make_ready_future<uint32_t, uint32_t, sstring, uint16_t>(smp::count, p.sharding_ignore_msb(), p.name(), _shard_port);
+    });
 
     if (listen_now) {
         start_listen();
@@ -368,6 +401,15 @@ future<> messaging_service::stop_nontls_server() {
     return make_ready_future<>();
 }
 
+future<> messaging_service::stop_shard_server() {
+    return parallel_for_each(_shard_server, [] (auto& s) {
+        if (s) {
+            return s->stop();
+        }
+        return make_ready_future<>();
+    });
+}
+
 future<> messaging_service::stop_client() {
     return parallel_for_each(_clients, [] (auto& m) {
         return parallel_for_each(m, [] (std::pair<const msg_addr, shard_info>& c) {
@@ -378,7 +420,7 @@ future<> messaging_service::stop_client() {
 
 future<> messaging_service::stop() {
     _stopping = true;
-    return when_all(stop_nontls_server(), stop_tls_server(), stop_client()).discard_result();
+    return when_all(stop_nontls_server(), stop_tls_server(), stop_shard_server(), stop_client()).discard_result();
 }
 
 rpc::no_wait_type messaging_service::no_wait() {
@@ -409,6 +451,52 @@ static unsigned get_rpc_client_idx(messaging_verb verb) {
     return idx;
 }
 
+constexpr unsigned messaging_service::shard_clients_idx;
+
+// Verbs delivered straight to the shard owning the data, when known.
+static bool is_shard_routed(messaging_verb verb) {
+    return verb == messaging_verb::MUTATION ||
+           verb == messaging_verb::MUTATIONS ||
+           verb == messaging_verb::READ_DATA ||
+           verb == messaging_verb::READ_MUTATION_DATA ||
+           verb == messaging_verb::READ_DIGEST;
+}
+
+// Returns which connection a message for verb to id goes through: its index
+// in _clients and its key. Connections are per node, except for requests
+// for data owned by a given shard of a node which listens on per-shard
+// ports; those go to that shard. Per-shard ports are not encrypted, so
+// they are not used when internode encryption is enabled.
+std::pair<unsigned, msg_addr> messaging_service::client_key(messaging_verb verb, msg_addr id) const {
+    if (is_shard_routed(verb) && _encrypt_what == encrypt_what::none) {
+        auto it = _remote_sharding.find(id.addr);
+        if (it != _remote_sharding.end() && it->second.partitioner && it->second.shard_port
+                && id.cpu_id < it->second.partitioner->shard_count()) {
+            return std::make_pair(shard_clients_idx, id);
+        }
+    }
+    return std::make_pair(get_rpc_client_idx(verb), msg_addr{id.addr, 0});
+}
+
+unsigned messaging_service::shard_of(gms::inet_address ep, const dht::token& t) {
+    auto it = _remote_sharding.find(ep);
+    if (it == _remote_sharding.end()) {
+        negotiate_sharding(ep);
+        return 0;
+    }
+    auto& p = it->second.partitioner;
+    return p ? p->shard_of(t) : 0;
+}
+
+void messaging_service::cache_remote_sharding(gms::inet_address ep, uint32_t shard_count, uint32_t ignore_msb, const sstring& partitioner, uint16_t shard_port) {
+    auto& rs = _remote_sharding[ep];
+    rs.shard_port = shard_port;
+    rs.partitioner = nullptr;
+    if (shard_count && partitioner == dht::global_partitioner().name()) {
+        rs.partitioner = dht::make_partitioner(partitioner, shard_count, ignore_msb);
+    }
+}
+
 /**
  * Get an IP for a given endpoint to connect to
  *
@@ -458,7 +546,9 @@ void messaging_service::cache_preferred_ip(gms::inet_address ep, gms::inet_addre
 
 shared_ptr<messaging_service::rpc_protocol_client_wrapper> messaging_service::get_rpc_client(messaging_verb verb, msg_addr id) {
     assert(!_stopping);
-    auto idx = get_rpc_client_idx(verb);
+    auto key = client_key(verb, id);
+    auto idx = key.first;
+    id = key.second;
     auto it = _clients[idx].find(id);
 
     if (it != _clients[idx].end()) {
@@ -513,7 +603,11 @@ shared_ptr<messaging_service::rpc_protocol_client_wrapper> messaging_service::ge
         return true;
     }();
 
-    auto remote_addr = ipv4_addr(get_preferred_ip(id.addr).raw_addr(), must_encrypt ? _ssl_port : _port);
+    auto port = must_encrypt ? _ssl_port : _port;
+    if (idx == shard_clients_idx) {
+        port = _remote_sharding.at(id.addr).shard_port + id.cpu_id;
+    }
+    auto remote_addr = ipv4_addr(get_preferred_ip(id.addr).raw_addr(), port);
     auto local_addr = ipv4_addr{_listen_address.raw_addr(), 0};
 
     rpc::client_options opts;
@@ -565,7 +659,12 @@ bool messaging_service::remove_rpc_client_one(clients_map& clients, msg_addr id,
 }
 
 void messaging_service::remove_error_rpc_client(messaging_verb verb, msg_addr id) {
-    if (remove_rpc_client_one(_clients[get_rpc_client_idx(verb)], id, true)) {
+    auto key = client_key(verb, id);
+    if (remove_rpc_client_one(_clients[key.first], key.second, true)) {
+        if (key.first != shard_clients_idx) {
+            // The node may have restarted with a different number of shards.
+            _remote_sharding.erase(id.addr);
+        }
         for (auto&& cb : _connection_drop_notifiers) {
             cb(id.addr);
         }
@@ -573,9 +672,21 @@ void messaging_service::remove_error_rpc_client(messaging_verb verb, msg_addr id
 }
 
 void messaging_service::remove_rpc_client(msg_addr id) {
-    for (auto& c : _clients) {
-        remove_rpc_client_one(c, id, false);
+    for (unsigned idx = 0; idx < _clients.size(); idx++) {
+        if (idx != shard_clients_idx) {
+            remove_rpc_client_one(_clients[idx], msg_addr{id.addr, 0}, false);
+        }
+    }
+    std::vector<msg_addr> shards;
+    for (auto&& c : _clients[shard_clients_idx]) {
+        if (c.first.addr == id.addr) {
+            shards.push_back(c.first);
+        }
     }
+    for (auto&& shard : shards) {
+        remove_rpc_client_one(_clients[shard_clients_idx], shard, false);
+    }
+    _remote_sharding.erase(id.addr);
 }
 
 std::unique_ptr<messaging_service::rpc_protocol_wrapper>& messaging_service::rpc() {
@@ -659,6 +770,28 @@ void messaging_service::register_prepare_message(std::function<future<streaming:
         streaming::prepare_message msg, UUID plan_id, sstring description)>&& func) {
     register_handler(this, messaging_verb::PREPARE_MESSAGE, std::move(func));
 }
+
+// Wrapper for SHARDING_INFO
+void messaging_service::negotiate_sharding(gms::inet_address ep) {
+    if (_stopping) {
+        return;
+    }
+    // Requests sent until the reply arrives, or for good if the node does not
+    // know the verb, go through the per-node connection.
+    _remote_sharding.emplace(ep, remote_sharding());
+    auto& p = dht::global_partitioner();
+    sstring partitioner = p.name();
+    send_message<future<uint32_t, uint32_t, sstring, uint16_t>>(this, messaging_verb::SHARDING_INFO, msg_addr{ep, 0},
+            uint32_t(smp::count), uint32_t(p.sharding_ignore_msb()), std::move(partitioner), _shard_port).then(
+            [this, ep, ms = shared_from_this()] (uint32_t shard_count, uint32_t ignore_msb, sstring partitioner, uint16_t shard_port) {
+        if (_remote_sharding.count(ep)) {
+            cache_remote_sharding(ep, shard_count, ignore_msb, partitioner, shard_port);
+        }
+    }).handle_exception([ep] (std::exception_ptr eptr) {
+        mlogger.debug("Failed to learn sharding of {}: {}", ep, eptr);
+    });
+}
+
 future<streaming::prepare_message> messaging_service::send_prepare_message(msg_addr id, streaming::prepare_message msg, UUID plan_id,
         sstring description) {
     return send_message<streaming::prepare_message>(this, messaging_verb::PREPARE_MESSAGE, id,
@@ -793,6 +926,19 @@ future<> messaging_service::send_mutation(msg_addr id, clock_type::time_point ti
         std::move(reply_to), std::move(shard), std::move(response_id), std::move(trace_info));
 }
 
+void messaging_service::register_mutations(std::function<future<rpc::no_wait_type> (const rpc::client_info&, rpc::opt_time_point, std::vector<frozen_mutation> fms, std::vector<uint32_t> timeouts_in_ms,
+    inet_address reply_to, unsigned shard, std::vector<response_id_type> response_ids)>&& func) {
+    register_handler(this, netw::messaging_verb::MUTATIONS, std::move(func));
+}
+void messaging_service::unregister_mutations() {
+    _rpc->unregister_handler(netw::messaging_verb::MUTATIONS);
+}
+future<> messaging_service::send_mutations(msg_addr id, clock_type::time_point timeout, std::vector<std::reference_wrapper<const frozen_mutation>> fms, std::vector<uint32_t> timeouts_in_ms,
+    inet_address reply_to, unsigned shard, std::vector<response_id_type> response_ids) {
+    return send_message_oneway_timeout(this, timeout, messaging_verb::MUTATIONS, std::move(id), std::move(fms), std::move(timeouts_in_ms),
+        std::move(reply_to), std::move(shard), std::move(response_ids));
+}
+
 void messaging_service::register_counter_mutation(std::function<future<> (const rpc::client_info&, rpc::opt_time_point, std::vector<frozen_mutation> fms, db::consistency_level cl, stdx::optional<tracing::trace_info> trace_info)>&& func) {
     register_handler(this, netw::messaging_verb::COUNTER_MUTATION, std::move(func));
 }
@@ -62,6 +62,7 @@ class partition_checksum;
 
 namespace dht {
     class token;
+    class i_partitioner;
 }
 
 namespace query {
@@ -108,7 +109,9 @@ enum class messaging_verb : int32_t {
     GET_SCHEMA_VERSION = 21,
     SCHEMA_CHECK = 22,
     COUNTER_MUTATION = 23,
-    LAST = 24,
+    SHARDING_INFO = 24,
+    MUTATIONS = 25,
+    LAST = 26,
 };
 
 } // namespace netw
@@ -148,7 +151,17 @@ class messaging_service : public seastar::async_sharded_service<messaging_servic
     using msg_addr = netw::msg_addr;
     using inet_address = gms::inet_address;
     using UUID = utils::UUID;
-    using clients_map = std::unordered_map<msg_addr, shard_info, msg_addr::hash>;
+    // Unlike msg_addr comparisons, client keys tell shards apart, as some
+    // connections go to a specific shard (see get_rpc_client()).
+    struct client_key_hash {
+        size_t operator()(const msg_addr& id) const;
+    };
+    struct client_key_equal {
+        bool operator()(const msg_addr& x, const msg_addr& y) const {
+            return x.addr == y.addr && x.cpu_id == y.cpu_id;
+        }
+    };
+    using clients_map = std::unordered_map<msg_addr, shard_info, client_key_hash, client_key_equal>;
 
     // This should change only if serialization format changes
     static constexpr int32_t current_version = 0;
@@ -190,9 +203,21 @@ class messaging_service : public seastar::async_sharded_service<messaging_servic
     };
 
 private:
+    friend class messaging_service_test;
+
+    // How a node shards data, learnt from the SHARDING_INFO handshake.
+    struct remote_sharding {
+        // Base of the ports the shards of the node listen on, 0 if none.
+        uint16_t shard_port = 0;
+        // Null if not known yet, or if the node shards data in a way we
+        // cannot reproduce.
+        std::unique_ptr<dht::i_partitioner> partitioner;
+    };
+
     gms::inet_address _listen_address;
     uint16_t _port;
     uint16_t _ssl_port;
+    uint16_t _shard_port = 0;
     encrypt_what _encrypt_what;
     compress_what _compress_what;
     tcp_nodelay_what _tcp_nodelay_what;
@@ -203,7 +228,11 @@ class messaging_service : public seastar::async_sharded_service<messaging_servic
     std::array<std::unique_ptr<rpc_protocol_server_wrapper>, 2> _server;
     ::shared_ptr<seastar::tls::server_credentials> _credentials;
     std::array<std::unique_ptr<rpc_protocol_server_wrapper>, 2> _server_tls;
-    std::array<clients_map, 4> _clients;
+    std::array<std::unique_ptr<rpc_protocol_server_wrapper>, 2> _shard_server;
+    // Index in _clients of the connections to specific shards of a node.
+    static constexpr unsigned shard_clients_idx = 4;
+    std::array<clients_map, 5> _clients;
+    std::unordered_map<gms::inet_address, remote_sharding> _remote_sharding;
     uint64_t _dropped_messages[static_cast<int32_t>(messaging_verb::LAST)] = {};
     bool _stopping = false;
     std::list<std::function<void(gms::inet_address ep)>> _connection_drop_notifiers;
@@ -218,11 +247,15 @@ class messaging_service : public seastar::async_sharded_service<messaging_servic
             bool sltba = false, bool listen_now = true);
     ~messaging_service();
 public:
+    // Makes shard N also listen on base_port + N, so that other nodes can
+    // send requests to it directly. Must be called before start_listen().
+    void set_shard_port(uint16_t base_port);
     void start_listen();
     uint16_t port();
     gms::inet_address listen_address();
     future<> stop_tls_server();
     future<> stop_nontls_server();
+    future<> stop_shard_server();
     future<> stop_client();
     future<> stop();
     static rpc::no_wait_type no_wait();
@@ -301,6 +334,15 @@ class messaging_service : public seastar::async_sharded_service<messaging_servic
     future<> send_mutation(msg_addr id, clock_type::time_point timeout, const frozen_mutation& fm, std::vector<inet_address> forward,
         inet_address reply_to, unsigned shard, response_id_type response_id, std::experimental::optional<tracing::trace_info> trace_info = std::experimental::nullopt);
 
+    // Wrapper for MUTATIONS, which carries several mutations for one replica
+    // shard, each with the time left until its own timeout
+    void register_mutations(std::function<future<rpc::no_wait_type> (const rpc::client_info&, rpc::opt_time_point, std::vector<frozen_mutation> fms, std::vector<uint32_t> timeouts_in_ms,
+        inet_address reply_to, unsigned shard, std::vector<response_id_type> response_ids)>&& func);
+    void unregister_mutations();
+    // The mutations must stay alive until the returned future resolves.
+    future<> send_mutations(msg_addr id, clock_type::time_point timeout, std::vector<std::reference_wrapper<const frozen_mutation>> fms, std::vector<uint32_t> timeouts_in_ms,
+        inet_address reply_to, unsigned shard, std::vector<response_id_type> response_ids);
+
     // Wrapper for COUNTER_MUTATION
     void register_counter_mutation(std::function<future<> (const rpc::client_info&, rpc::opt_time_point, std::vector<frozen_mutation> fms, db::consistency_level cl, stdx::optional<tracing::trace_info> trace_info)>&& func);
     void unregister_counter_mutation();
@@ -347,8 +389,15 @@ class messaging_service : public seastar::async_sharded_service<messaging_servic
     void unregister_replication_finished();
     future<> send_replication_finished(msg_addr id, inet_address from);
     void foreach_server_connection_stats(std::function<void(const rpc::client_info&, const rpc::stats&)>&& f) const;
+
+    // Returns the shard of node ep owning token t, so that requests for it
+    // can be delivered to that shard directly, or 0 if it is not known yet.
+    unsigned shard_of(gms::inet_address ep, const dht::token& t);
 private:
     bool remove_rpc_client_one(clients_map& clients, msg_addr id, bool dead_only);
+    std::pair<unsigned, msg_addr> client_key(messaging_verb verb, msg_addr id) const;
+    void negotiate_sharding(gms::inet_address ep);
+    void cache_remote_sharding(gms::inet_address ep, uint32_t shard_count, uint32_t ignore_msb, const sstring& partitioner, uint16_t shard_port);
 public:
     // Return rpc::protocol::client for a shard which is a ip + cpuid pair.
     shared_ptr<rpc_protocol_client_wrapper> get_rpc_client(messaging_verb verb, msg_addr id);
@@ -830,8 +830,8 @@ std::ostream&
 operator<<(std::ostream& os, const row& r) {
     sstring cells;
     switch (r._type) {
-    case row::storage_type::set:
-        cells = ::join(", ", r.get_range_set());
+    case row::storage_type::sparse:
+        cells = ::join(", ", r.get_range_sparse());
         break;
     case row::storage_type::vector:
         cells = ::join(", ", r.get_range_vector());
@@ -1054,22 +1054,55 @@ void row::for_each_cell(Func&& func, Rollback&& rollback) {
             throw;
         }
     } else {
-        auto i = _storage.set.begin();
+        auto& present = _storage.sparse.present;
+        auto& cells = _storage.sparse.cells;
+        size_type done = 0;
+        column_id last = 0;
         try {
-            while (i != _storage.set.end()) {
-                func(i->id(), i->cell());
-                ++i;
-            }
+            for_each_sparse_index(present, [&] (column_id id, size_type i) {
+                func(id, cells[i]);
+                done++;
+                last = id;
+                return stop_iteration::no;
+            });
         } catch (...) {
-            while (i != _storage.set.begin()) {
-                --i;
-                rollback(i->id(), i->cell());
+            // Walk the bitmap backwards from the last column processed.
+            auto w = last / bits_per_word;
+            auto bits = present[w] & (~uint64_t(0) >> (bits_per_word - 1 - last % bits_per_word));
+            while (done) {
+                while (!bits) {
+                    bits = present[--w];
+                }
+                auto bit = bits_per_word - 1 - count_leading_zeros(bits);
+                bits &= ~(uint64_t(1) << bit);
+                --done;
+                rollback(column_id(w * bits_per_word + bit), cells[done]);
             }
             throw;
         }
     }
 }
 
+void
+row::sparse_insert(column_id id, size_type idx, atomic_cell_or_collection& value) {
+    auto& present = _storage.sparse.present;
+    auto& cells = _storage.sparse.cells;
+    auto word = id / bits_per_word;
+    if (word >= present.size()) {
+        present.resize(word + 1);
+    }
+    if (cells.size() == cells.capacity()) {
+        // Grow by a quarter rather than doubling, wide rows are long lived.
+        cells.reserve(cells.size() + std::max<size_type>(cells.size() / 4, sparse_internal_count));
+    }
+    cells.emplace_back();
+    // Nothing below throws.
+    std::move_backward(cells.begin() + idx, cells.end() - 1, cells.end());
+    std::swap(cells[idx], value);
+    present[word] |= uint64_t(1) << (id % bits_per_word);
+    _size++;
+}
+
 void
 row::apply_reversibly(const column_definition& column, atomic_cell_or_collection& value) {
     static_assert(std::is_nothrow_move_constructible<atomic_cell_or_collection>::value
@@ -1093,16 +1126,13 @@ row::apply_reversibly(const column_definition& column, atomic_cell_or_collection
         }
     } else {
         if (_type == storage_type::vector) {
-            vector_to_set();
+            vector_to_sparse();
         }
-        auto i = _storage.set.lower_bound(id, cell_entry::compare());
-        if (i == _storage.set.end() || i->id() != id) {
-            cell_entry* e = current_allocator().construct<cell_entry>(id);
-            std::swap(e->_cell, value);
-            _storage.set.insert(i, *e);
-            _size++;
+        auto idx = sparse_index(id);
+        if (!sparse_contains(id)) {
+            sparse_insert(id, idx, value);
         } else {
-            ::apply_reversibly(column, i->cell(), value);
+            ::apply_reversibly(column, _storage.sparse.cells[idx], value);
         }
     }
 }
@@ -1120,11 +1150,13 @@ row::revert(const column_definition& column, atomic_cell_or_collection& src) noe
             ::revert(column, dst, src);
         }
     } else {
-        auto i = _storage.set.find(id, cell_entry::compare());
-        auto& dst = i->cell();
+        auto idx = sparse_index(id);
+        auto& cells = _storage.sparse.cells;
+        auto& dst = cells[idx];
         if (!src) {
             std::swap(dst, src);
-            _storage.set.erase_and_dispose(i, current_deleter<cell_entry>());
+            cells.erase(cells.begin() + idx);
+            _storage.sparse.present[id / bits_per_word] &= ~(uint64_t(1) << (id % bits_per_word));
             --_size;
         } else {
             ::revert(column, dst, src);
@@ -1140,10 +1172,10 @@ row::append_cell(column_id id, atomic_cell_or_collection value) {
         _storage.vector.present.set(id);
     } else {
         if (_type == storage_type::vector) {
-            vector_to_set();
+            vector_to_sparse();
         }
-        auto e = current_allocator().construct<cell_entry>(id, std::move(value));
-        _storage.set.insert(_storage.set.end(), *e);
+        sparse_insert(id, sparse_index(id), value);
+        return;
     }
     _size++;
 }
@@ -1156,11 +1188,10 @@ row::find_cell(column_id id) const {
         }
         return &_storage.vector.v[id];
     } else {
-        auto i = _storage.set.find(id, cell_entry::compare());
-        if (i == _storage.set.end()) {
+        if (!sparse_contains(id)) {
             return nullptr;
         }
-        return &i->cell();
+        return &_storage.sparse.cells[sparse_index(id)];
     }
 }
 
@@ -1172,8 +1203,10 @@ size_t row::external_memory_usage() const {
             mem += ac_o_c.external_memory_usage();
         }
     } else {
-        for (auto&& ce : _storage.set) {
-            mem += sizeof(cell_entry) + ce.cell().external_memory_usage();
+        mem += _storage.sparse.present.external_memory_usage();
+        mem += _storage.sparse.cells.external_memory_usage();
+        for (auto&& ac_o_c : _storage.sparse.cells) {
+            mem += ac_o_c.external_memory_usage();
         }
     }
     return mem;
@@ -1363,16 +1396,7 @@ row::row(const row& o)
     if (_type == storage_type::vector) {
         new (&_storage.vector) vector_storage(o._storage.vector);
     } else {
-        auto cloner = [] (const auto& x) {
-            return current_allocator().construct<std::remove_const_t<std::remove_reference_t<decltype(x)>>>(x);
-        };
-        new (&_storage.set) map_type;
-        try {
-            _storage.set.clone_from(o._storage.set, cloner, current_deleter<cell_entry>());
-        } catch (...) {
-            _storage.set.~map_type();
-            throw;
-        }
+        new (&_storage.sparse) sparse_storage(o._storage.sparse);
     }
 }
 
@@ -1380,26 +1404,10 @@ row::~row() {
     if (_type == storage_type::vector) {
         _storage.vector.~vector_storage();
     } else {
-        _storage.set.clear_and_dispose(current_deleter<cell_entry>());
-        _storage.set.~map_type();
+        _storage.sparse.~sparse_storage();
     }
 }
 
-row::cell_entry::cell_entry(const cell_entry& o)
-    : _id(o._id)
-    , _cell(o._cell)
-{ }
-
-row::cell_entry::cell_entry(cell_entry&& o) noexcept
-    : _link()
-    , _id(o._id)
-    , _cell(std::move(o._cell))
-{
-    using container_type = row::map_type;
-    container_type::node_algorithms::replace_node(o._link.this_ptr(), _link.this_ptr());
-    container_type::node_algorithms::init(o._link.this_ptr());
-}
-
 const atomic_cell_or_collection& row::cell_at(column_id id) const {
     auto&& cell = find_cell(id);
     if (!cell) {
@@ -1408,52 +1416,74 @@ const atomic_cell_or_collection& row::cell_at(column_id id) const {
     return *cell;
 }
 
-void row::vector_to_set()
+void row::vector_to_sparse()
 {
     assert(_type == storage_type::vector);
-    map_type set;
-    try {
+    static_assert(max_vector_size <= bits_per_word, "vector bitmap must fit in a single word");
+    sparse_storage sparse;
+    sparse.present.emplace_back(_storage.vector.present.to_ullong());
+    sparse.cells.reserve(_size);
+    // Nothing below throws.
     for (auto i : bitsets::for_each_set(_storage.vector.present)) {
-        auto& c = _storage.vector.v[i];
-        auto e = current_allocator().construct<cell_entry>(i, std::move(c));
-        set.insert(set.end(), *e);
-    }
-    } catch (...) {
-        set.clear_and_dispose([this, del = current_deleter<cell_entry>()] (cell_entry* ce) noexcept {
-            _storage.vector.v[ce->id()] = std::move(ce->cell());
-            del(ce);
-        });
-        throw;
+        sparse.cells.emplace_back(std::move(_storage.vector.v[i]));
     }
     _storage.vector.~vector_storage();
-    new (&_storage.set) map_type(std::move(set));
-    _type = storage_type::set;
+    new (&_storage.sparse) sparse_storage(std::move(sparse));
+    _type = storage_type::sparse;
+}
+
+column_id row::sparse_last_id() const
+{
+    auto& present = _storage.sparse.present;
+    for (auto w = present.size(); w; --w) {
+        if (present[w - 1]) {
+            return column_id((w - 1) * bits_per_word + bits_per_word - 1 - count_leading_zeros(present[w - 1]));
+        }
+    }
+    return 0;
 }
 
 void row::reserve(column_id last_column)
 {
     if (_type == storage_type::vector && last_column >= internal_count) {
         if (last_column >= max_vector_size) {
-            vector_to_set();
+            vector_to_sparse();
         } else {
             _storage.vector.v.reserve(last_column);
         }
     }
 }
 
+void row::reserve_for(const row& other)
+{
+    reserve(other._type == storage_type::vector ? other._storage.vector.v.size() - 1 : other.sparse_last_id());
+    if (_type == storage_type::vector) {
+        return;
+    }
+    size_type added = 0;
+    other.for_each_cell([&] (column_id id, const atomic_cell_or_collection&) {
+        added += !sparse_contains(id);
+    });
+    auto& sparse = _storage.sparse;
+    sparse.cells.reserve(sparse.cells.size() + added);
+    if (other._type == storage_type::sparse && sparse.present.size() < other._storage.sparse.present.size()) {
+        sparse.present.resize(other._storage.sparse.present.size());
+    }
+}
+
 template<typename Func>
 auto row::with_both_ranges(const row& other, Func&& func) const {
     if (_type == storage_type::vector) {
         if (other._type == storage_type::vector) {
             return func(get_range_vector(), other.get_range_vector());
         } else {
-            return func(get_range_vector(), other.get_range_set());
+            return func(get_range_vector(), other.get_range_sparse());
         }
     } else {
         if (other._type == storage_type::vector) {
-            return func(get_range_set(), other.get_range_vector());
+            return func(get_range_sparse(), other.get_range_vector());
         } else {
-            return func(get_range_set(), other.get_range_set());
+            return func(get_range_sparse(), other.get_range_sparse());
         }
     }
 }
@@ -1497,7 +1527,7 @@ row::row(row&& other) noexcept
     if (_type == storage_type::vector) {
         new (&_storage.vector) vector_storage(std::move(other._storage.vector));
     } else {
-        new (&_storage.set) map_type(std::move(other._storage.set));
+        new (&_storage.sparse) sparse_storage(std::move(other._storage.sparse));
     }
 }
 
@@ -1513,11 +1543,7 @@ void row::apply_reversibly(const schema& s, column_kind kind, row& other) {
     if (other.empty()) {
         return;
     }
-    if (other._type == storage_type::vector) {
-        reserve(other._storage.vector.v.size() - 1);
-    } else {
-        reserve(other._storage.set.rbegin()->id());
-    }
+    reserve_for(other);
     other.for_each_cell([&] (column_id id, atomic_cell_or_collection& cell) {
         apply_reversibly(s.column_at(kind, id), cell);
     }, [&] (column_id id, atomic_cell_or_collection& cell) noexcept {
@@ -1529,11 +1555,7 @@ void row::apply(const schema& s, column_kind kind, const row& other) {
     if (other.empty()) {
         return;
     }
-    if (other._type == storage_type::vector) {
-        reserve(other._storage.vector.v.size() - 1);
-    } else {
-        reserve(other._storage.set.rbegin()->id());
-    }
+    reserve_for(other);
     other.for_each_cell([&] (column_id id, const atomic_cell_or_collection& cell) {
         apply(s.column_at(kind, id), cell);
     });
@@ -1543,11 +1565,7 @@ void row::apply(const schema& s, column_kind kind, row&& other) {
     if (other.empty()) {
         return;
     }
-    if (other._type == storage_type::vector) {
-        reserve(other._storage.vector.v.size() - 1);
-    } else {
-        reserve(other._storage.set.rbegin()->id());
-    }
+    reserve_for(other);
     other.for_each_cell([&] (column_id id, atomic_cell_or_collection& cell) {
         apply(s.column_at(kind, id), std::move(cell));
     });
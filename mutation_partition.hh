@@ -27,8 +27,10 @@
 #include <boost/range/iterator_range.hpp>
 #include <boost/range/adaptor/indexed.hpp>
 #include <boost/range/adaptor/filtered.hpp>
+#include <boost/iterator/iterator_facade.hpp>
 
 #include <seastar/core/bitset-iter.hh>
+#include <seastar/core/bitops.hh>
 
 #include "schema.hh"
 #include "tombstone.hh"
@@ -52,57 +54,26 @@
 // for space-efficiency reasons. Whenever a method accepts a column_kind,
 // the caller must always supply the same column_kind.
 //
-// Can be used as a range of row::cell_entry.
+// Rows which only have cells of columns with small ids keep them in a
+// vector indexed by column id. Other rows use a sparse representation:
+// a bitmap of present column ids and a contiguous array of the present
+// cells, ordered by column id, so that wide rows cost no per-cell
+// allocations or tree nodes.
 //
 class row {
-    class cell_entry {
-        boost::intrusive::set_member_hook<> _link;
-        column_id _id;
-        atomic_cell_or_collection _cell;
-        friend class row;
-    public:
-        cell_entry(column_id id, atomic_cell_or_collection cell)
-            : _id(id)
-            , _cell(std::move(cell))
-        { }
-        cell_entry(column_id id)
-            : _id(id)
-        { }
-        cell_entry(cell_entry&&) noexcept;
-        cell_entry(const cell_entry&);
-
-        column_id id() const { return _id; }
-        const atomic_cell_or_collection& cell() const { return _cell; }
-        atomic_cell_or_collection& cell() { return _cell; }
-
-        struct compare {
-            bool operator()(const cell_entry& e1, const cell_entry& e2) const {
-                return e1._id < e2._id;
-            }
-            bool operator()(column_id id1, const cell_entry& e2) const {
-                return id1 < e2._id;
-            }
-            bool operator()(const cell_entry& e1, column_id id2) const {
-                return e1._id < id2;
-            }
-        };
-    };
-
     using size_type = std::make_unsigned_t<column_id>;
 
     enum class storage_type {
         vector,
-        set,
+        sparse,
     };
     storage_type _type = storage_type::vector;
     size_type _size = 0;
-
-    using map_type = boost::intrusive::set<cell_entry,
-        boost::intrusive::member_hook<cell_entry, boost::intrusive::set_member_hook<>, &cell_entry::_link>,
-        boost::intrusive::compare<cell_entry::compare>, boost::intrusive::constant_time_size<false>>;
 public:
     static constexpr size_t max_vector_size = 32;
-    static constexpr size_t internal_count = (sizeof(map_type) + sizeof(cell_entry)) / sizeof(atomic_cell_or_collection);
+    // Chosen so that rows with a few cells need no external storage.
+    static constexpr size_t internal_count = 5;
+    static constexpr size_t sparse_internal_count = internal_count - 1;
 private:
     using vector_type = managed_vector<atomic_cell_or_collection, internal_count, size_type>;
 
@@ -111,11 +82,23 @@ class row {
         vector_type v;
     };
 
+    static constexpr size_t bits_per_word = 64;
+    using bitmap_type = managed_vector<uint64_t, 1, size_type>;
+    using sparse_cells_type = managed_vector<atomic_cell_or_collection, sparse_internal_count, size_type>;
+
+    struct sparse_storage {
+        // Bit i is set iff column i has a cell.
+        bitmap_type present;
+        // Cells of the columns present in the bitmap, ordered by column id.
+        sparse_cells_type cells;
+    };
+    static_assert(sizeof(sparse_storage) <= sizeof(vector_storage), "sparse storage must not make rows larger");
+
     union storage {
         storage() { }
         ~storage() { }
-        map_type set;
         vector_storage vector;
+        sparse_storage sparse;
     } _storage;
 public:
     row();
@@ -133,6 +116,42 @@ class row {
     // Returns a pointer to cell's value or nullptr if column is not set.
     const atomic_cell_or_collection* find_cell(column_id id) const;
 private:
+    bool sparse_contains(column_id id) const {
+        auto& present = _storage.sparse.present;
+        auto word = id / bits_per_word;
+        return word < present.size() && (present[word] & (uint64_t(1) << (id % bits_per_word)));
+    }
+    // Returns the position in the cell array of the cell of column id, or
+    // where it would be inserted.
+    size_type sparse_index(column_id id) const {
+        auto& present = _storage.sparse.present;
+        auto word = id / bits_per_word;
+        size_type idx = 0;
+        for (size_type w = 0; w < std::min<size_type>(word, present.size()); w++) {
+            idx += __builtin_popcountll(present[w]);
+        }
+        if (word < present.size()) {
+            idx += __builtin_popcountll(present[word] & ((uint64_t(1) << (id % bits_per_word)) - 1));
+        }
+        return idx;
+    }
+    column_id sparse_last_id() const;
+
+    // Calls func(column_id, size_type index) for each present cell in column
+    // order, until it returns stop_iteration::yes.
+    template<typename Func>
+    static void for_each_sparse_index(const bitmap_type& present, Func&& func) {
+        size_type idx = 0;
+        for (size_type w = 0; w < present.size(); w++) {
+            for (auto bits = present[w]; bits; bits &= bits - 1) {
+                auto id = column_id(w * bits_per_word + count_trailing_zeros(bits));
+                if (func(id, idx++) == stop_iteration::yes) {
+                    return;
+                }
+            }
+        }
+    }
+
     template<typename Func>
     void remove_if(Func&& func) {
         if (_type == storage_type::vector) {
@@ -148,20 +167,69 @@ class row {
                 }
             }
         } else {
-            for (auto it = _storage.set.begin(); it != _storage.set.end();) {
-                if (func(it->id(), it->cell())) {
-                    auto& entry = *it;
-                    it = _storage.set.erase(it);
-                    current_allocator().destroy(&entry);
+            // Compacts the cell array in place.
+            auto& present = _storage.sparse.present;
+            auto& cells = _storage.sparse.cells;
+            size_type kept = 0;
+            for_each_sparse_index(present, [&] (column_id id, size_type i) {
+                if (func(id, cells[i])) {
+                    present[id / bits_per_word] &= ~(uint64_t(1) << (id % bits_per_word));
                     _size--;
                 } else {
-                    ++it;
+                    if (kept != i) {
+                        cells[kept] = std::move(cells[i]);
+                    }
+                    kept++;
                 }
+                return stop_iteration::no;
+            });
+            while (cells.size() > kept) {
+                cells.pop_back();
             }
         }
     }
 
 private:
+    class sparse_iterator : public boost::iterator_facade<sparse_iterator,
+            std::pair<column_id, const atomic_cell_or_collection&>,
+            boost::forward_traversal_tag,
+            std::pair<column_id, const atomic_cell_or_collection&>> {
+        const bitmap_type* _present;
+        size_type _word;
+        uint64_t _bits;
+        const atomic_cell_or_collection* _cell;
+
+        friend class boost::iterator_core_access;
+
+        void skip_empty_words() {
+            while (!_bits && ++_word < _present->size()) {
+                _bits = (*_present)[_word];
+            }
+        }
+        void increment() {
+            _bits &= _bits - 1;
+            ++_cell;
+            skip_empty_words();
+        }
+        bool equal(const sparse_iterator& other) const {
+            return _cell == other._cell;
+        }
+        std::pair<column_id, const atomic_cell_or_collection&> dereference() const {
+            return { column_id(_word * bits_per_word + count_trailing_zeros(_bits)), *_cell };
+        }
+    public:
+        sparse_iterator(const bitmap_type& present, const atomic_cell_or_collection* cell, bool end)
+            : _present(&present)
+            , _word(end ? present.size() : 0)
+            , _bits(end || present.empty() ? 0 : present[0])
+            , _cell(cell)
+        {
+            if (!end) {
+                skip_empty_words();
+            }
+        }
+    };
+
     auto get_range_vector() const {
         auto id_range = boost::irange<column_id>(0, _storage.vector.v.size());
         return boost::combine(id_range, _storage.vector.v)
@@ -171,16 +239,21 @@ class row {
             return std::pair<column_id, const atomic_cell_or_collection&>(t.get<0>(), t.get<1>());
         });
     }
-    auto get_range_set() const {
-        auto range = boost::make_iterator_range(_storage.set.begin(), _storage.set.end());
-        return range | boost::adaptors::transformed([] (const cell_entry& c) {
-            return std::pair<column_id, const atomic_cell_or_collection&>(c.id(), c.cell());
-        });
+    auto get_range_sparse() const {
+        auto& s = _storage.sparse;
+        return boost::make_iterator_range(sparse_iterator(s.present, s.cells.begin(), false),
+                                          sparse_iterator(s.present, s.cells.end(), true));
     }
     template<typename Func>
     auto with_both_ranges(const row& other, Func&& func) const;
 
-    void vector_to_set();
+    void vector_to_sparse();
+    // Inserts the cell of column id, which must not be present, at position
+    // idx of the cell array. Leaves the cell empty.
+    void sparse_insert(column_id id, size_type idx, atomic_cell_or_collection& cell);
+    // Prepares for merging other into this row, so that the cell array is
+    // grown at most once, to the exact size needed.
+    void reserve_for(const row& other);
 
     // Calls Func(column_id, atomic_cell_or_collection&) for each cell in this row.
     //
@@ -202,9 +275,11 @@ class row {
                 func(i, _storage.vector.v[i]);
             }
         } else {
-            for (auto& cell : _storage.set) {
-                func(cell.id(), cell.cell());
-            }
+            auto& cells = _storage.sparse.cells;
+            for_each_sparse_index(_storage.sparse.present, [&] (column_id id, size_type i) {
+                func(id, cells[i]);
+                return stop_iteration::no;
+            });
         }
     }
 
@@ -226,12 +301,10 @@ class row {
                 }
             }
         } else {
-            for (auto& cell : _storage.set) {
-                const auto& c = cell.cell();
-                if (func(cell.id(), c) == stop_iteration::yes) {
-                    break;
-                }
-            }
+            auto& cells = _storage.sparse.cells;
+            for_each_sparse_index(_storage.sparse.present, [&] (column_id id, size_type i) {
+                return func(id, cells[i]);
+            });
         }
     }
 
@@ -98,6 +98,26 @@ future<> combined_mutation_reader::prepare_next() {
     });
 }
 
+void combined_mutation_reader::prefetch() {
+    for (auto&& e : _ptables) {
+        if (_prefetch_used + prefetch_buffer_size > _prefetch.budget) {
+            return;
+        }
+        if (!e.prefetched && e.m.is_buffer_empty() && !e.m.is_end_of_stream()) {
+            stdx::optional<semaphore_units<>> units;
+            if (_prefetch.resources_sem) {
+                if (!_prefetch.resources_sem->try_wait(prefetch_buffer_size)) {
+                    return;
+                }
+                units.emplace(*_prefetch.resources_sem, prefetch_buffer_size);
+            }
+            e.prefetched = true;
+            e.fill = e.m.fill_buffer().finally([units = std::move(units)] { });
+            _prefetch_used += prefetch_buffer_size;
+        }
+    }
+}
+
 future<streamed_mutation_opt> combined_mutation_reader::next() {
     if ((_current.empty() && !_next.empty()) || _selector->has_new_readers(current_position())) {
         return prepare_next().then([this] { return next(); });
@@ -106,11 +126,16 @@ future<streamed_mutation_opt> combined_mutation_reader::next() {
         return make_ready_future<streamed_mutation_opt>();
     }
 
+    std::vector<future<>> fills;
     while (!_ptables.empty()) {
         boost::range::pop_heap(_ptables, &heap_compare);
         auto& candidate = _ptables.back();
         streamed_mutation& m = candidate.m;
 
+        if (candidate.prefetched) {
+            _prefetch_used -= prefetch_buffer_size;
+            fills.emplace_back(std::move(candidate.fill));
+        }
         _current.emplace_back(std::move(m));
         _next.emplace_back(candidate.read);
         _ptables.pop_back();
@@ -120,29 +145,75 @@ future<streamed_mutation_opt> combined_mutation_reader::next() {
             break;
         }
     }
-    if (_current.size() == 1) {
-        auto m = std::move(_current.back());
-        _current.pop_back();
-        return make_ready_future<streamed_mutation_opt>(std::move(m));
+    prefetch();
+
+    auto emit = [this] {
+        if (_current.size() == 1) {
+            auto m = std::move(_current.back());
+            _current.pop_back();
+            return streamed_mutation_opt(std::move(m));
+        }
+        return streamed_mutation_opt(merge_mutations(std::exchange(_current, {})));
+    };
+    if (fills.empty()) {
+        return make_ready_future<streamed_mutation_opt>(emit());
     }
-    return make_ready_future<streamed_mutation_opt>(merge_mutations(std::exchange(_current, {})));
+    // The emitted mutations must not be consumed while they are still filling their buffers.
+    return parallel_for_each(fills, [] (future<>& f) {
+        return std::move(f);
+    }).then(std::move(emit));
 }
 
-combined_mutation_reader::combined_mutation_reader(std::unique_ptr<reader_selector> selector, mutation_reader::forwarding fwd_mr)
+combined_mutation_reader::combined_mutation_reader(std::unique_ptr<reader_selector> selector, mutation_reader::forwarding fwd_mr,
+        combined_reader_prefetch prefetch)
     : _selector(std::move(selector))
     , _fwd_mr(fwd_mr)
+    , _prefetch(std::move(prefetch))
 {
 }
 
+combined_mutation_reader::~combined_mutation_reader() {
+    // Fills can't be waited for here, so keep what they use alive until they are done.
+    for (auto&& e : _ptables) {
+        if (e.prefetched) {
+            e.fill.then_wrapped([m = std::move(e.m), range = _prefetch.range, slice = _prefetch.slice] (future<> f) {
+                f.ignore_ready_future();
+            });
+        }
+    }
+}
+
 future<> combined_mutation_reader::fast_forward_to(const dht::partition_range& pr) {
-    _ptables.clear();
-    auto rs = _all_readers | boost::adaptors::transformed([] (auto& r) { return &r; });
-    _next.assign(rs.begin(), rs.end());
-
-    return parallel_for_each(_next, [this, &pr] (mutation_reader* mr) {
-        return mr->fast_forward_to(pr);
-    }).then([this, pr] {
-        add_readers(_selector->fast_forward_to(pr));
+    std::vector<future<>> fills;
+    for (auto&& e : _ptables) {
+        if (e.prefetched) {
+            fills.emplace_back(std::move(e.fill));
+        }
+    }
+    // Keep the range the readers are forwarded to alive for fills which may
+    // outlive this reader.
+    auto range = _prefetch.range ? make_lw_shared<const dht::partition_range>(pr) : lw_shared_ptr<const dht::partition_range>();
+    auto fwd_pr = range ? range.get() : &pr;
+    // Wait for the background fills before the readers are moved, ignoring
+    // their failures, as the mutations are dropped anyway.
+    return when_all(fills.begin(), fills.end()).then([this, fwd_pr] (std::vector<future<>> fills) {
+        for (auto&& f : fills) {
+            f.ignore_ready_future();
+        }
+        _ptables.clear();
+        _prefetch_used = 0;
+        auto rs = _all_readers | boost::adaptors::transformed([] (auto& r) { return &r; });
+        _next.assign(rs.begin(), rs.end());
+
+        return parallel_for_each(_next, [this, fwd_pr] (mutation_reader* mr) {
+            return mr->fast_forward_to(*fwd_pr);
+        }).then([this, fwd_pr] {
+            add_readers(_selector->fast_forward_to(*fwd_pr));
+        });
+    }).then([this, range = std::move(range)] () mutable {
+        if (range) {
+            _prefetch.range = std::move(range);
+        }
     });
 }
 
@@ -151,8 +222,8 @@ future<streamed_mutation_opt> combined_mutation_reader::operator()() {
 }
 
 mutation_reader
-make_combined_reader(std::vector<mutation_reader> readers, mutation_reader::forwarding fwd_mr) {
-    return make_mutation_reader<combined_mutation_reader>(std::make_unique<list_reader_selector>(std::move(readers)), fwd_mr);
+make_combined_reader(std::vector<mutation_reader> readers, mutation_reader::forwarding fwd_mr, combined_reader_prefetch prefetch) {
+    return make_mutation_reader<combined_mutation_reader>(std::make_unique<list_reader_selector>(std::move(readers)), fwd_mr, std::move(prefetch));
 }
 
 mutation_reader
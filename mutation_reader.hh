@@ -28,6 +28,7 @@
 #include "core/future.hh"
 #include "core/future-util.hh"
 #include "core/do_with.hh"
+#include "core/semaphore.hh"
 #include "tracing/trace_state.hh"
 
 // A mutation_reader is an object which allows iterating on mutations: invoke
@@ -120,14 +121,46 @@ class reader_selector {
     }
 };
 
+// How a combined_mutation_reader fills partition buffers ahead of time.
+//
+// A fill may still be running when the reader is destroyed, so it keeps
+// what it depends on alive until it completes: the mutation being filled,
+// its share of resources_sem, and the range and slice the underlying
+// readers were created with, if they were created with these copies.
+struct combined_reader_prefetch {
+    // Memory, in bytes, the buffers filled ahead of time may use; 0 disables prefetching.
+    size_t budget = 0;
+    // Reader admission semaphore, which each fill holds its buffer's worth
+    // of until it completes. A fill is not started if it's not available.
+    semaphore* resources_sem = nullptr;
+    lw_shared_ptr<const dht::partition_range> range;
+    lw_shared_ptr<const query::partition_slice> slice;
+};
+
 // Combines multiple mutation_readers into one.
+//
+// With a non-zero prefetch budget, the reader fills, in the background, the
+// buffers of the partitions which wait in the merge heap while the consumer
+// works on the partition emitted last, so that the I/O of all underlying
+// readers overlaps. The readers themselves are not advanced ahead of time,
+// as the partition they emitted last may still be being consumed. When the
+// prefetch carries a range, fast_forward_to() forwards the underlying readers
+// and the selector to a copy of the new range, which it keeps alive.
 class combined_mutation_reader : public mutation_reader::impl {
+    // What a partition buffer filled ahead of time is charged against the
+    // prefetch budget; the default streamed_mutation buffer size.
+    static constexpr size_t prefetch_buffer_size = 8 * 1024;
+
     std::unique_ptr<reader_selector> _selector;
     std::list<mutation_reader> _all_readers;
 
     struct mutation_and_reader {
         streamed_mutation m;
         mutation_reader* read;
+        bool prefetched = false;
+        // Resolves when m is done filling its buffer in the background.
+        // Holds the fill's share of the admission semaphore until then.
+        future<> fill = make_ready_future<>();
 
         bool operator<(const mutation_and_reader& other) const {
             return read < other.read;
@@ -155,16 +188,20 @@ class combined_mutation_reader : public mutation_reader::impl {
     std::vector<streamed_mutation> _current;
     std::vector<mutation_reader*> _next;
     mutation_reader::forwarding _fwd_mr;
+    combined_reader_prefetch _prefetch;
+    size_t _prefetch_used = 0;
 private:
     const dht::token* current_position() const;
     void maybe_add_readers(const dht::token* const t);
     void add_readers(std::vector<mutation_reader> new_readers);
     future<> prepare_next();
+    void prefetch();
     // Produces next mutation or disengaged optional if there are no more.
     future<streamed_mutation_opt> next();
 public:
     // The specified mutation_reader::forwarding tag must be the same for all included readers.
-    combined_mutation_reader(std::unique_ptr<reader_selector> selector, mutation_reader::forwarding fwd_mr);
+    combined_mutation_reader(std::unique_ptr<reader_selector> selector, mutation_reader::forwarding fwd_mr, combined_reader_prefetch prefetch = {});
+    ~combined_mutation_reader();
     virtual future<streamed_mutation_opt> operator()() override;
     virtual future<> fast_forward_to(const dht::partition_range& pr) override;
 };
@@ -172,7 +209,7 @@ class combined_mutation_reader : public mutation_reader::impl {
 // Creates a mutation reader which combines data return by supplied readers.
 // Returns mutation of the same schema only when all readers return mutations
 // of the same schema.
-mutation_reader make_combined_reader(std::vector<mutation_reader>, mutation_reader::forwarding);
+mutation_reader make_combined_reader(std::vector<mutation_reader>, mutation_reader::forwarding, combined_reader_prefetch prefetch = {});
 mutation_reader make_combined_reader(mutation_reader&& a, mutation_reader&& b, mutation_reader::forwarding fwd_mr = mutation_reader::forwarding::yes);
 // reads from the input readers, in order
 mutation_reader make_reader_returning(mutation, streamed_mutation::forwarding fwd = streamed_mutation::forwarding::no);
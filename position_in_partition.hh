@@ -61,6 +61,7 @@ enum class partition_region {
 
 class position_in_partition_view {
     friend class position_in_partition;
+    friend class byte_comparable_encoder;
 
     partition_region _type;
     int _bound_weight = 0;
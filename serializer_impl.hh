@@ -396,6 +396,16 @@ struct serializer<sstring> {
     }
 };
 
+// Write-only: lets a sender serialize objects it does not own, which the
+// receiver reads back as plain T.
+template<typename T>
+struct serializer<std::reference_wrapper<const T>> {
+    template<typename Output>
+    static void write(Output& out, const std::reference_wrapper<const T>& v) {
+        serialize(out, v.get());
+    }
+};
+
 template<typename T>
 struct serializer<std::unique_ptr<T>> {
     template<typename Input>
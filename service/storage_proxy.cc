@@ -70,6 +70,7 @@
 #include <boost/range/algorithm/sort.hpp>
 #include <boost/range/empty.hpp>
 #include <boost/range/algorithm/min_element.hpp>
+#include <boost/range/irange.hpp>
 #include <boost/range/adaptor/transformed.hpp>
 #include "utils/latency.hh"
 #include "schema.hh"
@@ -479,8 +480,21 @@ inline uint64_t& storage_proxy::split_stats::get_ep_stat(gms::inet_address ep) {
     return _dc_stats[dc].val;
 }
 
+static locator::dynamic_snitch::config make_dynamic_snitch_config(const db::config& cfg) {
+    locator::dynamic_snitch::config dcfg;
+    dcfg.enabled = cfg.dynamic_snitch();
+    dcfg.update_interval = std::chrono::milliseconds(cfg.dynamic_snitch_update_interval_in_ms());
+    dcfg.reset_interval = std::chrono::milliseconds(cfg.dynamic_snitch_reset_interval_in_ms());
+    dcfg.badness_threshold = cfg.dynamic_snitch_badness_threshold();
+    return dcfg;
+}
+
 storage_proxy::~storage_proxy() {}
-storage_proxy::storage_proxy(distributed<database>& db) : _db(db) {
+storage_proxy::storage_proxy(distributed<database>& db)
+    : _db(db)
+    , _write_coalescer(std::chrono::microseconds(db.local().get_config().write_coalescing_window_in_us()), db.local().get_config().write_coalescing_max_bytes())
+    , _dynamic_snitch(make_dynamic_snitch_config(db.local().get_config()))
+{
     namespace sm = seastar::metrics;
     _metrics.add_group(COORDINATOR_STATS_CATEGORY, {
         sm::make_histogram("read_latency", sm::description("The general read latency histogram"), [this]{ return _stats.estimated_read.get_histogram(16, 20);}),
@@ -503,6 +517,12 @@ storage_proxy::storage_proxy(distributed<database>& db) : _db(db) {
         sm::make_current_bytes("background_write_bytes", [this] { return _stats.background_write_bytes; },
                        sm::description("number of bytes in pending background write requests")),
 
+        sm::make_total_operations("coalesced_writes", [this] { return _write_coalescer.stats().writes; },
+                       sm::description("number of writes sent to replicas together with other writes, in MUTATIONS messages")),
+
+        sm::make_total_operations("write_batches", [this] { return _write_coalescer.stats().batches; },
+                       sm::description("number of MUTATIONS messages sent, each carrying several writes to a replica shard")),
+
         sm::make_queue_length("foreground_reads", [this] { return _stats.reads - _stats.background_reads; },
                        sm::description("number of currently pending foreground read requests")),
 
@@ -553,6 +573,9 @@ storage_proxy::storage_proxy(distributed<database>& db) : _db(db) {
         sm::make_total_operations("forwarding_errors", _stats.forwarding_errors,
                        sm::description("number of errors during forwarding mutations to other replica Nodes")),
 
+        sm::make_total_operations("cross_shard_ops", _stats.replica_cross_shard_ops,
+                       sm::description("number of local writes and single partition reads executed by another shard than the one which received them")),
+
         sm::make_total_operations("reads", _stats.replica_data_reads,
                        sm::description("number of remote data read requests this Node received"), {storage_proxy::split_stats::op_type_label("data")}),
 
@@ -563,6 +586,11 @@ storage_proxy::storage_proxy(distributed<database>& db) : _db(db) {
                        sm::description("number of remote digest read requests this Node received"), {storage_proxy::split_stats::op_type_label("digest")}),
 
     });
+    service::get_local_storage_service().register_subscriber(this);
+}
+
+void storage_proxy::on_leave_cluster(const gms::inet_address& endpoint) {
+    _dynamic_snitch.remove_endpoint(endpoint);
 }
 
 storage_proxy::rh_entry::rh_entry(shared_ptr<abstract_write_response_handler>&& h, std::function<void()>&& cb) : handler(std::move(h)), expire_timer(std::move(cb)) {}
@@ -974,6 +1002,7 @@ storage_proxy::mutate_locally(const mutation& m, clock_type::time_point timeout)
 future<>
 storage_proxy::mutate_locally(const schema_ptr& s, const frozen_mutation& m, clock_type::time_point timeout) {
     auto shard = _db.local().shard_of(m);
+    _stats.replica_cross_shard_ops += shard != engine().cpu_id();
     return _db.invoke_on(shard, [&m, gs = global_schema_ptr(s), timeout] (database& db) -> future<> {
         return db.apply(gs, m, timeout);
     });
@@ -1517,16 +1546,26 @@ void storage_proxy::send_to_live_endpoints(storage_proxy::response_id_type respo
     };
 
     // lambda for applying mutation remotely
-    auto rmutate = [this, handler_ptr, timeout, response_id, my_address] (gms::inet_address coordinator, std::vector<gms::inet_address>&& forward, const frozen_mutation& m) {
+    auto rmutate = [this, handler_ptr, timeout, response_id, my_address] (gms::inet_address coordinator, std::vector<gms::inet_address>&& forward, lw_shared_ptr<const frozen_mutation> m) {
         auto& ms = netw::get_local_messaging_service();
-        auto msize = m.representation().size();
+        auto msize = m->representation().size();
         _stats.queued_write_bytes += msize;
 
         auto& tr_state = handler_ptr->get_trace_state();
         tracing::trace(tr_state, "Sending a mutation to /{}", coordinator);
 
-        return ms.send_mutation(netw::messaging_service::msg_addr{coordinator, 0}, timeout, m,
-                std::move(forward), my_address, engine().cpu_id(), response_id, tracing::make_trace_info(tr_state)).finally([this, p = shared_from_this(), h = std::move(handler_ptr), msize] {
+        auto s = handler_ptr->get_schema();
+        auto shard = ms.shard_of(coordinator, dht::global_partitioner().get_token(*s, m->key(*s)));
+        future<> f = make_ready_future<>();
+        // Nodes which don't know the MUTATIONS verb would drop the writes.
+        if (forward.empty() && !tr_state && _write_coalescer.accepts(msize)
+                && service::get_local_storage_service().cluster_supports_write_coalescing()) {
+            f = _write_coalescer.send(coordinator, shard, std::move(m), response_id, timeout);
+        } else {
+            f = ms.send_mutation(netw::messaging_service::msg_addr{coordinator, shard}, timeout, *m,
+                    std::move(forward), my_address, engine().cpu_id(), response_id, tracing::make_trace_info(tr_state));
+        }
+        return f.finally([this, p = shared_from_this(), h = std::move(handler_ptr), msize] {
             _stats.queued_write_bytes -= msize;
             unthrottle();
         });
@@ -1556,7 +1595,7 @@ void storage_proxy::send_to_live_endpoints(storage_proxy::response_id_type respo
             if (coordinator == my_address) {
                 f = futurize<void>::apply(lmutate, std::move(m));
             } else {
-                f = futurize<void>::apply(rmutate, coordinator, std::move(forward), *m);
+                f = futurize<void>::apply(rmutate, coordinator, std::move(forward), std::move(m));
             }
         }
 
@@ -2401,6 +2440,16 @@ class data_read_resolver : public abstract_read_resolver {
     }
 };
 
+// Address of a replica to send a read of pr to: the shard owning the data
+// for single partition reads, so that it need not be forwarded there.
+static netw::msg_addr replica_addr(gms::inet_address ep, const dht::partition_range& pr) {
+    unsigned shard = 0;
+    if (pr.is_singular()) {
+        shard = netw::get_local_messaging_service().shard_of(ep, pr.start()->value().token());
+    }
+    return netw::msg_addr{ep, shard};
+}
+
 class abstract_read_executor : public enable_shared_from_this<abstract_read_executor> {
 protected:
     using targets_iterator = std::vector<gms::inet_address>::iterator;
@@ -2440,7 +2489,7 @@ class abstract_read_executor : public enable_shared_from_this<abstract_read_exec
         } else {
             auto& ms = netw::get_local_messaging_service();
             tracing::trace(_trace_state, "read_mutation_data: sending a message to /{}", ep);
-            return ms.send_read_mutation_data(netw::messaging_service::msg_addr{ep, 0}, timeout, *cmd, _partition_range).then([this, ep](reconcilable_result&& result, rpc::optional<cache_temperature> hit_rate) {
+            return ms.send_read_mutation_data(replica_addr(ep, _partition_range), timeout, *cmd, _partition_range).then([this, ep](reconcilable_result&& result, rpc::optional<cache_temperature> hit_rate) {
                 tracing::trace(_trace_state, "read_mutation_data: got response from /{}", ep);
                 return make_ready_future<foreign_ptr<lw_shared_ptr<reconcilable_result>>, cache_temperature>(make_foreign(::make_lw_shared<reconcilable_result>(std::move(result))), hit_rate.value_or(cache_temperature::invalid()));
             });
@@ -2456,7 +2505,7 @@ class abstract_read_executor : public enable_shared_from_this<abstract_read_exec
             auto& ms = netw::get_local_messaging_service();
             tracing::trace(_trace_state, "read_data: sending a message to /{}", ep);
             auto da = want_digest ? query::digest_algorithm::MD5 : query::digest_algorithm::none;
-            return ms.send_read_data(netw::messaging_service::msg_addr{ep, 0}, timeout, *_cmd, _partition_range, da).then([this, ep](query::result&& result, rpc::optional<cache_temperature> hit_rate) {
+            return ms.send_read_data(replica_addr(ep, _partition_range), timeout, *_cmd, _partition_range, da).then([this, ep](query::result&& result, rpc::optional<cache_temperature> hit_rate) {
                 tracing::trace(_trace_state, "read_data: got response from /{}", ep);
                 return make_ready_future<foreign_ptr<lw_shared_ptr<query::result>>, cache_temperature>(make_foreign(::make_lw_shared<query::result>(std::move(result))), hit_rate.value_or(cache_temperature::invalid()));
             });
@@ -2470,7 +2519,7 @@ class abstract_read_executor : public enable_shared_from_this<abstract_read_exec
         } else {
             auto& ms = netw::get_local_messaging_service();
             tracing::trace(_trace_state, "read_digest: sending a message to /{}", ep);
-            return ms.send_read_digest(netw::messaging_service::msg_addr{ep, 0}, timeout, *_cmd, _partition_range).then([this, ep] (query::result_digest d, rpc::optional<api::timestamp_type> t,
+            return ms.send_read_digest(replica_addr(ep, _partition_range), timeout, *_cmd, _partition_range).then([this, ep] (query::result_digest d, rpc::optional<api::timestamp_type> t,
                     rpc::optional<cache_temperature> hit_rate) {
                 tracing::trace(_trace_state, "read_digest: got response from /{}", ep);
                 return make_ready_future<query::result_digest, api::timestamp_type, cache_temperature>(d, t ? t.value() : api::missing_timestamp, hit_rate.value_or(cache_temperature::invalid()));
@@ -2479,7 +2528,9 @@ class abstract_read_executor : public enable_shared_from_this<abstract_read_exec
     }
     future<> make_mutation_data_requests(lw_shared_ptr<query::read_command> cmd, data_resolver_ptr resolver, targets_iterator begin, targets_iterator end, clock_type::time_point timeout) {
         return parallel_for_each(begin, end, [this, &cmd, resolver = std::move(resolver), timeout] (gms::inet_address ep) {
-            return make_mutation_data_request(cmd, ep, timeout).then_wrapped([this, resolver, ep] (future<foreign_ptr<lw_shared_ptr<reconcilable_result>>, cache_temperature> f) {
+            auto started = _proxy->_dynamic_snitch.request_started(ep);
+            return make_mutation_data_request(cmd, ep, timeout).then_wrapped([this, resolver, ep, started] (future<foreign_ptr<lw_shared_ptr<reconcilable_result>>, cache_temperature> f) {
+                _proxy->_dynamic_snitch.request_completed(ep, started);
                 try {
                     auto v = f.get();
                     _cf->set_hit_rate(ep, std::get<1>(v));
@@ -2494,7 +2545,9 @@ class abstract_read_executor : public enable_shared_from_this<abstract_read_exec
     }
     future<> make_data_requests(digest_resolver_ptr resolver, targets_iterator begin, targets_iterator end, clock_type::time_point timeout, bool want_digest) {
         return parallel_for_each(begin, end, [this, resolver = std::move(resolver), timeout, want_digest] (gms::inet_address ep) {
-            return make_data_request(ep, timeout, want_digest).then_wrapped([this, resolver, ep] (future<foreign_ptr<lw_shared_ptr<query::result>>, cache_temperature> f) {
+            auto started = _proxy->_dynamic_snitch.request_started(ep);
+            return make_data_request(ep, timeout, want_digest).then_wrapped([this, resolver, ep, started] (future<foreign_ptr<lw_shared_ptr<query::result>>, cache_temperature> f) {
+                _proxy->_dynamic_snitch.request_completed(ep, started);
                 try {
                     auto v = f.get();
                     _cf->set_hit_rate(ep, std::get<1>(v));
@@ -2509,7 +2562,9 @@ class abstract_read_executor : public enable_shared_from_this<abstract_read_exec
     }
     future<> make_digest_requests(digest_resolver_ptr resolver, targets_iterator begin, targets_iterator end, clock_type::time_point timeout) {
         return parallel_for_each(begin, end, [this, resolver = std::move(resolver), timeout] (gms::inet_address ep) {
-            return make_digest_request(ep, timeout).then_wrapped([this, resolver, ep] (future<query::result_digest, api::timestamp_type, cache_temperature> f) {
+            auto started = _proxy->_dynamic_snitch.request_started(ep);
+            return make_digest_request(ep, timeout).then_wrapped([this, resolver, ep, started] (future<query::result_digest, api::timestamp_type, cache_temperature> f) {
+                _proxy->_dynamic_snitch.request_completed(ep, started);
                 try {
                     auto v = f.get();
                     _cf->set_hit_rate(ep, std::get<2>(v));
@@ -2522,6 +2577,24 @@ class abstract_read_executor : public enable_shared_from_this<abstract_read_exec
             });
         });
     }
+    // Reads the data from ep alone, for executors which have nothing to
+    // resolve. Fails with timed_out_error if ep doesn't answer in time.
+    future<foreign_ptr<lw_shared_ptr<query::result>>> make_single_data_request(gms::inet_address ep, clock_type::time_point timeout) {
+        auto started = _proxy->_dynamic_snitch.request_started(ep);
+        auto f = with_timeout(timeout, make_data_request(ep, timeout, false));
+        return f.then_wrapped([this, exec = shared_from_this(), ep, started] (future<foreign_ptr<lw_shared_ptr<query::result>>, cache_temperature> f) {
+            _proxy->_dynamic_snitch.request_completed(ep, started);
+            try {
+                auto v = f.get();
+                _cf->set_hit_rate(ep, std::get<1>(v));
+                ++_proxy->_stats.data_read_completed.get_ep_stat(ep);
+                return std::get<0>(std::move(v));
+            } catch (...) {
+                ++_proxy->_stats.data_read_errors.get_ep_stat(ep);
+                throw;
+            }
+        });
+    }
     virtual future<> make_requests(digest_resolver_ptr resolver, clock_type::time_point timeout) {
         resolver->add_wait_targets(_targets.size());
         auto want_digest = _targets.size() > 1;
@@ -2692,6 +2765,21 @@ class never_speculating_read_executor : public abstract_read_executor {
     }
 };
 
+// Reads from the local node alone, when it is the only replica the read
+// needs: there is nothing to resolve, so the result goes to the client as
+// the local replica produced it, with no resolver and no digest.
+class local_read_executor : public abstract_read_executor {
+public:
+    local_read_executor(schema_ptr s, lw_shared_ptr<column_family> cf, shared_ptr<storage_proxy> proxy, lw_shared_ptr<query::read_command> cmd, dht::partition_range pr, db::consistency_level cl, std::vector<gms::inet_address> targets, tracing::trace_state_ptr trace_state) :
+                                        abstract_read_executor(std::move(s), std::move(cf), std::move(proxy), std::move(cmd), std::move(pr), cl, 1, std::move(targets), std::move(trace_state)) {
+    }
+    virtual future<foreign_ptr<lw_shared_ptr<query::result>>> execute(storage_proxy::clock_type::time_point timeout) override {
+        return make_single_data_request(_targets.front(), timeout).handle_exception_type([this, exec = shared_from_this()] (timed_out_error&) -> foreign_ptr<lw_shared_ptr<query::result>> {
+            throw read_timeout_exception(_schema->ks_name(), _schema->cf_name(), _cl, 0, 1, false);
+        });
+    }
+};
+
 // this executor always asks for one additional data reply
 class always_speculating_read_executor : public abstract_read_executor {
 public:
@@ -2815,6 +2903,10 @@ ::shared_ptr<abstract_read_executor> storage_proxy::get_read_executor(lw_shared_
     // Speculative retry is disabled *OR* there are simply no extra replicas to speculate.
     if (retry_type == speculative_retry::type::NONE || block_for == all_replicas.size()
             || (repair_decision == db::read_repair_decision::DC_LOCAL && is_datacenter_local(cl) && block_for == target_replicas.size())) {
+        // E.g. CL.ONE served by this node, with no read repair: nothing to reconcile.
+        if (target_replicas.size() == 1 && is_me(target_replicas.front())) {
+            return ::make_shared<local_read_executor>(schema, cf, p, cmd, std::move(pr), cl, std::move(target_replicas), std::move(trace_state));
+        }
         return ::make_shared<never_speculating_read_executor>(schema, cf, p, cmd, std::move(pr), cl, std::move(target_replicas), std::move(trace_state));
     }
 
@@ -2854,6 +2946,7 @@ future<foreign_ptr<lw_shared_ptr<query::result>>, cache_temperature>
 storage_proxy::query_result_local(schema_ptr s, lw_shared_ptr<query::read_command> cmd, const dht::partition_range& pr, query::result_request request, tracing::trace_state_ptr trace_state, uint64_t max_size) {
     if (pr.is_singular()) {
         unsigned shard = _db.local().shard_of(pr.start()->value().token());
+        _stats.replica_cross_shard_ops += shard != engine().cpu_id();
         return _db.invoke_on(shard, [max_size, gs = global_schema_ptr(s), prv = dht::partition_range_vector({pr}) /* FIXME: pr is copied */, cmd, request, gt = tracing::global_trace_state_ptr(std::move(trace_state))] (database& db) mutable {
             tracing::trace(gt, "Start querying the token range that starts with {}", seastar::value_of([&prv] { return prv.begin()->start()->value().token(); }));
             return db.query(gs, *cmd, request, prv, gt, max_size).then([trace_state = gt.get()](auto&& f, cache_temperature ht) {
@@ -3232,11 +3325,13 @@ std::vector<gms::inet_address> storage_proxy::get_live_endpoints(keyspace& ks, c
 std::vector<gms::inet_address> storage_proxy::get_live_sorted_endpoints(keyspace& ks, const dht::token& token) {
     auto eps = get_live_endpoints(ks, token);
     locator::i_endpoint_snitch::get_local_snitch_ptr()->sort_by_proximity(utils::fb_utilities::get_broadcast_address(), eps);
-    // FIXME: before dynamic snitch is implement put local address (if present) at the beginning
+    // put local address (if present) at the beginning, the dynamic snitch
+    // moves it away only if it responds much slower than other replicas
     auto it = boost::range::find(eps, utils::fb_utilities::get_broadcast_address());
     if (it != eps.end() && it != eps.begin()) {
         std::iter_swap(it, eps.begin());
     }
+    _dynamic_snitch.sort_by_score(eps);
     return eps;
 }
 
@@ -3656,7 +3751,42 @@ void storage_proxy::init_messaging_service() {
             });
         });
     });
-    ms.register_mutation([] (const rpc::client_info& cinfo, rpc::opt_time_point t, frozen_mutation in, std::vector<gms::inet_address> forward, gms::inet_address reply_to, unsigned shard, storage_proxy::response_id_type response_id, rpc::optional<std::experimental::optional<tracing::trace_info>> trace_info) {
+    // Applies a mutation received from a coordinator and reports it done.
+    // Failures are only logged, the coordinator learns about them by timing out.
+    auto apply_and_reply = [] (shared_ptr<storage_proxy>& p, const frozen_mutation& m, netw::messaging_service::msg_addr src_addr, gms::inet_address reply_to,
+            unsigned shard, storage_proxy::response_id_type response_id, tracing::trace_state_ptr trace_state_ptr, storage_proxy::clock_type::time_point timeout) {
+        // mutate_locally() may throw, putting it into apply() converts exception to a future.
+        return futurize<void>::apply([timeout, &p, &m, src_addr = std::move(src_addr)] () mutable {
+            // FIXME: get_schema_for_write() doesn't timeout
+            return get_schema_for_write(m.schema_version(), std::move(src_addr)).then([&m, &p, timeout] (schema_ptr s) {
+                return p->mutate_locally(std::move(s), m, timeout);
+            });
+        }).then([reply_to, shard, response_id, trace_state_ptr] () {
+            auto& ms = netw::get_local_messaging_service();
+            // We wait for send_mutation_done to complete, otherwise, if reply_to is busy, we will accumulate
+            // lots of unsent responses, which can OOM our shard.
+            //
+            // Usually we will return immediately, since this work only involves appending data to the connection
+            // send buffer.
+            tracing::trace(trace_state_ptr, "Sending mutation_done to /{}", reply_to);
+            return ms.send_mutation_done(netw::messaging_service::msg_addr{reply_to, shard}, shard, response_id).then_wrapped([] (future<> f) {
+                f.ignore_ready_future();
+            });
+        }).handle_exception([reply_to, shard] (std::exception_ptr eptr) {
+            seastar::log_level l = seastar::log_level::warn;
+            try {
+                std::rethrow_exception(eptr);
+            } catch (timed_out_error&) {
+                // ignore timeouts so that logs are not flooded.
+                // database total_writes_timedout counter was incremented.
+                l = seastar::log_level::debug;
+            } catch (...) {
+                // ignore
+            }
+            slogger.log(l, "Failed to apply mutation from {}#{}: {}", reply_to, shard, eptr);
+        });
+    };
+    ms.register_mutation([apply_and_reply] (const rpc::client_info& cinfo, rpc::opt_time_point t, frozen_mutation in, std::vector<gms::inet_address> forward, gms::inet_address reply_to, unsigned shard, storage_proxy::response_id_type response_id, rpc::optional<std::experimental::optional<tracing::trace_info>> trace_info) {
         tracing::trace_state_ptr trace_state_ptr;
         auto src_addr = netw::messaging_service::get_source(cinfo);
 
@@ -3675,40 +3805,11 @@ void storage_proxy::init_messaging_service() {
             timeout = *t;
         }
 
-        return do_with(std::move(in), get_local_shared_storage_proxy(), [src_addr = std::move(src_addr), &cinfo, forward = std::move(forward), reply_to, shard, response_id, trace_state_ptr, timeout] (const frozen_mutation& m, shared_ptr<storage_proxy>& p) mutable {
+        return do_with(std::move(in), get_local_shared_storage_proxy(), [apply_and_reply, src_addr = std::move(src_addr), &cinfo, forward = std::move(forward), reply_to, shard, response_id, trace_state_ptr, timeout] (const frozen_mutation& m, shared_ptr<storage_proxy>& p) mutable {
             ++p->_stats.received_mutations;
             p->_stats.forwarded_mutations += forward.size();
             return when_all(
-                // mutate_locally() may throw, putting it into apply() converts exception to a future.
-                futurize<void>::apply([timeout, &p, &m, reply_to, src_addr = std::move(src_addr)] () mutable {
-                    // FIXME: get_schema_for_write() doesn't timeout
-                    return get_schema_for_write(m.schema_version(), std::move(src_addr)).then([&m, &p, timeout] (schema_ptr s) {
-                        return p->mutate_locally(std::move(s), m, timeout);
-                    });
-                }).then([reply_to, shard, response_id, trace_state_ptr] () {
-                    auto& ms = netw::get_local_messaging_service();
-                    // We wait for send_mutation_done to complete, otherwise, if reply_to is busy, we will accumulate
-                    // lots of unsent responses, which can OOM our shard.
-                    //
-                    // Usually we will return immediately, since this work only involves appending data to the connection
-                    // send buffer.
-                    tracing::trace(trace_state_ptr, "Sending mutation_done to /{}", reply_to);
-                    return ms.send_mutation_done(netw::messaging_service::msg_addr{reply_to, shard}, shard, response_id).then_wrapped([] (future<> f) {
-                        f.ignore_ready_future();
-                    });
-                }).handle_exception([reply_to, shard, &p] (std::exception_ptr eptr) {
-                    seastar::log_level l = seastar::log_level::warn;
-                    try {
-                        std::rethrow_exception(eptr);
-                    } catch (timed_out_error&) {
-                        // ignore timeouts so that logs are not flooded.
-                        // database total_writes_timedout counter was incremented.
-                        l = seastar::log_level::debug;
-                    } catch (...) {
-                        // ignore
-                    }
-                    slogger.log(l, "Failed to apply mutation from {}#{}: {}", reply_to, shard, eptr);
-                }),
+                apply_and_reply(p, m, std::move(src_addr), reply_to, shard, response_id, trace_state_ptr, timeout),
                 parallel_for_each(forward.begin(), forward.end(), [reply_to, shard, response_id, &m, &p, trace_state_ptr, timeout] (gms::inet_address forward) {
                     auto& ms = netw::get_local_messaging_service();
                     tracing::trace(trace_state_ptr, "Forwarding a mutation to /{}", forward);
@@ -3726,6 +3827,28 @@ void storage_proxy::init_messaging_service() {
             });
         });
     });
+    ms.register_mutations([apply_and_reply] (const rpc::client_info& cinfo, rpc::opt_time_point t, std::vector<frozen_mutation> fms, std::vector<uint32_t> timeouts_in_ms,
+            gms::inet_address reply_to, unsigned shard, std::vector<storage_proxy::response_id_type> response_ids) {
+        auto src_addr = netw::messaging_service::get_source(cinfo);
+        if (timeouts_in_ms.size() != fms.size() || response_ids.size() != fms.size()) {
+            // The coordinator will time the writes out.
+            slogger.warn("Dropping malformed MUTATIONS message from {}#{}: {} mutations, {} timeouts, {} response ids",
+                    reply_to, shard, fms.size(), timeouts_in_ms.size(), response_ids.size());
+            return make_ready_future<rpc::no_wait_type>(netw::messaging_service::no_wait());
+        }
+        auto now = clock_type::now();
+        return do_with(std::move(fms), std::move(timeouts_in_ms), std::move(response_ids), get_local_shared_storage_proxy(),
+                [apply_and_reply, src_addr, reply_to, shard, now] (const std::vector<frozen_mutation>& fms, const std::vector<uint32_t>& timeouts_in_ms,
+                        const std::vector<storage_proxy::response_id_type>& response_ids, shared_ptr<storage_proxy>& p) {
+            p->_stats.received_mutations += fms.size();
+            return parallel_for_each(boost::irange<size_t>(0, fms.size()), [&, apply_and_reply, src_addr, reply_to, shard, now] (size_t i) {
+                auto timeout = now + std::chrono::milliseconds(timeouts_in_ms[i]);
+                return apply_and_reply(p, fms[i], src_addr, reply_to, shard, response_ids[i], tracing::trace_state_ptr(), timeout);
+            });
+        }).then([] {
+            return netw::messaging_service::no_wait();
+        });
+    });
     ms.register_mutation_done([] (const rpc::client_info& cinfo, unsigned shard, storage_proxy::response_id_type response_id) {
         auto& from = cinfo.retrieve_auxiliary<gms::inet_address>("baddr");
         return get_storage_proxy().invoke_on(shard, [from, response_id] (storage_proxy& sp) {
@@ -3839,6 +3962,7 @@ void storage_proxy::init_messaging_service() {
 void storage_proxy::uninit_messaging_service() {
     auto& ms = netw::get_local_messaging_service();
     ms.unregister_mutation();
+    ms.unregister_mutations();
     ms.unregister_mutation_done();
     ms.unregister_read_data();
     ms.unregister_read_mutation_data();
@@ -4023,6 +4147,7 @@ storage_proxy::query_mutations_locally(schema_ptr s, lw_shared_ptr<query::read_c
                                        tracing::trace_state_ptr trace_state, uint64_t max_size) {
     if (pr.is_singular()) {
         unsigned shard = _db.local().shard_of(pr.start()->value().token());
+        _stats.replica_cross_shard_ops += shard != engine().cpu_id();
         return _db.invoke_on(shard, [max_size, cmd, &pr, gs=global_schema_ptr(s), gt = tracing::global_trace_state_ptr(std::move(trace_state))] (database& db) mutable {
           return db.get_result_memory_limiter().new_mutation_read(max_size).then([&] (query::result_memory_accounter ma) {
             return db.query_mutations(gs, *cmd, pr, std::move(ma), gt).then([] (reconcilable_result&& result, cache_temperature ht) {
@@ -4182,6 +4307,8 @@ storage_proxy::query_nonsingular_mutations_locally(schema_ptr s, lw_shared_ptr<q
 
 future<>
 storage_proxy::stop() {
+    _write_coalescer.flush();
+    service::get_local_storage_service().unregister_subscriber(this);
     uninit_messaging_service();
     return make_ready_future<>();
 }
@@ -53,6 +53,9 @@
 #include "tracing/trace_state.hh"
 #include <seastar/core/metrics.hh>
 #include "frozen_mutation.hh"
+#include "service/write_coalescer.hh"
+#include "locator/dynamic_snitch.hh"
+#include "service/endpoint_lifecycle_subscriber.hh"
 
 namespace compat {
 
@@ -66,7 +69,7 @@ class abstract_write_response_handler;
 class abstract_read_executor;
 class mutation_holder;
 
-class storage_proxy : public seastar::async_sharded_service<storage_proxy> /*implements StorageProxyMBean*/ {
+class storage_proxy : public seastar::async_sharded_service<storage_proxy>, public endpoint_lifecycle_subscriber /*implements StorageProxyMBean*/ {
 public:
     using clock_type = lowres_clock;
 private:
@@ -164,6 +167,10 @@ class storage_proxy : public seastar::async_sharded_service<storage_proxy> /*imp
         uint64_t forwarded_mutations = 0;
         uint64_t forwarding_errors = 0;
 
+        // number of local writes and single partition reads which had to
+        // be executed on another shard than the one which received them
+        uint64_t replica_cross_shard_ops = 0;
+
         // number of read requests received as a replica
         uint64_t replica_data_reads = 0;
         uint64_t replica_digest_reads = 0;
@@ -223,6 +230,8 @@ class storage_proxy : public seastar::async_sharded_service<storage_proxy> /*imp
     std::default_random_engine _urandom;
     std::uniform_real_distribution<> _read_repair_chance = std::uniform_real_distribution<>(0,1);
     seastar::metrics::metric_groups _metrics;
+    write_coalescer _write_coalescer;
+    locator::dynamic_snitch _dynamic_snitch;
 private:
     void uninit_messaging_service();
     future<foreign_ptr<lw_shared_ptr<query::result>>> query_singular(lw_shared_ptr<query::read_command> cmd, dht::partition_range_vector&& partition_ranges, db::consistency_level cl, tracing::trace_state_ptr trace_state);
@@ -303,6 +312,12 @@ class storage_proxy : public seastar::async_sharded_service<storage_proxy> /*imp
 
     void init_messaging_service();
 
+    virtual void on_join_cluster(const gms::inet_address& endpoint) override {}
+    virtual void on_leave_cluster(const gms::inet_address& endpoint) override;
+    virtual void on_up(const gms::inet_address& endpoint) override {}
+    virtual void on_down(const gms::inet_address& endpoint) override {}
+    virtual void on_move(const gms::inet_address& endpoint) override {}
+
     // Applies mutation on this node.
     // Resolves with timed_out_error when timeout is reached.
     future<> mutate_locally(const mutation& m, clock_type::time_point timeout = clock_type::time_point::max());
@@ -90,6 +90,8 @@ static const sstring INDEXES_FEATURE = "INDEXES";
 static const sstring DIGEST_MULTIPARTITION_READ_FEATURE = "DIGEST_MULTIPARTITION_READ";
 static const sstring CORRECT_COUNTER_ORDER_FEATURE = "CORRECT_COUNTER_ORDER";
 static const sstring SCHEMA_TABLES_V3 = "SCHEMA_TABLES_V3";
+static const sstring WRITE_COALESCING_FEATURE = "WRITE_COALESCING";
+static const sstring BLOCKED_BLOOM_FILTER_FEATURE = "BLOCKED_BLOOM_FILTER";
 
 distributed<storage_service> _the_storage_service;
 
@@ -133,7 +135,9 @@ sstring storage_service::get_config_supported_features() {
         COUNTERS_FEATURE,
         DIGEST_MULTIPARTITION_READ_FEATURE,
         CORRECT_COUNTER_ORDER_FEATURE,
-        SCHEMA_TABLES_V3
+        SCHEMA_TABLES_V3,
+        WRITE_COALESCING_FEATURE,
+        BLOCKED_BLOOM_FILTER_FEATURE
     };
     if (service::get_local_storage_service()._db.local().get_config().experimental()) {
         features.push_back(MATERIALIZED_VIEWS_FEATURE);
@@ -344,6 +348,8 @@ void storage_service::register_features() {
     _digest_multipartition_read_feature = gms::feature(DIGEST_MULTIPARTITION_READ_FEATURE);
     _correct_counter_order_feature = gms::feature(CORRECT_COUNTER_ORDER_FEATURE);
     _schema_tables_v3 = gms::feature(SCHEMA_TABLES_V3);
+    _write_coalescing_feature = gms::feature(WRITE_COALESCING_FEATURE);
+    _blocked_bloom_filter_feature = gms::feature(BLOCKED_BLOOM_FILTER_FEATURE);
 
     if (_db.local().get_config().experimental()) {
         _materialized_views_feature = gms::feature(MATERIALIZED_VIEWS_FEATURE);
@@ -773,7 +779,7 @@ void storage_service::handle_state_normal(inet_address endpoint) {
     // a race where natural endpoint was updated to contain node A, but A was
     // not yet removed from pending endpoints
     _token_metadata.update_normal_tokens(tokens_to_update_in_metadata, endpoint);
-    do_update_pending_ranges();
+    do_update_pending_ranges(locator::can_yield::no);
 
     for (auto ep : endpoints_to_remove) {
         remove_endpoint(ep);
@@ -1367,6 +1373,9 @@ future<> storage_service::init_server(int delay) {
 
 // Serialized
 future<> storage_service::replicate_tm_only() {
+    // Copying token_metadata does not copy its contents: all shards end up
+    // sharing the version of shard 0, and the next change on shard 0 is
+    // made to a copy of it. See token_metadata.
     _shadow_token_metadata = _token_metadata;
 
     return get_storage_service().invoke_on_all([this](storage_service& local_ss){
@@ -3130,26 +3139,43 @@ std::chrono::milliseconds storage_service::get_ring_delay() {
     return std::chrono::milliseconds(ring_delay);
 }
 
-void storage_service::do_update_pending_ranges() {
+void storage_service::do_update_pending_ranges(locator::can_yield cy) {
     if (engine().cpu_id() != 0) {
         throw std::runtime_error("do_update_pending_ranges should be called on cpu zero");
     }
-    // long start = System.currentTimeMillis();
+    // A yielding calculation is serialized with other yielding ones. One that
+    // does not yield needs no units, and waiting for them could yield; a
+    // yielding calculation it races with drops its stale result.
+    stdx::optional<semaphore_units<>> units;
+    if (cy) {
+        units = get_units(_update_pending_ranges_sem, 1).get0();
+    }
+    auto start = std::chrono::steady_clock::now();
     auto keyspaces = _db.local().get_non_system_keyspaces();
     for (auto& keyspace_name : keyspaces) {
-        auto& ks = _db.local().find_keyspace(keyspace_name);
-        auto& strategy = ks.get_replication_strategy();
-        get_local_storage_service().get_token_metadata().calculate_pending_ranges(strategy, keyspace_name);
+        if (!_db.local().has_keyspace(keyspace_name)) {
+            continue;
+        }
+        // Work on a private copy of the strategy, since the keyspace may be
+        // altered or dropped while we yield.
+        auto ksm = _db.local().find_keyspace(keyspace_name).metadata();
+        auto strategy = locator::abstract_replication_strategy::create_replication_strategy(
+                keyspace_name, ksm->strategy_name(), _token_metadata, ksm->strategy_options());
+        _token_metadata.calculate_pending_ranges(*strategy, keyspace_name, cy);
     }
-    // slogger.debug("finished calculation for {} keyspaces in {}ms", keyspaces.size(), System.currentTimeMillis() - start);
+    slogger.debug("finished calculation for {} keyspaces in {}ms", keyspaces.size(),
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
 }
 
 future<> storage_service::update_pending_ranges() {
     return get_storage_service().invoke_on(0, [] (auto& ss){
         ss._update_jobs++;
-        ss.do_update_pending_ranges();
-        // calculate_pending_ranges will modify token_metadata, we need to repliate to other cores
-        return ss.replicate_to_all_cores().finally([&ss, ss0 = ss.shared_from_this()] {
+        return seastar::async([&ss] {
+            ss.do_update_pending_ranges(locator::can_yield::yes);
+        }).then([&ss] {
+            // calculate_pending_ranges will modify token_metadata, we need to repliate to other cores
+            return ss.replicate_to_all_cores();
+        }).finally([&ss, ss0 = ss.shared_from_this()] {
             ss._update_jobs--;
         });
     });
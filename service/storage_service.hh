@@ -114,6 +114,7 @@ class storage_service : public service::migration_listener, public gms::i_endpoi
 #endif
     distributed<database>& _db;
     int _update_jobs{0};
+    semaphore _update_pending_ranges_sem{1};
     // Note that this is obviously only valid for the current shard. Users of
     // this facility should elect a shard to be the coordinator based on any
     // given objective criteria
@@ -139,7 +140,10 @@ class storage_service : public service::migration_listener, public gms::i_endpoi
     void uninit_messaging_service();
 
 private:
-    void do_update_pending_ranges();
+    // Must be called from a seastar thread. With can_yield::no the pending
+    // ranges are updated without yielding, so that no other fiber can see
+    // the token metadata in between.
+    void do_update_pending_ranges(locator::can_yield cy);
 
 public:
     future<> keyspace_changed(const sstring& ks_name);
@@ -267,6 +271,8 @@ class storage_service : public service::migration_listener, public gms::i_endpoi
     gms::feature _digest_multipartition_read_feature;
     gms::feature _correct_counter_order_feature;
     gms::feature _schema_tables_v3;
+    gms::feature _write_coalescing_feature;
+    gms::feature _blocked_bloom_filter_feature;
 public:
     void enable_all_features() {
         _range_tombstones_feature.enable();
@@ -277,6 +283,8 @@ class storage_service : public service::migration_listener, public gms::i_endpoi
         _digest_multipartition_read_feature.enable();
         _correct_counter_order_feature.enable();
         _schema_tables_v3.enable();
+        _write_coalescing_feature.enable();
+        _blocked_bloom_filter_feature.enable();
     }
 
     void finish_bootstrapping() {
@@ -2241,6 +2249,14 @@ class storage_service : public service::migration_listener, public gms::i_endpoi
     const gms::feature& cluster_supports_schema_tables_v3() const {
         return _schema_tables_v3;
     }
+
+    bool cluster_supports_write_coalescing() const {
+        return bool(_write_coalescing_feature);
+    }
+
+    bool cluster_supports_blocked_bloom_filter() const {
+        return bool(_blocked_bloom_filter_feature);
+    }
 };
 
 inline future<> init_storage_service(distributed<database>& db) {
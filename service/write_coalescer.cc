@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2017 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <boost/range/algorithm/max_element.hpp>
+#include "write_coalescer.hh"
+#include "message/messaging_service.hh"
+#include "utils/fb_utilities.hh"
+
+namespace service {
+
+static future<> send_via_messaging_service(gms::inet_address ep, unsigned shard, write_coalescer::clock_type::time_point timeout,
+        std::vector<lw_shared_ptr<const frozen_mutation>> mutations, std::vector<uint32_t> timeouts_in_ms, std::vector<write_coalescer::response_id_type> response_ids) {
+    auto& ms = netw::get_local_messaging_service();
+    std::vector<std::reference_wrapper<const frozen_mutation>> fms;
+    fms.reserve(mutations.size());
+    for (auto& m : mutations) {
+        fms.emplace_back(*m);
+    }
+    return ms.send_mutations(netw::messaging_service::msg_addr{ep, shard}, timeout, std::move(fms), std::move(timeouts_in_ms),
+            utils::fb_utilities::get_broadcast_address(), engine().cpu_id(), std::move(response_ids)).finally([mutations = std::move(mutations)] { });
+}
+
+write_coalescer::write_coalescer(std::chrono::microseconds window, size_t max_bytes, send_func send)
+    : _window(window)
+    , _max_bytes(max_bytes)
+    , _send(send ? std::move(send) : send_func(send_via_messaging_service))
+    , _timer([this] { on_timer(); })
+{ }
+
+future<> write_coalescer::send(gms::inet_address ep, unsigned shard, lw_shared_ptr<const frozen_mutation> m, response_id_type response_id, clock_type::time_point timeout) {
+    auto dst = replica_shard(ep, shard);
+    auto it = _batches.find(dst);
+    if (it == _batches.end()) {
+        auto id = _next_batch_id++;
+        it = _batches.emplace(dst, std::make_unique<batch>(id)).first;
+        _deadlines.push_back(deadline{steady_clock_type::now() + _window, dst, id});
+        if (!_timer.armed()) {
+            _timer.arm(_deadlines.front().at);
+        }
+    }
+    auto& b = *it->second;
+    b.bytes += m->representation().size();
+    b.mutations.push_back(std::move(m));
+    b.timeouts.push_back(timeout);
+    b.response_ids.push_back(response_id);
+    auto f = b.sent.get_shared_future();
+    if (b.bytes >= _max_bytes) {
+        send_batch(it);
+    }
+    return f;
+}
+
+void write_coalescer::send_batch(batches_type::iterator it) {
+    auto dst = it->first;
+    auto b = std::move(it->second);
+    _batches.erase(it);
+
+    _stats.batches++;
+    _stats.writes += b->mutations.size();
+
+    // The replica gets the time left until each write times out; the
+    // message itself times out with the last of them.
+    auto now = clock_type::now();
+    std::vector<uint32_t> timeouts_in_ms;
+    timeouts_in_ms.reserve(b->timeouts.size());
+    for (auto t : b->timeouts) {
+        auto left = std::max(t - now, clock_type::duration::zero());
+        timeouts_in_ms.push_back(std::chrono::duration_cast<std::chrono::milliseconds>(left).count());
+    }
+    auto timeout = *boost::max_element(b->timeouts);
+
+    auto sending = futurize<void>::apply(_send, dst.first, dst.second, timeout, std::move(b->mutations), std::move(timeouts_in_ms), std::move(b->response_ids));
+    sending.then_wrapped([b = std::move(b)] (future<> f) {
+        if (f.failed()) {
+            b->sent.set_exception(f.get_exception());
+        } else {
+            b->sent.set_value();
+        }
+    });
+}
+
+void write_coalescer::on_timer() {
+    auto now = steady_clock_type::now();
+    while (!_deadlines.empty() && _deadlines.front().at <= now) {
+        auto& d = _deadlines.front();
+        auto it = _batches.find(d.dst);
+        if (it != _batches.end() && it->second->id == d.batch_id) {
+            send_batch(it);
+        }
+        _deadlines.pop_front();
+    }
+    if (!_deadlines.empty()) {
+        _timer.arm(_deadlines.front().at);
+    }
+}
+
+void write_coalescer::flush() {
+    _timer.cancel();
+    _deadlines.clear();
+    while (!_batches.empty()) {
+        send_batch(_batches.begin());
+    }
+}
+
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2017 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <map>
+#include <functional>
+#include "core/circular_buffer.hh"
+#include "core/shared_future.hh"
+#include "core/timer.hh"
+#include "gms/inet_address.hh"
+#include "frozen_mutation.hh"
+
+namespace service {
+
+struct write_coalescer_stats {
+    uint64_t writes = 0;  // writes sent in MUTATIONS messages
+    uint64_t batches = 0; // MUTATIONS messages sent
+};
+
+// Packs small writes to the same replica shard, issued within a short
+// window, into one MUTATIONS message, to save the per-message cost of
+// sending them one by one. Each write keeps its own response id, and so its
+// own response handler on the coordinator, and its own timeout, which the
+// replica applies the write with.
+class write_coalescer {
+public:
+    using clock_type = lowres_clock;
+    using response_id_type = uint64_t;
+    // Sends one MUTATIONS message to the given shard of a replica.
+    using send_func = std::function<future<> (gms::inet_address ep, unsigned shard, clock_type::time_point timeout, std::vector<lw_shared_ptr<const frozen_mutation>> mutations,
+            std::vector<uint32_t> timeouts_in_ms, std::vector<response_id_type> response_ids)>;
+private:
+    using replica_shard = std::pair<gms::inet_address, unsigned>;
+    struct batch {
+        uint64_t id;
+        std::vector<lw_shared_ptr<const frozen_mutation>> mutations;
+        std::vector<clock_type::time_point> timeouts;
+        std::vector<response_id_type> response_ids;
+        size_t bytes = 0;
+        shared_promise<> sent;
+        explicit batch(uint64_t id_) : id(id_) {}
+    };
+    using batches_type = std::map<replica_shard, std::unique_ptr<batch>>;
+    struct deadline {
+        steady_clock_type::time_point at;
+        replica_shard dst;
+        uint64_t batch_id;
+    };
+
+    std::chrono::microseconds _window;
+    size_t _max_bytes;
+    send_func _send;
+    batches_type _batches;
+    // In the order the batches were opened, which is also the order their
+    // windows end. Batches sent early, for reaching the size limit, leave
+    // their entries behind.
+    circular_buffer<deadline> _deadlines;
+    timer<> _timer;
+    uint64_t _next_batch_id = 0;
+    write_coalescer_stats _stats;
+private:
+    void send_batch(batches_type::iterator it);
+    void on_timer();
+public:
+    // A write waits at most window for others to join it. A batch is sent
+    // as soon as it reaches max_bytes. A zero window disables coalescing.
+    // Batches go through the messaging service unless send is given.
+    write_coalescer(std::chrono::microseconds window, size_t max_bytes, send_func send = {});
+    write_coalescer(const write_coalescer&) = delete;
+    write_coalescer(write_coalescer&&) = delete;
+
+    // Whether a write of the given size should be coalesced. Writes which
+    // are big enough to be sent alone are not.
+    bool accepts(size_t size) const {
+        return _window.count() && size < _max_bytes;
+    }
+
+    // Sends m to the given shard of ep, together with other writes to it.
+    // Resolves when the message carrying m has been sent. m is shared with
+    // the batch rather than copied into it, as the same mutation usually
+    // goes to several replicas.
+    future<> send(gms::inet_address ep, unsigned shard, lw_shared_ptr<const frozen_mutation> m, response_id_type response_id, clock_type::time_point timeout);
+
+    // Sends all pending batches without waiting for their windows to end.
+    void flush();
+
+    const write_coalescer_stats& stats() const {
+        return _stats;
+    }
+};
+
+}
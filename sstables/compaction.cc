@@ -158,14 +158,21 @@ class compaction {
     std::vector<unsigned long> _ancestors;
     db::replay_position _rp;
     seastar::thread_scheduling_group* _tsg;
+    // Token range to which this compaction is restricted.
+    dht::token_range _range;
+    dht::partition_range _partition_range;
 protected:
-    compaction(column_family& cf, std::vector<shared_sstable> sstables, uint64_t max_sstable_size, uint32_t sstable_level, seastar::thread_scheduling_group* tsg)
+    compaction(column_family& cf, std::vector<shared_sstable> sstables, uint64_t max_sstable_size, uint32_t sstable_level, seastar::thread_scheduling_group* tsg,
+            dht::token_range range = dht::token_range::make_open_ended_both_sides(), utils::UUID run_id = utils::make_random_uuid())
         : _cf(cf)
         , _sstables(std::move(sstables))
         , _max_sstable_size(max_sstable_size)
         , _sstable_level(sstable_level)
         , _tsg(tsg)
+        , _range(std::move(range))
+        , _partition_range(dht::to_partition_range(_range))
     {
+        _info->run_id = run_id;
         _cf.get_compaction_manager().register_compaction(_info);
     }
 
@@ -216,12 +223,23 @@ class compaction {
             // FIXME: If the sstables have cardinality estimation bitmaps, use that
             // for a better estimate for the number of partitions in the merged
             // sstable than just adding up the lengths of individual sstables.
-            _estimated_partitions += sst->get_estimated_key_count();
-            _info->total_partitions += sst->get_estimated_key_count();
+            auto keys = sst->get_estimated_key_count();
+            auto bytes = sst->data_size();
+            auto bytes_on_disk = sst->bytes_on_disk();
+            // Only the part of the sstable which falls in the range is read.
+            if (!_range.is_full() && keys) {
+                auto keys_in_range = std::min(sst->estimated_keys_for_range(_range), keys);
+                bytes = bytes * keys_in_range / keys;
+                bytes_on_disk = bytes_on_disk * keys_in_range / keys;
+                keys = keys_in_range;
+            }
+            _estimated_partitions += keys;
+            _info->total_partitions += keys;
+            _info->progress.add_input(bytes, keys);
             // Compacted sstable keeps track of its ancestors.
             _ancestors.push_back(sst->generation());
             formatted_msg += sprint("%s:level=%d, ", sst->get_filename(), sst->get_sstable_level());
-            _info->start_size += sst->bytes_on_disk();
+            _info->start_size += bytes_on_disk;
             // TODO:
             // Note that this is not fully correct. Since we might be merging sstables that originated on
             // another shard (#cpu changed), we might be comparing RP:s with differing shard ids,
@@ -232,6 +250,9 @@ class compaction {
             _rp = std::max(_rp, sst->get_stats_metadata().position);
         }
         formatted_msg += "]";
+        if (!_range.is_full()) {
+            formatted_msg += sprint(" in range %s", _range);
+        }
         _info->sstables = _sstables.size();
         _info->ks = schema->ks_name();
         _info->cf = schema->cf_name();
@@ -239,7 +260,7 @@ class compaction {
 
         return ::make_range_sstable_reader(_cf.schema(),
                 ssts,
-                query::full_partition_range,
+                _partition_range,
                 _cf.schema()->full_slice(),
                 service::get_local_compaction_priority(),
                 no_resource_tracking(),
@@ -249,6 +270,7 @@ class compaction {
     }
 
     compaction_info finish(std::chrono::time_point<db_clock> started_at, std::chrono::time_point<db_clock> ended_at) {
+        _info->progress.on_finished();
         _info->ended_at = std::chrono::duration_cast<std::chrono::milliseconds>(ended_at.time_since_epoch()).count();
         auto ratio = double(_info->end_size) / double(_info->start_size);
         auto duration = std::chrono::duration<float>(ended_at - started_at);
@@ -345,8 +367,8 @@ class regular_compaction : public compaction {
     stdx::optional<sstable_writer> _writer;
 public:
     regular_compaction(column_family& cf, std::vector<shared_sstable> sstables, std::function<shared_sstable()> creator,
-            uint64_t max_sstable_size, uint32_t sstable_level, seastar::thread_scheduling_group* tsg)
-        : compaction(cf, std::move(sstables), max_sstable_size, sstable_level, tsg)
+            uint64_t max_sstable_size, uint32_t sstable_level, seastar::thread_scheduling_group* tsg, dht::token_range range, utils::UUID run_id)
+        : compaction(cf, std::move(sstables), max_sstable_size, sstable_level, tsg, std::move(range), run_id)
         , _creator(std::move(creator))
         , _set(cf.get_sstable_set())
         , _selector(_set.make_incremental_selector())
@@ -401,8 +423,8 @@ class regular_compaction : public compaction {
 class cleanup_compaction final : public regular_compaction {
 public:
     cleanup_compaction(column_family& cf, std::vector<shared_sstable> sstables, std::function<shared_sstable()> creator,
-            uint64_t max_sstable_size, uint32_t sstable_level, seastar::thread_scheduling_group* tsg)
-        : regular_compaction(cf, std::move(sstables), std::move(creator), max_sstable_size, sstable_level, tsg)
+            uint64_t max_sstable_size, uint32_t sstable_level, seastar::thread_scheduling_group* tsg, dht::token_range range, utils::UUID run_id)
+        : regular_compaction(cf, std::move(sstables), std::move(creator), max_sstable_size, sstable_level, tsg, std::move(range), run_id)
     {
         _info->type = compaction_type::Cleanup;
     }
@@ -498,7 +520,11 @@ future<compaction_info> compaction::run(std::unique_ptr<compaction> c) {
 
         auto start_time = db_clock::now();
         try {
-            consume_flattened_in_thread(reader, cfc, c->filter_func());
+            auto filter = [&progress = c->_info->progress, filter = c->filter_func()] (const streamed_mutation& sm) {
+                progress.on_partition_read();
+                return filter(sm);
+            };
+            consume_flattened_in_thread(reader, cfc, std::move(filter));
         } catch (...) {
             delete_sstables_for_interrupted_compaction(c->_info->new_sstables, c->_info->ks, c->_info->cf);
             c = nullptr; // make sure writers are stopped while running in thread context
@@ -520,11 +546,12 @@ static std::unique_ptr<compaction> make_compaction(bool cleanup, Params&&... par
 
 future<compaction_info>
 compact_sstables(std::vector<shared_sstable> sstables, column_family& cf, std::function<shared_sstable()> creator,
-        uint64_t max_sstable_size, uint32_t sstable_level, bool cleanup, seastar::thread_scheduling_group *tsg) {
+        uint64_t max_sstable_size, uint32_t sstable_level, bool cleanup, seastar::thread_scheduling_group *tsg, dht::token_range range,
+        utils::UUID run_id) {
     if (sstables.empty()) {
         throw std::runtime_error(sprint("Called compaction with empty set on behalf of {}.{}", cf.schema()->ks_name(), cf.schema()->cf_name()));
     }
-    auto c = make_compaction(cleanup, cf, std::move(sstables), std::move(creator), max_sstable_size, sstable_level, tsg);
+    auto c = make_compaction(cleanup, cf, std::move(sstables), std::move(creator), max_sstable_size, sstable_level, tsg, std::move(range), run_id);
     return compaction::run(std::move(c));
 }
 
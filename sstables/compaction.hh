@@ -24,6 +24,9 @@
 
 #include "database_fwd.hh"
 #include "shared_sstable.hh"
+#include "progress_monitor.hh"
+#include "dht/i_partitioner.hh"
+#include "utils/UUID.hh"
 #include <seastar/core/thread.hh>
 #include <functional>
 
@@ -36,6 +39,11 @@ namespace sstables {
         int level;
         // Threshold size for sstable(s) to be created.
         uint64_t max_sstable_bytes;
+        // Whether the compaction may be split into token range sub-jobs, which
+        // run concurrently and write their own sstables. Only worth it for
+        // compactions which rewrite all of a table, like major compaction and
+        // cleanup.
+        bool split_by_token_range = false;
 
         compaction_descriptor() = default;
 
@@ -92,6 +100,10 @@ namespace sstables {
         int64_t ended_at;
         std::vector<shared_sstable> new_sstables;
         sstring stop_requested;
+        progress_monitor progress;
+        // Shared by the token range sub-jobs of a compaction, which are
+        // reported as a single one.
+        utils::UUID run_id;
 
         bool is_stop_requested() const {
             return stop_requested.size() > 0;
@@ -113,10 +125,14 @@ namespace sstables {
     // If cleanup is true, mutation that doesn't belong to current node will be
     // cleaned up, log messages will inform the user that compact_sstables runs for
     // cleaning operation, and compaction history will not be updated.
+    // Only partitions whose token falls in range are compacted, the others
+    // are left for other compactions of the same sstables.
     future<compaction_info> compact_sstables(std::vector<shared_sstable> sstables,
             column_family& cf, std::function<shared_sstable()> creator,
             uint64_t max_sstable_size, uint32_t sstable_level, bool cleanup = false,
-            seastar::thread_scheduling_group* tsg = nullptr);
+            seastar::thread_scheduling_group* tsg = nullptr,
+            dht::token_range range = dht::token_range::make_open_ended_both_sides(),
+            utils::UUID run_id = utils::make_random_uuid());
 
     // Compacts a set of N shared sstables into M sstables. For every shard involved,
     // i.e. which owns any of the sstables, a new unshared sstable is created.
@@ -129,6 +145,10 @@ namespace sstables {
     std::vector<sstables::shared_sstable>
     size_tiered_most_interesting_bucket(const std::vector<sstables::shared_sstable>& candidates);
 
+    // Return the number of bytes size-tiered compaction, merging fan_in
+    // sstables at a time, has to write to compact sstables into a single one.
+    uint64_t size_tiered_backlog(const std::vector<sstables::shared_sstable>& sstables, int fan_in);
+
     // Return list of expired sstables for column family cf.
     // A sstable is fully expired *iff* its max_local_deletion_time precedes gc_before and its
     // max timestamp is lower than any other relevant sstable.
@@ -296,7 +296,9 @@ future<> compaction_manager::submit_major_compaction(column_family* cf) {
             auto sstables = get_candidates(*cf);
             auto compacting = compacting_sstable_registration(this, sstables);
 
-            return cf->compact_sstables(sstables::compaction_descriptor(std::move(sstables))).then([compacting = std::move(compacting)] {});
+            auto descriptor = sstables::compaction_descriptor(std::move(sstables));
+            descriptor.split_by_token_range = true;
+            return cf->compact_sstables(std::move(descriptor)).then([compacting = std::move(compacting)] {});
         });
     }).then_wrapped([this, task] (future<> f) {
         _stats.active_tasks--;
@@ -374,6 +376,9 @@ void compaction_manager::register_metrics() {
     _metrics.add_group("compaction_manager", {
         sm::make_gauge("compactions", [this] { return _stats.active_tasks; },
                        sm::description("Holds the number of currently active compactions.")),
+
+        sm::make_gauge("backlog", [this] { return backlog(); },
+                       sm::description("Holds the number of bytes compaction has yet to write, as estimated by the compaction strategies.")),
     });
 }
 
@@ -383,6 +388,15 @@ void compaction_manager::start() {
     _compaction_submission_timer.arm(periodic_compaction_submission_interval());
 }
 
+uint64_t compaction_manager::backlog() const {
+    uint64_t backlog = 0;
+    for (auto& e : _compaction_locks) {
+        auto* cf = e.first;
+        backlog += cf->get_compaction_strategy().estimated_backlog_bytes(*cf);
+    }
+    return backlog;
+}
+
 std::function<void()> compaction_manager::compaction_submission_callback() {
     return [this] () mutable {
         for (auto& e: _compaction_locks) {
@@ -142,6 +142,10 @@ class compaction_manager {
     // Submit a column family to be compacted.
     void submit(column_family* cf);
 
+    // Returns the number of bytes compaction has yet to write for the column
+    // families known to the manager, as estimated by their strategies.
+    uint64_t backlog() const;
+
     // Submit a column family to be cleaned up and wait for its termination.
     future<> perform_cleanup(column_family* cf);
 
@@ -39,6 +39,7 @@
 
 #include <vector>
 #include <chrono>
+#include <cmath>
 
 #include "sstables.hh"
 #include "compaction.hh"
@@ -48,7 +49,7 @@
 #include "schema.hh"
 #include "sstable_set.hh"
 #include "compatible_ring_position.hh"
-#include <boost/range/algorithm/find.hpp>
+#include <boost/range/algorithm/find_if.hpp>
 #include <boost/range/adaptors.hpp>
 #include <boost/icl/interval_map.hpp>
 #include <boost/algorithm/cxx11/any_of.hpp>
@@ -149,42 +150,6 @@ sstable_set::make_incremental_selector() const {
     return incremental_selector(_impl->make_incremental_selector());
 }
 
-// default sstable_set, not specialized for anything
-class bag_sstable_set : public sstable_set_impl {
-    // erasing is slow, but select() is fast
-    std::vector<shared_sstable> _sstables;
-public:
-    virtual std::unique_ptr<sstable_set_impl> clone() const override {
-        return std::make_unique<bag_sstable_set>(*this);
-    }
-    virtual std::vector<shared_sstable> select(const dht::partition_range& range = query::full_partition_range) const override {
-        return _sstables;
-    }
-    virtual void insert(shared_sstable sst) override {
-        _sstables.push_back(std::move(sst));
-    }
-    virtual void erase(shared_sstable sst) override {
-        _sstables.erase(boost::find(_sstables, sst));
-    }
-    virtual std::unique_ptr<incremental_selector_impl> make_incremental_selector() const override;
-    class incremental_selector;
-};
-
-class bag_sstable_set::incremental_selector : public incremental_selector_impl {
-    const std::vector<shared_sstable>& _sstables;
-public:
-    incremental_selector(const std::vector<shared_sstable>& sstables)
-        : _sstables(sstables) {
-    }
-    virtual std::tuple<dht::token_range, std::vector<shared_sstable>, dht::token> select(const dht::token& token) override {
-        return std::make_tuple(dht::token_range::make_open_ended_both_sides(), _sstables, dht::maximum_token());
-    }
-};
-
-std::unique_ptr<incremental_selector_impl> bag_sstable_set::make_incremental_selector() const {
-    return std::make_unique<incremental_selector>(_sstables);
-}
-
 // specialized when sstables are partitioned in the token range space
 // e.g. leveled compaction strategy
 class partitioned_sstable_set : public sstable_set_impl {
@@ -328,8 +293,184 @@ std::unique_ptr<incremental_selector_impl> partitioned_sstable_set::make_increme
     return std::make_unique<incremental_selector>(_schema, _unleveled_sstables, _leveled_sstables);
 }
 
+// specialized for sstables which overlap arbitrarily in the token range
+// space, e.g. size-tiered and time-window compaction strategies. The
+// sstables are kept in an interval tree keyed by their token ranges, so
+// that only the ones which overlap a range, or a token, are selected.
+class interval_sstable_set : public sstable_set_impl {
+    struct entry {
+        dht::token first;
+        dht::token last;
+        shared_sstable sst;
+    };
+    // Sorted by first token, forming an implicit balanced search tree: the
+    // root of the subtree covering [lo, hi) is at lo + (hi - lo) / 2, and
+    // _max_last holds the largest last token found in each subtree.
+    std::vector<entry> _entries;
+    mutable std::vector<dht::token> _max_last;
+    // Inserts and erases keep _entries sorted, and leave rebuilding
+    // _max_last, which is linear, to the next query.
+    mutable bool _max_last_valid = true;
+private:
+    const dht::token& build(size_t lo, size_t hi) const {
+        static const dht::token min = dht::minimum_token();
+        if (lo >= hi) {
+            return min;
+        }
+        auto mid = lo + (hi - lo) / 2;
+        auto& left = build(lo, mid);
+        auto& right = build(mid + 1, hi);
+        _max_last[mid] = std::max({_entries[mid].last, left, right});
+        return _max_last[mid];
+    }
+    void ensure_built() const {
+        if (!_max_last_valid) {
+            _max_last.resize(_entries.size());
+            build(0, _entries.size());
+            _max_last_valid = true;
+        }
+    }
+    template <typename Func>
+    void visit(size_t lo, size_t hi, const dht::token& start, const dht::token& end, Func&& func) const {
+        while (lo < hi) {
+            auto mid = lo + (hi - lo) / 2;
+            if (_max_last[mid] < start) {
+                return;
+            }
+            visit(lo, mid, start, end, func);
+            if (end < _entries[mid].first) {
+                return;
+            }
+            if (!(_entries[mid].last < start)) {
+                func(_entries[mid]);
+            }
+            lo = mid + 1;
+        }
+    }
+    auto first_after(const dht::token& t) const {
+        return std::upper_bound(_entries.begin(), _entries.end(), t, [] (const dht::token& t, const entry& e) {
+            return t < e.first;
+        });
+    }
+public:
+    // Calls func for every sstable which overlaps [start, end], in first token order.
+    template <typename Func>
+    void for_each_overlapping(const dht::token& start, const dht::token& end, Func&& func) const {
+        ensure_built();
+        visit(0, _entries.size(), start, end, func);
+    }
+    virtual std::unique_ptr<sstable_set_impl> clone() const override {
+        return std::make_unique<interval_sstable_set>(*this);
+    }
+    virtual std::vector<shared_sstable> select(const dht::partition_range& range) const override {
+        auto start = range.start() ? range.start()->value().token() : dht::minimum_token();
+        auto end = range.end() ? range.end()->value().token() : dht::maximum_token();
+        std::vector<shared_sstable> r;
+        for_each_overlapping(start, end, [&r] (const entry& e) {
+            r.push_back(e.sst);
+        });
+        return r;
+    }
+    virtual void insert(shared_sstable sst) override {
+        auto first = sst->get_first_decorated_key().token();
+        auto last = sst->get_last_decorated_key().token();
+        auto it = first_after(first);
+        _entries.insert(it, entry{std::move(first), std::move(last), std::move(sst)});
+        _max_last_valid = false;
+    }
+    virtual void erase(shared_sstable sst) override {
+        // _entries is sorted by first token, so only the entries which share
+        // the sstable's first token need to be looked at.
+        auto first = sst->get_first_decorated_key().token();
+        auto begin = std::partition_point(_entries.begin(), _entries.end(), [&first] (const entry& e) {
+            return e.first < first;
+        });
+        auto it = std::find_if(begin, first_after(first), [&sst] (const entry& e) { return e.sst == sst; });
+        if (it != _entries.end() && it->sst == sst) {
+            _entries.erase(it);
+            _max_last_valid = false;
+        }
+    }
+    virtual std::unique_ptr<incremental_selector_impl> make_incremental_selector() const override;
+    class incremental_selector;
+};
+
+class interval_sstable_set::incremental_selector : public incremental_selector_impl {
+    const interval_sstable_set& _set;
+    stdx::optional<dht::token> _last_token;
+public:
+    explicit incremental_selector(const interval_sstable_set& set)
+        : _set(set) {
+    }
+    virtual std::tuple<dht::token_range, std::vector<shared_sstable>, dht::token> select(const dht::token& token) override {
+        std::vector<shared_sstable> ssts;
+        stdx::optional<dht::token> min_last;
+        _set.for_each_overlapping(token, token, [&] (const entry& e) {
+            ssts.push_back(e.sst);
+            if (!min_last || e.last < *min_last) {
+                min_last = e.last;
+            }
+        });
+        // Callers move forward, and may jump over sstables which start and
+        // end between two consecutive tokens. Those are selected too, so
+        // that a reader does not miss them; the other users only get a
+        // more conservative answer.
+        if (_last_token && *_last_token < token) {
+            auto skipped_end = _set.first_after(token);
+            for (auto it = _set.first_after(*_last_token); it != skipped_end; ++it) {
+                if (it->last < token) {
+                    ssts.push_back(it->sst);
+                }
+            }
+        }
+        _last_token = token;
+        // The selection changes when the next sstable starts, or when one of
+        // the selected ones ends, whichever comes first. Only the former can
+        // bring in new sstables.
+        auto next = _set.first_after(token);
+        auto next_token = next == _set._entries.end() ? dht::maximum_token() : next->first;
+        auto range = [&] {
+            if (min_last && (next_token.is_maximum() || *min_last < next_token)) {
+                return dht::token_range::make({token, true}, {*min_last, true});
+            }
+            if (next_token.is_maximum()) {
+                return dht::token_range::make_starting_with({token, true});
+            }
+            return dht::token_range::make({token, true}, {next_token, false});
+        }();
+        return std::make_tuple(std::move(range), std::move(ssts), std::move(next_token));
+    }
+};
+
+std::unique_ptr<incremental_selector_impl> interval_sstable_set::make_incremental_selector() const {
+    return std::make_unique<incremental_selector>(*this);
+}
+
+// Every byte of an sstable is rewritten once per tier it has yet to climb
+// before all data ends up in a single sstable, and climbing a tier
+// multiplies the sstable size by fan_in.
+uint64_t size_tiered_backlog(const std::vector<shared_sstable>& sstables, int fan_in) {
+    uint64_t total = 0;
+    for (auto& sst : sstables) {
+        total += sst->data_size();
+    }
+    double backlog = 0;
+    for (auto& sst : sstables) {
+        auto size = sst->data_size();
+        if (size) {
+            backlog += size * std::log(double(total) / size) / std::log(std::max(fan_in, 2));
+        }
+    }
+    return backlog;
+}
+
+uint64_t compaction_strategy_impl::estimated_backlog_bytes(column_family& cf) const {
+    std::vector<shared_sstable> sstables(cf.get_sstables()->begin(), cf.get_sstables()->end());
+    return size_tiered_backlog(sstables, cf.schema()->min_compaction_threshold());
+}
+
 std::unique_ptr<sstable_set_impl> compaction_strategy_impl::make_sstable_set(schema_ptr schema) const {
-    return std::make_unique<bag_sstable_set>();
+    return std::make_unique<interval_sstable_set>();
 }
 
 std::unique_ptr<sstable_set_impl> leveled_compaction_strategy::make_sstable_set(schema_ptr schema) const {
@@ -363,6 +504,10 @@ class null_compaction_strategy : public compaction_strategy_impl {
         return 0;
     }
 
+    virtual uint64_t estimated_backlog_bytes(column_family& cf) const override {
+        return 0;
+    }
+
     virtual compaction_strategy_type type() const {
         return compaction_strategy_type::null;
     }
@@ -435,10 +580,18 @@ int64_t compaction_strategy::estimated_pending_compactions(column_family& cf) co
     return _compaction_strategy_impl->estimated_pending_compactions(cf);
 }
 
+uint64_t compaction_strategy::estimated_backlog_bytes(column_family& cf) const {
+    return _compaction_strategy_impl->estimated_backlog_bytes(cf);
+}
+
 bool compaction_strategy::use_clustering_key_filter() const {
     return _compaction_strategy_impl->use_clustering_key_filter();
 }
 
+bool compaction_strategy::use_time_ordered_reads() const {
+    return _compaction_strategy_impl->use_time_ordered_reads();
+}
+
 sstable_set
 compaction_strategy::make_sstable_set(schema_ptr schema) const {
     return sstable_set(
@@ -36,6 +36,7 @@ class compaction_strategy_impl {
     const sstring TOMBSTONE_COMPACTION_INTERVAL_OPTION = "tombstone_compaction_interval";
 
     bool _use_clustering_key_filter = false;
+    bool _use_time_ordered_reads = false;
     bool _disable_tombstone_compaction = false;
     float _tombstone_threshold = DEFAULT_TOMBSTONE_THRESHOLD;
     db_clock::duration _tombstone_compaction_interval = DEFAULT_TOMBSTONE_COMPACTION_INTERVAL();
@@ -71,12 +72,19 @@ class compaction_strategy_impl {
         return true;
     }
     virtual int64_t estimated_pending_compactions(column_family& cf) const = 0;
+    // By default, sstables are assumed to be compacted in tiers of fan_in
+    // similarly-sized sstables, as size-tiered compaction does.
+    virtual uint64_t estimated_backlog_bytes(column_family& cf) const;
     virtual std::unique_ptr<sstable_set_impl> make_sstable_set(schema_ptr schema) const;
 
     bool use_clustering_key_filter() const {
         return _use_clustering_key_filter;
     }
 
+    bool use_time_ordered_reads() const {
+        return _use_time_ordered_reads;
+    }
+
     // Check if a given sstable is entitled for tombstone compaction based on its
     // droppable tombstone histogram and gc_before.
     bool worth_dropping_tombstones(const shared_sstable& sst, gc_clock::time_point gc_before) {
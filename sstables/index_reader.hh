@@ -44,6 +44,39 @@ class index_consumer {
     }
 };
 
+// Less comparator of positions with the starts of promoted index blocks,
+// giving the order of position_in_partition::composite_less_compare.
+// If the promoted index has encoded block starts, the comparisons are done on
+// the byte-comparable encodings, and make_key() encodes the position once per
+// lookup.
+class promoted_index_block_compare {
+    const promoted_index& _pi;
+    const byte_comparable_encoder* _encoder;
+    position_in_partition::composite_less_compare _cmp;
+public:
+    struct key {
+        position_in_partition_view pos;
+        bytes encoded;
+    };
+
+    promoted_index_block_compare(const schema& s, const promoted_index& pi, const byte_comparable_encoder* encoder)
+        : _pi(pi)
+        , _encoder(pi.has_encoded_starts ? encoder : nullptr)
+        , _cmp(s)
+    { }
+
+    key make_key(position_in_partition_view pos) const {
+        return key{pos, _encoder ? _encoder->encode(pos) : bytes()};
+    }
+
+    bool operator()(const key& k, const promoted_index::entry& e) const {
+        if (_encoder) {
+            return byte_comparable_encoder::compare(k.encoded, _pi.encoded_start(e)) < 0;
+        }
+        return _cmp(k.pos, e.start);
+    }
+};
+
 // IndexConsumer is a concept that implements:
 //
 // bool should_continue();
@@ -202,7 +235,26 @@ class index_reader {
     uint64_t _current_pi_idx = 0; // Points to upper bound of the cursor.
     uint64_t _data_file_position = 0;
     indexable_element _element = indexable_element::partition;
+    // Engaged when _current_list holds a run of entries found through the
+    // partition index model rather than a summary page: the ordinal of the
+    // entry following the run.
+    stdx::optional<uint64_t> _model_run_end;
 private:
+    future<index_list> read_entries(uint64_t begin, uint64_t end, uint64_t quantity) {
+        return close_reader().then_wrapped([this, begin, end, quantity] (auto&& f) {
+            try {
+                f.get();
+                _reader.emplace(_sstable, _pc, begin, end, quantity);
+            } catch (...) {
+                _reader = stdx::nullopt;
+                throw;
+            }
+            return _reader->_context.consume_input(_reader->_context).then([this] {
+                return std::move(_reader->_consumer.indexes);
+            });
+        });
+    }
+
     future<> advance_to_end() {
         sstlog.trace("index {}: advance_to_end()", this);
         _data_file_position = data_file_end();
@@ -241,18 +293,7 @@ class index_reader {
                 end = summary.entries[summary_idx + 1].position;
             }
 
-            return close_reader().then_wrapped([this, position, end, quantity, summary_idx] (auto&& f) {
-                try {
-                    f.get();
-                    _reader.emplace(_sstable, _pc, position, end, quantity);
-                } catch (...) {
-                    _reader = stdx::nullopt;
-                    throw;
-                }
-                return _reader->_context.consume_input(_reader->_context).then([this] {
-                    return std::move(_reader->_consumer.indexes);
-                });
-            });
+            return read_entries(position, end, quantity);
         };
 
         return _sstable->_index_lists.get_or_load(summary_idx, loader).then([this, summary_idx] (shared_index_lists::list_ptr ref) {
@@ -275,6 +316,78 @@ class index_reader {
             }
         });
     }
+
+    // Positions the cursor on the first entry of a run given by the
+    // partition index model. Runs are shared like pages are.
+    future<> advance_to_run(const partition_index_model::entry_range& r) {
+        sstlog.trace("index {}: advance_to_run({}, {})", this, r.first, r.count);
+        auto loader = [this, r] (uint64_t) {
+            return read_entries(r.begin, r.end, r.count);
+        };
+        return _sstable->_index_model_runs.get_or_load(r.first << 16 | r.count, loader).then([this, r] (shared_index_lists::list_ptr ref) {
+            _prev_list = std::move(_current_list);
+            _current_list = std::move(ref);
+            _model_run_end = r.first + _current_list->size();
+            _current_index_idx = 0;
+            _current_pi_idx = 0;
+            assert(!_current_list->empty());
+            _data_file_position = (*_current_list)[0].position();
+            _element = indexable_element::partition;
+        });
+    }
+
+    // Drops a run given by the partition index model, leaving the cursor as
+    // it was when the index_reader was created.
+    void leave_run() {
+        sstlog.trace("index {}: leave_run()", this);
+        _model_run_end = stdx::nullopt;
+        _prev_list = std::move(_current_list);
+        _previous_summary_idx = 0;
+        _current_summary_idx = 0;
+        _current_index_idx = 0;
+        _current_pi_idx = 0;
+        _data_file_position = 0;
+        _element = indexable_element::partition;
+    }
+
+    future<bool> check_if_present(dht::ring_position_view key) {
+        if (eof()) {
+            return make_ready_future<bool>(false);
+        }
+        return read_partition_data().then([this, key] {
+            index_comparator cmp(*_sstable->_schema);
+            return cmp(key, current_partition_entry()) == 0;
+        });
+    }
+
+    // Finds key in the run of entries the partition index model predicts.
+    // The run is trusted only if it brackets the key, otherwise we go
+    // through the summary.
+    future<bool> advance_with_model(const partition_index_model& model, uint64_t model_key, dht::ring_position_view key) {
+        return advance_to_run(model.lookup(model_key)).then([this, &model, key] {
+            index_list& il = *_current_list;
+            index_comparator cmp(*_sstable->_schema);
+            auto i = std::lower_bound(il.begin(), il.end(), key, cmp);
+            auto run_first = *_model_run_end - il.size();
+            if ((i == il.begin() && run_first != 0) || (i == il.end() && *_model_run_end != model.entries())) {
+                sstlog.trace("index {}: key outside of the modelled run", this);
+                leave_run();
+                return advance_to(key).then([this, key] {
+                    return check_if_present(key);
+                });
+            }
+            if (i == il.end()) {
+                sstlog.trace("index {}: not found", this);
+                return advance_to_end().then([] {
+                    return false;
+                });
+            }
+            _current_index_idx = std::distance(il.begin(), i);
+            _data_file_position = i->position();
+            sstlog.trace("index {}: modelled run index = {}, pos={}", this, _current_index_idx, _data_file_position);
+            return make_ready_future<bool>(!cmp(key, *i));
+        });
+    }
 public:
     future<> advance_to_start(const dht::partition_range& range) {
         if (range.start()) {
@@ -310,6 +423,7 @@ class index_reader {
         , _current_pi_idx(r._current_pi_idx)
         , _data_file_position(r._data_file_position)
         , _element(r._element)
+        , _model_run_end(r._model_run_end)
     {
         sstlog.trace("index {}: index_reader for {}", this, _sstable->get_filename());
     }
@@ -387,7 +501,7 @@ class index_reader {
         index_entry& e = current_partition_entry();
         promoted_index* pi = nullptr;
         try {
-            pi = e.get_promoted_index(s);
+            pi = e.get_promoted_index(s, _sstable->get_promoted_index_encoder());
         } catch (...) {
             sstlog.error("Failed to get promoted index for sstable {}, page {}, index {}: {}", _sstable->get_filename(),
                 _current_summary_idx, _current_index_idx, std::current_exception());
@@ -404,18 +518,16 @@ class index_reader {
             }
         }
 
-        auto cmp_with_start = [pos_cmp = position_in_partition::composite_less_compare(s)]
-            (position_in_partition_view pos, const promoted_index::entry& e) -> bool {
-            return pos_cmp(pos, e.start);
-        };
+        auto cmp_with_start = promoted_index_block_compare(s, *pi, _sstable->get_promoted_index_encoder());
+        auto key = cmp_with_start.make_key(pos);
 
         // Optimize short skips which typically land in the same block
-        if (_current_pi_idx >= pi->entries.size() || cmp_with_start(pos, pi->entries[_current_pi_idx])) {
+        if (_current_pi_idx >= pi->entries.size() || cmp_with_start(key, pi->entries[_current_pi_idx])) {
             sstlog.trace("index {}: position in current block", this);
             return make_ready_future<>();
         }
 
-        auto i = std::upper_bound(pi->entries.begin() + _current_pi_idx, pi->entries.end(), pos, cmp_with_start);
+        auto i = std::upper_bound(pi->entries.begin() + _current_pi_idx, pi->entries.end(), key, cmp_with_start);
         _current_pi_idx = std::distance(pi->entries.begin(), i);
         if (i != pi->entries.begin()) {
             --i;
@@ -449,7 +561,7 @@ class index_reader {
         index_entry& e = current_partition_entry();
         promoted_index* pi = nullptr;
         try {
-            pi = e.get_promoted_index(s);
+            pi = e.get_promoted_index(s, _sstable->get_promoted_index_encoder());
         } catch (...) {
             sstlog.error("Failed to get promoted index for sstable {}, page {}, index {}: {}", _sstable->get_filename(),
                 _current_summary_idx, _current_index_idx, std::current_exception());
@@ -459,12 +571,9 @@ class index_reader {
             return advance_to_next_partition();
         }
 
-        auto cmp_with_start = [pos_cmp = position_in_partition::composite_less_compare(s)]
-            (position_in_partition_view pos, const promoted_index::entry& e) -> bool {
-            return pos_cmp(pos, e.start);
-        };
-
-        auto i = std::upper_bound(pi->entries.begin() + _current_pi_idx, pi->entries.end(), pos, cmp_with_start);
+        auto cmp_with_start = promoted_index_block_compare(s, *pi, _sstable->get_promoted_index_encoder());
+        auto i = std::upper_bound(pi->entries.begin() + _current_pi_idx, pi->entries.end(),
+                cmp_with_start.make_key(pos), cmp_with_start);
         _current_pi_idx = std::distance(pi->entries.begin(), i);
         if (i == pi->entries.end()) {
             return advance_to_next_partition();
@@ -477,15 +586,19 @@ class index_reader {
     }
 
     // Like advance_to(dht::ring_position_view), but returns information whether the key was found
+    //
+    // From a fresh cursor, uses the partition index model of the sstable, if
+    // it has one, to read only a few index entries around the key.
     future<bool> advance_and_check_if_present(dht::ring_position_view key) {
-        return advance_to(key).then([this, key] {
-            if (eof()) {
-                return make_ready_future<bool>(false);
+        auto& model = _sstable->_components->index_model;
+        if (model && !_current_list && !_previous_summary_idx) {
+            auto model_key = partition_index_model::key_of(key.token());
+            if (model_key) {
+                return advance_with_model(*model, *model_key, key);
             }
-            return read_partition_data().then([this, key] {
-                index_comparator cmp(*_sstable->_schema);
-                return cmp(key, current_partition_entry()) == 0;
-            });
+        }
+        return advance_to(key).then([this, key] {
+            return check_if_present(key);
         });
     }
 
@@ -504,6 +617,13 @@ class index_reader {
             _element = indexable_element::partition;
             return make_ready_future<>();
         }
+        if (_model_run_end) {
+            auto& model = *_sstable->_components->index_model;
+            if (*_model_run_end < model.entries()) {
+                return advance_to_run(model.entries_from(*_model_run_end));
+            }
+            return advance_to_end();
+        }
         auto& summary = _sstable->get_summary();
         if (_current_summary_idx + 1 < summary.header.size) {
             return advance_to_page(_current_summary_idx + 1);
@@ -523,6 +643,12 @@ class index_reader {
             return advance_to_end();
         }
 
+        // Positions are non-decreasing, so starting over from the summary
+        // finds the same or a later entry.
+        if (_model_run_end) {
+            leave_run();
+        }
+
         auto& summary = _sstable->get_summary();
         _previous_summary_idx = std::distance(std::begin(summary.entries),
             std::lower_bound(summary.entries.begin() + _previous_summary_idx, summary.entries.end(), pos, index_comparator(*_sstable->_schema)));
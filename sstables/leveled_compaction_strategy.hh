@@ -62,6 +62,8 @@ class leveled_compaction_strategy : public compaction_strategy_impl {
 
     virtual int64_t estimated_pending_compactions(column_family& cf) const override;
 
+    virtual uint64_t estimated_backlog_bytes(column_family& cf) const override;
+
     virtual bool parallel_compaction() const override {
         return false;
     }
@@ -194,4 +196,24 @@ int64_t leveled_compaction_strategy::estimated_pending_compactions(column_family
     return manifest.get_estimated_tasks();
 }
 
+// L0 is compacted into L1 as a whole, and the bytes in excess of the target
+// size of a higher level are merged with the ~10x as many bytes they overlap
+// in the level above.
+uint64_t leveled_compaction_strategy::estimated_backlog_bytes(column_family& cf) const {
+    std::vector<uint64_t> level_bytes(leveled_manifest::MAX_LEVELS);
+    for (auto& sst : *cf.get_sstables()) {
+        auto level = std::min<size_t>(sst->get_sstable_level(), level_bytes.size() - 1);
+        level_bytes[level] += sst->data_size();
+    }
+    uint64_t max_sstable_size_in_bytes = uint64_t(_max_sstable_size_in_mb) << 20;
+    uint64_t backlog = level_bytes[0] ? level_bytes[0] + level_bytes[1] : 0;
+    for (size_t level = 1; level < level_bytes.size(); ++level) {
+        auto target = leveled_manifest::max_bytes_for_level(level, max_sstable_size_in_bytes);
+        if (level_bytes[level] > target) {
+            backlog += (level_bytes[level] - target) * 11;
+        }
+    }
+    return backlog;
+}
+
 }
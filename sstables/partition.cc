@@ -1011,7 +1011,7 @@ static inline bytes_view consume_bytes(bytes_view& p, size_t len) {
     return ret;
 }
 
-promoted_index promoted_index_view::parse(const schema& s) const {
+promoted_index promoted_index_view::parse(const schema& s, const byte_comparable_encoder* encoder) const {
     bytes_view data = _bytes;
 
     sstables::deletion_time del_time;
@@ -1019,7 +1019,9 @@ promoted_index promoted_index_view::parse(const schema& s) const {
     del_time.marked_for_delete_at = consume_be<uint64_t>(data);
 
     auto num_blocks = consume_be<uint32_t>(data);
-    std::deque<promoted_index::entry> entries;
+    promoted_index pi;
+    pi.del_time = del_time;
+    pi.has_encoded_starts = encoder != nullptr;
     while (num_blocks--) {
         uint16_t len = consume_be<uint16_t>(data);
         auto start_ck = composite_view(consume_bytes(data, len), s.is_compound());
@@ -1027,10 +1029,16 @@ promoted_index promoted_index_view::parse(const schema& s) const {
         auto end_ck = composite_view(consume_bytes(data, len), s.is_compound());
         uint64_t offset = consume_be<uint64_t>(data);
         uint64_t width = consume_be<uint64_t>(data);
-        entries.emplace_back(promoted_index::entry{start_ck, end_ck, offset, width});
+        pi.entries.emplace_back(promoted_index::entry{start_ck, end_ck, offset, width});
+        if (encoder) {
+            auto& e = pi.entries.back();
+            auto encoded = encoder->encode(start_ck);
+            e.encoded_start_offset = pi.encoded_starts.size();
+            e.encoded_start_size = encoded.size();
+            pi.encoded_starts += encoded;
+        }
     }
-
-    return promoted_index{del_time, std::move(entries)};
+    return pi;
 }
 
 sstables::deletion_time promoted_index_view::get_deletion_time() const {
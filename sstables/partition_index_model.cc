@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2017 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cmath>
+#include <limits>
+#include <seastar/core/align.hh>
+
+#include "sstables/partition_index_model.hh"
+#include "dht/murmur3_partitioner.hh"
+
+namespace sstables {
+
+bool partition_index_model::supported() {
+    return dynamic_cast<const dht::murmur3_partitioner*>(&dht::global_partitioner());
+}
+
+stdx::optional<uint64_t> partition_index_model::key_of(const dht::token& t) {
+    auto p = dynamic_cast<const dht::murmur3_partitioner*>(&dht::global_partitioner());
+    if (!p || t.is_minimum() || t.is_maximum()) {
+        return stdx::nullopt;
+    }
+    return p->unbias(t);
+}
+
+partition_index_model::entry_range partition_index_model::make_range(uint64_t first, uint64_t last) const {
+    first -= first % sample_interval;
+    last = std::min(align_up(last + 1, sample_interval), _entries);
+    auto begin = _sampled_offsets[first / sample_interval];
+    auto end = last == _entries ? _index_size : _sampled_offsets[last / sample_interval];
+    return entry_range{first, last - first, begin, end};
+}
+
+partition_index_model::entry_range partition_index_model::lookup(uint64_t key) const {
+    auto it = std::upper_bound(_segments.begin(), _segments.end(), key, [] (uint64_t key, const segment& s) {
+        return key < s.first_key;
+    });
+    if (it == _segments.begin()) {
+        return make_range(0, 0);
+    }
+    auto next = it;
+    auto& s = *--it;
+    // Keys between the last entry of a segment and the first of the next
+    // one belong to the latter.
+    double limit = next == _segments.end() ? _entries - 1 : next->first_entry;
+    double predicted = std::min(s.first_entry + std::round(s.slope * double(key - s.first_key)), limit);
+    // An absent key falls between two entries, so may be off by one more.
+    auto error = double(max_error + 1);
+    auto first = uint64_t(std::max(predicted - error, 0.0));
+    auto last = uint64_t(std::min(predicted + error, double(_entries - 1)));
+    return make_range(first, last);
+}
+
+partition_index_model::entry_range partition_index_model::entries_from(uint64_t first) const {
+    return make_range(first, first);
+}
+
+void partition_index_model::builder::start_segment(uint64_t key, uint64_t entry) {
+    _first_key = key;
+    _first_entry = entry;
+    _slope_lo = 0;
+    _slope_hi = std::numeric_limits<double>::infinity();
+}
+
+void partition_index_model::builder::end_segment() {
+    auto slope = std::isinf(_slope_hi) ? _slope_lo : (_slope_lo + _slope_hi) / 2;
+    _model._segments.push_back(segment{_first_key, _first_entry, slope});
+}
+
+void partition_index_model::builder::add(uint64_t key, uint64_t index_offset) {
+    auto entry = _model._entries++;
+    if (entry % sample_interval == 0) {
+        _model._sampled_offsets.push_back(index_offset);
+    }
+    if (!entry) {
+        start_segment(key, entry);
+        return;
+    }
+    auto dy = double(entry - _first_entry);
+    if (key == _first_key) {
+        // Predicted as the first entry of the segment.
+        if (dy > max_error) {
+            end_segment();
+            start_segment(key, entry);
+        }
+        return;
+    }
+    auto dx = double(key - _first_key);
+    auto lo = (dy - max_error) / dx;
+    auto hi = (dy + max_error) / dx;
+    if (lo > _slope_hi || hi < _slope_lo) {
+        end_segment();
+        start_segment(key, entry);
+        return;
+    }
+    _slope_lo = std::max(_slope_lo, lo);
+    _slope_hi = std::min(_slope_hi, hi);
+}
+
+partition_index_model partition_index_model::builder::build(uint64_t index_size) && {
+    if (_model._entries) {
+        end_segment();
+    }
+    _model._index_size = index_size;
+    return std::move(_model);
+}
+
+}
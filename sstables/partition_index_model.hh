@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2017 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <experimental/optional>
+#include "dht/i_partitioner.hh"
+#include "utils/chunked_vector.hh"
+
+namespace sstables {
+
+// A compact in-memory model of the partition index (Index.db) of an sstable,
+// mapping the token of a partition to the position of its index entry.
+//
+// The ordinal of an index entry is modelled as a piecewise-linear function
+// of the token, built so that it is off by at most max_error entries for
+// every partition in the sstable. Index.db offsets are kept only for every
+// sample_interval-th entry, so a lookup gives a short run of entries, which
+// can be read directly instead of a whole summary page. Since tokens of
+// murmur3 are uniformly distributed, few segments are needed and the model
+// takes about 8 / sample_interval bytes per partition.
+//
+// Lookups are hints: the reader must check that the entries it read do
+// bracket the key, and fall back to the summary otherwise.
+class partition_index_model {
+public:
+    static constexpr uint64_t max_error = 8;
+    static constexpr uint64_t sample_interval = 8;
+
+    // A run of consecutive index entries, and the range of Index.db holding them.
+    struct entry_range {
+        uint64_t first;
+        uint64_t count;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    class builder;
+private:
+    struct segment {
+        uint64_t first_key;
+        uint64_t first_entry;
+        double slope;
+    };
+    utils::chunked_vector<segment> _segments;
+    // Index.db offset of every sample_interval-th entry.
+    utils::chunked_vector<uint64_t> _sampled_offsets;
+    uint64_t _entries = 0;
+    uint64_t _index_size = 0;
+private:
+    entry_range make_range(uint64_t first, uint64_t last) const;
+public:
+    // Returns the entries which should contain the first partition whose
+    // token is not smaller than the one key was computed from.
+    entry_range lookup(uint64_t key) const;
+
+    // Returns a run of entries starting with the first-th one.
+    // first must be lower than entries().
+    entry_range entries_from(uint64_t first) const;
+
+    uint64_t entries() const {
+        return _entries;
+    }
+
+    size_t memory_usage() const {
+        return sizeof(*this) + _segments.size() * sizeof(segment) + _sampled_offsets.size() * sizeof(uint64_t);
+    }
+
+    // Whether the partitioner orders tokens as unsigned integers the model
+    // can use. Only murmur3 does.
+    static bool supported();
+
+    // The model key of a token, if the partitioner is supported and the
+    // token is not the minimum or maximum one.
+    static stdx::optional<uint64_t> key_of(const dht::token& t);
+};
+
+// Builds a partition_index_model from the index entries, in order, in a
+// single pass and without keeping them.
+//
+// Segments are fitted greedily: a segment is extended for as long as some
+// line through its first point stays within max_error of all its points,
+// the candidate slopes narrowing with each point (a "shrinking cone").
+class partition_index_model::builder {
+    partition_index_model _model;
+    uint64_t _first_key = 0;
+    uint64_t _first_entry = 0;
+    double _slope_lo = 0;
+    double _slope_hi = 0;
+private:
+    void start_segment(uint64_t key, uint64_t entry);
+    void end_segment();
+public:
+    void add(uint64_t key, uint64_t index_offset);
+    partition_index_model build(uint64_t index_size) &&;
+};
+
+}
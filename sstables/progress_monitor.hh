@@ -23,6 +23,7 @@
 #pragma once
 
 
+#include <algorithm>
 #include <seastar/core/shared_ptr.hh>
 #include <seastar/core/shared_ptr_incomplete.hh>
 
@@ -40,4 +41,41 @@ struct noop_write_monitor final : public write_monitor {
 };
 
 seastar::shared_ptr<write_monitor> default_write_monitor();
+
+// Tracks how much of its input a long-running operation, such as a
+// compaction, has consumed, in bytes. The input is described by its
+// estimated size and number of partitions, and progress is measured in
+// partitions, which are assumed to be of the same size.
+class progress_monitor {
+    uint64_t _total_bytes = 0;
+    uint64_t _total_partitions = 0;
+    uint64_t _partitions_read = 0;
+    bool _finished = false;
+public:
+    void add_input(uint64_t bytes, uint64_t partitions) {
+        _total_bytes += bytes;
+        _total_partitions += partitions;
+    }
+    void on_partition_read() {
+        _partitions_read++;
+    }
+    void on_finished() {
+        _finished = true;
+    }
+    uint64_t total_bytes() const {
+        return _total_bytes;
+    }
+    // Partition counts are estimates, so the progress is capped short of
+    // the total until the operation is done.
+    uint64_t bytes_done() const {
+        if (_finished) {
+            return _total_bytes;
+        }
+        if (!_total_partitions) {
+            return 0;
+        }
+        auto ratio = std::min(double(_partitions_read) / _total_partitions, 0.99);
+        return _total_bytes * ratio;
+    }
+};
 }
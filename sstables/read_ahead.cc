@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2017 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <unordered_map>
+#include <seastar/core/metrics.hh>
+#include <seastar/core/reactor.hh>
+
+#include "sstables/read_ahead.hh"
+#include "service/priority_manager.hh"
+
+namespace sstables {
+
+static seastar::metrics::label class_label("class");
+static seastar::metrics::label pattern_label("pattern");
+
+read_ahead_controller::read_ahead_controller(access_pattern p, sstring priority_class)
+    : _max_read_ahead(p == access_pattern::partition_range ? 4 * default_read_ahead : default_read_ahead)
+{
+    namespace sm = seastar::metrics;
+    std::vector<sm::label_instance> labels = {
+        class_label(priority_class),
+        pattern_label(p == access_pattern::partition_range ? "partition_range" : "single_partition"),
+    };
+    _metrics.add_group("sstables", {
+        sm::make_derive("read_ahead_bytes_read", [this] { return _stats.bytes_read; },
+                        sm::description("bytes read from disk by sstable data streams"), labels),
+        sm::make_derive("read_ahead_bytes_consumed", [this] { return _stats.bytes_consumed; },
+                        sm::description("bytes of what sstable data streams read which were parsed, the rest was read ahead in vain"), labels),
+        sm::make_gauge("read_ahead_depth", [this] { return _read_ahead; },
+                       sm::description("maximum number of buffers an sstable data stream reads ahead"), labels),
+        sm::make_gauge("read_ahead_buffer_shift", [this] { return _buffer_shift; },
+                       sm::description("number of times the buffer size of sstable data streams is halved"), labels),
+    });
+}
+
+size_t read_ahead_controller::buffer_size(size_t sstable_buffer_size) const {
+    return std::max(sstable_buffer_size >> _buffer_shift, std::min(sstable_buffer_size, size_t(4096)));
+}
+
+void read_ahead_controller::adjust() {
+    auto consumed = std::min(_window_consumed, _window_read);
+    auto wasted = _window_read - consumed;
+    if (wasted * 2 > _window_read) {
+        if (_read_ahead > 1) {
+            _read_ahead /= 2;
+        } else if (_buffer_shift < max_buffer_shift) {
+            _buffer_shift++;
+        }
+        _stats.shrinks++;
+    } else if (wasted * 10 < _window_read) {
+        if (_buffer_shift) {
+            _buffer_shift--;
+        } else if (_read_ahead < _max_read_ahead) {
+            _read_ahead = std::min(_read_ahead * 2, _max_read_ahead);
+        }
+        _stats.grows++;
+    }
+    _window_read = 0;
+    _window_consumed = 0;
+}
+
+static sstring priority_class_name(const io_priority_class& pc) {
+    auto& pm = service::get_local_priority_manager();
+    if (pc.id() == pm.sstable_query_read_priority().id()) {
+        return "query";
+    } else if (pc.id() == pm.compaction_priority().id()) {
+        return "compaction";
+    } else if (pc.id() == pm.streaming_read_priority().id()) {
+        return "streaming_read";
+    } else if (pc.id() == default_priority_class().id()) {
+        return "default";
+    }
+    return sprint("%d", pc.id());
+}
+
+read_ahead_controller& get_read_ahead_controller(access_pattern p, const io_priority_class& pc) {
+    static thread_local std::unordered_map<unsigned, std::unique_ptr<read_ahead_controller>> controllers;
+    auto key = pc.id() * 2 + unsigned(p);
+    auto i = controllers.find(key);
+    if (i == controllers.end()) {
+        i = controllers.emplace(key, std::make_unique<read_ahead_controller>(p, priority_class_name(pc))).first;
+    }
+    return *i->second;
+}
+
+// Reads may complete after the file is gone, so they report to the
+// controller, which lives as long as the shard, not to the file.
+class read_ahead_accounting_file_impl : public file_impl {
+    file _file;
+    read_ahead_controller& _controller;
+public:
+    read_ahead_accounting_file_impl(file f, read_ahead_controller& c)
+        : _file(std::move(f))
+        , _controller(c) {
+        _memory_dma_alignment = _file.memory_dma_alignment();
+        _disk_read_dma_alignment = _file.disk_read_dma_alignment();
+        _disk_write_dma_alignment = _file.disk_write_dma_alignment();
+    }
+
+    virtual future<size_t> write_dma(uint64_t pos, const void* buffer, size_t len, const io_priority_class& pc) override {
+        return get_file_impl(_file)->write_dma(pos, buffer, len, pc);
+    }
+
+    virtual future<size_t> write_dma(uint64_t pos, std::vector<iovec> iov, const io_priority_class& pc) override {
+        return get_file_impl(_file)->write_dma(pos, std::move(iov), pc);
+    }
+
+    virtual future<size_t> read_dma(uint64_t pos, void* buffer, size_t len, const io_priority_class& pc) override {
+        return get_file_impl(_file)->read_dma(pos, buffer, len, pc).then([&c = _controller] (size_t n) {
+            c.on_read(n);
+            return n;
+        });
+    }
+
+    virtual future<size_t> read_dma(uint64_t pos, std::vector<iovec> iov, const io_priority_class& pc) override {
+        return get_file_impl(_file)->read_dma(pos, iov, pc).then([&c = _controller] (size_t n) {
+            c.on_read(n);
+            return n;
+        });
+    }
+
+    virtual future<> flush(void) override {
+        return get_file_impl(_file)->flush();
+    }
+
+    virtual future<struct stat> stat(void) override {
+        return get_file_impl(_file)->stat();
+    }
+
+    virtual future<> truncate(uint64_t length) override {
+        return get_file_impl(_file)->truncate(length);
+    }
+
+    virtual future<> discard(uint64_t offset, uint64_t length) override {
+        return get_file_impl(_file)->discard(offset, length);
+    }
+
+    virtual future<> allocate(uint64_t position, uint64_t length) override {
+        return get_file_impl(_file)->allocate(position, length);
+    }
+
+    virtual future<uint64_t> size(void) override {
+        return get_file_impl(_file)->size();
+    }
+
+    virtual future<> close() override {
+        return get_file_impl(_file)->close();
+    }
+
+    virtual std::unique_ptr<file_handle_impl> dup() override {
+        return get_file_impl(_file)->dup();
+    }
+
+    virtual subscription<directory_entry> list_directory(std::function<future<> (directory_entry de)> next) override {
+        return get_file_impl(_file)->list_directory(std::move(next));
+    }
+
+    virtual future<temporary_buffer<uint8_t>> dma_read_bulk(uint64_t offset, size_t range_size, const io_priority_class& pc) override {
+        return get_file_impl(_file)->dma_read_bulk(offset, range_size, pc).then([&c = _controller] (temporary_buffer<uint8_t> buf) {
+            c.on_read(buf.size());
+            return make_ready_future<temporary_buffer<uint8_t>>(std::move(buf));
+        });
+    }
+};
+
+file make_read_ahead_accounting_file(file f, read_ahead_controller& c) {
+    return file(make_shared<read_ahead_accounting_file_impl>(std::move(f), c));
+}
+
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2017 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <seastar/core/file.hh>
+#include <seastar/core/metrics_registration.hh>
+
+#include "seastarx.hh"
+
+namespace sstables {
+
+// How a data file stream is read. Read-ahead pays off very differently for
+// each, so each is adjusted on its own.
+enum class access_pattern {
+    single_partition,   // point reads and slices of a single partition
+    partition_range,    // scans over consecutive partitions, including compaction
+};
+
+struct read_ahead_stats {
+    uint64_t bytes_read = 0;        // read from disk by the data streams
+    uint64_t bytes_consumed = 0;    // parsed by the readers, in on-disk bytes
+    uint64_t shrinks = 0;
+    uint64_t grows = 0;
+};
+
+// Sets the buffer size and read-ahead depth of the data streams of one access
+// pattern and io_priority_class on a shard, from how much of what the streams
+// read is consumed. The history of each stream only trims read-ahead within
+// these limits; the controller moves the limits themselves, so that sustained
+// sequential scans can keep more reads in flight than the default, and reads
+// which keep skipping what was read ahead ask for less.
+//
+// Every window of bytes read, a waste over one half shrinks read-ahead, then
+// the buffers, and a waste under one tenth grows them back.
+class read_ahead_controller {
+public:
+    static constexpr uint64_t window = 32 << 20;
+    static constexpr unsigned default_read_ahead = 4;
+    static constexpr unsigned max_buffer_shift = 3;
+private:
+    unsigned _max_read_ahead;
+    unsigned _read_ahead = default_read_ahead;
+    unsigned _buffer_shift = 0; // the sstable's buffer size is halved this many times
+    uint64_t _window_read = 0;
+    uint64_t _window_consumed = 0;
+    read_ahead_stats _stats;
+    seastar::metrics::metric_groups _metrics;
+private:
+    void adjust();
+public:
+    read_ahead_controller(access_pattern p, sstring priority_class);
+
+    read_ahead_controller(const read_ahead_controller&) = delete;
+    read_ahead_controller(read_ahead_controller&&) = delete;
+
+    size_t buffer_size(size_t sstable_buffer_size) const;
+
+    unsigned read_ahead() const {
+        return _read_ahead;
+    }
+
+    void on_read(uint64_t n) {
+        _stats.bytes_read += n;
+        _window_read += n;
+        if (_window_read >= window) {
+            adjust();
+        }
+    }
+
+    void on_consumed(uint64_t n) {
+        _stats.bytes_consumed += n;
+        _window_consumed += n;
+    }
+
+    const read_ahead_stats& stats() const {
+        return _stats;
+    }
+};
+
+// The controller of the given access pattern and priority class on this shard.
+read_ahead_controller& get_read_ahead_controller(access_pattern p, const io_priority_class& pc);
+
+// Returns a file which reports the bytes read through it to the controller.
+file make_read_ahead_accounting_file(file f, read_ahead_controller& c);
+
+}
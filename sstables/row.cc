@@ -396,10 +396,15 @@ class data_consume_context::impl {
 private:
     shared_sstable _sst;
     std::unique_ptr<data_consume_rows_context> _ctx;
+    read_ahead_controller& _read_ahead;
+    // Converts positions, which are in uncompressed bytes, to on-disk bytes.
+    double _ondisk_ratio;
 public:
-    impl(shared_sstable sst, row_consumer& consumer, input_stream<char>&& input, uint64_t start, uint64_t maxlen)
+    impl(shared_sstable sst, row_consumer& consumer, input_stream<char>&& input, uint64_t start, uint64_t maxlen, access_pattern pattern)
         : _sst(std::move(sst))
         , _ctx(new data_consume_rows_context(consumer, std::move(input), start, maxlen))
+        , _read_ahead(get_read_ahead_controller(pattern, consumer.io_priority()))
+        , _ondisk_ratio(_sst->get_compression_ratio() > 0 ? _sst->get_compression_ratio() : 1.0)
     { }
     ~impl() {
         if (_ctx) {
@@ -408,7 +413,10 @@ class data_consume_context::impl {
         }
     }
     future<> read() {
-        return _ctx->consume_input(*_ctx);
+        auto start = _ctx->position();
+        return _ctx->consume_input(*_ctx).then([this, start] {
+            _read_ahead.on_consumed((_ctx->position() - start) * _ondisk_ratio);
+        });
     }
     future<> fast_forward_to(uint64_t begin, uint64_t end) {
         _ctx->reset(indexable_element::partition);
@@ -458,14 +466,16 @@ data_consume_context sstable::data_consume_rows(
     // returned context, and may make small skips.
     return std::make_unique<data_consume_context::impl>(shared_from_this(),
             consumer, data_stream(toread.start, last_end - toread.start,
-                consumer.io_priority(), consumer.resource_tracker(), _partition_range_history), toread.start, toread.end - toread.start);
+                consumer.io_priority(), consumer.resource_tracker(), access_pattern::partition_range), toread.start, toread.end - toread.start,
+                access_pattern::partition_range);
 }
 
 data_consume_context sstable::data_consume_single_partition(
         row_consumer& consumer, sstable::disk_read_range toread) {
     return std::make_unique<data_consume_context::impl>(shared_from_this(),
             consumer, data_stream(toread.start, toread.end - toread.start,
-                 consumer.io_priority(), consumer.resource_tracker(), _single_partition_history), toread.start, toread.end - toread.start);
+                 consumer.io_priority(), consumer.resource_tracker(), access_pattern::single_partition), toread.start, toread.end - toread.start,
+                 access_pattern::single_partition);
 }
 
 
@@ -200,6 +200,7 @@ std::unordered_map<sstable::component_type, sstring, enum_hash<sstable::componen
     { component_type::Filter, "Filter.db" },
     { component_type::Statistics, "Statistics.db" },
     { component_type::Scylla, "Scylla.db" },
+    { component_type::BlockedFilter, "BlockedFilter.db" },
     { component_type::TemporaryTOC, TEMPORARY_TOC_SUFFIX },
     { component_type::TemporaryStatistics, "Statistics.db.tmp" },
 };
@@ -969,7 +970,7 @@ future<> sstable::read_toc() {
 
 }
 
-void sstable::generate_toc(compressor c, double filter_fp_chance) {
+void sstable::generate_toc(compressor c, double filter_fp_chance, bool blocked_bloom_filter) {
     // Creating table of components.
     _recognized_components.insert(component_type::TOC);
     _recognized_components.insert(component_type::Statistics);
@@ -978,7 +979,7 @@ void sstable::generate_toc(compressor c, double filter_fp_chance) {
     _recognized_components.insert(component_type::Summary);
     _recognized_components.insert(component_type::Data);
     if (filter_fp_chance != 1.0) {
-        _recognized_components.insert(component_type::Filter);
+        _recognized_components.insert(blocked_bloom_filter ? component_type::BlockedFilter : component_type::Filter);
     }
     if (c == compressor::none) {
         _recognized_components.insert(component_type::CRC);
@@ -1133,6 +1134,8 @@ void sstable::write_simple(const T& component, const io_priority_class& pc) {
 
 template future<> sstable::read_simple<sstable::component_type::Filter>(sstables::filter& f, const io_priority_class& pc);
 template void sstable::write_simple<sstable::component_type::Filter>(const sstables::filter& f, const io_priority_class& pc);
+template future<> sstable::read_simple<sstable::component_type::BlockedFilter>(sstables::filter& f, const io_priority_class& pc);
+template void sstable::write_simple<sstable::component_type::BlockedFilter>(const sstables::filter& f, const io_priority_class& pc);
 
 future<> sstable::read_compression(const io_priority_class& pc) {
      // FIXME: If there is no compression, we should expect a CRC file to be present.
@@ -1306,9 +1309,11 @@ future<> sstable::update_info_for_opened_data() {
             _index_file_size = size;
         });
     }).then([this] {
-        if (this->has_component(sstable::component_type::Filter)) {
-            return io_check([&] {
-                return engine().file_size(this->filename(sstable::component_type::Filter));
+        auto filter_component = this->has_component(sstable::component_type::BlockedFilter)
+                ? sstable::component_type::BlockedFilter : sstable::component_type::Filter;
+        if (this->has_component(filter_component)) {
+            return io_check([this, filter_component] {
+                return engine().file_size(this->filename(filter_component));
             }).then([this] (auto size) {
                 _filter_file_size = size;
             });
@@ -1347,6 +1352,21 @@ future<> sstable::create_data() {
 }
 
 future<> sstable::read_filter(const io_priority_class& pc) {
+    if (has_component(sstable::component_type::BlockedFilter)) {
+        return do_with(sstables::filter(), [this, &pc] (auto& filter) {
+            return this->read_simple<sstable::component_type::BlockedFilter>(filter, pc).then([this, &filter] {
+                if (filter.hashes != utils::filter::blocked_bloom_filter::hash_count || filter.buckets.elements.empty()
+                        || filter.buckets.elements.size() % utils::filter::blocked_bloom_filter::words_per_block) {
+                    throw malformed_sstable_exception(sprint("blocked filter with %d hashes and %d words", filter.hashes, filter.buckets.elements.size()),
+                            filename(component_type::BlockedFilter));
+                }
+                large_bitset bs(filter.buckets.elements.size() * 64);
+                bs.load(filter.buckets.elements.begin(), filter.buckets.elements.end());
+                _components->filter = utils::filter::create_blocked_filter(std::move(bs));
+            });
+        });
+    }
+
     if (!has_component(sstable::component_type::Filter)) {
         _components->filter = std::make_unique<utils::filter::always_present_filter>();
         return make_ready_future<>();
@@ -1362,17 +1382,20 @@ future<> sstable::read_filter(const io_priority_class& pc) {
 }
 
 void sstable::write_filter(const io_priority_class& pc) {
-    if (!has_component(sstable::component_type::Filter)) {
-        return;
+    auto save = [] (large_bitset& bs) {
+        utils::chunked_vector<uint64_t> v(align_up(bs.size(), size_t(64)) / 64);
+        bs.save(v.begin());
+        return v;
+    };
+    if (has_component(sstable::component_type::BlockedFilter)) {
+        auto f = static_cast<utils::filter::blocked_bloom_filter*>(_components->filter.get());
+        auto filter = sstables::filter(utils::filter::blocked_bloom_filter::hash_count, save(f->bits()));
+        write_simple<sstable::component_type::BlockedFilter>(filter, pc);
+    } else if (has_component(sstable::component_type::Filter)) {
+        auto f = static_cast<utils::filter::murmur3_bloom_filter *>(_components->filter.get());
+        auto filter = sstables::filter(f->num_hashes(), save(f->bits()));
+        write_simple<sstable::component_type::Filter>(filter, pc);
     }
-
-    auto f = static_cast<utils::filter::murmur3_bloom_filter *>(_components->filter.get());
-
-    auto&& bs = f->bits();
-    utils::chunked_vector<uint64_t> v(align_up(bs.size(), size_t(64)) / 64);
-    bs.save(v.begin());
-    auto filter = sstables::filter(f->num_hashes(), std::move(v));
-    write_simple<sstable::component_type::Filter>(filter, pc);
 }
 
 // This interface is only used during tests, snapshot loading and early initialization.
@@ -1388,6 +1411,8 @@ future<> sstable::load(const io_priority_class& pc) {
             validate_min_max_metadata();
             set_clustering_components_ranges();
             return open_data();
+        }).then([this, &pc] {
+            return build_index_model(pc);
         });
     });
 }
@@ -2004,6 +2029,14 @@ static const db::config& get_config() {
     }
 }
 
+// Nodes which don't know BlockedFilter read such sstables without a filter,
+// so it is only written once all of them do.
+static bool use_blocked_bloom_filter() {
+    return get_config().enable_sstable_blocked_bloom_filter()
+        && service::get_storage_service().local_is_initialized()
+        && service::get_local_storage_service().cluster_supports_blocked_bloom_filter();
+}
+
 // Returns the cost for writing a byte to summary such that the ratio of summary
 // to data will be 1 to cost by the time sstable is sealed.
 static size_t summary_byte_cost() {
@@ -2024,8 +2057,15 @@ components_writer::components_writer(sstable& sst, const schema& s, file_writer&
     , _tombstone_written(false)
     , _summary_byte_cost(summary_byte_cost())
 {
-    _sst._components->filter = utils::i_filter::get_filter(estimated_partitions, _schema.bloom_filter_fp_chance());
+    if (_sst.has_component(sstable::component_type::BlockedFilter)) {
+        _sst._components->filter = utils::i_filter::get_blocked_filter(estimated_partitions, _schema.bloom_filter_fp_chance());
+    } else {
+        _sst._components->filter = utils::i_filter::get_filter(estimated_partitions, _schema.bloom_filter_fp_chance());
+    }
     _sst._pi_write.desired_block_size = cfg.promoted_index_block_size.value_or(get_config().column_index_size_in_kb() * 1024);
+    if (get_config().enable_sstable_partition_index_model() && partition_index_model::supported()) {
+        _index_model_builder.emplace();
+    }
 
     prepare_summary(_sst._components->summary, estimated_partitions, _schema.min_index_interval());
 
@@ -2049,6 +2089,9 @@ void components_writer::consume_new_partition(const dht::decorated_key& dk) {
     // Write an index entry minus the "promoted index" (sample of columns)
     // part. We can only write that after processing the entire partition
     // and collecting the sample of columns.
+    if (_index_model_builder) {
+        _index_model_builder->add(*partition_index_model::key_of(dk.token()), _index.offset());
+    }
     write_index_header(_index, p_key, _out.offset());
     _sst._pi_write.data = {};
     _sst._pi_write.numblocks = 0;
@@ -2152,6 +2195,14 @@ stop_iteration components_writer::consume_end_of_partition() {
 void components_writer::consume_end_of_stream() {
     seal_summary(_sst._components->summary, std::move(_first_key), std::move(_last_key)); // what if there is only one partition? what if it is empty?
 
+    if (_index_model_builder) {
+        auto model = std::move(*_index_model_builder).build(_index.offset());
+        if (model.entries()) {
+            sstlog.debug("Partition index model of {}: {} entries, {} bytes", _sst.get_filename(), model.entries(), model.memory_usage());
+            _sst._components->index_model = std::move(model);
+        }
+    }
+
     _index_needs_close = false;
     _index.close().get();
 
@@ -2248,7 +2299,8 @@ sstable_writer::sstable_writer(sstable& sst, const schema& s, uint64_t estimated
     , _shard(shard)
     , _monitor(cfg.monitor)
 {
-    _sst.generate_toc(_schema.get_compressor_params().get_compressor(), _schema.bloom_filter_fp_chance());
+    _sst.generate_toc(_schema.get_compressor_params().get_compressor(), _schema.bloom_filter_fp_chance(),
+            cfg.blocked_bloom_filter.value_or(use_blocked_bloom_filter()));
     _sst.write_toc(_pc);
     _sst.create_data().get();
     _compression_enabled = !_sst.has_component(sstable::component_type::CRC);
@@ -2373,6 +2425,39 @@ future<> sstable::generate_summary(const io_priority_class& pc) {
     });
 }
 
+future<> sstable::build_index_model(const io_priority_class& pc) {
+    if (_components->index_model || !get_config().enable_sstable_partition_index_model() || !partition_index_model::supported()) {
+        return make_ready_future<>();
+    }
+
+    struct model_generator {
+        partition_index_model::builder builder;
+
+        void consume_entry(index_entry&& ie, uint64_t index_offset) {
+            auto token = dht::global_partitioner().get_token(ie.get_key());
+            builder.add(*partition_index_model::key_of(token), index_offset);
+        }
+    };
+
+    file_input_stream_options options;
+    options.buffer_size = sstable_buffer_size;
+    options.io_priority_class = pc;
+    auto index_size = this->index_size();
+    auto stream = make_file_input_stream(_index_file, 0, index_size, std::move(options));
+    return do_with(model_generator(), [this, stream = std::move(stream), index_size] (model_generator& g) mutable {
+        auto ctx = make_lw_shared<index_consume_entry_context<model_generator>>(g, std::move(stream), 0, index_size);
+        return ctx->consume_input(*ctx).finally([ctx] {
+            return ctx->close();
+        }).then([this, &g, index_size] {
+            auto model = std::move(g.builder).build(index_size);
+            if (model.entries()) {
+                sstlog.debug("Partition index model of {}: {} entries, {} bytes", get_filename(), model.entries(), model.memory_usage());
+                _components->index_model = std::move(model);
+            }
+        });
+    });
+}
+
 uint64_t sstable::data_size() const {
     if (has_component(sstable::component_type::CompressionInfo)) {
         return _components->compression.uncompressed_file_length();
@@ -2546,15 +2631,26 @@ sstable::component_type sstable::component_from_sstring(sstring &s) {
     }
 }
 
-input_stream<char> sstable::data_stream(uint64_t pos, size_t len, const io_priority_class& pc, reader_resource_tracker resource_tracker, lw_shared_ptr<file_input_stream_history> history) {
+input_stream<char> sstable::data_stream(uint64_t pos, size_t len, const io_priority_class& pc, reader_resource_tracker resource_tracker, stdx::optional<access_pattern> pattern) {
     file_input_stream_options options;
     options.buffer_size = sstable_buffer_size;
     options.io_priority_class = pc;
     options.read_ahead = 4;
-    options.dynamic_adjustments = std::move(history);
 
     auto f = resource_tracker.track(_data_file);
 
+    if (pattern) {
+        auto& controller = get_read_ahead_controller(*pattern, pc);
+        options.buffer_size = controller.buffer_size(sstable_buffer_size);
+        options.read_ahead = controller.read_ahead();
+        auto& history = _stream_histories[pc.id() * 2 + unsigned(*pattern)];
+        if (!history) {
+            history = make_lw_shared<file_input_stream_history>();
+        }
+        options.dynamic_adjustments = history;
+        f = make_read_ahead_accounting_file(std::move(f), controller);
+    }
+
     input_stream<char> stream;
     if (_components->compression) {
         return make_compressed_file_input_stream(f, &_components->compression,
@@ -2566,7 +2662,7 @@ input_stream<char> sstable::data_stream(uint64_t pos, size_t len, const io_prior
 }
 
 future<temporary_buffer<char>> sstable::data_read(uint64_t pos, size_t len, const io_priority_class& pc) {
-    return do_with(data_stream(pos, len, pc, no_resource_tracking(), {}), [len] (auto& stream) {
+    return do_with(data_stream(pos, len, pc, no_resource_tracking(), stdx::nullopt), [len] (auto& stream) {
         return stream.read_exactly(len).finally([&stream] {
             return stream.close();
         });
@@ -54,7 +54,9 @@
 #include "disk-error-handler.hh"
 #include "atomic_deletion.hh"
 #include "sstables/shared_index_lists.hh"
+#include "sstables/partition_index_model.hh"
 #include "sstables/progress_monitor.hh"
+#include "sstables/read_ahead.hh"
 #include "db/commitlog/replay_position.hh"
 
 namespace seastar {
@@ -142,6 +144,9 @@ struct sstable_writer_config {
     stdx::optional<db::replay_position> replay_position;
     seastar::thread_scheduling_group* thread_scheduling_group = nullptr;
     seastar::shared_ptr<write_monitor> monitor = default_write_monitor();
+    // Whether to write a BlockedFilter rather than a Filter; by default, if
+    // enabled in the configuration and supported by the whole cluster.
+    stdx::optional<bool> blocked_bloom_filter;
 };
 
 static constexpr inline size_t default_sstable_buffer_size() {
@@ -166,6 +171,9 @@ class sstable : public enable_lw_shared_from_this<sstable> {
         TemporaryTOC,
         TemporaryStatistics,
         Scylla,
+        // A filter in the layout of utils::filter::blocked_bloom_filter.
+        // Written instead of Filter, which older versions would misread.
+        BlockedFilter,
         Unknown,
     };
     using version_types = sstable_version_types;
@@ -176,6 +184,7 @@ class sstable : public enable_lw_shared_from_this<sstable> {
             io_error_handler_gen error_handler_gen = default_io_error_handler_gen(), size_t buffer_size = default_buffer_size)
         : sstable_buffer_size(buffer_size)
         , _schema(std::move(schema))
+        , _promoted_index_encoder(byte_comparable_encoder::for_schema(*_schema))
         , _dir(std::move(dir))
         , _generation(generation)
         , _version(v)
@@ -418,6 +427,15 @@ class sstable : public enable_lw_shared_from_this<sstable> {
         return _components->filter->memory_size();
     }
 
+    const byte_comparable_encoder* get_promoted_index_encoder() const {
+        return _promoted_index_encoder ? &*_promoted_index_encoder : nullptr;
+    }
+
+    // Memory used by the partition index model, 0 if the sstable has none.
+    uint64_t index_model_memory_size() const {
+        return _components->index_model ? _components->index_model->memory_usage() : 0;
+    }
+
     // Returns the total bytes of all components.
     uint64_t bytes_on_disk();
 
@@ -477,6 +495,7 @@ class sstable : public enable_lw_shared_from_this<sstable> {
         sstables::summary summary;
         sstables::statistics statistics;
         stdx::optional<sstables::scylla_metadata> scylla_metadata;
+        stdx::optional<partition_index_model> index_model;
     };
 private:
     size_t sstable_buffer_size = default_buffer_size;
@@ -490,6 +509,9 @@ class sstable : public enable_lw_shared_from_this<sstable> {
 
     foreign_ptr<lw_shared_ptr<shareable_components>> _components = make_foreign(make_lw_shared<shareable_components>());
     shared_index_lists _index_lists;
+    // Runs of index entries read through the partition index model, keyed
+    // by their first entry and length.
+    shared_index_lists _index_model_runs;
     bool _shared = true;  // across shards; safe default
     // NOTE: _collector and _c_stats are used to generation of statistics file
     // when writing a new sstable.
@@ -507,8 +529,8 @@ class sstable : public enable_lw_shared_from_this<sstable> {
     stdx::optional<dht::decorated_key> _first;
     stdx::optional<dht::decorated_key> _last;
 
-    lw_shared_ptr<file_input_stream_history> _single_partition_history = make_lw_shared<file_input_stream_history>();
-    lw_shared_ptr<file_input_stream_history> _partition_range_history = make_lw_shared<file_input_stream_history>();
+    // Histories of the data streams, by access pattern and priority class.
+    std::unordered_map<unsigned, lw_shared_ptr<file_input_stream_history>> _stream_histories;
 
     // _pi_write is used temporarily for building the promoted
     // index (column sample) of one partition when writing a new sstable.
@@ -533,6 +555,8 @@ class sstable : public enable_lw_shared_from_this<sstable> {
             composite::eoc marker = composite::eoc::none);
 
     schema_ptr _schema;
+    // Disengaged if the clustering key types cannot be encoded.
+    stdx::optional<byte_comparable_encoder> _promoted_index_encoder;
     sstring _dir;
     unsigned long _generation = 0;
     version_types _version;
@@ -557,7 +581,7 @@ class sstable : public enable_lw_shared_from_this<sstable> {
     template <sstable::component_type Type, typename T>
     void write_simple(const T& comp, const io_priority_class& pc);
 
-    void generate_toc(compressor c, double filter_fp_chance);
+    void generate_toc(compressor c, double filter_fp_chance, bool blocked_bloom_filter = false);
     void write_toc(const io_priority_class& pc);
     future<> seal_sstable();
 
@@ -581,6 +605,10 @@ class sstable : public enable_lw_shared_from_this<sstable> {
     // happen if old tools are being used.
     future<> generate_summary(const io_priority_class& pc);
 
+    // Builds the partition index model from the index file, if enabled and
+    // not built when the sstable was written.
+    future<> build_index_model(const io_priority_class& pc);
+
     future<> read_statistics(const io_priority_class& pc);
     void write_statistics(const io_priority_class& pc);
     // Rewrite statistics component by creating a temporary Statistics and
@@ -610,8 +638,13 @@ class sstable : public enable_lw_shared_from_this<sstable> {
     // of bytes to be read using this stream, we can make better choices
     // about the buffer size to read, and where exactly to stop reading
     // (even when a large buffer size is used).
+    //
+    // With an access pattern, the buffer size and read-ahead are those the
+    // read_ahead_controller of the pattern and priority class sets, and the
+    // stream adapts them further to what it reads, learning from the previous
+    // streams of the same kind.
     input_stream<char> data_stream(uint64_t pos, size_t len, const io_priority_class& pc,
-                                   reader_resource_tracker resource_tracker, lw_shared_ptr<file_input_stream_history> history);
+                                   reader_resource_tracker resource_tracker, stdx::optional<access_pattern> pattern);
 
     // Read exactly the specific byte range from the data file (after
     // uncompression, if the file is compressed). This can be used to read
@@ -821,6 +854,7 @@ class components_writer {
     uint64_t _next_data_offset_to_write_summary = 0;
     // Enforces ratio of summary to data of 1 to N.
     size_t _summary_byte_cost = default_summary_byte_cost;
+    stdx::optional<partition_index_model::builder> _index_model_builder;
 private:
     void maybe_add_summary_entry(const dht::token& token, bytes_view key);
     uint64_t get_offset() const;
@@ -836,7 +870,8 @@ class components_writer {
     components_writer(components_writer&& o) : _sst(o._sst), _schema(o._schema), _out(o._out), _index(std::move(o._index)),
             _index_needs_close(o._index_needs_close), _max_sstable_size(o._max_sstable_size), _tombstone_written(o._tombstone_written),
             _first_key(std::move(o._first_key)), _last_key(std::move(o._last_key)), _partition_key(std::move(o._partition_key)),
-            _next_data_offset_to_write_summary(o._next_data_offset_to_write_summary), _summary_byte_cost(o._summary_byte_cost) {
+            _next_data_offset_to_write_summary(o._next_data_offset_to_write_summary), _summary_byte_cost(o._summary_byte_cost),
+            _index_model_builder(std::move(o._index_model_builder)) {
         o._index_needs_close = false;
     }
 
@@ -130,6 +130,7 @@ class time_window_compaction_strategy : public compaction_strategy_impl {
             clogger.debug("Enabling tombstone compactions for TWCS");
         }
         _use_clustering_key_filter = true;
+        _use_time_ordered_reads = true;
     }
 
     virtual compaction_descriptor get_sstables_for_compaction(column_family& cf, std::vector<shared_sstable> candidates) override {
@@ -294,6 +295,25 @@ class time_window_compaction_strategy : public compaction_strategy_impl {
         return _estimated_remaining_tasks;
     }
 
+    // Past windows are compacted into a single sstable at once, and the
+    // current one is compacted with size-tiered compaction.
+    virtual uint64_t estimated_backlog_bytes(column_family& cf) const override {
+        auto buckets = get_buckets(std::vector<shared_sstable>(cf.get_sstables()->begin(), cf.get_sstables()->end()),
+            _options.sstable_window_size).first;
+        uint64_t backlog = 0;
+        for (auto& key_bucket : buckets) {
+            auto& bucket = key_bucket.second;
+            if (key_bucket.first >= _highest_window_seen) {
+                backlog += size_tiered_backlog(bucket, cf.schema()->min_compaction_threshold());
+            } else if (bucket.size() >= 2) {
+                for (auto& sst : bucket) {
+                    backlog += sst->data_size();
+                }
+            }
+        }
+        return backlog;
+    }
+
     virtual compaction_strategy_type type() const {
         return compaction_strategy_type::time_window;
     }
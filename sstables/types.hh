@@ -31,6 +31,7 @@
 #include "column_name_helper.hh"
 #include "sstables/key.hh"
 #include "db/commitlog/replay_position.hh"
+#include "byte_comparable.hh"
 #include <vector>
 #include <unordered_map>
 #include <type_traits>
@@ -102,9 +103,20 @@ struct promoted_index {
         composite_view end;
         uint64_t offset;
         uint64_t width;
+        // Location of the encoding of start in encoded_starts.
+        uint32_t encoded_start_offset = 0;
+        uint32_t encoded_start_size = 0;
     };
     deletion_time del_time;
     std::deque<entry> entries;
+    // Byte-comparable encodings of all block starts, if the promoted index
+    // was parsed with an encoder.
+    bool has_encoded_starts = false;
+    bytes encoded_starts;
+
+    bytes_view encoded_start(const entry& e) const {
+        return bytes_view(encoded_starts).substr(e.encoded_start_offset, e.encoded_start_size);
+    }
 };
 
 class promoted_index_view {
@@ -112,7 +124,8 @@ class promoted_index_view {
 public:
     explicit promoted_index_view(bytes_view v) : _bytes(v) {}
     sstables::deletion_time get_deletion_time() const;
-    promoted_index parse(const schema&) const;
+    // If encoder is given, the block starts are encoded, once, when parsing.
+    promoted_index parse(const schema&, const byte_comparable_encoder* encoder = nullptr) const;
     explicit operator bool() const { return !_bytes.empty(); }
 };
 
@@ -160,11 +173,11 @@ class index_entry {
         , _promoted_index_bytes(o._promoted_index_bytes.get(), o._promoted_index_bytes.size())
     { }
 
-    promoted_index* get_promoted_index(const schema& s) {
+    promoted_index* get_promoted_index(const schema& s, const byte_comparable_encoder* encoder = nullptr) {
         if (!_promoted_index) {
             auto v = get_promoted_index_view();
             if (v) {
-                _promoted_index = v.parse(s);
+                _promoted_index = v.parse(s, encoder);
             }
         }
         return _promoted_index ? &*_promoted_index : nullptr;
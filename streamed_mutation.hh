@@ -600,6 +600,8 @@ class streamed_mutation {
         bool is_buffer_empty() const { return _buffer.empty(); }
         bool is_buffer_full() const { return _buffer_size >= max_buffer_size_in_bytes; }
 
+        const mutation_fragment& peek_buffer() const { return _buffer.front(); }
+
         mutation_fragment pop_mutation_fragment() {
             auto mf = std::move(_buffer.front());
             _buffer.pop_front();
@@ -642,6 +644,9 @@ class streamed_mutation {
     bool is_buffer_empty() const { return _impl->is_buffer_empty(); }
     bool is_buffer_full() const { return _impl->is_buffer_full(); }
 
+    // Must be called only if !is_buffer_empty().
+    const mutation_fragment& peek_buffer() const { return _impl->peek_buffer(); }
+
     mutation_fragment pop_mutation_fragment() { return _impl->pop_mutation_fragment(); }
 
     future<> fill_buffer() { return _impl->fill_buffer(); }
@@ -68,11 +68,14 @@ boost_tests = [
     'config_test',
     'dynamic_bitset_test',
     'gossip_test',
+    'messaging_service_test',
+    'write_coalescer_test',
     'managed_vector_test',
     'map_difference_test',
     'memtable_test',
     'mutation_query_test',
     'snitch_reset_test',
+    'dynamic_snitch_test',
     'auth_test',
     'idl_test',
     'range_tombstone_list_test',
@@ -20,12 +20,14 @@
  */
 
 #include "counters.hh"
+#include "counter_cache.hh"
 
 #include <random>
 
 #include <seastar/core/thread.hh>
 
 #include <boost/range/algorithm/sort.hpp>
+#include <boost/range/irange.hpp>
 
 #include "tests/test-utils.hh"
 #include "tests/test_services.hh"
@@ -465,6 +467,135 @@ SEASTAR_TEST_CASE(test_transfer_updates_to_shards) {
     });
 }
 
+SEASTAR_TEST_CASE(test_counter_cache) {
+    return seastar::async([] {
+        storage_service_for_tests ssft;
+
+        auto s = get_schema();
+
+        auto pk = partition_key::from_single_value(*s, int32_type->decompose(0));
+        auto ck = clustering_key::from_single_value(*s, int32_type->decompose(0));
+        auto& col = *s->get_column_definition(utf8_type->decompose(sstring("c1")));
+        auto& scol = *s->get_column_definition(utf8_type->decompose(sstring("s1")));
+
+        auto make_update = [&] (int64_t c, int64_t sc) {
+            mutation m(pk, s);
+            m.set_clustered_cell(ck, col, atomic_cell::make_live_counter_update(api::new_timestamp(), c));
+            m.set_static_cell(scol, atomic_cell::make_live_counter_update(api::new_timestamp(), sc));
+            return m;
+        };
+
+        counter_cache_tracker tracker(1 << 20);
+        counter_cache cc(s, tracker);
+
+        // Slow path, as database::do_apply_counter_update() does it.
+        stdx::optional<mutation> state;
+        auto apply_slow = [&] (mutation m) {
+            cc.prepare_for_read(m).get();
+            transform_counter_updates_to_shards(m, state ? &*state : nullptr, 0);
+            auto w = cc.populate(m);
+            if (state) {
+                state->apply(m);
+            } else {
+                state = m;
+            }
+            w.complete(true);
+        };
+
+        auto m = make_update(5, 4);
+        BOOST_REQUIRE(!cc.transform_counter_updates_to_shards(m, 0));
+        BOOST_REQUIRE_EQUAL(tracker.stats().misses, 1);
+        apply_slow(m);
+        BOOST_REQUIRE_EQUAL(tracker.stats().cells, 2);
+
+        // Hits transform updates exactly as the slow path would have.
+        for (auto i : boost::irange(0, 3)) {
+            auto update = make_update(9 + i, 8 + i);
+            auto expected = update;
+            transform_counter_updates_to_shards(expected, &*state, 0);
+            auto w = cc.transform_counter_updates_to_shards(update, 0);
+            BOOST_REQUIRE(w);
+            BOOST_REQUIRE_EQUAL(update, expected);
+            state->apply(update);
+            w->complete(true);
+        }
+        BOOST_REQUIRE_EQUAL(tracker.stats().hits, 3);
+        BOOST_REQUIRE_EQUAL(counter_cell_view(get_counter_cell(*state)).total_value(), 5 + 9 + 10 + 11);
+        BOOST_REQUIRE_EQUAL(counter_cell_view(get_static_counter_cell(*state)).total_value(), 4 + 8 + 9 + 10);
+
+        // A failed write invalidates the cells it used.
+        m = make_update(1, 1);
+        auto w = cc.transform_counter_updates_to_shards(m, 0);
+        BOOST_REQUIRE(w);
+        w->complete(false);
+        BOOST_REQUIRE_EQUAL(tracker.stats().cells, 0);
+        BOOST_REQUIRE_EQUAL(tracker.stats().memory, 0);
+        m = make_update(1, 1);
+        BOOST_REQUIRE(!cc.transform_counter_updates_to_shards(m, 0));
+
+        // Tombstones invalidate the partition.
+        apply_slow(make_update(1, 1));
+        BOOST_REQUIRE_EQUAL(tracker.stats().cells, 2);
+        mutation del(pk, s);
+        del.partition().apply(tombstone(api::new_timestamp(), gc_clock::now()));
+        cc.invalidate(*s, freeze(del));
+        BOOST_REQUIRE_EQUAL(tracker.stats().cells, 0);
+        m = make_update(1, 1);
+        BOOST_REQUIRE(!cc.transform_counter_updates_to_shards(m, 0));
+
+        // The slow path waits for the updates in flight.
+        apply_slow(make_update(1, 1));
+        m = make_update(1, 1);
+        w = cc.transform_counter_updates_to_shards(m, 0);
+        BOOST_REQUIRE(w);
+        auto f = cc.prepare_for_read(make_update(1, 1));
+        BOOST_REQUIRE(!f.available());
+        BOOST_REQUIRE_EQUAL(tracker.stats().cells, 2);
+        w->complete(true);
+        f.get();
+        BOOST_REQUIRE_EQUAL(tracker.stats().cells, 0);
+        BOOST_REQUIRE_EQUAL(tracker.stats().memory, 0);
+    });
+}
+
+SEASTAR_TEST_CASE(test_counter_cache_eviction) {
+    return seastar::async([] {
+        storage_service_for_tests ssft;
+
+        auto s = get_schema();
+        auto& col = *s->get_column_definition(utf8_type->decompose(sstring("c1")));
+        auto ck = clustering_key::from_single_value(*s, int32_type->decompose(0));
+
+        // Room for a handful of cells only.
+        counter_cache_tracker tracker(1024);
+        {
+            counter_cache cc(s, tracker);
+            for (auto i : boost::irange(0, 100)) {
+                auto pk = partition_key::from_single_value(*s, int32_type->decompose(i));
+                mutation m(pk, s);
+                m.set_clustered_cell(ck, col, atomic_cell::make_live_counter_update(api::new_timestamp(), 1));
+                cc.prepare_for_read(m).get();
+                transform_counter_updates_to_shards(m, nullptr, 0);
+                cc.populate(m).complete(true);
+                BOOST_REQUIRE_LE(tracker.stats().memory, 1024);
+            }
+            BOOST_REQUIRE_GT(tracker.stats().evictions, 0);
+            BOOST_REQUIRE_GT(tracker.stats().cells, 0);
+            BOOST_REQUIRE_EQUAL(tracker.stats().cells + tracker.stats().evictions, 100);
+
+            // The most recently used cell is still there.
+            auto pk = partition_key::from_single_value(*s, int32_type->decompose(99));
+            mutation m(pk, s);
+            m.set_clustered_cell(ck, col, atomic_cell::make_live_counter_update(api::new_timestamp(), 1));
+            auto w = cc.transform_counter_updates_to_shards(m, 0);
+            BOOST_REQUIRE(w);
+            w->complete(true);
+        }
+        BOOST_REQUIRE_EQUAL(tracker.stats().memory, 0);
+        BOOST_REQUIRE_EQUAL(tracker.stats().cells, 0);
+    });
+}
+
 SEASTAR_TEST_CASE(test_sanitize_corrupted_cells) {
     return seastar::async([] {
         std::random_device rd;
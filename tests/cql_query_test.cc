@@ -29,11 +29,13 @@
 #include "tests/test-utils.hh"
 #include "tests/cql_test_env.hh"
 #include "tests/cql_assertions.hh"
+#include "tests/mutation_assertions.hh"
 
 #include "core/future-util.hh"
 #include "core/sleep.hh"
 #include "transport/messages/result_message.hh"
 #include "utils/big_decimal.hh"
+#include "tracing/trace_row_builder.hh"
 
 #include "disk-error-handler.hh"
 
@@ -2389,3 +2391,83 @@ SEASTAR_TEST_CASE(test_pg_style_string_literal) {
         });
     });
 }
+
+SEASTAR_TEST_CASE(test_trivial_selection_is_serialized) {
+    return do_with_cql_env_thread([] (cql_test_env& e) {
+        e.execute_cql("create table cf (p int, c text, v blob, s int static, PRIMARY KEY (p, c));").get();
+        e.execute_cql("insert into cf (p, c, v, s) values (1, 'a', 0x01, 7);").get();
+        e.execute_cql("insert into cf (p, c) values (1, 'b');").get();
+        e.execute_cql("insert into cf (p, s) values (2, 8);").get();
+
+        auto serialized_rows = [] (shared_ptr<cql_transport::messages::result_message> msg) {
+            auto rows = dynamic_pointer_cast<cql_transport::messages::result_message::rows>(msg);
+            BOOST_REQUIRE(rows);
+            return rows->rs().serialized_rows();
+        };
+
+        auto msg = e.execute_cql("select p, c, v, s from cf where p = 1;").get0();
+        BOOST_REQUIRE(serialized_rows(msg));
+        assert_that(msg).is_rows().with_rows({
+            { int32_type->decompose(1), utf8_type->decompose(sstring("a")), bytes_type->decompose(bytes("\x01")), int32_type->decompose(7) },
+            { int32_type->decompose(1), utf8_type->decompose(sstring("b")), {}, int32_type->decompose(7) },
+        });
+
+        msg = e.execute_cql("select s, c, p from cf where p = 2;").get0();
+        BOOST_REQUIRE(serialized_rows(msg));
+        assert_that(msg).is_rows().with_rows({
+            { int32_type->decompose(8), {}, int32_type->decompose(2) },
+        });
+
+        msg = e.execute_cql("select writetime(v) from cf where p = 1;").get0();
+        BOOST_REQUIRE(!serialized_rows(msg));
+
+        // c is fetched for ordering only, and must not be sent.
+        e.execute_cql("create table cf2 (p int, c int, v int, PRIMARY KEY (p, c));").get();
+        e.execute_cql("insert into cf2 (p, c, v) values (1, 2, 20);").get();
+        e.execute_cql("insert into cf2 (p, c, v) values (2, 1, 10);").get();
+        msg = e.execute_cql("select v from cf2 where p in (1, 2) order by c;").get0();
+        BOOST_REQUIRE(!serialized_rows(msg));
+        assert_that(msg).is_rows().with_size(2);
+    });
+}
+
+// Trace records are written as mutations built directly, which must be the
+// same as the ones their INSERT ... USING TTL statements would make.
+SEASTAR_TEST_CASE(test_trace_row_builder_matches_insert) {
+    return do_with_cql_env_thread([] (cql_test_env& e) {
+        e.execute_cql("create table ks.traces (p int, c int, v text, m map<text, text>, primary key (p, c)) "
+                      "with default_time_to_live = 86400;").get();
+        auto& db = e.local_db();
+        auto s = db.find_schema("ks", "traces");
+        auto map_type = map_type_impl::get_instance(utf8_type, utf8_type, true);
+
+        int32_t p = 0;
+        auto check = [&] (int ttl) {
+            while (true) {
+                // Expiry times depend on the time of the write, so retry
+                // until both are made within the same second.
+                auto now = gc_clock::now();
+                e.execute_cql(sprint("insert into ks.traces (p, c, v, m) values (%d, 1, 'a', {'k': 'v'}) using timestamp 1000 and ttl %d;", p, ttl)).get();
+                if (gc_clock::now() != now) {
+                    ++p;
+                    continue;
+                }
+                auto pk = partition_key::from_single_value(*s, int32_type->decompose(p++));
+                mutation expected(pk, s);
+                tracing::trace_row_builder(expected, clustering_key::from_single_value(*s, int32_type->decompose(1)), 1000, std::chrono::seconds(ttl), now)
+                    .set("v", utf8_type, utf8_type->decompose(sstring("a")))
+                    .set_collection("m", map_type, {{utf8_type->decompose(sstring("k")), utf8_type->decompose(sstring("v"))}});
+
+                auto pr = dht::partition_range::make_singular(dht::global_partitioner().decorate_key(*s, std::move(pk)));
+                auto reader = db.find_column_family(s).make_reader(s, pr);
+                auto m = mutation_from_streamed_mutation(reader().get0()).get0();
+                BOOST_REQUIRE(m);
+                assert_that(*m).is_equal_to(expected);
+                return;
+            }
+        };
+        check(100);
+        // No TTL stands for the table's default.
+        check(0);
+    });
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2017 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <boost/test/unit_test.hpp>
+
+#include "tests/test-utils.hh"
+#include "locator/dynamic_snitch.hh"
+#include "locator/snitch_base.hh"
+#include "utils/fb_utilities.hh"
+#include <seastar/util/defer.hh>
+
+#include "disk-error-handler.hh"
+
+thread_local disk_error_signal_type commit_error;
+thread_local disk_error_signal_type general_disk_error;
+
+namespace locator {
+
+class dynamic_snitch_test {
+public:
+    static void set_latency(dynamic_snitch& ds, gms::inet_address ep, double latency_us) {
+        ds.get_endpoint(ep).latency_us = latency_us;
+        ds.update_scores();
+    }
+
+    static bool knows(const dynamic_snitch& ds, gms::inet_address ep) {
+        return ds._endpoints.count(ep);
+    }
+};
+
+}
+
+using locator::dynamic_snitch_test;
+using addresses = std::vector<gms::inet_address>;
+
+// RackInferringSnitch puts 10.1.1.x and 10.2.2.x into different datacenters.
+static const gms::inet_address a1("10.1.1.1");
+static const gms::inet_address a2("10.1.1.2");
+static const gms::inet_address a3("10.1.1.3");
+static const gms::inet_address b1("10.2.2.1");
+static const gms::inet_address b2("10.2.2.2");
+
+template <typename Func>
+static future<> with_snitch(Func&& func) {
+    return seastar::async([func = std::forward<Func>(func)] () mutable {
+        utils::fb_utilities::set_broadcast_address(a1);
+        locator::i_endpoint_snitch::create_snitch("RackInferringSnitch").get();
+        auto stop_snitch = defer([] { locator::i_endpoint_snitch::stop_snitch().get(); });
+        BOOST_REQUIRE(locator::i_endpoint_snitch::get_local_snitch_ptr()->get_datacenter(a1)
+                != locator::i_endpoint_snitch::get_local_snitch_ptr()->get_datacenter(b1));
+        locator::dynamic_snitch ds(locator::dynamic_snitch::config{});
+        func(ds);
+    });
+}
+
+static addresses sorted(const locator::dynamic_snitch& ds, addresses eps) {
+    ds.sort_by_score(eps);
+    return eps;
+}
+
+SEASTAR_TEST_CASE(test_static_order_is_kept_without_measurements) {
+    return with_snitch([] (locator::dynamic_snitch& ds) {
+        BOOST_REQUIRE(sorted(ds, {a3, a1, a2}) == addresses({a3, a1, a2}));
+    });
+}
+
+SEASTAR_TEST_CASE(test_static_order_is_kept_within_badness_threshold) {
+    return with_snitch([] (locator::dynamic_snitch& ds) {
+        dynamic_snitch_test::set_latency(ds, a1, 105);
+        dynamic_snitch_test::set_latency(ds, a2, 100);
+        BOOST_REQUIRE(sorted(ds, {a1, a2}) == addresses({a1, a2}));
+        dynamic_snitch_test::set_latency(ds, a1, 200);
+        BOOST_REQUIRE(sorted(ds, {a1, a2}) == addresses({a2, a1}));
+    });
+}
+
+SEASTAR_TEST_CASE(test_replicas_are_reordered_within_datacenters) {
+    return with_snitch([] (locator::dynamic_snitch& ds) {
+        dynamic_snitch_test::set_latency(ds, a2, 100);
+        dynamic_snitch_test::set_latency(ds, a3, 1000);
+        dynamic_snitch_test::set_latency(ds, b1, 10);
+        dynamic_snitch_test::set_latency(ds, b2, 1);
+        BOOST_REQUIRE(sorted(ds, {a3, a2, b1, b2}) == addresses({a2, a3, b2, b1}));
+    });
+}
+
+SEASTAR_TEST_CASE(test_unmeasured_replicas_score_like_the_median) {
+    return with_snitch([] (locator::dynamic_snitch& ds) {
+        dynamic_snitch_test::set_latency(ds, a2, 100);
+        dynamic_snitch_test::set_latency(ds, a3, 1000);
+        dynamic_snitch_test::set_latency(ds, b1, 10);
+        // a1 is not measured, so it must not be taken for the fastest one,
+        // nor does it count as clearly worse than a measured one.
+        BOOST_REQUIRE(sorted(ds, {a3, a1, a2}) == addresses({a2, a3, a1}));
+        BOOST_REQUIRE(sorted(ds, {a1, a3}) == addresses({a1, a3}));
+        // b2 only shares its datacenter with b1, whose score it takes.
+        BOOST_REQUIRE(sorted(ds, {b2, b1}) == addresses({b2, b1}));
+    });
+}
+
+SEASTAR_TEST_CASE(test_removed_endpoint_is_forgotten) {
+    return with_snitch([] (locator::dynamic_snitch& ds) {
+        auto started = ds.request_started(a1);
+        BOOST_REQUIRE(dynamic_snitch_test::knows(ds, a1));
+        ds.remove_endpoint(a1);
+        BOOST_REQUIRE(!dynamic_snitch_test::knows(ds, a1));
+        // A request in flight when it left doesn't bring it back.
+        ds.request_completed(a1, started);
+        BOOST_REQUIRE(!dynamic_snitch_test::knows(ds, a1));
+    });
+}
@@ -27,6 +27,8 @@
 #include "schema.hh"
 #include "schema_builder.hh"
 #include "types.hh"
+#include "clustering_ordering_prefix.hh"
+#include "byte_comparable.hh"
 
 #include "idl/keys.dist.hh"
 #include "serializer_impl.hh"
@@ -160,3 +162,125 @@ BOOST_AUTO_TEST_CASE(test_serialization) {
 
     BOOST_REQUIRE(key.equal(*s, reserialize(key)));
 }
+
+BOOST_AUTO_TEST_CASE(test_clustering_ordering_prefix) {
+    auto check = [] (data_type type, std::vector<bytes> values) {
+        auto s = schema_builder("ks", "cf")
+                .with_column("pk", bytes_type, column_kind::partition_key)
+                .with_column("ck1", type, column_kind::clustering_key)
+                .with_column("ck2", bytes_type, column_kind::clustering_key)
+                .build();
+        auto enc = clustering_ordering_prefix::for_schema(*s);
+        BOOST_REQUIRE(enc != clustering_ordering_prefix::encoding::none);
+        auto cmp = clustering_key::tri_compare(*s);
+        for (auto&& a : values) {
+            for (auto&& b : values) {
+                auto ka = clustering_key::from_exploded(*s, {a, bytes("x")});
+                auto kb = clustering_key::from_exploded(*s, {b, bytes("y")});
+                clustering_ordering_prefix::value_type pa, pb;
+                BOOST_REQUIRE(clustering_ordering_prefix::of_key(enc, ka.representation(), pa));
+                BOOST_REQUIRE(clustering_ordering_prefix::of_key(enc, kb.representation(), pb));
+                if (cmp(ka, kb) < 0) {
+                    BOOST_REQUIRE_LE(pa, pb);
+                }
+            }
+        }
+    };
+
+    auto ints = std::vector<bytes>{bytes()};
+    for (auto v : {std::numeric_limits<int32_t>::min(), -1000, -1, 0, 1, 1000, std::numeric_limits<int32_t>::max()}) {
+        ints.push_back(int32_type->decompose(v));
+    }
+    check(int32_type, ints);
+    check(reversed_type_impl::get_instance(int32_type), ints);
+
+    auto longs = std::vector<bytes>{bytes()};
+    for (auto v : {std::numeric_limits<int64_t>::min(), int64_t(-1), int64_t(0), int64_t(1) << 40, std::numeric_limits<int64_t>::max()}) {
+        longs.push_back(long_type->decompose(v));
+    }
+    check(long_type, longs);
+    check(reversed_type_impl::get_instance(long_type), longs);
+
+    auto blobs = std::vector<bytes>{bytes(), bytes("a"), bytes("ab"), to_bytes(sstring("ab\0", 3)), bytes("abcdefghij"), bytes("abcdefghik"), bytes("b"), bytes("\xff")};
+    check(bytes_type, blobs);
+    check(utf8_type, {bytes(), bytes("a"), bytes("abcdefgh"), bytes("abcdefghi"), bytes("b")});
+    check(reversed_type_impl::get_instance(bytes_type), blobs);
+
+    auto s = schema_builder("ks", "cf")
+            .with_column("pk", bytes_type, column_kind::partition_key)
+            .with_column("ck", uuid_type, column_kind::clustering_key)
+            .build();
+    BOOST_REQUIRE(clustering_ordering_prefix::for_schema(*s) == clustering_ordering_prefix::encoding::none);
+}
+
+BOOST_AUTO_TEST_CASE(test_byte_comparable_encoding) {
+    auto s = schema_builder("ks", "cf")
+            .with_column("pk", bytes_type, column_kind::partition_key)
+            .with_column("ck1", int32_type, column_kind::clustering_key)
+            .with_column("ck2", reversed_type_impl::get_instance(utf8_type), column_kind::clustering_key)
+            .build();
+    byte_comparable_encoder enc(*s);
+    BOOST_REQUIRE(enc.supported());
+
+    auto ck1s = std::vector<bytes>{bytes(), int32_type->decompose(-1), int32_type->decompose(0), int32_type->decompose(7)};
+    auto ck2s = std::vector<bytes>{bytes(), bytes("a"), to_bytes(sstring("a\0", 2)), bytes("ab")};
+    std::vector<std::vector<bytes>> prefixes = {{}};
+    for (auto&& ck1 : ck1s) {
+        prefixes.push_back({ck1});
+        for (auto&& ck2 : ck2s) {
+            prefixes.push_back({ck1, ck2});
+        }
+    }
+
+    std::vector<position_in_partition> positions;
+    std::vector<composite> composites;
+    positions.emplace_back(position_in_partition::static_row_tag_t());
+    composites.push_back(composite::static_prefix(*s));
+    for (auto&& p : prefixes) {
+        auto ck = clustering_key_prefix::from_exploded(*s, p);
+        positions.emplace_back(position_in_partition::range_tag_t(), bound_view(ck, bound_kind::incl_start));
+        positions.emplace_back(position_in_partition::after_clustering_row_tag_t(), ck);
+        if (p.size() == s->clustering_key_size()) {
+            positions.emplace_back(position_in_partition::clustering_row_tag_t(), ck);
+        }
+        auto values = std::vector<bytes_view>(p.begin(), p.end());
+        if (!values.empty()) {
+            for (auto eoc : {composite::eoc::start, composite::eoc::none, composite::eoc::end}) {
+                composites.push_back(composite::from_exploded(values, eoc));
+            }
+        }
+    }
+
+    auto sign = [] (int c) { return c < 0 ? -1 : c > 0 ? 1 : 0; };
+    auto cmp = position_in_partition::composite_tri_compare(*s);
+    for (auto&& a : positions) {
+        for (auto&& b : positions) {
+            BOOST_REQUIRE_EQUAL(sign(cmp(a, b)), sign(byte_comparable_encoder::compare(enc.encode(a), enc.encode(b))));
+        }
+        for (auto&& c : composites) {
+            BOOST_REQUIRE_EQUAL(sign(cmp(a, composite_view(c))),
+                    sign(byte_comparable_encoder::compare(enc.encode(a), enc.encode(composite_view(c)))));
+        }
+    }
+
+    auto u = schema_builder("ks", "cf")
+            .with_column("pk", bytes_type, column_kind::partition_key)
+            .with_column("ck1", int32_type, column_kind::clustering_key)
+            .with_column("ck2", double_type, column_kind::clustering_key)
+            .build();
+    BOOST_REQUIRE(!byte_comparable_encoder(*u).supported());
+
+    // Sets of byte-ordered types compare element by element, so {"a", "z"}
+    // sorts before {"b"}, unlike their serialized forms.
+    auto set_type = set_type_impl::get_instance(utf8_type, false);
+    auto v = schema_builder("ks", "cf")
+            .with_column("pk", bytes_type, column_kind::partition_key)
+            .with_column("ck", set_type, column_kind::clustering_key)
+            .build();
+    auto az = set_type->decompose(make_set_value(set_type, set_type_impl::native_type({sstring("a"), sstring("z")})));
+    auto b = set_type->decompose(make_set_value(set_type, set_type_impl::native_type({sstring("b")})));
+    BOOST_REQUIRE_LT(set_type->compare(az, b), 0);
+    BOOST_REQUIRE_GT(compare_unsigned(az, b), 0);
+    BOOST_REQUIRE(clustering_ordering_prefix::for_schema(*v) == clustering_ordering_prefix::encoding::none);
+    BOOST_REQUIRE(!byte_comparable_encoder(*v).supported());
+}
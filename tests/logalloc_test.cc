@@ -1194,3 +1194,54 @@ SEASTAR_TEST_CASE(test_reclaiming_runs_as_long_as_there_is_soft_pressure) {
         });
     });
 }
+
+SEASTAR_TEST_CASE(test_reclaim_on_idle_tops_up_reserve) {
+    return seastar::async([] {
+#ifndef DEFAULT_ALLOCATOR // Because we need memory::stats().free_memory();
+        region r;
+        std::vector<managed_bytes> objs;
+
+        r.make_evictable([&] {
+            if (objs.empty()) {
+                return memory::reclaiming_result::reclaimed_nothing;
+            }
+            with_allocator(r.allocator(), [&] {
+                objs.pop_back();
+            });
+            return memory::reclaiming_result::reclaimed_something;
+        });
+
+        auto prev_reserve = shard_tracker().idle_reserve();
+        auto restore_reserve = defer([&] { shard_tracker().set_idle_reserve(prev_reserve); });
+
+        auto free_segments = memory::stats().free_memory() / logalloc::segment_size;
+        with_allocator(r.allocator(), [&] {
+            for (int i = 0; i < 64 * 16; ++i) {
+                objs.emplace_back(managed_bytes(managed_bytes::initialized_later(), 16 * 1024));
+            }
+        });
+        BOOST_REQUIRE(memory::stats().free_memory() / logalloc::segment_size < free_segments - 32);
+
+        // Leave some slack for segments which stay in partially used zones
+        auto reserve_segments = free_segments - 16;
+        shard_tracker().set_idle_reserve(reserve_segments);
+        auto reserve = reserve_segments * logalloc::segment_size;
+        auto stats_before = shard_tracker().stats();
+
+        // Yields straight away if there is work waiting
+        auto res = shard_tracker().reclaim_on_idle([] { return true; });
+        BOOST_REQUIRE(res == reactor::idle_cpu_handler_result::interrupted_by_higher_priority_task);
+        BOOST_REQUIRE_EQUAL(shard_tracker().stats().idle_reclaims, stats_before.idle_reclaims);
+
+        res = shard_tracker().reclaim_on_idle([] { return false; });
+        BOOST_REQUIRE(res == reactor::idle_cpu_handler_result::no_more_work);
+        BOOST_REQUIRE(memory::stats().free_memory() >= reserve);
+        BOOST_REQUIRE(shard_tracker().stats().idle_reclaims > stats_before.idle_reclaims);
+        BOOST_REQUIRE_EQUAL(shard_tracker().stats().sync_reclaims, stats_before.sync_reclaims);
+
+        with_allocator(r.allocator(), [&] {
+            objs.clear();
+        });
+#endif
+    });
+}
@@ -161,6 +161,26 @@ static mutation make_mutation(mutation_settings settings) {
     return m;
 }
 
+// Reports the memory used by a row holding cells of every step-th column out
+// of column_count, with values small enough to be stored inline.
+static void print_row_footprint() {
+    std::cout << "row footprint (bytes per row):\n";
+    std::cout << sprint(" %8s %8s %8s %10s\n", "columns", "cells", "bytes", "per cell");
+    for (column_id column_count : {1, 4, 8, 16, 32, 33, 50, 64, 100, 128, 200}) {
+        for (column_id step : {1, 4}) {
+            if (step > column_count) {
+                continue;
+            }
+            row r;
+            for (column_id id = step - 1; id < column_count; id += step) {
+                r.append_cell(id, atomic_cell_or_collection(atomic_cell::make_live(1, bytes(8, 'x'))));
+            }
+            auto bytes = sizeof(row) + r.external_memory_usage();
+            std::cout << sprint(" %8d %8d %8d %10.1f\n", column_count, r.size(), bytes, double(bytes) / r.size());
+        }
+    }
+}
+
 struct sizes {
     size_t memtable;
     size_t cache;
@@ -238,6 +258,9 @@ int main(int argc, char** argv) {
 
             std::cout << "\n";
             size_calculator::print_cache_entry_size();
+
+            std::cout << "\n";
+            print_row_footprint();
         });
       });
     });
@@ -193,6 +193,52 @@ SEASTAR_TEST_CASE(test_virtual_dirty_accounting_on_flush) {
     });
 }
 
+SEASTAR_TEST_CASE(test_memtables_being_flushed_are_not_picked_for_flush) {
+    return seastar::async([] {
+        schema_ptr s = schema_builder("ks", "cf")
+                .with_column("pk", bytes_type, column_kind::partition_key)
+                .with_column("col", bytes_type, column_kind::regular_column)
+                .build();
+
+        dirty_memory_manager mgr;
+        shared_promise<> flushed;
+        auto seal = [&flushed] (memtable_list*& list) {
+            return [&flushed, &list] (flush_permit&&) {
+                list->add_memtable();
+                return flushed.get_shared_future();
+            };
+        };
+        memtable_list* big_ptr = nullptr;
+        memtable_list* small_ptr = nullptr;
+        memtable_list big(seal(big_ptr), [s] { return s; }, &mgr);
+        memtable_list small(seal(small_ptr), [s] { return s; }, &mgr);
+        big_ptr = &big;
+        small_ptr = &small;
+
+        auto fill = [&] (memtable_list& list, size_t cell_size) {
+            for (auto&& m : make_ring(s, 3)) {
+                m.set_clustered_cell(clustering_key::make_empty(), to_bytes("col"),
+                                     data_value(bytes(bytes::initialized_later(), cell_size)), next_timestamp());
+                list.active_memtable().apply(m);
+            }
+        };
+        fill(big, 64 * 1024);
+        fill(small, 1024);
+        BOOST_REQUIRE_EQUAL(mgr.memtable_list_to_flush(), &big);
+
+        auto f = mgr.flush_one(big, mgr.get_flush_permit().get0());
+        BOOST_REQUIRE(big.flush_in_progress());
+        BOOST_REQUIRE_EQUAL(mgr.memtable_list_to_flush(), &small);
+
+        auto f2 = mgr.flush_one(small, mgr.get_flush_permit().get0());
+        BOOST_REQUIRE(!mgr.memtable_list_to_flush());
+
+        flushed.set_value();
+        f.get();
+        f2.get();
+    });
+}
+
 // Reproducer for #1753
 SEASTAR_TEST_CASE(test_partition_version_consistency_after_lsa_compaction_happens) {
     return seastar::async([] {
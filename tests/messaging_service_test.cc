@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2017 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <boost/test/unit_test.hpp>
+
+#include "tests/test-utils.hh"
+#include "message/messaging_service.hh"
+#include "dht/i_partitioner.hh"
+#include "utils/fb_utilities.hh"
+#include "core/sleep.hh"
+
+#include "disk-error-handler.hh"
+
+thread_local disk_error_signal_type commit_error;
+thread_local disk_error_signal_type general_disk_error;
+
+using namespace std::chrono_literals;
+
+namespace netw {
+
+class messaging_service_test {
+public:
+    // Whether requests for verb to id go through a connection to the shard,
+    // rather than the per-node one.
+    static bool routed_to_shard(const messaging_service& ms, messaging_verb verb, msg_addr id) {
+        return ms.client_key(verb, id).first == messaging_service::shard_clients_idx;
+    }
+
+    // Whether the SHARDING_INFO handshake with ep completed, successfully or not.
+    static bool handshake_done(const messaging_service& ms, gms::inet_address ep) {
+        auto it = ms._remote_sharding.find(ep);
+        return it != ms._remote_sharding.end() && (it->second.partitioner || it->second.shard_port);
+    }
+
+    static bool knows_sharding(const messaging_service& ms, gms::inet_address ep) {
+        auto it = ms._remote_sharding.find(ep);
+        return it != ms._remote_sharding.end() && it->second.partitioner;
+    }
+
+    static void disable_sharding_info(messaging_service& ms) {
+        ms.rpc()->unregister_handler(messaging_verb::SHARDING_INFO);
+    }
+};
+
+}
+
+using netw::messaging_service;
+using netw::messaging_service_test;
+using netw::messaging_verb;
+using netw::msg_addr;
+
+static const gms::inet_address local("127.0.0.1");
+static const gms::inet_address remote("127.0.0.2");
+static constexpr uint16_t port = 17000;
+static constexpr uint16_t shard_port = 17100;
+
+static shared_ptr<messaging_service> make_messaging_service(gms::inet_address ip, uint16_t shard_port) {
+    auto ms = seastar::make_shared<messaging_service>(ip, port, false);
+    ms->set_shard_port(shard_port);
+    ms->start_listen();
+    return ms;
+}
+
+// Waits for the handshake shard_of() starts in the background.
+static void wait_for_handshake(messaging_service& ms, gms::inet_address ep) {
+    for (int i = 0; i < 1000 && !messaging_service_test::handshake_done(ms, ep); ++i) {
+        sleep(1ms).get();
+    }
+}
+
+SEASTAR_TEST_CASE(test_sharding_info_handshake) {
+    return seastar::async([] {
+        utils::fb_utilities::set_broadcast_address(local);
+        auto a = make_messaging_service(local, shard_port);
+        auto b = make_messaging_service(remote, shard_port);
+        auto token = dht::global_partitioner().get_random_token();
+        auto id = msg_addr{remote, dht::global_partitioner().shard_of(token)};
+
+        // Until the handshake completes, requests use the per-node connection.
+        BOOST_REQUIRE_EQUAL(a->shard_of(remote, token), 0u);
+        BOOST_REQUIRE(!messaging_service_test::routed_to_shard(*a, messaging_verb::MUTATION, id));
+
+        wait_for_handshake(*a, remote);
+        BOOST_REQUIRE(messaging_service_test::knows_sharding(*a, remote));
+        BOOST_REQUIRE_EQUAL(a->shard_of(remote, token), id.cpu_id);
+        BOOST_REQUIRE(messaging_service_test::routed_to_shard(*a, messaging_verb::MUTATION, id));
+        BOOST_REQUIRE(messaging_service_test::routed_to_shard(*a, messaging_verb::READ_DATA, id));
+        // Only replica requests are routed to shards.
+        BOOST_REQUIRE(!messaging_service_test::routed_to_shard(*a, messaging_verb::GOSSIP_DIGEST_SYN, id));
+        // The remote node learns the sharding of the coordinator too.
+        BOOST_REQUIRE(messaging_service_test::knows_sharding(*b, local));
+
+        // A node which is removed has to be asked again.
+        a->remove_rpc_client(msg_addr{remote, 0});
+        BOOST_REQUIRE(!messaging_service_test::routed_to_shard(*a, messaging_verb::MUTATION, id));
+
+        a->stop().get();
+        b->stop().get();
+    });
+}
+
+SEASTAR_TEST_CASE(test_sharding_info_fallback_to_node_connection) {
+    return seastar::async([] {
+        utils::fb_utilities::set_broadcast_address(local);
+        auto token = dht::global_partitioner().get_random_token();
+        auto id = msg_addr{remote, dht::global_partitioner().shard_of(token)};
+
+        // A node which does not listen on per-shard ports.
+        {
+            auto a = make_messaging_service(local, shard_port);
+            auto b = make_messaging_service(remote, 0);
+            a->shard_of(remote, token);
+            for (int i = 0; i < 1000 && !messaging_service_test::knows_sharding(*a, remote); ++i) {
+                sleep(1ms).get();
+            }
+            BOOST_REQUIRE(messaging_service_test::knows_sharding(*a, remote));
+            BOOST_REQUIRE(!messaging_service_test::routed_to_shard(*a, messaging_verb::MUTATION, id));
+            a->stop().get();
+            b->stop().get();
+        }
+
+        // A node which does not know the verb.
+        {
+            auto a = make_messaging_service(local, shard_port);
+            auto b = make_messaging_service(remote, shard_port);
+            messaging_service_test::disable_sharding_info(*b);
+            a->shard_of(remote, token);
+            // The failed handshake leaves no trace to wait for, so give it time.
+            sleep(100ms).get();
+            BOOST_REQUIRE(!messaging_service_test::knows_sharding(*a, remote));
+            BOOST_REQUIRE_EQUAL(a->shard_of(remote, token), 0u);
+            BOOST_REQUIRE(!messaging_service_test::routed_to_shard(*a, messaging_verb::MUTATION, id));
+            a->stop().get();
+            b->stop().get();
+        }
+    });
+}
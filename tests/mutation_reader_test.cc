@@ -319,6 +319,89 @@ SEASTAR_TEST_CASE(test_fast_forwarding_combining_reader) {
     });
 }
 
+SEASTAR_TEST_CASE(test_prefetching_combining_reader) {
+    return seastar::async([] {
+        auto s = make_schema();
+
+        auto keys = generate_keys(s, 6);
+        auto ring = to_ring_positions(keys);
+
+        std::vector<std::vector<mutation>> mutations {
+            {
+                make_mutation_with_key(s, keys[0]),
+                make_mutation_with_key(s, keys[2]),
+                make_mutation_with_key(s, keys[4]),
+            },
+            {
+                make_mutation_with_key(s, keys[1]),
+                make_mutation_with_key(s, keys[2]),
+                make_mutation_with_key(s, keys[3]),
+            },
+            {
+                make_mutation_with_key(s, keys[0]),
+                make_mutation_with_key(s, keys[3]),
+                make_mutation_with_key(s, keys[5]),
+            },
+        };
+
+        // Lets through only one prefetched buffer at a time.
+        semaphore sem(8 * 1024);
+
+        auto make_reader = [&] (const dht::partition_range& pr, size_t prefetch_budget, semaphore* resources_sem = nullptr) {
+            std::vector<mutation_reader> readers;
+            boost::range::transform(mutations, std::back_inserter(readers), [&pr] (auto& ms) {
+                return make_reader_returning_many(ms, pr);
+            });
+            combined_reader_prefetch prefetch;
+            prefetch.budget = prefetch_budget;
+            prefetch.resources_sem = resources_sem;
+            return make_combined_reader(std::move(readers), mutation_reader::forwarding::yes, std::move(prefetch));
+        };
+
+        // From no prefetching, through a budget for a single partition, to all of them.
+        for (size_t budget : { 0, 8 * 1024, 16 * 1024, 1024 * 1024 }) {
+            BOOST_TEST_MESSAGE(sprint("prefetch budget: %d", budget));
+
+            auto pr = dht::partition_range::make_open_ended_both_sides();
+            auto rd = assert_that(make_reader(pr, budget));
+            for (auto&& k : keys) {
+                rd.produces(make_mutation_with_key(s, k));
+            }
+            rd.produces_end_of_stream();
+
+            pr = dht::partition_range::make(ring[0], ring[1]);
+            assert_that(make_reader(pr, budget))
+                .produces(keys[0])
+                .fast_forward_to(dht::partition_range::make(ring[2], ring[3]))
+                .produces(keys[2])
+                .produces(keys[3])
+                .produces_end_of_stream()
+                .fast_forward_to(dht::partition_range::make_starting_with(ring[5]))
+                .produces(keys[5])
+                .produces_end_of_stream();
+
+            // Dropped with buffers being filled in the background.
+            make_reader(dht::partition_range::make_open_ended_both_sides(), budget)().get0();
+
+            // Fills which can't get their share of the semaphore are not started.
+            {
+                auto units = consume_units(sem, sem.available_units());
+                auto rd = assert_that(make_reader(dht::partition_range::make_open_ended_both_sides(), budget, &sem));
+                for (auto&& k : keys) {
+                    rd.produces(make_mutation_with_key(s, k));
+                }
+                rd.produces_end_of_stream();
+            }
+            auto rd_sem = assert_that(make_reader(dht::partition_range::make_open_ended_both_sides(), budget, &sem));
+            for (auto&& k : keys) {
+                rd_sem.produces(make_mutation_with_key(s, k));
+            }
+            rd_sem.produces_end_of_stream();
+            BOOST_REQUIRE_EQUAL(sem.available_units(), 8 * 1024);
+        }
+    });
+}
+
 SEASTAR_TEST_CASE(test_multi_range_reader) {
         return seastar::async([] {
             auto s = make_schema();
@@ -1581,3 +1581,70 @@ SEASTAR_TEST_CASE(test_continuity_merging) {
         }
     });
 }
+
+SEASTAR_TEST_CASE(test_wide_row_cells) {
+    return seastar::async([] {
+        const column_id column_count = 200;
+        auto builder = schema_builder("ks", "cf")
+                .with_column("pk", bytes_type, column_kind::partition_key);
+        for (column_id id = 0; id < column_count; ++id) {
+            builder.with_column(to_bytes(sprint("v%03d", id)), bytes_type);
+        }
+        auto s = builder.build();
+
+        auto make_cell = [] (column_id id, api::timestamp_type ts) {
+            return atomic_cell_or_collection(atomic_cell::make_live(ts, to_bytes(sprint("%d", id))));
+        };
+        auto apply_cell = [&] (row& r, column_id id, api::timestamp_type ts) {
+            r.apply(s->regular_column_at(id), make_cell(id, ts));
+        };
+
+        std::vector<column_id> even;
+        for (column_id id = 0; id < column_count; id += 2) {
+            even.push_back(id);
+        }
+        std::shuffle(even.begin(), even.end(), std::default_random_engine(0));
+
+        row evens;
+        for (auto id : even) {
+            apply_cell(evens, id, 1);
+        }
+        BOOST_REQUIRE_EQUAL(evens.size(), column_count / 2);
+
+        row odds;
+        for (column_id id = 1; id < column_count; id += 2) {
+            odds.append_cell(id, make_cell(id, 3));
+        }
+
+        row all;
+        for (column_id id = 0; id < column_count; ++id) {
+            apply_cell(all, id, id % 2 ? 3 : 1);
+        }
+
+        column_id expected = 0;
+        all.for_each_cell([&] (column_id id, const atomic_cell_or_collection& c) {
+            BOOST_REQUIRE_EQUAL(id, expected++);
+            BOOST_REQUIRE(c == make_cell(id, id % 2 ? 3 : 1));
+        });
+        BOOST_REQUIRE_EQUAL(expected, column_count);
+        for (column_id id = 0; id < column_count; ++id) {
+            BOOST_REQUIRE_EQUAL(bool(evens.find_cell(id)), id % 2 == 0);
+            BOOST_REQUIRE_EQUAL(bool(odds.find_cell(id)), id % 2 == 1);
+        }
+
+        auto merged = evens;
+        merged.apply(*s, column_kind::regular_column, odds);
+        BOOST_REQUIRE(merged == all);
+
+        auto merged_from_rvalue = odds;
+        merged_from_rvalue.apply(*s, column_kind::regular_column, row(evens));
+        BOOST_REQUIRE(merged_from_rvalue == all);
+
+        BOOST_REQUIRE(all.difference(*s, column_kind::regular_column, evens) == odds);
+
+        auto compacted = all;
+        auto tomb = row_tombstone(tombstone(2, gc_clock::now()));
+        BOOST_REQUIRE(compacted.compact_and_expire(*s, column_kind::regular_column, tomb, gc_clock::now(), always_gc, gc_clock::now()));
+        BOOST_REQUIRE(compacted == odds);
+    });
+}
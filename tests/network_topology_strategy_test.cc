@@ -24,6 +24,7 @@
 #include "locator/network_topology_strategy.hh"
 #include "tests/test-utils.hh"
 #include "core/sstring.hh"
+#include "core/thread.hh"
 #include "log.hh"
 #include <vector>
 #include <string>
@@ -304,3 +305,43 @@ SEASTAR_TEST_CASE(NetworkTopologyStrategy_simple) {
 SEASTAR_TEST_CASE(NetworkTopologyStrategy_heavy) {
     return heavy_origin_test();
 }
+
+// Copies of a token_metadata share its contents, and changes made through
+// one copy are not seen through the others.
+SEASTAR_TEST_CASE(token_metadata_versions) {
+    return seastar::async([] {
+        utils::fb_utilities::set_broadcast_address(gms::inet_address("localhost"));
+        utils::fb_utilities::set_broadcast_rpc_address(gms::inet_address("localhost"));
+        i_endpoint_snitch::create_snitch("RackInferringSnitch").get();
+
+        auto make_token = [] (double point) {
+            return token{dht::token::kind::key, {(int8_t*)d2t(point).data(), 8}};
+        };
+        auto ep1 = inet_address("192.100.10.1");
+        auto ep2 = inet_address("192.100.20.1");
+
+        token_metadata tm;
+        tm.update_normal_token(make_token(0.25), ep1);
+        auto version = tm;
+        BOOST_REQUIRE_EQUAL(&tm.sorted_tokens(), &version.sorted_tokens());
+
+        tm.update_normal_token(make_token(0.5), ep2);
+        tm.add_leaving_endpoint(ep1);
+        BOOST_REQUIRE_EQUAL(tm.sorted_tokens().size(), 2u);
+        BOOST_REQUIRE(tm.is_leaving(ep1));
+        BOOST_REQUIRE_EQUAL(version.sorted_tokens().size(), 1u);
+        BOOST_REQUIRE(!version.is_member(ep2));
+        BOOST_REQUIRE(!version.is_leaving(ep1));
+
+        // Other shards read the version of this one, and the last reference
+        // may be dropped on any of them.
+        smp::submit_to(smp::count - 1, [version = std::move(version), ep1] () mutable {
+            BOOST_REQUIRE_EQUAL(version.sorted_tokens().size(), 1u);
+            BOOST_REQUIRE(version.pending_endpoints_for(version.sorted_tokens().front(), "ks").empty());
+            BOOST_REQUIRE(version.is_member(ep1));
+            version = token_metadata();
+        }).get();
+
+        i_endpoint_snitch::stop_snitch().get();
+    });
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2017 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <random>
+#include "utils/bloom_filter.hh"
+#include "utils/i_filter.hh"
+#include "tests/perf/perf.hh"
+
+#include "disk-error-handler.hh"
+
+thread_local disk_error_signal_type commit_error;
+thread_local disk_error_signal_type general_disk_error;
+
+volatile uint64_t black_hole;
+
+static std::vector<utils::hashed_key> make_keys(unsigned count, uint64_t first) {
+    std::vector<utils::hashed_key> keys;
+    keys.reserve(count);
+    for (uint64_t i = first; i < first + count; i++) {
+        keys.emplace_back(utils::make_hashed_key(bytes_view(reinterpret_cast<const int8_t*>(&i), sizeof(i))));
+    }
+    return keys;
+}
+
+// Probes are by hashed key, so that only the filter lookup is timed, and in
+// random order over a filter much larger than the CPU caches, as is the case
+// for the filters of large sstables.
+static void run(const char* name, utils::filter_ptr f, double fp_chance, double predicted_fp, unsigned elements) {
+    auto present = make_keys(elements, 0);
+    for (uint64_t i = 0; i < elements; i++) {
+        f->add(bytes_view(reinterpret_cast<const int8_t*>(&i), sizeof(i)));
+    }
+    auto absent = make_keys(elements, elements);
+    size_t false_positives = 0;
+    for (auto&& k : absent) {
+        false_positives += f->is_present(k);
+    }
+    std::cout << sprint("%-7s fp_chance %.4f: %.2f MB, false positive rate %.5f (predicted %.5f)\n", name, fp_chance,
+            f->memory_size() / 1e6, double(false_positives) / elements, predicted_fp);
+
+    std::mt19937 rnd(1234);
+    std::uniform_int_distribution<size_t> dist(0, elements - 1);
+    uint64_t sink = 0;
+    std::cout << "  present keys, probes/s: ";
+    time_it([&] {
+        sink += f->is_present(present[dist(rnd)]);
+    }, 3);
+    std::cout << "  absent keys, probes/s: ";
+    time_it([&] {
+        sink += f->is_present(absent[dist(rnd)]);
+    }, 3);
+    black_hole = sink;
+}
+
+int main(int argc, char* argv[]) {
+    unsigned elements = argc > 1 ? std::stoul(argv[1]) : 10000000;
+
+    for (auto fp_chance : { 0.1, 0.01, 0.001 }) {
+        auto buckets = utils::bloom_calculations::max_buckets_per_element(elements);
+        auto spec = utils::bloom_calculations::compute_bloom_spec(buckets, fp_chance);
+        run("classic", utils::i_filter::get_filter(elements, fp_chance), fp_chance,
+                utils::bloom_calculations::probs[spec.buckets_per_element][spec.K], elements);
+
+        auto blocked_buckets = utils::bloom_calculations::blocked_buckets_per_element(fp_chance);
+        run("blocked", utils::i_filter::get_blocked_filter(elements, fp_chance), fp_chance,
+                utils::bloom_calculations::blocked_false_positive_rate(blocked_buckets), elements);
+    }
+}
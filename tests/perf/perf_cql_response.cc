@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2015 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <boost/range/irange.hpp>
+
+#include "transport/response.hh"
+#include "tests/perf/perf.hh"
+
+#include "disk-error-handler.hh"
+
+thread_local disk_error_signal_type commit_error;
+thread_local disk_error_signal_type general_disk_error;
+
+using namespace cql_transport;
+
+// Builds a RESULT frame with a page of rows, as a SELECT would, and turns it
+// into the message sent to the client.
+static net::packet make_rows_page(unsigned rows, unsigned columns, const bytes& cell, cql_compression compression) {
+    cql_server::response r(0, cql_binary_opcode::RESULT, tracing::trace_state_ptr());
+    r.write_int(0x0002); // Rows
+    r.write_int(0x0004); // No_metadata
+    r.write_int(columns);
+    r.write_int(rows);
+    for (auto i : boost::irange(0u, rows * columns)) {
+        (void)i;
+        r.write_value(cell);
+    }
+    if (compression != cql_compression::none) {
+        r.compress(compression);
+    }
+    return std::move(r.make_message(4)).release();
+}
+
+static void run(unsigned rows, unsigned columns, size_t cell_size, cql_compression compression, sstring compression_name) {
+    bytes cell(bytes::initialized_later(), cell_size);
+    for (size_t i = 0; i < cell_size; ++i) {
+        cell[i] = 'a' + i % 26;
+    }
+
+    auto p = make_rows_page(rows, columns, cell, compression);
+    size_t largest_fragment = 0;
+    for (auto&& f : p.fragments()) {
+        largest_fragment = std::max(largest_fragment, f.size);
+    }
+    std::cout << sprint("%d rows x %d columns x %d bytes, compression: %s, frame: %d bytes, %d fragments, largest: %d bytes\n",
+            rows, columns, cell_size, compression_name, p.len(), p.nr_frags(), largest_fragment);
+
+    std::cout << "  pages/s: ";
+    time_it([&] {
+        make_rows_page(rows, columns, cell, compression);
+    }, 1, 1);
+}
+
+int main(int argc, char* argv[]) {
+    for (auto&& c : std::vector<std::pair<cql_compression, sstring>>{
+            {cql_compression::none, "none"}, {cql_compression::lz4, "lz4"}, {cql_compression::snappy, "snappy"}}) {
+        run(100, 4, 16, c.first, c.second);
+        run(10000, 4, 64, c.first, c.second);
+        run(1000, 2, 4096, c.first, c.second);
+    }
+}
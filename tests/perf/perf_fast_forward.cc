@@ -358,6 +358,7 @@ struct table_config {
     sstring name;
     int n_rows;
     int value_size;
+    int n_sstables = 1; // of small_part, relevant only for population
 };
 
 static test_result test_forwarding_with_restriction(column_family& cf, table_config& cfg, bool single_partition) {
@@ -463,29 +464,36 @@ void populate(cql_test_env& env, table_config cfg) {
         cf.compact_all_sstables().get();
     }
 
-    // Small partitions, but lots
-    env.execute_cql("create table small_part (pk int, value blob, primary key (pk))"
-        " WITH compression = { 'sstable_compression' : '' };").get();
+    // Small partitions, but lots. With more than one sstable, each one covers
+    // the whole ring, so that scans merge all of them.
+    env.execute_cql(sprint("create table small_part (pk int, value blob, primary key (pk))"
+        " WITH compression = { 'sstable_compression' : '' }%s;",
+        cfg.n_sstables > 1 ? " AND compaction = { 'class' : 'SizeTieredCompactionStrategy', 'enabled' : 'false' }" : "")).get();
 
     {
-        std::cout << "Populating small_part with " << cfg.n_rows << " partitions...";
+        std::cout << "Populating small_part with " << cfg.n_rows << " partitions in " << cfg.n_sstables << " sstable(s)...";
 
         auto insert_id = env.prepare("update small_part set \"value\" = ? where \"pk\" = ?;").get0();
+        column_family& cf = db.find_column_family("ks", "small_part");
+        auto flush_every = std::max(1, cfg.n_rows / cfg.n_sstables);
 
         for (int pk = 0; pk < cfg.n_rows; ++pk) {
             env.execute_prepared(insert_id, {{
                                                  cql3::raw_value::make_value(data_value(make_blob(cfg.value_size)).serialize()),
                                                  cql3::raw_value::make_value(data_value(pk).serialize())
                                              }}).get();
+            if ((pk + 1) % flush_every == 0 && pk + 1 < cfg.n_rows) {
+                cf.flush().get();
+            }
         }
 
-        column_family& cf = db.find_column_family("ks", "small_part");
-
         std::cout << "flushing...\n";
         cf.flush().get();
 
-        std::cout << "compacting...\n";
-        cf.compact_all_sstables().get();
+        if (cfg.n_sstables == 1) {
+            std::cout << "compacting...\n";
+            cf.compact_all_sstables().get();
+        }
     }
 }
 
@@ -910,6 +918,8 @@ int main(int argc, char** argv) {
         ("rows", bpo::value<int>()->default_value(1000000), "Number of CQL rows in a partition. Relevant only for population.")
         ("value-size", bpo::value<int>()->default_value(100), "Size of value stored in a cell. Relevant only for population.")
         ("name", bpo::value<std::string>()->default_value("default"), "Name of the configuration")
+        ("sstables", bpo::value<int>()->default_value(1), "Number of sstables small_part is split into. Relevant only for population.")
+        ("prefetch-memory-kb", bpo::value<unsigned>()->default_value(0), "Memory per scan for filling partition buffers ahead of time, see sstable_scan_prefetch_memory_in_kb")
         ;
 
     return app.run(argc, argv, [] {
@@ -933,6 +943,7 @@ int main(int argc, char** argv) {
         db_cfg.enable_cache(app.configuration().count("enable-cache"));
         db_cfg.enable_commitlog(false);
         db_cfg.data_file_directories({datadir}, db::config::config_source::CommandLine);
+        db_cfg.sstable_scan_prefetch_memory_in_kb(app.configuration()["prefetch-memory-kb"].as<unsigned>());
 
         if (!app.configuration().count("verbose")) {
             logging::logger_registry().set_all_loggers_level(seastar::log_level::warn);
@@ -950,7 +961,8 @@ int main(int argc, char** argv) {
                 if (app.configuration().count("populate")) {
                     int n_rows = app.configuration()["rows"].as<int>();
                     int value_size = app.configuration()["value-size"].as<int>();
-                    table_config cfg{name, n_rows, value_size};
+                    int n_sstables = app.configuration()["sstables"].as<int>();
+                    table_config cfg{name, n_rows, value_size, std::max(n_sstables, 1)};
                     populate(env, cfg);
                 } else {
                     if (smp::count != 1) {
@@ -964,7 +976,8 @@ int main(int argc, char** argv) {
                     cache_enabled = app.configuration().count("enable-cache");
                     new_test_case = false;
 
-                    std::cout << "Config: rows: " << cfg.n_rows << ", value size: " << cfg.value_size << "\n";
+                    std::cout << "Config: rows: " << cfg.n_rows << ", value size: " << cfg.value_size
+                              << ", prefetch memory: " << app.configuration()["prefetch-memory-kb"].as<unsigned>() << " kB\n";
 
                     sleep(1s).get(); // wait for system table flushes to quiesce
 
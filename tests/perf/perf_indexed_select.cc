@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2017 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <random>
+#include <numeric>
+#include <boost/range/irange.hpp>
+#include <boost/range/algorithm/sort.hpp>
+#include "seastarx.hh"
+#include "core/app-template.hh"
+#include "core/thread.hh"
+#include "core/sleep.hh"
+#include "tests/cql_test_env.hh"
+#include "transport/messages/result_message.hh"
+#include "log.hh"
+
+#include "disk-error-handler.hh"
+
+thread_local disk_error_signal_type commit_error;
+thread_local disk_error_signal_type general_disk_error;
+
+static logging::logger test_log("test");
+
+using clk = std::chrono::steady_clock;
+
+// Column v<i> takes one of cardinalities[i] values, so a query restricted
+// on it selects rows / cardinalities[i] rows.
+static const std::vector<unsigned> cardinalities = { 10000, 1000, 100, 10 };
+
+static void populate(cql_test_env& env, unsigned partitions, unsigned rows_per_partition) {
+    sstring columns = "p int, c int";
+    for (auto i : boost::irange<size_t>(0, cardinalities.size())) {
+        columns += sprint(", v%d int", i);
+    }
+    env.execute_cql(sprint("create table cf (%s, primary key (p, c));", columns)).get();
+    for (auto i : boost::irange<size_t>(0, cardinalities.size())) {
+        env.execute_cql(sprint("create index cf_v%d on cf (v%d);", i, i)).get();
+    }
+
+    test_log.info("Populating {} partitions with {} rows each", partitions, rows_per_partition);
+    sstring names = "p, c";
+    sstring markers = "?, ?";
+    for (auto i : boost::irange<size_t>(0, cardinalities.size())) {
+        names += sprint(", v%d", i);
+        markers += ", ?";
+    }
+    auto id = env.prepare(sprint("insert into cf (%s) values (%s);", names, markers)).get0();
+    std::mt19937 rnd(1234);
+    for (auto p : boost::irange(0u, partitions)) {
+        for (auto c : boost::irange(0u, rows_per_partition)) {
+            std::vector<cql3::raw_value> values;
+            values.push_back(cql3::raw_value::make_value(int32_type->decompose(int32_t(p))));
+            values.push_back(cql3::raw_value::make_value(int32_type->decompose(int32_t(c))));
+            for (auto card : cardinalities) {
+                values.push_back(cql3::raw_value::make_value(int32_type->decompose(int32_t(rnd() % card))));
+            }
+            env.execute_prepared(id, std::move(values)).get();
+        }
+    }
+}
+
+static void run(cql_test_env& env, size_t column, unsigned queries) {
+    auto id = env.prepare(sprint("select * from cf where v%d = ?;", column)).get0();
+    std::mt19937 rnd(4321);
+    std::vector<double> latencies;
+    latencies.reserve(queries);
+    uint64_t rows = 0;
+    for (unsigned i = 0; i < queries; ++i) {
+        auto value = int32_t(rnd() % cardinalities[column]);
+        auto start = clk::now();
+        auto msg = env.execute_prepared(id, {cql3::raw_value::make_value(int32_type->decompose(value))}).get0();
+        latencies.push_back(std::chrono::duration<double, std::milli>(clk::now() - start).count());
+        auto rs = dynamic_pointer_cast<cql_transport::messages::result_message::rows>(msg);
+        if (rs) {
+            rows += rs->rs().size();
+        }
+    }
+    boost::sort(latencies);
+    auto avg = std::accumulate(latencies.begin(), latencies.end(), 0.0) / latencies.size();
+    std::cout << sprint("%10d %12.1f %10.3f %10.3f %10.3f\n", cardinalities[column], double(rows) / queries,
+            avg, latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100]);
+}
+
+int main(int argc, char** argv) {
+    namespace bpo = boost::program_options;
+    app_template app;
+    app.add_options()
+        ("partitions", bpo::value<unsigned>()->default_value(10000), "number of partitions")
+        ("rows-per-partition", bpo::value<unsigned>()->default_value(10), "number of rows in each partition")
+        ("queries", bpo::value<unsigned>()->default_value(1000), "number of queries per indexed column")
+        ;
+
+    return app.run(argc, argv, [&app] {
+        return do_with_cql_env_thread([&app] (cql_test_env& env) {
+            auto& cfg = app.configuration();
+            populate(env, cfg["partitions"].as<unsigned>(), cfg["rows-per-partition"].as<unsigned>());
+            // View updates are asynchronous, let them settle.
+            sleep(std::chrono::seconds(1)).get();
+
+            std::cout << sprint("%10s %12s %10s %10s %10s\n", "values", "rows/query", "avg [ms]", "p50 [ms]", "p99 [ms]");
+            for (auto column : boost::irange<size_t>(0, cardinalities.size())) {
+                run(env, column, cfg["queries"].as<unsigned>());
+            }
+        });
+    });
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2015 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <random>
+
+#include "byte_comparable.hh"
+#include "schema_builder.hh"
+#include "tests/perf/perf.hh"
+
+#include "disk-error-handler.hh"
+
+thread_local disk_error_signal_type commit_error;
+thread_local disk_error_signal_type general_disk_error;
+
+volatile uint64_t black_hole;
+
+static std::default_random_engine gen;
+
+static bytes random_value(const data_type& type) {
+    auto t = type->is_reversed() ? type->underlying_type() : type;
+    if (t == int32_type) {
+        return int32_type->decompose(std::uniform_int_distribution<int32_t>()(gen));
+    }
+    if (t == long_type) {
+        return long_type->decompose(std::uniform_int_distribution<int64_t>()(gen));
+    }
+    if (t == timestamp_type) {
+        return timestamp_type->decompose(db_clock::time_point(db_clock::duration(std::uniform_int_distribution<int64_t>(0, 1L << 42)(gen))));
+    }
+    // Text with a long common prefix, like most real-world keys.
+    auto s = sprint("user:%08d", std::uniform_int_distribution<int>(0, 100000)(gen));
+    return t->decompose(data_value(s));
+}
+
+static void run(sstring name, std::vector<data_type> types) {
+    auto sb = schema_builder("ks", "cf")
+            .with_column("pk", bytes_type, column_kind::partition_key);
+    for (unsigned i = 0; i < types.size(); ++i) {
+        sb.with_column(to_bytes(sprint("ck%d", i)), types[i], column_kind::clustering_key);
+    }
+    auto s = sb.build();
+    byte_comparable_encoder enc(*s);
+    assert(enc.supported());
+
+    const unsigned n = 1024;
+    std::vector<position_in_partition> positions;
+    std::vector<composite> composites;
+    std::vector<bytes> encoded_positions;
+    std::vector<bytes> encoded_composites;
+    for (unsigned i = 0; i < n; ++i) {
+        std::vector<bytes> values;
+        for (auto&& t : types) {
+            values.push_back(random_value(t));
+        }
+        positions.emplace_back(position_in_partition::clustering_row_tag_t(), clustering_key::from_exploded(*s, values));
+        composites.push_back(composite::from_exploded(std::vector<bytes_view>(values.begin(), values.end())));
+        encoded_positions.push_back(enc.encode(positions.back()));
+        encoded_composites.push_back(enc.encode(composite_view(composites.back())));
+    }
+
+    std::cout << name << ":\n";
+    auto cmp = position_in_partition::composite_tri_compare(*s);
+    unsigned i = 0;
+    std::cout << "  type comparators:     ";
+    time_it([&] {
+        black_hole += cmp(positions[i % n], composite_view(composites[(i * 7) % n])) < 0;
+        ++i;
+    }, 1);
+    std::cout << "  byte-comparable:      ";
+    time_it([&] {
+        black_hole += byte_comparable_encoder::compare(encoded_positions[i % n], encoded_composites[(i * 7) % n]) < 0;
+        ++i;
+    }, 1);
+    std::cout << "  encoding a position:  ";
+    time_it([&] {
+        black_hole += enc.encode(positions[i % n]).size();
+        ++i;
+    }, 1);
+}
+
+int main(int argc, char* argv[]) {
+    run("int", {int32_type});
+    run("bigint, text", {long_type, utf8_type});
+    run("reversed timestamp, text", {reversed_type_impl::get_instance(timestamp_type), utf8_type});
+    run("text, text, int", {utf8_type, utf8_type, int32_type});
+}
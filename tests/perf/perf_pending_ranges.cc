@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2017 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <boost/range/irange.hpp>
+#include <boost/range/adaptor/map.hpp>
+#include "seastarx.hh"
+#include "core/app-template.hh"
+#include "core/thread.hh"
+#include "core/timer.hh"
+#include "locator/token_metadata.hh"
+#include "locator/abstract_replication_strategy.hh"
+#include "locator/snitch_base.hh"
+#include "utils/fb_utilities.hh"
+#include "log.hh"
+
+#include "disk-error-handler.hh"
+
+thread_local disk_error_signal_type commit_error;
+thread_local disk_error_signal_type general_disk_error;
+
+static logging::logger test_log("test");
+
+using namespace locator;
+using clk = std::chrono::steady_clock;
+
+// Measures the longest interval during which the reactor did not get to run
+// a 1ms periodic timer, i.e. the longest stall caused by the calculation.
+class stall_detector {
+    timer<> _timer;
+    clk::time_point _last;
+    clk::duration _max_stall{};
+public:
+    stall_detector() : _timer([this] {
+        auto now = clk::now();
+        _max_stall = std::max(_max_stall, now - _last);
+        _last = now;
+    }) {
+        _last = clk::now();
+        _timer.arm_periodic(std::chrono::milliseconds(1));
+    }
+    clk::duration max_stall() const {
+        return _max_stall;
+    }
+};
+
+// 10.dc.rack.node, as understood by RackInferringSnitch.
+static inet_address make_address(unsigned dc, unsigned rack, unsigned node) {
+    return inet_address(0x0a000000 + (dc << 16) + (rack << 8) + node);
+}
+
+static void populate(token_metadata& tm, unsigned nodes, unsigned vnodes, unsigned dcs, unsigned racks) {
+    std::unordered_map<inet_address, std::unordered_set<token>> endpoint_tokens;
+    for (auto i : boost::irange(0u, nodes)) {
+        auto ep = make_address(i % dcs, (i / dcs) % racks, 1 + i / (dcs * racks));
+        auto& tokens = endpoint_tokens[ep];
+        while (tokens.size() < vnodes) {
+            tokens.insert(dht::global_partitioner().get_random_token());
+        }
+    }
+    tm.update_normal_tokens(endpoint_tokens);
+}
+
+static std::unordered_set<token> random_tokens(unsigned vnodes) {
+    std::unordered_set<token> tokens;
+    while (tokens.size() < vnodes) {
+        tokens.insert(dht::global_partitioner().get_random_token());
+    }
+    return tokens;
+}
+
+static void run(const sstring& name, token_metadata& tm, abstract_replication_strategy& strategy, unsigned keyspaces) {
+    stall_detector stalls;
+    auto start = clk::now();
+    for (auto i : boost::irange(0u, keyspaces)) {
+        tm.calculate_pending_ranges(strategy, sprint("ks_%s_%d", name, i), can_yield::yes);
+    }
+    auto first = clk::now();
+    // Nothing changed, so this should be (almost) free.
+    for (auto i : boost::irange(0u, keyspaces)) {
+        tm.calculate_pending_ranges(strategy, sprint("ks_%s_%d", name, i), can_yield::yes);
+    }
+    auto second = clk::now();
+    auto ms = [] (clk::duration d) {
+        return std::chrono::duration<double, std::milli>(d).count();
+    };
+    std::cout << sprint("%-10s: %d keyspace(s): %.2f ms, unchanged: %.2f ms, max stall: %.2f ms\n",
+            name, keyspaces, ms(first - start), ms(second - first), ms(stalls.max_stall()));
+}
+
+int main(int argc, char** argv) {
+    namespace bpo = boost::program_options;
+    app_template app;
+    app.add_options()
+        ("nodes", bpo::value<unsigned>()->default_value(1000), "number of nodes in the ring")
+        ("vnodes", bpo::value<unsigned>()->default_value(256), "number of tokens per node")
+        ("dcs", bpo::value<unsigned>()->default_value(2), "number of data centers")
+        ("racks", bpo::value<unsigned>()->default_value(3), "number of racks per data center")
+        ("rf", bpo::value<unsigned>()->default_value(3), "replication factor in each data center")
+        ("keyspaces", bpo::value<unsigned>()->default_value(10), "number of keyspaces sharing the replication strategy")
+        ;
+
+    return app.run(argc, argv, [&app] {
+        return seastar::async([&app] {
+            auto& cfg = app.configuration();
+            auto nodes = cfg["nodes"].as<unsigned>();
+            auto vnodes = cfg["vnodes"].as<unsigned>();
+            auto dcs = cfg["dcs"].as<unsigned>();
+            auto racks = cfg["racks"].as<unsigned>();
+            auto rf = cfg["rf"].as<unsigned>();
+            auto keyspaces = cfg["keyspaces"].as<unsigned>();
+
+            utils::fb_utilities::set_broadcast_address(gms::inet_address("localhost"));
+            utils::fb_utilities::set_broadcast_rpc_address(gms::inet_address("localhost"));
+            i_endpoint_snitch::create_snitch("RackInferringSnitch").get();
+
+            token_metadata tm;
+            test_log.info("Populating ring with {} nodes, {} tokens each", nodes, vnodes);
+            populate(tm, nodes, vnodes, dcs, racks);
+
+            std::map<sstring, sstring> options;
+            for (auto dc : boost::irange(0u, dcs)) {
+                options.emplace(to_sstring(dc), to_sstring(rf));
+            }
+            auto strategy = abstract_replication_strategy::create_replication_strategy(
+                    "ks", "NetworkTopologyStrategy", tm, options);
+
+            auto bootstrapping = make_address(0, 0, 250);
+            tm.add_bootstrap_tokens(random_tokens(vnodes), bootstrapping);
+            run("bootstrap", tm, *strategy, keyspaces);
+            // Only the ranges of the new node should be calculated.
+            tm.add_bootstrap_tokens(random_tokens(vnodes), make_address(1, 0, 250));
+            run("bootstrap+1", tm, *strategy, keyspaces);
+            tm.remove_bootstrap_tokens(boost::copy_range<std::unordered_set<token>>(
+                    tm.get_bootstrap_tokens() | boost::adaptors::map_keys));
+
+            auto leaving = tm.get_endpoint(tm.sorted_tokens().front());
+            tm.add_leaving_endpoint(*leaving);
+            run("leave", tm, *strategy, keyspaces);
+            tm.remove_endpoint(*leaving);
+
+            auto moving = tm.get_endpoint(tm.sorted_tokens().front());
+            tm.add_moving_endpoint(dht::global_partitioner().get_random_token(), *moving);
+            run("move", tm, *strategy, keyspaces);
+            tm.remove_from_moving(*moving);
+
+            i_endpoint_snitch::stop_snitch().get();
+        });
+    });
+}
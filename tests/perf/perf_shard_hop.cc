@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2017 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <time.h>
+#include <boost/range/irange.hpp>
+#include "seastarx.hh"
+#include "core/app-template.hh"
+#include "core/thread.hh"
+#include "tests/cql_test_env.hh"
+#include "service/storage_proxy.hh"
+#include "frozen_mutation.hh"
+#include "log.hh"
+
+#include "disk-error-handler.hh"
+
+thread_local disk_error_signal_type commit_error;
+thread_local disk_error_signal_type general_disk_error;
+
+static logging::logger test_log("test");
+
+using clk = std::chrono::steady_clock;
+
+// Replica writes, as they arrive from the coordinators. With per-node
+// connections all of them are received by the shard which accepted the
+// connection, shard 0 here, which then hops to the owning shard. With
+// per-shard connections each shard receives only writes it owns.
+struct replica_writes {
+    schema_ptr schema;
+    std::vector<std::vector<frozen_mutation>> by_receiving_shard;
+};
+
+static replica_writes make_writes(cql_test_env& env, unsigned partitions, bool per_shard) {
+    auto s = env.local_db().find_schema("ks", "cf");
+    replica_writes w{s, std::vector<std::vector<frozen_mutation>>(smp::count)};
+    for (auto i : boost::irange(0u, partitions)) {
+        auto pk = partition_key::from_single_value(*s, int32_type->decompose(int32_t(i)));
+        mutation m(pk, s);
+        m.set_clustered_cell(clustering_key::make_empty(), to_bytes("v"), data_value(int32_t(i)), api::new_timestamp());
+        auto shard = per_shard ? env.local_db().shard_of(m) : 0;
+        w.by_receiving_shard[shard].emplace_back(freeze(m));
+    }
+    return w;
+}
+
+static uint64_t cross_shard_ops() {
+    return service::get_storage_proxy().map_reduce0([] (service::storage_proxy& p) {
+        return p.get_stats().replica_cross_shard_ops;
+    }, uint64_t(0), std::plus<uint64_t>()).get0();
+}
+
+static clk::duration process_cpu_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+static void run(cql_test_env& env, unsigned partitions, unsigned concurrency, bool per_shard) {
+    auto w = make_writes(env, partitions, per_shard);
+    auto hops = cross_shard_ops();
+    auto cpu = process_cpu_time();
+    auto start = clk::now();
+    parallel_for_each(boost::irange(0u, smp::count), [&w, concurrency] (unsigned shard) {
+        return smp::submit_to(shard, [&w, concurrency] {
+            auto& writes = w.by_receiving_shard[engine().cpu_id()];
+            return do_with(size_t(0), [&w, &writes, concurrency] (size_t& next) {
+                return parallel_for_each(boost::irange(0u, concurrency), [&w, &writes, &next] (unsigned) {
+                    return do_until([&writes, &next] { return next == writes.size(); }, [&w, &writes, &next] {
+                        return service::get_local_storage_proxy().mutate_locally(w.schema, writes[next++]);
+                    });
+                });
+            });
+        });
+    }).get();
+    auto elapsed = clk::now() - start;
+    auto cpu_us = std::chrono::duration<double, std::micro>(process_cpu_time() - cpu).count();
+    hops = cross_shard_ops() - hops;
+    std::cout << sprint("%-9s connections: %.3f hops/op, %.2f us CPU/op, %.0f ops/s\n",
+            per_shard ? "per-shard" : "per-node", double(hops) / partitions, cpu_us / partitions,
+            partitions / std::chrono::duration<double>(elapsed).count());
+}
+
+// CPU time is that of the whole process, so idle reactors should not poll:
+// run with --idle-poll-time-us 0 --poll-aio 0.
+int main(int argc, char** argv) {
+    namespace bpo = boost::program_options;
+    app_template app;
+    app.add_options()
+        ("partitions", bpo::value<unsigned>()->default_value(200000), "number of partitions written in each run")
+        ("concurrency", bpo::value<unsigned>()->default_value(100), "number of writes in flight per receiving shard")
+        ;
+
+    return app.run(argc, argv, [&app] {
+        auto partitions = app.configuration()["partitions"].as<unsigned>();
+        auto concurrency = app.configuration()["concurrency"].as<unsigned>();
+        return do_with_cql_env_thread([partitions, concurrency] (cql_test_env& env) {
+            env.execute_cql("create table cf (p int primary key, v int);").get();
+            test_log.info("Writing {} partitions on {} shard(s)", partitions, smp::count);
+            run(env, partitions, concurrency, false);
+            run(env, partitions, concurrency, true);
+        });
+    });
+}
@@ -24,6 +24,9 @@
 #include "tests/perf/perf.hh"
 #include "core/app-template.hh"
 #include "schema_builder.hh"
+#include "db/config.hh"
+#include "transport/messages/result_message.hh"
+#include "core/memory.hh"
 
 #include "disk-error-handler.hh"
 
@@ -68,6 +71,7 @@ struct test_config {
     bool query_single_key;
     unsigned duration_in_seconds;
     bool counters;
+    unsigned counter_cache_size_mb = 0;
     unsigned operations_per_shard = 0;
 };
 
@@ -86,6 +90,7 @@ std::ostream& operator<<(std::ostream& os, const test_config& cfg) {
            << ", mode=" << cfg.mode
            << ", query_single_key=" << (cfg.query_single_key ? "yes" : "no")
            << ", counters=" << (cfg.counters ? "yes" : "no")
+           << ", counter_cache_size_mb=" << cfg.counter_cache_size_mb
            << "}";
 }
 
@@ -100,14 +105,46 @@ future<> create_partitions(cql_test_env& env, test_config& cfg) {
     });
 }
 
+static thread_local uint64_t rows_read = 0;
+
+struct read_stats {
+    uint64_t rows = 0;
+    uint64_t allocations = 0;
+
+    static future<read_stats> get() {
+        return map_reduce(boost::irange(0u, smp::count), [] (unsigned shard) {
+            return smp::submit_to(shard, [] {
+                return read_stats{rows_read, memory::stats().mallocs()};
+            });
+        }, read_stats(), [] (read_stats a, read_stats b) {
+            return read_stats{a.rows + b.rows, a.allocations + b.allocations};
+        });
+    }
+};
+
 future<> test_read(cql_test_env& env, test_config& cfg) {
     return create_partitions(env, cfg).then([&env] {
         return env.prepare("select \"C0\", \"C1\", \"C2\", \"C3\", \"C4\" from cf where \"KEY\" = ?");
     }).then([&env, &cfg](auto id) {
-        return time_parallel([&env, &cfg, id] {
-            bytes key = make_key(cfg.query_single_key ? 0 : std::rand() % cfg.partitions);
-            return env.execute_prepared(id, {{cql3::raw_value::make_value(std::move(key))}}).discard_result();
-        }, cfg.concurrency, cfg.duration_in_seconds, cfg.operations_per_shard);
+        return read_stats::get().then([&env, &cfg, id] (read_stats before) {
+            auto start = std::chrono::steady_clock::now();
+            return time_parallel([&env, &cfg, id] {
+                bytes key = make_key(cfg.query_single_key ? 0 : std::rand() % cfg.partitions);
+                return env.execute_prepared(id, {{cql3::raw_value::make_value(std::move(key))}}).then([] (auto msg) {
+                    auto rows = dynamic_pointer_cast<cql_transport::messages::result_message::rows>(msg);
+                    if (rows) {
+                        rows_read += rows->rs().size();
+                    }
+                });
+            }, cfg.concurrency, cfg.duration_in_seconds, cfg.operations_per_shard).then([before, start] {
+                auto duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                return read_stats::get().then([before, duration] (read_stats after) {
+                    auto rows = after.rows - before.rows;
+                    std::cout << sprint("%.2f rows/s, %.2f allocations/row\n", rows / duration,
+                            rows ? double(after.allocations - before.allocations) / rows : 0.0);
+                });
+            });
+        });
     });
 }
 
@@ -205,9 +242,12 @@ int main(int argc, char** argv) {
         ("query-single-key", "test reading with a single key instead of random keys")
         ("concurrency", bpo::value<unsigned>()->default_value(100), "workers per core")
         ("operations-per-shard", bpo::value<unsigned>(), "run this many operations per shard (overrides duration)")
-        ("counters", "test counters");
+        ("counters", "test counters")
+        ("counter-cache-size-mb", bpo::value<unsigned>()->default_value(0), "counter cache size in MB, 0 disables it");
 
     return app.run(argc, argv, [&app] {
+        db::config db_cfg;
+        db_cfg.counter_cache_size_in_mb(app.configuration()["counter-cache-size-mb"].as<unsigned>());
         return do_with_cql_env([&app] (auto&& env) {
             auto cfg = make_lw_shared<test_config>();
             cfg->partitions = app.configuration()["partitions"].as<unsigned>();
@@ -215,6 +255,7 @@ int main(int argc, char** argv) {
             cfg->concurrency = app.configuration()["concurrency"].as<unsigned>();
             cfg->query_single_key = app.configuration().count("query-single-key");
             cfg->counters = app.configuration().count("counters");
+            cfg->counter_cache_size_mb = app.configuration()["counter-cache-size-mb"].as<unsigned>();
             if (app.configuration().count("write")) {
                 cfg->mode = test_config::run_mode::write;
             } else if (app.configuration().count("delete")) {
@@ -226,6 +267,6 @@ int main(int argc, char** argv) {
                 cfg->operations_per_shard = app.configuration()["operations-per-shard"].as<unsigned>();
             }
             return do_test(env, *cfg).finally([cfg] {});
-        });
+        }, db_cfg);
     });
 }
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2017 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <random>
+#include <boost/range/irange.hpp>
+#include <boost/range/algorithm/sort.hpp>
+#include "seastarx.hh"
+#include "core/app-template.hh"
+#include "core/thread.hh"
+#include "sstables/compaction_strategy.hh"
+#include "sstables/sstable_set.hh"
+#include "tests/sstable_test.hh"
+#include "tests/perf/perf.hh"
+#include "log.hh"
+
+#include "disk-error-handler.hh"
+
+thread_local disk_error_signal_type commit_error;
+thread_local disk_error_signal_type general_disk_error;
+
+static logging::logger test_log("test");
+
+struct key_and_token {
+    sstring key;
+    dht::token token;
+};
+
+// Random partition keys, sorted in ring order.
+static std::vector<key_and_token> make_keys(schema_ptr s, unsigned count, std::mt19937& rnd) {
+    std::vector<key_and_token> keys;
+    keys.reserve(count);
+    for (auto i : boost::irange(0u, count)) {
+        auto key = sprint("key%d-%d", i, rnd());
+        auto dk = dht::global_partitioner().decorate_key(*s, partition_key::from_single_value(*s, to_bytes(key)));
+        keys.push_back(key_and_token{std::move(key), dk.token()});
+    }
+    boost::sort(keys, [] (const key_and_token& a, const key_and_token& b) {
+        return a.token < b.token;
+    });
+    return keys;
+}
+
+// sstables spanning `span` consecutive keys each, starting at random keys,
+// as small size-tiered sstables covering part of the ring would.
+static sstables::sstable_set make_set(schema_ptr s, const std::vector<key_and_token>& keys, unsigned sstables, unsigned span, std::mt19937& rnd) {
+    auto cs = sstables::make_compaction_strategy(sstables::compaction_strategy_type::size_tiered, s->compaction_strategy_options());
+    auto set = cs.make_sstable_set(s);
+    std::uniform_int_distribution<size_t> first_dist(0, keys.size() - span - 1);
+    for (auto gen : boost::irange(1u, sstables + 1)) {
+        auto first = first_dist(rnd);
+        auto sst = sstables::make_sstable(s, "", gen, la, big);
+        sstables::test(sst).set_values_for_leveled_strategy(0, 0, 0, keys[first].key, keys[first + span].key);
+        set.insert(std::move(sst));
+    }
+    return set;
+}
+
+static void run(schema_ptr s, unsigned sstables, unsigned span) {
+    std::mt19937 rnd(1234);
+    auto keys = make_keys(s, std::max(sstables * 4, span * 2), rnd);
+    auto set = make_set(s, keys, sstables, span, rnd);
+    std::cout << sprint("%d sstables spanning %d of %d keys each\n", sstables, span, keys.size());
+
+    std::uniform_int_distribution<size_t> key_dist(0, keys.size() - 1);
+    size_t selected = 0;
+
+    std::cout << "  point select(), ops/s: ";
+    time_it([&] {
+        auto& t = keys[key_dist(rnd)].token;
+        auto pr = dht::partition_range::make(dht::ring_position::starting_at(t), dht::ring_position::ending_at(t));
+        selected += set.select(pr).size();
+    }, 1, 100);
+
+    std::cout << "  incremental sweep over all keys, sweeps/s: ";
+    time_it([&] {
+        auto sel = set.make_incremental_selector();
+        for (auto&& k : keys) {
+            selected += sel.select(k.token).sstables.size();
+        }
+    }, 1, 1);
+
+    std::cout << "  linear scan of all sstables, ops/s: ";
+    time_it([&] {
+        auto& t = keys[key_dist(rnd)].token;
+        for (auto&& sst : *set.all()) {
+            selected += !(t < sst->get_first_decorated_key().token()) && !(sst->get_last_decorated_key().token() < t);
+        }
+    }, 1, 100);
+
+    test_log.debug("selected {} sstables in total", selected);
+}
+
+int main(int argc, char** argv) {
+    namespace bpo = boost::program_options;
+    app_template app;
+    app.add_options()
+        ("sstables", bpo::value<unsigned>()->default_value(10000), "number of sstables in the set")
+        ("span", bpo::value<unsigned>()->default_value(16), "number of keys, out of 4 per sstable, each sstable spans")
+        ;
+
+    return app.run(argc, argv, [&app] {
+        return seastar::async([&app] {
+            auto& cfg = app.configuration();
+            auto s = make_lw_shared(schema({}, "ks", "cf", {{"p1", utf8_type}}, {}, {}, {}, utf8_type));
+            run(s, cfg["sstables"].as<unsigned>(), cfg["span"].as<unsigned>());
+        });
+    });
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2017 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <numeric>
+#include <boost/range/irange.hpp>
+#include <boost/range/algorithm/sort.hpp>
+#include "seastarx.hh"
+#include "core/app-template.hh"
+#include "core/thread.hh"
+#include "tests/cql_test_env.hh"
+#include "service/storage_proxy.hh"
+#include "service/write_coalescer.hh"
+#include "message/messaging_service.hh"
+#include "frozen_mutation.hh"
+#include "log.hh"
+
+#include "disk-error-handler.hh"
+
+thread_local disk_error_signal_type commit_error;
+thread_local disk_error_signal_type general_disk_error;
+
+static logging::logger test_log("test");
+
+using clk = std::chrono::steady_clock;
+
+// Writes are sent over the loopback to this node, which applies them as a
+// replica with the storage_proxy's handlers and reports them done to the
+// benchmark, which plays the coordinator.
+static const gms::inet_address local("127.0.0.1");
+
+// Writes waiting for MUTATION_DONE, by response id, on each shard.
+static thread_local std::unordered_map<uint64_t, promise<>> pending_writes;
+static thread_local uint64_t next_response_id = 1;
+
+static void init_replica() {
+    service::get_storage_proxy().invoke_on_all([] (service::storage_proxy& p) {
+        p.init_messaging_service();
+        auto& ms = netw::get_local_messaging_service();
+        ms.unregister_mutation_done();
+        ms.register_mutation_done([] (const rpc::client_info&, unsigned shard, uint64_t response_id) {
+            return smp::submit_to(shard, [response_id] {
+                auto it = pending_writes.find(response_id);
+                if (it != pending_writes.end()) {
+                    it->second.set_value();
+                    pending_writes.erase(it);
+                }
+                return netw::messaging_service::no_wait();
+            });
+        });
+    }).get();
+}
+
+// Small writes, as from an ingestion workload, for each sending shard.
+static std::vector<std::vector<frozen_mutation>> make_writes(cql_test_env& env, unsigned partitions, unsigned value_size) {
+    auto s = env.local_db().find_schema("ks", "cf");
+    std::vector<std::vector<frozen_mutation>> writes(smp::count);
+    for (auto shard : boost::irange(0u, smp::count)) {
+        for (auto i : boost::irange(0u, partitions)) {
+            auto pk = partition_key::from_single_value(*s, int32_type->decompose(int32_t(shard * partitions + i)));
+            mutation m(pk, s);
+            m.set_clustered_cell(clustering_key::make_empty(), to_bytes("v"), data_value(bytes(value_size, int8_t(i))), api::new_timestamp());
+            writes[shard].emplace_back(freeze(m));
+        }
+    }
+    return writes;
+}
+
+struct shard_result {
+    std::vector<uint32_t> latencies_us;
+    service::write_coalescer_stats stats;
+};
+
+// Keeps concurrency writes in flight until all writes of this shard are done.
+static shard_result write_all(const std::vector<frozen_mutation>& writes, unsigned concurrency, std::chrono::microseconds window, size_t max_bytes) {
+    auto& ms = netw::get_local_messaging_service();
+    auto dst = netw::messaging_service::msg_addr{local, engine().cpu_id()};
+    service::write_coalescer wc(window, max_bytes);
+    shard_result r;
+    r.latencies_us.reserve(writes.size());
+    size_t next = 0;
+    parallel_for_each(boost::irange(0u, concurrency), [&] (unsigned) {
+        return do_until([&] { return next == writes.size(); }, [&] {
+            auto& m = writes[next++];
+            auto id = next_response_id++;
+            auto done = pending_writes[id].get_future();
+            auto timeout = netw::messaging_service::clock_type::now() + std::chrono::seconds(10);
+            auto start = clk::now();
+            auto sent = wc.accepts(m.representation().size())
+                    ? wc.send(local, dst.cpu_id, m, id, timeout)
+                    : ms.send_mutation(dst, timeout, m, {}, local, engine().cpu_id(), id);
+            return sent.then([done = std::move(done)] () mutable {
+                return std::move(done);
+            }).then([&r, start] {
+                r.latencies_us.push_back(std::chrono::duration_cast<std::chrono::microseconds>(clk::now() - start).count());
+            });
+        });
+    }).get();
+    r.stats = wc.stats();
+    return r;
+}
+
+static void run(const std::vector<std::vector<frozen_mutation>>& writes, unsigned concurrency, std::chrono::microseconds window, size_t max_bytes) {
+    auto start = clk::now();
+    auto shards = boost::irange(0u, smp::count);
+    auto results = map_reduce(shards.begin(), shards.end(), [&writes, concurrency, window, max_bytes] (unsigned shard) {
+        return smp::submit_to(shard, [&writes, concurrency, window, max_bytes] {
+            return seastar::async([&writes, concurrency, window, max_bytes] {
+                return write_all(writes[engine().cpu_id()], concurrency, window, max_bytes);
+            });
+        });
+    }, shard_result(), [] (shard_result acc, shard_result r) {
+        acc.latencies_us.insert(acc.latencies_us.end(), r.latencies_us.begin(), r.latencies_us.end());
+        acc.stats.writes += r.stats.writes;
+        acc.stats.batches += r.stats.batches;
+        return acc;
+    }).get0();
+    auto elapsed = std::chrono::duration<double>(clk::now() - start).count();
+
+    auto& l = results.latencies_us;
+    boost::sort(l);
+    auto mean = std::accumulate(l.begin(), l.end(), 0.0) / l.size();
+    auto p99 = l[l.size() * 99 / 100];
+    auto per_message = results.stats.batches ? double(results.stats.writes) / results.stats.batches : 1.0;
+    std::cout << sprint("%-9s concurrency %4d: %8.0f ops/s, latency mean %6.0f us, p99 %6d us, %5.1f writes/message\n",
+            window.count() ? "coalesced" : "single", concurrency, l.size() / elapsed, mean, p99, per_message);
+}
+
+// Prints throughput against latency for increasing numbers of writes in
+// flight, with each write sent in its own message and with writes
+// coalesced into MUTATIONS messages.
+int main(int argc, char** argv) {
+    namespace bpo = boost::program_options;
+    app_template app;
+    app.add_options()
+        ("partitions", bpo::value<unsigned>()->default_value(100000), "number of writes sent by each shard in each run")
+        ("value-size", bpo::value<unsigned>()->default_value(200), "size in bytes of the value written")
+        ("max-concurrency", bpo::value<unsigned>()->default_value(256), "largest number of writes in flight per shard")
+        ("window-us", bpo::value<unsigned>()->default_value(100), "coalescing window, in microseconds")
+        ("max-bytes", bpo::value<unsigned>()->default_value(65536), "size at which coalesced writes are sent without waiting for the window to end")
+        ;
+
+    return app.run(argc, argv, [&app] {
+        auto& cfg = app.configuration();
+        auto partitions = cfg["partitions"].as<unsigned>();
+        auto value_size = cfg["value-size"].as<unsigned>();
+        auto max_concurrency = cfg["max-concurrency"].as<unsigned>();
+        auto window = std::chrono::microseconds(cfg["window-us"].as<unsigned>());
+        auto max_bytes = cfg["max-bytes"].as<unsigned>();
+        return do_with_cql_env_thread([=] (cql_test_env& env) {
+            env.execute_cql("create table cf (p int primary key, v blob);").get();
+            init_replica();
+            auto writes = make_writes(env, partitions, value_size);
+            test_log.info("Writing {} partitions of {} bytes from each of {} shard(s)", partitions, value_size, smp::count);
+            for (unsigned concurrency = 1; concurrency <= max_concurrency; concurrency *= 4) {
+                run(writes, concurrency, std::chrono::microseconds(0), max_bytes);
+                run(writes, concurrency, window, max_bytes);
+            }
+        });
+    });
+}
@@ -55,11 +55,15 @@
 #include <ftw.h>
 #include <unistd.h>
 #include <boost/range/algorithm/find_if.hpp>
+#include <boost/range/algorithm/count.hpp>
+#include <boost/range/adaptor/map.hpp>
 #include <boost/algorithm/cxx11/all_of.hpp>
 #include <boost/algorithm/cxx11/is_sorted.hpp>
 #include "test_services.hh"
 
 #include "sstable_utils.hh"
+#include "cql_test_env.hh"
+#include "db/config.hh"
 
 using namespace sstables;
 
@@ -1186,6 +1190,68 @@ SEASTAR_TEST_CASE(compact) {
     // verify that the compacted sstable look like
 }
 
+// Compacting disjoint token ranges of the same sstables, as sub-jobs of a
+// major compaction or cleanup do, splits the output between them.
+SEASTAR_TEST_CASE(compact_token_range) {
+    return seastar::async([] {
+        BOOST_REQUIRE(smp::count == 1);
+        auto builder = schema_builder("tests", "compaction")
+            .with_column("name", utf8_type, column_kind::partition_key)
+            .with_column("age", int32_type)
+            .with_column("height", int32_type);
+        builder.set_gc_grace_seconds(std::numeric_limits<int32_t>::max());
+        auto s = builder.build();
+        auto cm = make_lw_shared<compaction_manager>();
+        cell_locker_stats cl_stats;
+        auto cf = make_lw_shared<column_family>(s, column_family::config(), column_family::no_commitlog(), *cm, cl_stats);
+        cf->mark_ready_for_writes();
+
+        // Partitions are ordered jerry, tom, john, nadav in the ring.
+        auto split = dht::global_partitioner().get_token(*s, partition_key::from_singular(*s, data_value(sstring("tom"))));
+        auto ranges = std::vector<dht::token_range>{
+            dht::token_range::make_ending_with({split, true}),
+            dht::token_range::make_starting_with({split, false}),
+        };
+        auto expected = std::vector<std::vector<sstring>>{{"jerry", "tom"}, {"john", "nadav"}};
+
+        test_setup::do_with_test_directory([&] {
+            return seastar::async([&] {
+                auto sstables = open_sstables(s, "tests/sstables/compaction", {1,2,3}).get0();
+                uint64_t input_size = 0;
+                for (auto& sst : sstables) {
+                    input_size += sst->bytes_on_disk();
+                }
+                uint64_t start_sizes = 0;
+                for (auto i : boost::irange<size_t>(0, ranges.size())) {
+                    unsigned long generation = 17 + i;
+                    auto new_sstable = [generation, s] {
+                        return sstables::make_sstable(s, "tests/sstables/tests-temporary",
+                                generation, sstables::sstable::version_types::la, sstables::sstable::format_types::big);
+                    };
+                    auto info = sstables::compact_sstables(sstables, *cf, new_sstable, std::numeric_limits<uint64_t>::max(), 0,
+                            false, nullptr, ranges[i]).get0();
+                    BOOST_REQUIRE_EQUAL(info.new_sstables.size(), 1u);
+                    BOOST_REQUIRE(info.progress.total_bytes() > 0);
+                    BOOST_REQUIRE_EQUAL(info.progress.bytes_done(), info.progress.total_bytes());
+                    // Each sub-job accounts only for its part of the input.
+                    BOOST_REQUIRE(info.start_size < input_size);
+                    start_sizes += info.start_size;
+
+                    auto sst = open_sstable(s, "tests/sstables/tests-temporary", generation).get0();
+                    auto reader = sstable_reader(sst, s);
+                    for (auto&& name : expected[i]) {
+                        auto sm = reader().get0();
+                        BOOST_REQUIRE(sm);
+                        BOOST_REQUIRE(sm->key().equal(*s, partition_key::from_singular(*s, data_value(name))));
+                    }
+                    BOOST_REQUIRE(!reader().get0());
+                }
+                BOOST_REQUIRE(start_sizes <= input_size);
+            });
+        }).get();
+    });
+}
+
 static std::vector<sstables::shared_sstable> get_candidates_for_leveled_strategy(column_family& cf) {
     std::vector<sstables::shared_sstable> candidates;
     candidates.reserve(cf.sstables_count());
@@ -1789,6 +1855,56 @@ static bool sstable_overlaps(const lw_shared_ptr<column_family>& cf, int64_t gen
     return range1.overlaps(range2, dht::token_comparator());
 }
 
+SEASTAR_TEST_CASE(compaction_backlog_estimation) {
+    auto s = make_lw_shared(schema({}, some_keyspace, some_column_family,
+        {{"p1", utf8_type}}, {}, {}, {}, utf8_type));
+
+    column_family::config cfg;
+    cell_locker_stats cl_stats;
+    compaction_manager cm;
+    cfg.enable_disk_writes = false;
+    cfg.enable_commitlog = false;
+    auto key_and_token_pair = token_generation_for_current_shard(4);
+    auto min_key = key_and_token_pair[0].first;
+    auto max_key = key_and_token_pair[key_and_token_pair.size()-1].first;
+    uint64_t size = 1 << 20;
+
+    auto backlog = [] (lw_shared_ptr<column_family>& cf) {
+        return cf->get_compaction_strategy().estimated_backlog_bytes(*cf);
+    };
+
+    {
+        auto cf = make_lw_shared<column_family>(s, cfg, column_family::no_commitlog(), cm, cl_stats);
+        cf->set_compaction_strategy(sstables::compaction_strategy_type::size_tiered);
+        add_sstable_for_leveled_test(cf, 1, size, 0, min_key, max_key);
+        BOOST_REQUIRE_EQUAL(backlog(cf), 0u);
+        // Two sstables out of the 4 merged at a time: each byte is rewritten
+        // log4(2) = 1/2 times.
+        add_sstable_for_leveled_test(cf, 2, size, 0, min_key, max_key);
+        BOOST_REQUIRE(std::abs(int64_t(backlog(cf)) - int64_t(size)) <= 1);
+    }
+
+    {
+        auto cf = make_lw_shared<column_family>(s, cfg, column_family::no_commitlog(), cm, cl_stats);
+        cf->set_compaction_strategy(sstables::compaction_strategy_type::leveled);
+        add_sstable_for_leveled_test(cf, 1, size, 1, min_key, max_key);
+        BOOST_REQUIRE_EQUAL(backlog(cf), 0u);
+        // L0 is compacted together with the L1 sstables it overlaps.
+        add_sstable_for_leveled_test(cf, 2, size, 0, min_key, max_key);
+        BOOST_REQUIRE_EQUAL(backlog(cf), 2 * size);
+    }
+
+    {
+        auto cf = make_lw_shared<column_family>(s, cfg, column_family::no_commitlog(), cm, cl_stats);
+        cf->set_compaction_strategy(sstables::compaction_strategy_type::null);
+        add_sstable_for_leveled_test(cf, 1, size, 0, min_key, max_key);
+        add_sstable_for_leveled_test(cf, 2, size, 0, min_key, max_key);
+        BOOST_REQUIRE_EQUAL(backlog(cf), 0u);
+    }
+
+    return make_ready_future<>();
+}
+
 SEASTAR_TEST_CASE(leveled_01) {
     auto s = make_lw_shared(schema({}, some_keyspace, some_column_family,
         {{"p1", utf8_type}}, {}, {}, {}, utf8_type));
@@ -3867,6 +3983,70 @@ SEASTAR_TEST_CASE(sstable_set_incremental_selector) {
     return make_ready_future<>();
 }
 
+SEASTAR_TEST_CASE(interval_sstable_set_test) {
+    auto s = make_lw_shared(schema({}, some_keyspace, some_column_family,
+        {{"p1", utf8_type}}, {}, {}, {}, utf8_type));
+    auto cs = sstables::make_compaction_strategy(sstables::compaction_strategy_type::size_tiered, s->compaction_strategy_options());
+    auto key_and_token_pair = token_generation_for_current_shard(8);
+
+    auto check = [] (const std::vector<shared_sstable>& sstables, std::unordered_set<int64_t> expected_gens) {
+        BOOST_REQUIRE(sstables.size() == expected_gens.size());
+        for (auto& sst : sstables) {
+            BOOST_REQUIRE(expected_gens.count(sst->generation()) == 1);
+        }
+    };
+
+    sstable_set set = cs.make_sstable_set(s);
+    set.insert(sstable_for_overlapping_test(s, 1, key_and_token_pair[0].first, key_and_token_pair[1].first));
+    set.insert(sstable_for_overlapping_test(s, 2, key_and_token_pair[0].first, key_and_token_pair[1].first));
+    set.insert(sstable_for_overlapping_test(s, 3, key_and_token_pair[3].first, key_and_token_pair[4].first));
+    set.insert(sstable_for_overlapping_test(s, 4, key_and_token_pair[4].first, key_and_token_pair[4].first));
+    set.insert(sstable_for_overlapping_test(s, 5, key_and_token_pair[4].first, key_and_token_pair[5].first));
+
+    auto range = [&] (unsigned first, unsigned last) {
+        return dht::partition_range::make(dht::ring_position::starting_at(key_and_token_pair[first].second),
+            dht::ring_position::ending_at(key_and_token_pair[last].second));
+    };
+    check(set.select(query::full_partition_range), {1, 2, 3, 4, 5});
+    check(set.select(range(1, 3)), {1, 2, 3});
+    check(set.select(range(2, 2)), {});
+    check(set.select(range(4, 4)), {3, 4, 5});
+    check(set.select(range(6, 7)), {});
+
+    {
+        sstable_set::incremental_selector sel = set.make_incremental_selector();
+        auto selection = sel.select(key_and_token_pair[0].second);
+        check(selection.sstables, {1, 2});
+        BOOST_REQUIRE(selection.next_token == key_and_token_pair[3].second);
+        check(sel.select(key_and_token_pair[1].second).sstables, {1, 2});
+        check(sel.select(key_and_token_pair[2].second).sstables, {});
+        check(sel.select(key_and_token_pair[3].second).sstables, {3});
+        selection = sel.select(key_and_token_pair[4].second);
+        check(selection.sstables, {3, 4, 5});
+        BOOST_REQUIRE(selection.next_token.is_maximum());
+        check(sel.select(key_and_token_pair[5].second).sstables, {5});
+        check(sel.select(key_and_token_pair[6].second).sstables, {});
+        check(sel.select(key_and_token_pair[7].second).sstables, {});
+    }
+
+    {
+        // sstables contained entirely between two consecutive tokens are
+        // selected too, or a reader would miss them.
+        sstable_set::incremental_selector sel = set.make_incremental_selector();
+        check(sel.select(key_and_token_pair[0].second).sstables, {1, 2});
+        check(sel.select(key_and_token_pair[5].second).sstables, {3, 4, 5});
+    }
+
+    set.erase(*boost::find_if(*set.all(), [] (const shared_sstable& sst) { return sst->generation() == 4; }));
+    check(set.select(range(4, 4)), {3, 5});
+    // 1 and 2 share their first token.
+    set.erase(*boost::find_if(*set.all(), [] (const shared_sstable& sst) { return sst->generation() == 2; }));
+    check(set.select(range(0, 1)), {1});
+    check(set.select(query::full_partition_range), {1, 3, 5});
+
+    return make_ready_future<>();
+}
+
 SEASTAR_TEST_CASE(sstable_resharding_strategy_tests) {
     // TODO: move it to sstable_resharding_test.cc. Unable to do so now because of linking issues
     // when using sstables::stats_metadata at sstable_resharding_test.cc.
@@ -4318,3 +4498,200 @@ SEASTAR_TEST_CASE(compaction_correctness_with_partitioned_sstable_set) {
                 .produces_end_of_stream();
     });
 }
+
+SEASTAR_TEST_CASE(test_time_ordered_reads) {
+    return seastar::async([] {
+        // Newest rows first, as time series usually are.
+        auto builder = schema_builder("tests", "time_ordered_reads")
+                .with_column("pk", int32_type, column_kind::partition_key)
+                .with_column("ts", reversed_type_impl::get_instance(long_type), column_kind::clustering_key)
+                .with_column("v", int32_type);
+        builder.set_compaction_strategy(sstables::compaction_strategy_type::time_window);
+        auto s = builder.build();
+
+        auto tmp = make_lw_shared<tmpdir>();
+        auto sst_gen = [s, tmp, gen = make_lw_shared<unsigned>(1)] () mutable {
+            return make_sstable(s, tmp->path, (*gen)++, la, big);
+        };
+
+        auto pk = partition_key::from_single_value(*s, int32_type->decompose(0));
+        auto ck = [&] (int64_t ts) {
+            return clustering_key::from_single_value(*s, long_type->decompose(ts));
+        };
+        // A window of ten rows, each written at the time it is keyed with.
+        auto make_window = [&] (int64_t first) {
+            mutation m(pk, s);
+            for (auto ts = first; ts < first + 10; ++ts) {
+                m.set_clustered_cell(ck(ts), bytes("v"), data_value(int32_t(1)), ts);
+            }
+            return m;
+        };
+        mutation expected(pk, s);
+        std::vector<sstables::shared_sstable> windows;
+        for (auto first : {0, 10, 20}) {
+            auto m = make_window(first);
+            expected.apply(m);
+            windows.push_back(make_sstable_containing(sst_gen, {std::move(m)}));
+        }
+
+        cell_locker_stats cl_stats;
+        ::cf_stats cf_stats;
+        auto cm = make_lw_shared<compaction_manager>();
+        auto make_cf = [&] (bool enable_cache) {
+            column_family::config cfg;
+            cfg.enable_cache = enable_cache;
+            cfg.enable_disk_writes = false;
+            cfg.enable_commitlog = false;
+            cfg.enable_incremental_backups = false;
+            cfg.cf_stats = &cf_stats;
+            auto cf = make_lw_shared<column_family>(s, cfg, column_family::no_commitlog(), *cm, cl_stats);
+            cf->mark_ready_for_writes();
+            for (auto& sst : windows) {
+                column_family_test(cf).add_sstable(sst);
+            }
+            return cf;
+        };
+
+        auto pr = dht::partition_range::make_singular(dht::global_partitioner().decorate_key(*s, pk));
+        auto cf = make_cf(false);
+
+        // A read which stops within the newest window doesn't open the others.
+        {
+            auto reader = cf->make_reader(s, pr, s->full_slice());
+            auto sm = reader().get0();
+            BOOST_REQUIRE(sm);
+            sm->set_max_buffer_size(1);
+            for (auto ts : {29, 28, 27, 26, 25}) {
+                auto mf = (*sm)().get0();
+                BOOST_REQUIRE(mf && mf->is_clustering_row());
+                BOOST_REQUIRE(mf->as_clustering_row().key().equal(*s, ck(ts)));
+            }
+        }
+        BOOST_REQUIRE_EQUAL(cf_stats.time_ordered_reads, 1);
+        BOOST_REQUIRE_EQUAL(cf_stats.sstables_skipped_by_time_ordered_reads, 2);
+
+        // A full read opens all of them, in order.
+        auto read = [&] (column_family& cf) {
+            auto reader = cf.make_reader(s, pr, s->full_slice());
+            auto m = mutation_from_streamed_mutation(reader().get0()).get0();
+            BOOST_REQUIRE(m);
+            return std::move(*m);
+        };
+        assert_that(read(*cf)).is_equal_to(expected);
+        BOOST_REQUIRE_EQUAL(cf_stats.time_ordered_reads, 2);
+        BOOST_REQUIRE_EQUAL(cf_stats.sstables_skipped_by_time_ordered_reads, 2);
+
+        // Reads through the cache fast forward the sstable readers.
+        assert_that(read(*make_cf(true))).is_equal_to(expected);
+        BOOST_REQUIRE_EQUAL(cf_stats.sstables_skipped_by_time_ordered_reads, 2);
+
+        // Tombstones aren't covered by the clustering bounds, so an sstable
+        // with one is opened up front.
+        mutation del(pk, s);
+        del.partition().apply_delete(*s, ck(5), tombstone(100, gc_clock::now()));
+        expected.apply(del);
+        windows.push_back(make_sstable_containing(sst_gen, {std::move(del)}));
+        cf = make_cf(false);
+        assert_that(read(*cf)).is_equal_to(expected);
+        {
+            auto reader = cf->make_reader(s, pr, s->full_slice());
+            auto sm = reader().get0();
+            BOOST_REQUIRE(sm);
+            sm->set_max_buffer_size(1);
+            BOOST_REQUIRE((*sm)().get0());
+        }
+        BOOST_REQUIRE_EQUAL(cf_stats.sstables_skipped_by_time_ordered_reads, 4);
+    });
+}
+
+SEASTAR_TEST_CASE(test_blocked_bloom_filter) {
+    return seastar::async([] {
+        simple_schema table;
+        auto s = table.schema();
+
+        auto keys = table.make_pkeys(1000);
+        std::vector<mutation> partitions;
+        for (auto&& key : keys) {
+            mutation m(key, s);
+            table.add_row(m, table.make_ckey(0), "v");
+            partitions.emplace_back(std::move(m));
+        }
+        std::sort(partitions.begin(), partitions.end(), mutation_decorated_key_less_comparator());
+
+        tmpdir dir;
+        sstable_writer_config cfg;
+        cfg.blocked_bloom_filter = true;
+        make_sstable(dir.path, s, make_reader_returning_many(partitions), cfg);
+
+        auto sst = make_sstable(s, dir.path, 1, sstables::sstable::version_types::ka, big);
+        sst->load().get();
+        auto components = sst->all_components() | boost::adaptors::map_keys;
+        BOOST_REQUIRE(boost::count(components, sstable::component_type::BlockedFilter) == 1);
+        BOOST_REQUIRE(boost::count(components, sstable::component_type::Filter) == 0);
+
+        for (auto&& key : keys) {
+            BOOST_REQUIRE(sst->filter_has_key(sstables::key::from_partition_key(*s, key.key())));
+        }
+
+        size_t false_positives = 0;
+        for (uint32_t i = 1000; i < 2000; ++i) {
+            false_positives += sst->filter_has_key(sstables::key::from_partition_key(*s, table.make_pkey(i).key()));
+        }
+        // Several times the configured chance, so that the test is not flaky.
+        BOOST_REQUIRE_LE(false_positives, 1000 * s->bloom_filter_fp_chance() * 5 + 5);
+    });
+}
+
+SEASTAR_TEST_CASE(test_partition_index_model_reads) {
+    db::config db_cfg;
+    db_cfg.enable_sstable_partition_index_model(true);
+    return do_with_cql_env_thread([] (cql_test_env& e) {
+        simple_schema table;
+        auto s = table.schema();
+
+        auto keys = table.make_pkeys(2000);
+        std::vector<mutation> partitions;
+        for (auto&& key : keys) {
+            mutation m(key, s);
+            table.add_row(m, table.make_ckey(0), "v");
+            partitions.emplace_back(std::move(m));
+        }
+
+        tmpdir dir;
+        make_sstable(dir.path, s, make_reader_returning_many(partitions), sstable_writer_config());
+
+        auto sst = make_sstable(s, dir.path, 1, sstables::sstable::version_types::ka, big);
+        sst->load().get();
+        BOOST_REQUIRE_GT(sst->index_model_memory_size(), 0);
+
+        auto check_reads = [&] {
+            for (auto&& m : partitions) {
+                auto mo = mutation_from_streamed_mutation(sst->read_row(s, m.decorated_key()).get0()).get0();
+                BOOST_REQUIRE(mo);
+                assert_that(*mo).is_equal_to(m);
+            }
+            for (uint32_t i = 2000; i < 2100; ++i) {
+                BOOST_REQUIRE(!sst->read_row(s, table.make_pkey(i)).get0());
+            }
+            // From an entry found through the model, the cursor moves on
+            // across runs up to the end of the index.
+            for (auto first : {size_t(0), keys.size() / 2, keys.size() - 1}) {
+                auto ir = sst->get_index_reader(default_priority_class());
+                BOOST_REQUIRE(ir->advance_and_check_if_present(keys[first]).get0());
+                for (auto i = first; i < keys.size(); ++i) {
+                    BOOST_REQUIRE(!ir->eof());
+                    ir->read_partition_data().get();
+                    BOOST_REQUIRE(ir->current_partition_entry().get_key() == sstables::key::from_partition_key(*s, keys[i].key()));
+                    ir->advance_to_next_partition().get();
+                }
+                BOOST_REQUIRE(ir->eof());
+                ir->close().get();
+            }
+        };
+        check_reads();
+
+        // Lookups the model gets wrong fall back to the summary.
+        sstables::test(sst).build_skewed_index_model().get();
+        check_reads();
+    }, db_cfg);
+}
@@ -21,6 +21,8 @@
 
 
 #include <boost/test/unit_test.hpp>
+#include <boost/range/algorithm/sort.hpp>
+#include <boost/range/algorithm/lower_bound.hpp>
 
 #include "core/sstring.hh"
 #include "core/future-util.hh"
@@ -35,6 +37,7 @@
 #include "compress.hh"
 #include "database.hh"
 #include <memory>
+#include <random>
 #include "sstable_test.hh"
 #include "tmpdir.hh"
 #include "partition_slice_builder.hh"
@@ -1329,3 +1332,77 @@ SEASTAR_TEST_CASE(test_skipping_in_compressed_stream) {
         expect_eof(in);
     });
 }
+
+SEASTAR_TEST_CASE(test_read_ahead_controller) {
+    using sstables::read_ahead_controller;
+    read_ahead_controller c(sstables::access_pattern::partition_range, "test_read_ahead_controller");
+    auto window = read_ahead_controller::window;
+    auto buffer_size = size_t(128 * 1024);
+
+    // Everything read is consumed: read-ahead grows, up to its limit.
+    for (auto i = 0; i < 4; ++i) {
+        c.on_consumed(window);
+        c.on_read(window);
+    }
+    BOOST_REQUIRE_EQUAL(c.read_ahead(), 4 * read_ahead_controller::default_read_ahead);
+    BOOST_REQUIRE_EQUAL(c.buffer_size(buffer_size), buffer_size);
+
+    // Nothing is: read-ahead shrinks to a single buffer, then buffers shrink.
+    for (auto i = 0; i < 10; ++i) {
+        c.on_read(window);
+    }
+    BOOST_REQUIRE_EQUAL(c.read_ahead(), 1);
+    BOOST_REQUIRE_EQUAL(c.buffer_size(buffer_size), buffer_size >> read_ahead_controller::max_buffer_shift);
+
+    // Consumption picks up again: buffers are restored first.
+    c.on_consumed(window);
+    c.on_read(window);
+    BOOST_REQUIRE_EQUAL(c.read_ahead(), 1);
+    BOOST_REQUIRE_EQUAL(c.buffer_size(buffer_size), buffer_size >> (read_ahead_controller::max_buffer_shift - 1));
+
+    BOOST_REQUIRE_EQUAL(c.stats().bytes_read, 15 * window);
+    BOOST_REQUIRE_EQUAL(c.stats().bytes_consumed, 5 * window);
+    return make_ready_future<>();
+}
+
+SEASTAR_TEST_CASE(test_partition_index_model) {
+    using sstables::partition_index_model;
+    std::mt19937_64 rnd(1234);
+    for (auto n : { 1u, 7u, 9u, 100000u }) {
+        std::vector<uint64_t> keys(n);
+        for (auto& k : keys) {
+            k = rnd();
+        }
+        boost::sort(keys);
+        partition_index_model::builder b;
+        for (auto i = 0u; i < n; ++i) {
+            b.add(keys[i], i * 100);
+        }
+        auto m = std::move(b).build(n * 100);
+        BOOST_REQUIRE_EQUAL(m.entries(), n);
+
+        // The run of each present key contains it, and is small.
+        for (auto i = 0u; i < n; ++i) {
+            auto r = m.lookup(keys[i]);
+            BOOST_REQUIRE_LE(r.first, i);
+            BOOST_REQUIRE_LT(i, r.first + r.count);
+            BOOST_REQUIRE_EQUAL(r.begin, r.first * 100);
+            BOOST_REQUIRE_EQUAL(r.end, (r.first + r.count) * 100);
+            BOOST_REQUIRE_LE(r.count, 2 * (partition_index_model::max_error + partition_index_model::sample_interval + 1));
+        }
+
+        // So does the run of an absent key, with the first key after it.
+        for (auto i = 0; i < 1000; ++i) {
+            auto k = rnd();
+            auto r = m.lookup(k);
+            uint64_t next = boost::lower_bound(keys, k) - keys.begin();
+            BOOST_REQUIRE_LE(r.first, next);
+            BOOST_REQUIRE(next < r.first + r.count || (next == n && r.first + r.count == n));
+        }
+
+        auto r = m.entries_from(n - 1);
+        BOOST_REQUIRE_EQUAL(r.first + r.count, n);
+        BOOST_REQUIRE_EQUAL(r.end, n * 100);
+    }
+    return make_ready_future<>();
+}
@@ -124,6 +124,29 @@ class test {
         return _sst->_recognized_components;
     }
 
+    // Replaces the partition index model with one built as if the n-th
+    // partition had model key n, so that lookups of real keys mispredict.
+    future<> build_skewed_index_model() {
+        struct model_generator {
+            partition_index_model::builder builder;
+            uint64_t entries = 0;
+
+            void consume_entry(index_entry&& ie, uint64_t index_offset) {
+                builder.add(++entries, index_offset);
+            }
+        };
+        auto index_size = _sst->index_size();
+        auto stream = make_file_input_stream(_sst->_index_file, 0, index_size);
+        return do_with(model_generator(), [this, stream = std::move(stream), index_size] (model_generator& g) mutable {
+            auto ctx = make_lw_shared<index_consume_entry_context<model_generator>>(g, std::move(stream), 0, index_size);
+            return ctx->consume_input(*ctx).finally([ctx] {
+                return ctx->close();
+            }).then([this, &g, index_size] {
+                _sst->_components->index_model = std::move(g.builder).build(index_size);
+            });
+        });
+    }
+
     template <typename T>
     int binary_search(const T& entries, const key& sk) {
         return sstables::binary_search(entries, sk);
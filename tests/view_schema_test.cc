@@ -22,6 +22,7 @@
 
 #include <boost/test/unit_test.hpp>
 #include <boost/range/adaptor/map.hpp>
+#include <set>
 
 #include "database.hh"
 
@@ -32,6 +33,9 @@
 #include "disk-error-handler.hh"
 
 #include "db/config.hh"
+#include "cql3/query_options.hh"
+#include "service/pager/paging_state.hh"
+#include "transport/messages/result_message.hh"
 
 thread_local disk_error_signal_type commit_error;
 thread_local disk_error_signal_type general_disk_error;
@@ -2975,3 +2979,75 @@ SEASTAR_TEST_CASE(complex_timestamp_deletion_test_with_flush) {
         });
     }, cfg);
 }
+
+SEASTAR_TEST_CASE(test_select_using_index) {
+    return do_with_cql_env_thread([] (auto& e) {
+        e.execute_cql("create table cf (p int, c int, v int, primary key (p, c));").get();
+        e.execute_cql("create index cf_v on cf (v);").get();
+        for (auto p : {1, 2, 3}) {
+            for (auto c : {1, 2}) {
+                e.execute_cql(sprint("insert into cf (p, c, v) values (%d, %d, %d);", p, c, (p + c) % 2)).get();
+            }
+        }
+
+        eventually([&] {
+            auto msg = e.execute_cql("select p, c from cf where v = 0;").get0();
+            assert_that(msg).is_rows().with_size(3)
+                .with_rows_ignore_order({
+                    {{int32_type->decompose(1)}, {int32_type->decompose(1)}},
+                    {{int32_type->decompose(2)}, {int32_type->decompose(2)}},
+                    {{int32_type->decompose(3)}, {int32_type->decompose(1)}},
+                });
+        });
+
+        eventually([&] {
+            auto msg = e.execute_cql("select count(*) from cf where v = 1;").get0();
+            assert_that(msg).is_rows().with_rows({{ {long_type->decompose(3L)} }});
+        });
+
+        eventually([&] {
+            auto msg = e.execute_cql("select p, c from cf where v = 1 limit 2;").get0();
+            assert_that(msg).is_rows().with_size(2);
+        });
+
+        auto msg = e.execute_cql("select p, c from cf where v = 2;").get0();
+        assert_that(msg).is_rows().is_empty();
+
+        for (auto p : {4, 5, 6, 7}) {
+            for (auto c : {1, 2, 3}) {
+                e.execute_cql(sprint("insert into cf (p, c, v) values (%d, %d, 3);", p, c)).get();
+            }
+        }
+        e.execute_cql("update cf set v = 4 where p = 5 and c = 2;").get();
+
+        // Reads all pages, each resuming from the paging state of the previous one.
+        auto read_pages = [&] (int32_t page_size) {
+            std::set<std::pair<int32_t, int32_t>> rows;
+            size_t pages = 0;
+            ::shared_ptr<service::pager::paging_state> paging_state;
+            do {
+                auto qo = std::make_unique<cql3::query_options>(db::consistency_level::ONE, std::vector<cql3::raw_value>{},
+                        cql3::query_options::specific_options{page_size, paging_state, {}, api::missing_timestamp});
+                auto msg = e.execute_cql("select p, c from cf where v = 3;", std::move(qo)).get0();
+                auto result = dynamic_pointer_cast<cql_transport::messages::result_message::rows>(msg);
+                BOOST_REQUIRE(result);
+                BOOST_REQUIRE_LE(result->rs().size(), size_t(page_size));
+                for (auto&& row : result->rs().rows()) {
+                    auto inserted = rows.emplace(value_cast<int32_t>(int32_type->deserialize(*row[0])),
+                            value_cast<int32_t>(int32_type->deserialize(*row[1]))).second;
+                    BOOST_REQUIRE(inserted);
+                }
+                auto next = result->rs().get_metadata().paging_state();
+                paging_state = next ? ::make_shared<service::pager::paging_state>(*next) : nullptr;
+                ++pages;
+            } while (paging_state);
+            return std::make_pair(rows, pages);
+        };
+        eventually([&] {
+            auto result = read_pages(4);
+            BOOST_REQUIRE_EQUAL(result.first.size(), 11);
+            BOOST_REQUIRE(!result.first.count(std::make_pair(5, 2)));
+            BOOST_REQUIRE_GE(result.second, 3);
+        });
+    });
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2017 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "tests/test-utils.hh"
+#include "tests/simple_schema.hh"
+#include "service/write_coalescer.hh"
+
+#include "disk-error-handler.hh"
+
+thread_local disk_error_signal_type commit_error;
+thread_local disk_error_signal_type general_disk_error;
+
+using namespace std::chrono_literals;
+
+using response_id_type = service::write_coalescer::response_id_type;
+
+struct sent_message {
+    gms::inet_address ep;
+    unsigned shard;
+    std::vector<lw_shared_ptr<const frozen_mutation>> mutations;
+    std::vector<uint32_t> timeouts_in_ms;
+    std::vector<response_id_type> response_ids;
+};
+
+static service::write_coalescer::send_func recording_sender(std::vector<sent_message>& sent) {
+    return [&sent] (gms::inet_address ep, unsigned shard, service::write_coalescer::clock_type::time_point,
+            std::vector<lw_shared_ptr<const frozen_mutation>> mutations, std::vector<uint32_t> timeouts_in_ms, std::vector<response_id_type> response_ids) {
+        sent.push_back(sent_message{ep, shard, std::move(mutations), std::move(timeouts_in_ms), std::move(response_ids)});
+        return make_ready_future<>();
+    };
+}
+
+static lw_shared_ptr<const frozen_mutation> make_write(simple_schema& s, sstring pk) {
+    auto m = s.new_mutation(pk);
+    s.add_row(m, s.make_ckey(0), "v");
+    return make_lw_shared<const frozen_mutation>(freeze(m));
+}
+
+SEASTAR_TEST_CASE(test_writes_to_the_same_shard_are_sent_together) {
+    return seastar::async([] {
+        simple_schema s;
+        std::vector<sent_message> sent;
+        service::write_coalescer wc(10ms, 1 << 20, recording_sender(sent));
+        auto a = gms::inet_address("127.0.0.1");
+        auto b = gms::inet_address("127.0.0.2");
+        auto timeout = service::write_coalescer::clock_type::now() + 10s;
+
+        auto f1 = wc.send(a, 0, make_write(s, "pk1"), 1, timeout);
+        auto f2 = wc.send(a, 0, make_write(s, "pk2"), 2, timeout);
+        auto f3 = wc.send(a, 1, make_write(s, "pk3"), 3, timeout);
+        auto f4 = wc.send(b, 0, make_write(s, "pk4"), 4, timeout);
+        BOOST_REQUIRE(sent.empty());
+
+        when_all(std::move(f1), std::move(f2), std::move(f3), std::move(f4)).get();
+        BOOST_REQUIRE_EQUAL(sent.size(), 3);
+        BOOST_REQUIRE_EQUAL(wc.stats().batches, 3);
+        BOOST_REQUIRE_EQUAL(wc.stats().writes, 4);
+
+        for (auto& msg : sent) {
+            BOOST_REQUIRE_EQUAL(msg.mutations.size(), msg.timeouts_in_ms.size());
+            BOOST_REQUIRE_EQUAL(msg.mutations.size(), msg.response_ids.size());
+            for (auto t : msg.timeouts_in_ms) {
+                BOOST_REQUIRE(t > 0 && t <= 10000);
+            }
+            if (msg.ep == a && msg.shard == 0) {
+                BOOST_REQUIRE(msg.response_ids == std::vector<response_id_type>({1, 2}));
+                BOOST_REQUIRE(msg.mutations[0]->decorated_key(*s.schema()).equal(*s.schema(), s.make_pkey("pk1")));
+                BOOST_REQUIRE(msg.mutations[1]->decorated_key(*s.schema()).equal(*s.schema(), s.make_pkey("pk2")));
+            } else {
+                BOOST_REQUIRE_EQUAL(msg.response_ids.size(), 1);
+            }
+        }
+    });
+}
+
+SEASTAR_TEST_CASE(test_batch_is_sent_when_it_reaches_max_bytes) {
+    return seastar::async([] {
+        simple_schema s;
+        std::vector<sent_message> sent;
+        auto fm = make_write(s, "pk");
+        auto size = fm->representation().size();
+        // Long enough a window that only the size limit can send the batch.
+        service::write_coalescer wc(1h, 3 * size, recording_sender(sent));
+        auto ep = gms::inet_address("127.0.0.1");
+        auto timeout = service::write_coalescer::clock_type::now() + 10s;
+
+        BOOST_REQUIRE(wc.accepts(size));
+        BOOST_REQUIRE(!wc.accepts(3 * size));
+
+        auto f1 = wc.send(ep, 0, fm, 1, timeout);
+        auto f2 = wc.send(ep, 0, fm, 2, timeout);
+        BOOST_REQUIRE(sent.empty());
+        auto f3 = wc.send(ep, 0, fm, 3, timeout);
+        BOOST_REQUIRE_EQUAL(sent.size(), 1);
+        BOOST_REQUIRE_EQUAL(sent[0].mutations.size(), 3);
+        // The batch shares the writes instead of copying them.
+        for (auto& m : sent[0].mutations) {
+            BOOST_REQUIRE_EQUAL(m.get(), fm.get());
+        }
+        when_all(std::move(f1), std::move(f2), std::move(f3)).get();
+
+        // The next write starts a new batch, sent by flush().
+        auto f4 = wc.send(ep, 0, fm, 4, timeout);
+        BOOST_REQUIRE_EQUAL(sent.size(), 1);
+        wc.flush();
+        f4.get();
+        BOOST_REQUIRE_EQUAL(sent.size(), 2);
+        BOOST_REQUIRE(sent[1].response_ids == std::vector<response_id_type>({4}));
+    });
+}
+
+SEASTAR_TEST_CASE(test_send_failure_fails_all_writes_in_the_batch) {
+    return seastar::async([] {
+        simple_schema s;
+        service::write_coalescer wc(1h, 1 << 20, [] (auto&&...) {
+            return make_exception_future<>(std::runtime_error("injected"));
+        });
+        auto ep = gms::inet_address("127.0.0.1");
+        auto timeout = service::write_coalescer::clock_type::now() + 10s;
+
+        auto f1 = wc.send(ep, 0, make_write(s, "pk1"), 1, timeout);
+        auto f2 = wc.send(ep, 0, make_write(s, "pk2"), 2, timeout);
+        wc.flush();
+        BOOST_REQUIRE_THROW(f1.get(), std::runtime_error);
+        BOOST_REQUIRE_THROW(f2.get(), std::runtime_error);
+    });
+}
+
+SEASTAR_TEST_CASE(test_zero_window_disables_coalescing) {
+    service::write_coalescer wc(0us, 1 << 20, [] (auto&&...) { return make_ready_future<>(); });
+    BOOST_REQUIRE(!wc.accepts(1));
+    return make_ready_future<>();
+}
@@ -38,11 +38,13 @@
  * You should have received a copy of the GNU General Public License
  * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <boost/range/adaptor/map.hpp>
 #include <seastar/core/metrics.hh>
 #include "types.hh"
 #include "tracing/trace_keyspace_helper.hh"
-#include "cql3/statements/batch_statement.hh"
+#include "tracing/trace_row_builder.hh"
 #include "cql3/statements/modification_statement.hh"
+#include "service/storage_proxy.hh"
 
 namespace tracing {
 
@@ -58,10 +60,21 @@ const sstring trace_keyspace_helper::NODE_SLOW_QUERY_LOG_TIME_IDX("node_slow_log
 
 struct trace_keyspace_backend_sesssion_state final : public backend_session_state_base {
     int64_t last_nanos = 0;
-    semaphore write_sem {1};
     virtual ~trace_keyspace_backend_sesssion_state() {}
 };
 
+namespace {
+
+int64_t to_millis(std::chrono::system_clock::duration d) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+}
+
+int64_t to_minute_millis(std::chrono::system_clock::duration d) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::duration_cast<std::chrono::minutes>(d)).count();
+}
+
+}
+
 trace_keyspace_helper::trace_keyspace_helper(tracing& tr)
             : i_tracing_backend_helper(tr)
             , _dummy_query_state(service::client_state(service::client_state::external_tag{}))
@@ -176,6 +189,7 @@ trace_keyspace_helper::trace_keyspace_helper(tracing& tr)
                                                  "node_ip,"
                                                  "shard) VALUES (?, ?, ?, ?, ?, ?)"
                                                  "USING TTL ?", KEYSPACE_NAME, NODE_SLOW_QUERY_LOG_TIME_IDX))
+            , _write_scheduling_group(std::chrono::milliseconds(1), write_scheduling_quota)
 {
     namespace sm = seastar::metrics;
 
@@ -189,6 +203,19 @@ trace_keyspace_helper::trace_keyspace_helper(tracing& tr)
                                         "One error may result one or more tracing records to be lost. "
                                         "Non-zero value indicates that the administrator has to take immediate steps to fix the corresponding schema. "
                                         "The appropriate error message will be printed in the syslog.")),
+
+        sm::make_derive("dropped_records", [this] { return _stats.dropped_records; },
+                        sm::description("Counts a number of tracing records lost because writing them to the system_traces keyspace failed.")),
+
+        sm::make_derive("written_records", [this] { return _stats.written_records; },
+                        sm::description("Counts a number of tracing records written to the system_traces keyspace.")),
+
+        sm::make_derive("written_mutations", [this] { return _stats.written_mutations; },
+                        sm::description("Counts a number of mutations the tracing records were written with. "
+                                        "Records of the same partition written together share a mutation.")),
+
+        sm::make_histogram("write_latency", sm::description("Holds a histogram of durations of writes of bulks of tracing records, in microseconds."),
+                           [this] { return _write_latency.get_histogram(16, 20); }),
     });
 }
 
@@ -196,10 +223,25 @@ future<> trace_keyspace_helper::start() {
     return table_helper::setup_keyspace(KEYSPACE_NAME, "2", _dummy_query_state,_sessions, _sessions_time_idx, _events, _slow_query_log, _slow_query_log_time_idx);
 }
 
-void trace_keyspace_helper::write_one_session_records(lw_shared_ptr<one_session_records> records) {
-    with_gate(_pending_writes, [this, records = std::move(records)] {
-        auto num_records = records->size();
-        return this->flush_one_session_mutations(std::move(records)).finally([this, num_records] { _local_tracing.write_complete(num_records); });
+void trace_keyspace_helper::write_sessions(std::vector<session_write> sessions, uint64_t num_records) {
+    with_gate(_pending_writes, [this, sessions = std::move(sessions), num_records] () mutable {
+        return with_semaphore(_write_sem, 1, [this, sessions = std::move(sessions)] () mutable {
+            seastar::thread_attributes attr;
+            attr.scheduling_group = &_write_scheduling_group;
+            return seastar::async(std::move(attr), [this, sessions = std::move(sessions)] () mutable {
+                auto start = std::chrono::steady_clock::now();
+                flush_sessions_mutations(sessions);
+                _write_latency.add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+            });
+        }).then_wrapped([this, num_records] (future<> f) {
+            _local_tracing.write_complete(num_records);
+            if (f.failed()) {
+                _stats.dropped_records += num_records;
+            } else {
+                _stats.written_records += num_records;
+            }
+            return f;
+        });
     }).handle_exception([this] (auto ep) {
         try {
             ++_stats.tracing_errors;
@@ -220,54 +262,76 @@ void trace_keyspace_helper::write_one_session_records(lw_shared_ptr<one_session_
 
 void trace_keyspace_helper::write_records_bulk(records_bulk& bulk) {
     tlogger.trace("Writing {} sessions", bulk.size());
-    std::for_each(bulk.begin(), bulk.end(), [this] (records_bulk::value_type& one_session_records_ptr) {
-        write_one_session_records(std::move(one_session_records_ptr));
-    });
+    std::vector<session_write> sessions;
+    sessions.reserve(bulk.size());
+    uint64_t num_records = 0;
+    for (auto& records : bulk) {
+        num_records += records->size();
+
+        // Check if a session's record is ready before handling events' records.
+        //
+        // New event's records and a session's record may become ready while a
+        // mutation with the current events' records is being written. We don't want
+        // to allow the situation when a session's record is written before the last
+        // event record from the same session.
+        bool session_record_is_ready = records->session_rec.ready();
+        auto events = std::move(records->events_recs);
+        records->events_recs.clear();
+
+        // From this point on - all new data will have to be handled in the next write event
+        records->data_consumed();
+
+        sessions.push_back(session_write{std::move(records), std::move(events), session_record_is_ready});
+    }
+    write_sessions(std::move(sessions), num_records);
+}
+
+schema_ptr trace_keyspace_helper::get_schema(table_helper& t) {
+    // Preparing the INSERT statement validates the table, and the prepared
+    // statement is invalidated when its schema changes.
+    t.cache_table_info(_dummy_query_state).get();
+    return t.insert_stmt()->s;
 }
 
-cql3::query_options trace_keyspace_helper::make_session_mutation_data(const one_session_records& session_records) {
+void trace_keyspace_helper::add_session_mutation(mutations_batch& batch, const schema_ptr& s, const one_session_records& session_records, api::timestamp_type ts) {
     const session_record& record = session_records.session_rec;
-    auto millis_since_epoch = std::chrono::duration_cast<std::chrono::milliseconds>(record.started_at.time_since_epoch()).count();
-    std::vector<std::pair<data_value, data_value>> parameters_values_vector;
-    parameters_values_vector.reserve(record.parameters.size());
-    std::for_each(record.parameters.begin(), record.parameters.end(), [&parameters_values_vector] (auto& val_pair) { parameters_values_vector.emplace_back(val_pair.first, val_pair.second); });
-    auto my_map_type = map_type_impl::get_instance(utf8_type, utf8_type, true);
-
-    std::vector<cql3::raw_value> values {
-        cql3::raw_value::make_value(uuid_type->decompose(session_records.session_id)),
-        cql3::raw_value::make_value(utf8_type->decompose(type_to_string(record.command))),
-        cql3::raw_value::make_value(inet_addr_type->decompose(record.client.addr())),
-        cql3::raw_value::make_value(inet_addr_type->decompose(utils::fb_utilities::get_broadcast_address().addr())),
-        cql3::raw_value::make_value(int32_type->decompose(elapsed_to_micros(record.elapsed))),
-        cql3::raw_value::make_value(make_map_value(my_map_type, map_type_impl::native_type(std::move(parameters_values_vector))).serialize()),
-        cql3::raw_value::make_value(utf8_type->decompose(record.request)),
-        cql3::raw_value::make_value(timestamp_type->decompose(millis_since_epoch)),
-        cql3::raw_value::make_value(int32_type->decompose((int32_t)(session_records.ttl.count())))
-    };
-
-    return cql3::query_options(db::consistency_level::ANY, std::experimental::nullopt, std::move(values), false, cql3::query_options::specific_options::DEFAULT, cql_serialization_format::latest());
+    std::vector<std::pair<bytes, bytes>> parameters;
+    parameters.reserve(record.parameters.size());
+    for (auto&& p : record.parameters) {
+        parameters.emplace_back(utf8_type->decompose(p.first), utf8_type->decompose(p.second));
+    }
+
+    mutation m(partition_key::from_singular(*s, session_records.session_id), s);
+    trace_row_builder(m, clustering_key::make_empty(), ts, session_records.ttl)
+        .set("command", utf8_type, utf8_type->decompose(type_to_string(record.command)))
+        .set("client", inet_addr_type, inet_addr_type->decompose(record.client.addr()))
+        .set("coordinator", inet_addr_type, inet_addr_type->decompose(utils::fb_utilities::get_broadcast_address().addr()))
+        .set("duration", int32_type, int32_type->decompose(elapsed_to_micros(record.elapsed)))
+        .set_collection("parameters", map_type_impl::get_instance(utf8_type, utf8_type, true), std::move(parameters))
+        .set("request", utf8_type, utf8_type->decompose(record.request))
+        .set("started_at", timestamp_type, timestamp_type->decompose(to_millis(record.started_at.time_since_epoch())));
+    batch.sessions.emplace_back(std::move(m));
 }
 
-cql3::query_options trace_keyspace_helper::make_session_time_idx_mutation_data(const one_session_records& session_records) {
+void trace_keyspace_helper::add_session_time_idx_mutation(mutations_batch& batch, const schema_ptr& s, const one_session_records& session_records, api::timestamp_type ts) {
     auto started_at_duration = session_records.session_rec.started_at.time_since_epoch();
     // timestamp in minutes when the query began
-    auto minutes_in_millis = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::duration_cast<std::chrono::minutes>(started_at_duration)).count();
-    // timestamp when the query began
-    auto millis_since_epoch = std::chrono::duration_cast<std::chrono::milliseconds>(started_at_duration).count();
-
-    std::vector<cql3::raw_value> values {
-        cql3::raw_value::make_value(timestamp_type->decompose(minutes_in_millis)),
-        cql3::raw_value::make_value(timestamp_type->decompose(millis_since_epoch)),
-        cql3::raw_value::make_value(uuid_type->decompose(session_records.session_id)),
-        cql3::raw_value::make_value(int32_type->decompose(int32_t(session_records.ttl.count())))
-    };
-
-    return cql3::query_options(db::consistency_level::ANY, std::experimental::nullopt, std::move(values), false, cql3::query_options::specific_options::DEFAULT, cql_serialization_format::latest());
+    auto minutes_in_millis = to_minute_millis(started_at_duration);
+
+    auto it = batch.sessions_time_idx.find(minutes_in_millis);
+    if (it == batch.sessions_time_idx.end()) {
+        auto pk = partition_key::from_exploded(*s, {timestamp_type->decompose(minutes_in_millis)});
+        it = batch.sessions_time_idx.emplace(minutes_in_millis, mutation(std::move(pk), s)).first;
+    }
+    auto ck = clustering_key::from_exploded(*s, {
+        timestamp_type->decompose(to_millis(started_at_duration)),
+        uuid_type->decompose(session_records.session_id)
+    });
+    trace_row_builder(it->second, std::move(ck), ts, session_records.ttl);
 }
 
-cql3::query_options trace_keyspace_helper::make_slow_query_mutation_data(const one_session_records& session_records, const utils::UUID& start_time_id) {
+void trace_keyspace_helper::add_slow_query_mutation(mutations_batch& batch, const schema_ptr& s, const one_session_records& session_records, const utils::UUID& start_time_id, api::timestamp_type ts) {
     const session_record& record = session_records.session_rec;
-    auto millis_since_epoch = std::chrono::duration_cast<std::chrono::milliseconds>(record.started_at.time_since_epoch()).count();
 
     // query command is stored on a parameters map with a 'query' key
     auto query_str_it = record.parameters.find("query");
@@ -276,147 +340,135 @@ cql3::query_options trace_keyspace_helper::make_slow_query_mutation_data(const o
     }
 
     // parameters map
-    std::vector<std::pair<data_value, data_value>> parameters_values_vector;
-    parameters_values_vector.reserve(record.parameters.size());
-    std::for_each(record.parameters.begin(), record.parameters.end(), [&parameters_values_vector] (auto& val_pair) { parameters_values_vector.emplace_back(val_pair.first, val_pair.second); });
-    auto my_map_type = map_type_impl::get_instance(utf8_type, utf8_type, true);
+    std::vector<std::pair<bytes, bytes>> parameters;
+    parameters.reserve(record.parameters.size());
+    for (auto&& p : record.parameters) {
+        parameters.emplace_back(utf8_type->decompose(p.first), utf8_type->decompose(p.second));
+    }
 
     // set of tables involved in this query
-    std::vector<data_value> tables_names_vector;
-    tables_names_vector.reserve(record.tables.size());
-    std::for_each(record.tables.begin(), record.tables.end(), [&tables_names_vector] (auto& val) { tables_names_vector.emplace_back(val); });
-    auto my_set_type = set_type_impl::get_instance(utf8_type, true);
-
-    std::vector<cql3::raw_value> values({
-        cql3::raw_value::make_value(inet_addr_type->decompose(utils::fb_utilities::get_broadcast_address().addr())),
-        cql3::raw_value::make_value(int32_type->decompose((int32_t)(engine().cpu_id()))),
-        cql3::raw_value::make_value(uuid_type->decompose(session_records.session_id)),
-        cql3::raw_value::make_value(timestamp_type->decompose(millis_since_epoch)),
-        cql3::raw_value::make_value(timeuuid_type->decompose(start_time_id)),
-        cql3::raw_value::make_value(utf8_type->decompose(query_str_it->second)),
-        cql3::raw_value::make_value(int32_type->decompose(elapsed_to_micros(record.elapsed))),
-        cql3::raw_value::make_value(make_map_value(my_map_type, map_type_impl::native_type(std::move(parameters_values_vector))).serialize()),
-        cql3::raw_value::make_value(inet_addr_type->decompose(record.client.addr())),
-        cql3::raw_value::make_value(make_set_value(my_set_type, set_type_impl::native_type(std::move(tables_names_vector))).serialize()),
-        cql3::raw_value::make_value(utf8_type->decompose(record.username)),
-        cql3::raw_value::make_value(int32_type->decompose((int32_t)(record.slow_query_record_ttl.count())))
-    });
+    std::vector<std::pair<bytes, bytes>> tables;
+    tables.reserve(record.tables.size());
+    for (auto&& t : record.tables) {
+        tables.emplace_back(utf8_type->decompose(t), bytes());
+    }
 
-    return cql3::query_options(db::consistency_level::ANY, std::experimental::nullopt, std::move(values), false, cql3::query_options::specific_options::DEFAULT, cql_serialization_format::latest());
+    mutation m(partition_key::from_exploded(*s, {timeuuid_type->decompose(start_time_id)}), s);
+    auto ck = clustering_key::from_exploded(*s, {
+        inet_addr_type->decompose(utils::fb_utilities::get_broadcast_address().addr()),
+        int32_type->decompose(int32_t(engine().cpu_id()))
+    });
+    trace_row_builder(m, std::move(ck), ts, record.slow_query_record_ttl)
+        .set("session_id", uuid_type, uuid_type->decompose(session_records.session_id))
+        .set("date", timestamp_type, timestamp_type->decompose(to_millis(record.started_at.time_since_epoch())))
+        .set("command", utf8_type, utf8_type->decompose(query_str_it->second))
+        .set("duration", int32_type, int32_type->decompose(elapsed_to_micros(record.elapsed)))
+        .set_collection("parameters", map_type_impl::get_instance(utf8_type, utf8_type, true), std::move(parameters))
+        .set("source_ip", inet_addr_type, inet_addr_type->decompose(record.client.addr()))
+        .set_collection("table_names", set_type_impl::get_instance(utf8_type, true), std::move(tables))
+        .set("username", utf8_type, utf8_type->decompose(record.username));
+    batch.sessions.emplace_back(std::move(m));
 }
 
-cql3::query_options trace_keyspace_helper::make_slow_query_time_idx_mutation_data(const one_session_records& session_records, const utils::UUID& start_time_id) {
+void trace_keyspace_helper::add_slow_query_time_idx_mutation(mutations_batch& batch, const schema_ptr& s, const one_session_records& session_records, const utils::UUID& start_time_id, api::timestamp_type ts) {
     auto started_at_duration = session_records.session_rec.started_at.time_since_epoch();
     // timestamp in minutes when the query began
-    auto minutes_in_millis = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::duration_cast<std::chrono::minutes>(started_at_duration)).count();
-    // timestamp when the query began
-    auto millis_since_epoch = std::chrono::duration_cast<std::chrono::milliseconds>(started_at_duration).count();
-
-    std::vector<cql3::raw_value> values({
-        cql3::raw_value::make_value(timestamp_type->decompose(minutes_in_millis)),
-        cql3::raw_value::make_value(timestamp_type->decompose(millis_since_epoch)),
-        cql3::raw_value::make_value(uuid_type->decompose(session_records.session_id)),
-        cql3::raw_value::make_value(timeuuid_type->decompose(start_time_id)),
-        cql3::raw_value::make_value(inet_addr_type->decompose(utils::fb_utilities::get_broadcast_address().addr())),
-        cql3::raw_value::make_value(int32_type->decompose(int32_t(engine().cpu_id()))),
-        cql3::raw_value::make_value(int32_type->decompose(int32_t(session_records.session_rec.slow_query_record_ttl.count())))
-    });
-
-    return cql3::query_options(db::consistency_level::ANY, std::experimental::nullopt, std::move(values), false, cql3::query_options::specific_options::DEFAULT, cql_serialization_format::latest());
-}
-
-std::vector<cql3::raw_value> trace_keyspace_helper::make_event_mutation_data(one_session_records& session_records, const event_record& record) {
-    auto backend_state_ptr = static_cast<trace_keyspace_backend_sesssion_state*>(session_records.backend_state_ptr.get());
+    auto minutes_in_millis = to_minute_millis(started_at_duration);
 
-    std::vector<cql3::raw_value> values({
-        cql3::raw_value::make_value(uuid_type->decompose(session_records.session_id)),
-        cql3::raw_value::make_value(timeuuid_type->decompose(utils::UUID_gen::get_time_UUID(table_helper::make_monotonic_UUID_tp(backend_state_ptr->last_nanos, record.event_time_point)))),
-        cql3::raw_value::make_value(utf8_type->decompose(record.message)),
-        cql3::raw_value::make_value(inet_addr_type->decompose(utils::fb_utilities::get_broadcast_address().addr())),
-        cql3::raw_value::make_value(int32_type->decompose(elapsed_to_micros(record.elapsed))),
-        cql3::raw_value::make_value(utf8_type->decompose(_local_tracing.get_thread_name())),
-        cql3::raw_value::make_value(long_type->decompose(int64_t(session_records.parent_id.get_id()))),
-        cql3::raw_value::make_value(long_type->decompose(int64_t(session_records.my_span_id.get_id()))),
-        cql3::raw_value::make_value(int32_type->decompose((int32_t)(session_records.ttl.count())))
+    auto it = batch.slow_query_log_time_idx.find(minutes_in_millis);
+    if (it == batch.slow_query_log_time_idx.end()) {
+        auto pk = partition_key::from_exploded(*s, {timestamp_type->decompose(minutes_in_millis)});
+        it = batch.slow_query_log_time_idx.emplace(minutes_in_millis, mutation(std::move(pk), s)).first;
+    }
+    auto ck = clustering_key::from_exploded(*s, {
+        timestamp_type->decompose(to_millis(started_at_duration)),
+        uuid_type->decompose(session_records.session_id)
     });
-
-    return values;
+    trace_row_builder(it->second, std::move(ck), ts, session_records.session_rec.slow_query_record_ttl)
+        .set("start_time", timeuuid_type, timeuuid_type->decompose(start_time_id))
+        .set("node_ip", inet_addr_type, inet_addr_type->decompose(utils::fb_utilities::get_broadcast_address().addr()))
+        .set("shard", int32_type, int32_type->decompose(int32_t(engine().cpu_id())));
 }
 
-future<> trace_keyspace_helper::apply_events_mutation(lw_shared_ptr<one_session_records> records, std::deque<event_record>& events_records) {
-    if (events_records.empty()) {
-        return now();
+mutation trace_keyspace_helper::make_events_mutation(const schema_ptr& s, one_session_records& session_records, const std::deque<event_record>& events_records, api::timestamp_type ts) {
+    auto backend_state_ptr = static_cast<trace_keyspace_backend_sesssion_state*>(session_records.backend_state_ptr.get());
+    auto source = inet_addr_type->decompose(utils::fb_utilities::get_broadcast_address().addr());
+    auto thread = utf8_type->decompose(_local_tracing.get_thread_name());
+    auto parent_id = long_type->decompose(int64_t(session_records.parent_id.get_id()));
+    auto span_id = long_type->decompose(int64_t(session_records.my_span_id.get_id()));
+
+    mutation m(partition_key::from_singular(*s, session_records.session_id), s);
+    for (auto&& record : events_records) {
+        auto event_id = utils::UUID_gen::get_time_UUID(table_helper::make_monotonic_UUID_tp(backend_state_ptr->last_nanos, record.event_time_point));
+        trace_row_builder(m, clustering_key::from_exploded(*s, {timeuuid_type->decompose(event_id)}), ts, session_records.ttl)
+            .set("activity", utf8_type, utf8_type->decompose(record.message))
+            .set("source", inet_addr_type, source)
+            .set("source_elapsed", int32_type, int32_type->decompose(elapsed_to_micros(record.elapsed)))
+            .set("thread", utf8_type, thread)
+            .set("scylla_parent_id", long_type, parent_id)
+            .set("scylla_span_id", long_type, span_id);
     }
+    return m;
+}
 
-    return _events.cache_table_info(_dummy_query_state).then([this, records, &events_records] {
-        tlogger.trace("{}: storing {} events records: parent_id {} span_id {}", records->session_id, events_records.size(), records->parent_id, records->my_span_id);
-
-        std::vector<shared_ptr<cql3::statements::modification_statement>> modifications(events_records.size(), _events.insert_stmt());
-        std::vector<std::vector<cql3::raw_value>> values;
-        auto& qp = cql3::get_local_query_processor();
-
-        values.reserve(events_records.size());
-        std::for_each(events_records.begin(), events_records.end(), [&values, all_records = records, this] (event_record& one_event_record) { values.emplace_back(make_event_mutation_data(*all_records, one_event_record)); });
+void trace_keyspace_helper::flush_sessions_mutations(std::vector<session_write>& sessions) {
+    auto ts = api::new_timestamp();
+    mutations_batch batch;
+    stdx::optional<schema_ptr> events_schema;
 
-        return do_with(
-            cql3::query_options::make_batch_options(cql3::query_options(db::consistency_level::ANY, std::experimental::nullopt, std::vector<cql3::raw_value>{}, false, cql3::query_options::specific_options::DEFAULT, cql_serialization_format::latest()), std::move(values)),
-            cql3::statements::batch_statement(cql3::statements::batch_statement::type::UNLOGGED, std::move(modifications), cql3::attributes::none(), qp.get_cql_stats()),
-            [this] (auto& batch_options, auto& batch) {
-                return batch.execute(service::get_storage_proxy(), _dummy_query_state, batch_options).then([] (shared_ptr<cql_transport::messages::result_message> res) { return now(); });
-            }
-        );
-    });
-}
+    for (auto& sw : sessions) {
+        if (sw.events.empty()) {
+            continue;
+        }
+        if (!events_schema) {
+            events_schema = get_schema(_events);
+        }
+        tlogger.trace("{}: storing {} events records: parent_id {} span_id {}", sw.records->session_id, sw.events.size(), sw.records->parent_id, sw.records->my_span_id);
+        batch.events.emplace_back(make_events_mutation(*events_schema, *sw.records, sw.events, ts));
+        if (seastar::thread::should_yield()) {
+            seastar::thread::yield();
+        }
+    }
 
-future<> trace_keyspace_helper::flush_one_session_mutations(lw_shared_ptr<one_session_records> records) {
-    // grab events records available so far
-    return do_with(std::move(records->events_recs), [this, records] (std::deque<event_record>& events_records) {
-        records->events_recs.clear();
+    for (auto& sw : sessions) {
+        if (!sw.session_record_is_ready) {
+            continue;
+        }
 
-        // Check if a session's record is ready before handling events' records.
-        //
-        // New event's records and a session's record may become ready while a
-        // mutation with the current events' records is being written. We don't want
-        // to allow the situation when a session's record is written before the last
-        // event record from the same session.
-        bool session_record_is_ready = records->session_rec.ready();
+        // if session is finished - store a session and a session time index entries
+        tlogger.trace("{}: going to store a session event", sw.records->session_id);
+        add_session_mutation(batch, get_schema(_sessions), *sw.records, ts);
+        add_session_time_idx_mutation(batch, get_schema(_sessions_time_idx), *sw.records, ts);
+
+        if (sw.records->do_log_slow_query) {
+            // if slow query log is requested - store a slow query log and a slow query log time index entries
+            auto start_time_id = utils::UUID_gen::get_time_UUID(table_helper::make_monotonic_UUID_tp(_slow_query_last_nanos, sw.records->session_rec.started_at));
+            tlogger.trace("{}: going to store a slow query event", sw.records->session_id);
+            add_slow_query_mutation(batch, get_schema(_slow_query_log), *sw.records, start_time_id, ts);
+            add_slow_query_time_idx_mutation(batch, get_schema(_slow_query_log_time_idx), *sw.records, start_time_id, ts);
+        }
+        if (seastar::thread::should_yield()) {
+            seastar::thread::yield();
+        }
+    }
 
-        // From this point on - all new data will have to be handled in the next write event
-        records->data_consumed();
+    for (auto&& m : batch.sessions_time_idx | boost::adaptors::map_values) {
+        batch.sessions.emplace_back(std::move(m));
+    }
+    for (auto&& m : batch.slow_query_log_time_idx | boost::adaptors::map_values) {
+        batch.sessions.emplace_back(std::move(m));
+    }
 
-        // We want to serialize the creation of events mutations in order to ensure
-        // that mutations for events that were created first are going to be
-        // created first too.
-        auto backend_state_ptr = static_cast<trace_keyspace_backend_sesssion_state*>(records->backend_state_ptr.get());
-        semaphore& write_sem = backend_state_ptr->write_sem;
-        return with_semaphore(write_sem, 1, [this, records, session_record_is_ready, &events_records] {
-            return apply_events_mutation(records, events_records).then([this, session_record_is_ready, records] {
-                if (session_record_is_ready) {
-
-                    // if session is finished - store a session and a session time index entries
-                    tlogger.trace("{}: going to store a session event", records->session_id);
-                    return _sessions.insert(_dummy_query_state, make_session_mutation_data, *records).then([this, records] {
-                        tlogger.trace("{}: going to store a {} entry", records->session_id, _sessions_time_idx.name());
-                        return _sessions_time_idx.insert(_dummy_query_state, make_session_time_idx_mutation_data, *records);
-                    }).then([this, records] {
-                        if (!records->do_log_slow_query) {
-                            return now();
-                        }
-
-                        // if slow query log is requested - store a slow query log and a slow query log time index entries
-                        auto start_time_id = utils::UUID_gen::get_time_UUID(table_helper::make_monotonic_UUID_tp(_slow_query_last_nanos, records->session_rec.started_at));
-                        tlogger.trace("{}: going to store a slow query event", records->session_id);
-                        return _slow_query_log.insert(_dummy_query_state, make_slow_query_mutation_data, *records, start_time_id).then([this, records, start_time_id] {
-                            tlogger.trace("{}: going to store a {} entry", records->session_id, _slow_query_log_time_idx.name());
-                            return _slow_query_log_time_idx.insert(_dummy_query_state, make_slow_query_time_idx_mutation_data, *records, start_time_id);
-                        });
-                    });
-                } else {
-                    return now();
-                }
-            });
-        }).finally([records] {});
-    });
+    // Events go first, so that a session record, which marks the session as
+    // complete, is never visible before its events.
+    auto& proxy = service::get_local_storage_proxy();
+    _stats.written_mutations += batch.events.size() + batch.sessions.size();
+    if (!batch.events.empty()) {
+        proxy.mutate(std::move(batch.events), db::consistency_level::ANY, nullptr).get();
+    }
+    if (!batch.sessions.empty()) {
+        proxy.mutate(std::move(batch.sessions), db::consistency_level::ANY, nullptr).get();
+    }
 }
 
 std::unique_ptr<backend_session_state_base> trace_keyspace_helper::allocate_session_state() const {
@@ -41,13 +41,16 @@
 #pragma once
 
 #include <tuple>
+#include <map>
 #include <seastar/core/gate.hh>
 #include <seastar/core/apply.hh>
+#include <seastar/core/thread.hh>
 #include <seastar/core/metrics_registration.hh>
 #include "database.hh"
 #include "tracing/tracing.hh"
 #include "cql3/query_processor.hh"
 #include "table_helper.hh"
+#include "utils/estimated_histogram.hh"
 
 namespace tracing {
 
@@ -64,8 +67,16 @@ class trace_keyspace_helper final : public i_tracing_backend_helper {
 
 private:
     static constexpr int bad_column_family_message_period = 10000;
+    // Fraction of the CPU the building of trace mutations may use when the
+    // shard is busy.
+    static constexpr float write_scheduling_quota = 0.1;
 
     seastar::gate _pending_writes;
+    // Bulks are written one at a time, in the order they were handed over,
+    // so that a session record is never written before the events records
+    // of the same session which came in an earlier bulk.
+    semaphore _write_sem{1};
+    seastar::thread_scheduling_group _write_scheduling_group;
     int64_t _slow_query_last_nanos = 0;
     service::query_state _dummy_query_state;
 
@@ -78,10 +89,30 @@ class trace_keyspace_helper final : public i_tracing_backend_helper {
     struct stats {
         uint64_t tracing_errors = 0;
         uint64_t bad_column_family_errors = 0;
+        uint64_t dropped_records = 0;
+        uint64_t written_records = 0;
+        uint64_t written_mutations = 0;
     } _stats;
+    utils::estimated_histogram _write_latency;
 
     seastar::metrics::metric_groups _metrics;
 
+    // Records of a single session taken for writing in one bulk.
+    struct session_write {
+        lw_shared_ptr<one_session_records> records;
+        std::deque<event_record> events;
+        bool session_record_is_ready;
+    };
+
+    // Mutations of a bulk, merged per partition. Index tables are
+    // partitioned by the minute, so many sessions share a partition.
+    struct mutations_batch {
+        std::vector<mutation> events;
+        std::vector<mutation> sessions;
+        std::map<int64_t, mutation> sessions_time_idx;
+        std::map<int64_t, mutation> slow_query_log_time_idx;
+    };
+
 public:
     trace_keyspace_helper(tracing& tr);
     virtual ~trace_keyspace_helper() {}
@@ -102,89 +133,93 @@ class trace_keyspace_helper final : public i_tracing_backend_helper {
 
 private:
     /**
-     * Write records of a single tracing session
+     * Write records of a bulk of tracing sessions.
      *
-     * @param records records to write
-     */
-    void write_one_session_records(lw_shared_ptr<one_session_records> records);
-
-    /**
-     * Flush mutations of one particular tracing session. First "events"
-     * mutations and then, when they are complete, a "sessions" mutation.
+     * Mutations are built directly, without going through CQL, and all
+     * mutations of the same partition are merged. Events mutations are
+     * applied first and then, when they are complete, sessions mutations.
      *
      * @note This function guaranties that it'll handle exactly the same number
-     * of records @param records had when the function was invoked.
-     *
-     * @param records records describing the session's records
+     * of records the sessions had when the function was invoked.
      *
-     * @return A future that resolves when applying of above mutations is
-     *         complete.
+     * @param sessions records of the sessions to write
+     * @param num_records the total number of records in @param sessions
      */
-    future<> flush_one_session_mutations(lw_shared_ptr<one_session_records> records);
+    void write_sessions(std::vector<session_write> sessions, uint64_t num_records);
 
     /**
-     * Apply events records mutations.
+     * Build and apply the mutations of a bulk of sessions. Must be called in
+     * a seastar thread.
      *
-     * @param records all session records
-     * @param events_records events recods to apply
-     * @param start_point a time point when this tracing session data writing has started
+     * @param sessions records of the sessions to write
+     */
+    void flush_sessions_mutations(std::vector<session_write>& sessions);
+
+    /**
+     * Make sure the schema of a table is as expected, and return it.
      *
-     * @return a future that resolves when the mutation has been written.
+     * @return the schema of the table behind @param t
      *
-     * @note A caller must ensure that @param events_records is alive till the
-     * returned future resolves.
+     * @throw bad_column_family if the table doesn't exist or has an
+     *        incompatible schema
      */
-    future<> apply_events_mutation(lw_shared_ptr<one_session_records> records, std::deque<event_record>& events_records);
+    schema_ptr get_schema(table_helper& t);
 
     /**
-     * Create a mutation data for a new session record
+     * Add a mutation for a new session record
      *
+     * @param batch the batch to add the mutation to
+     * @param s the sessions table schema
      * @param all_records_handle handle to access an object with all records of this session
-     *
-     * @return the relevant cql3::query_options object with the mutation data
+     * @param ts the mutation timestamp
      */
-    static cql3::query_options make_session_mutation_data(const one_session_records& all_records_handle);
+    static void add_session_mutation(mutations_batch& batch, const schema_ptr& s, const one_session_records& all_records_handle, api::timestamp_type ts);
 
     /**
-     * Create a mutation data for a new session_idx record
+     * Add a mutation for a new session_idx record
      *
+     * @param batch the batch to add the mutation to
+     * @param s the sessions_time_idx table schema
      * @param all_records_handle handle to access an object with all records of this session
-     *
-     * @return the relevant cql3::query_options object with the mutation data
+     * @param ts the mutation timestamp
      */
-    static cql3::query_options make_session_time_idx_mutation_data(const one_session_records& all_records_handle);
+    static void add_session_time_idx_mutation(mutations_batch& batch, const schema_ptr& s, const one_session_records& all_records_handle, api::timestamp_type ts);
 
     /**
-     * Create mutation for a new slow_query_log record
+     * Add a mutation for a new slow_query_log record
      *
+     * @param batch the batch to add the mutation to
+     * @param s the slow_query_log table schema
      * @param all_records_handle handle to access an object with all records of this session
      * @param start_time_id time UUID generated from the query start time
-     *
-     * @return the relevant mutation
+     * @param ts the mutation timestamp
      */
-    static cql3::query_options make_slow_query_mutation_data(const one_session_records& all_records_handle, const utils::UUID& start_time_id);
+    static void add_slow_query_mutation(mutations_batch& batch, const schema_ptr& s, const one_session_records& all_records_handle, const utils::UUID& start_time_id, api::timestamp_type ts);
 
     /**
-     * Create mutation for a new slow_query_log_time_idx record
+     * Add a mutation for a new slow_query_log_time_idx record
      *
+     * @param batch the batch to add the mutation to
+     * @param s the slow_query_log_time_idx table schema
      * @param all_records_handle handle to access an object with all records of this session
      * @param start_time_id time UUID generated from the query start time
-     *
-     * @return the relevant mutation
+     * @param ts the mutation timestamp
      */
-    static cql3::query_options make_slow_query_time_idx_mutation_data(const one_session_records& all_records_handle, const utils::UUID& start_time_id);
+    static void add_slow_query_time_idx_mutation(mutations_batch& batch, const schema_ptr& s, const one_session_records& all_records_handle, const utils::UUID& start_time_id, api::timestamp_type ts);
 
     /**
-     * Create a mutation data for a new trace point record
+     * Create a mutation of the events partition of a session
      *
+     * @param s the events table schema
      * @param session_records handle to access an object with all records of this session.
      *                        It's needed here in order to update the last event's mutation
      *                        timestamp value stored inside it.
-     * @param record data describing this trace event
+     * @param events_records data describing the trace events
+     * @param ts the mutation timestamp
      *
-     * @return a vector with the mutation data
+     * @return the mutation with all @param events_records
      */
-    std::vector<cql3::raw_value> make_event_mutation_data(one_session_records& session_records, const event_record& record);
+    mutation make_events_mutation(const schema_ptr& s, one_session_records& session_records, const std::deque<event_record>& events_records, api::timestamp_type ts);
 
     /**
      * Converts a @param elapsed to an int32_t value of microseconds.
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2017 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "mutation.hh"
+#include "table_helper.hh"
+#include "types.hh"
+
+namespace tracing {
+
+// Builds a row of a system_traces table the way an INSERT ... USING TTL of
+// the same values, executed at now, would.
+class trace_row_builder {
+    mutation& _m;
+    clustering_key _ck;
+    api::timestamp_type _ts;
+    gc_clock::time_point _now;
+    gc_clock::duration _ttl;
+private:
+    const column_definition& column(const char* name, const data_type& type) const {
+        auto cdef = _m.schema()->get_column_definition(to_bytes(name));
+        if (!cdef || cdef->type != type) {
+            throw bad_column_family(_m.schema()->ks_name(), _m.schema()->cf_name());
+        }
+        return *cdef;
+    }
+
+    atomic_cell make_cell(bytes_view value) const {
+        if (_ttl.count() > 0) {
+            return atomic_cell::make_live(_ts, value, _now + _ttl, _ttl);
+        }
+        return atomic_cell::make_live(_ts, value);
+    }
+public:
+    // A ttl of 0 stands for the table's default_time_to_live, like it does in CQL.
+    trace_row_builder(mutation& m, clustering_key ck, api::timestamp_type ts, std::chrono::seconds ttl,
+                      gc_clock::time_point now = gc_clock::now())
+        : _m(m)
+        , _ck(std::move(ck))
+        , _ts(ts)
+        , _now(now)
+        , _ttl(ttl.count() > 0 ? std::chrono::duration_cast<gc_clock::duration>(ttl) : _m.schema()->default_time_to_live())
+    {
+        _m.partition().clustered_row(*_m.schema(), _ck).apply(row_marker(_ts, _ttl, _now + _ttl));
+    }
+
+    trace_row_builder& set(const char* name, const data_type& type, const bytes& value) {
+        _m.set_clustered_cell(_ck, column(name, type), make_cell(value));
+        return *this;
+    }
+
+    // Sets a non-frozen collection, replacing its previous content.
+    trace_row_builder& set_collection(const char* name, const data_type& type, std::vector<std::pair<bytes, bytes>> cells) {
+        auto& cdef = column(name, type);
+        collection_type_impl::mutation mut;
+        mut.tomb = tombstone(_ts - 1, _now);
+        mut.cells.reserve(cells.size());
+        for (auto&& c : cells) {
+            mut.cells.emplace_back(std::move(c.first), make_cell(c.second));
+        }
+        auto ctype = static_pointer_cast<const collection_type_impl>(type);
+        _m.set_clustered_cell(_ck, cdef, atomic_cell_or_collection::from_collection_mutation(ctype->serialize_mutation_form(std::move(mut))));
+        return *this;
+    }
+};
+
+}
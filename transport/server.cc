@@ -20,6 +20,7 @@
  */
 
 #include "server.hh"
+#include "response.hh"
 
 #include <boost/bimap/unordered_set_of.hpp>
 #include <boost/range/irange.hpp>
@@ -54,6 +55,7 @@
 #include <string>
 
 #include <snappy-c.h>
+#include <snappy.h>
 #include <lz4.h>
 
 namespace cql_transport {
@@ -66,26 +68,6 @@ struct cql_frame_error : std::exception {
     }
 };
 
-enum class cql_binary_opcode : uint8_t {
-    ERROR          = 0,
-    STARTUP        = 1,
-    READY          = 2,
-    AUTHENTICATE   = 3,
-    CREDENTIALS    = 4,
-    OPTIONS        = 5,
-    SUPPORTED      = 6,
-    QUERY          = 7,
-    RESULT         = 8,
-    PREPARE        = 9,
-    EXECUTE        = 10,
-    REGISTER       = 11,
-    EVENT          = 12,
-    BATCH          = 13,
-    AUTH_CHALLENGE = 14,
-    AUTH_RESPONSE  = 15,
-    AUTH_SUCCESS   = 16,
-};
-
 inline db::consistency_level wire_to_consistency(int16_t v)
 {
      switch (v) {
@@ -183,83 +165,6 @@ cql_load_balance parse_load_balance(sstring value)
     }
 }
 
-class cql_server::response {
-    int16_t           _stream;
-    cql_binary_opcode _opcode;
-    uint8_t           _flags = 0; // a bitwise OR mask of zero or more cql_frame_flags values
-    std::vector<char> _body;
-public:
-    response(int16_t stream, cql_binary_opcode opcode, const tracing::trace_state_ptr& tr_state_ptr)
-        : _stream{stream}
-        , _opcode{opcode}
-        , _body(tracing::should_return_id_in_response(tr_state_ptr) ? utils::UUID::serialized_size() : 0)
-    {
-        if (tracing::should_return_id_in_response(tr_state_ptr)) {
-            auto i = _body.begin();
-            tr_state_ptr->session_id().serialize(i);
-            set_frame_flag(cql_frame_flags::tracing);
-        }
-    }
-
-    void set_frame_flag(cql_frame_flags flag) noexcept {
-        _flags |= flag;
-    }
-
-    scattered_message<char> make_message(uint8_t version);
-    void serialize(const event::schema_change& event, uint8_t version);
-    void write_byte(uint8_t b);
-    void write_int(int32_t n);
-    void write_long(int64_t n);
-    void write_short(uint16_t n);
-    void write_string(const sstring& s);
-    void write_bytes_as_string(bytes_view s);
-    void write_long_string(const sstring& s);
-    void write_string_list(std::vector<sstring> string_list);
-    void write_bytes(bytes b);
-    void write_short_bytes(bytes b);
-    void write_inet(ipv4_addr inet);
-    void write_consistency(db::consistency_level c);
-    void write_string_map(std::map<sstring, sstring> string_map);
-    void write_string_multimap(std::multimap<sstring, sstring> string_map);
-    void write_value(bytes_opt value);
-    void write(const cql3::metadata& m, bool skip = false);
-    void write(const cql3::prepared_metadata& m, uint8_t version);
-    future<> output(output_stream<char>& out, uint8_t version, cql_compression compression);
-
-    cql_binary_opcode opcode() const {
-        return _opcode;
-    }
-private:
-    void compress(cql_compression compression);
-    std::vector<char> compress_lz4(const std::vector<char>& body);
-    std::vector<char> compress_snappy(const std::vector<char>& body);
-
-    template <typename CqlFrameHeaderType>
-    sstring make_frame_one(uint8_t version, size_t length) {
-        sstring frame_buf(sstring::initialized_later(), sizeof(CqlFrameHeaderType));
-        auto* frame = reinterpret_cast<CqlFrameHeaderType*>(frame_buf.begin());
-        frame->version = version | 0x80;
-        frame->flags   = _flags;
-        frame->opcode  = static_cast<uint8_t>(_opcode);
-        frame->length  = htonl(length);
-        frame->stream = net::hton((decltype(frame->stream))_stream);
-
-        return frame_buf;
-    }
-
-    sstring make_frame(uint8_t version, size_t length) {
-        if (version > 0x04) {
-            throw exceptions::protocol_exception(sprint("Invalid or unsupported protocol version: %d", version));
-        }
-
-        if (version > 0x02) {
-            return make_frame_one<cql_binary_frame_v3>(version, length);
-        } else {
-            return make_frame_one<cql_binary_frame_v1>(version, length);
-        }
-    }
-};
-
 cql_server::cql_server(distributed<service::storage_proxy>& proxy, distributed<cql3::query_processor>& qp, cql_load_balance lb)
     : _proxy(proxy)
     , _query_processor(qp)
@@ -1141,6 +1046,10 @@ class cql_server::fmt_visitor : public messages::result_message::visitor_base {
         auto& rs = m.rs();
         _response->write(rs.get_metadata(), _skip_metadata);
         _response->write_int(rs.size());
+        if (auto rows = rs.serialized_rows()) {
+            _response->write(*rows);
+            return;
+        }
         for (auto&& row : rs.rows()) {
             for (auto&& cell : row | boost::adaptors::sliced(0, rs.get_metadata().column_count())) {
                 _response->write_value(cell);
@@ -1487,12 +1396,15 @@ cql3::raw_value_view cql_server::connection::read_value_view(bytes_view& buf) {
     return cql3::raw_value_view::make_value(std::move(bv));
 }
 
+// Moves the body into the message, which references its fragments instead
+// of copying them.
 scattered_message<char> cql_server::response::make_message(uint8_t version) {
     scattered_message<char> msg;
-    sstring body{_body.data(), _body.size()};
-    sstring frame = make_frame(version, _body.size());
-    msg.append(std::move(frame));
-    msg.append(std::move(body));
+    msg.append(make_frame(version, _body.size()));
+    for (auto&& fragment : _body.fragments()) {
+        msg.append_static(reinterpret_cast<const char*>(fragment.data()), fragment.size());
+    }
+    msg.on_delete([body = std::move(_body)] { });
     return msg;
 }
 
@@ -1501,13 +1413,7 @@ cql_server::response::output(output_stream<char>& out, uint8_t version, cql_comp
     if (compression != cql_compression::none) {
         compress(compression);
     }
-    auto frame = make_frame(version, _body.size());
-    auto tmp = temporary_buffer<char>(frame.size());
-    std::copy_n(frame.begin(), frame.size(), tmp.get_write());
-    auto f = out.write(tmp.get(), tmp.size());
-    return f.then([this, &out, tmp = std::move(tmp)] {
-        return out.write(_body.data(), _body.size());
-    });
+    return out.write(make_message(version));
 }
 
 void cql_server::response::compress(cql_compression compression)
@@ -1525,13 +1431,16 @@ void cql_server::response::compress(cql_compression compression)
     set_frame_flag(cql_frame_flags::compression);
 }
 
-std::vector<char> cql_server::response::compress_lz4(const std::vector<char>& body)
+// The protocol requires the body to be a single LZ4 block, so unlike Snappy,
+// LZ4 cannot compress it fragment by fragment.
+bytes_ostream cql_server::response::compress_lz4(bytes_ostream& body)
 {
-    const char* input = body.data();
-    size_t input_len = body.size();
-    std::vector<char> comp;
-    comp.resize(LZ4_COMPRESSBOUND(input_len) + 4);
-    char *output = comp.data();
+    auto in = body.linearize();
+    const char* input = reinterpret_cast<const char*>(in.data());
+    size_t input_len = in.size();
+    bytes_ostream comp;
+    size_t output_bound = LZ4_COMPRESSBOUND(input_len) + 4;
+    char *output = reinterpret_cast<char*>(comp.write_place_holder(output_bound));
     output[0] = (input_len >> 24) & 0xFF;
     output[1] = (input_len >> 16) & 0xFF;
     output[2] = (input_len >> 8) & 0xFF;
@@ -1545,22 +1454,69 @@ std::vector<char> cql_server::response::compress_lz4(const std::vector<char>& bo
         throw std::runtime_error("CQL frame LZ4 compression failure");
     }
     size_t output_len = ret + 4;
-    comp.resize(output_len);
+    comp.remove_suffix(output_bound - output_len);
     return comp;
 }
 
-std::vector<char> cql_server::response::compress_snappy(const std::vector<char>& body)
-{
-    const char* input = body.data();
-    size_t input_len = body.size();
-    std::vector<char> comp;
-    size_t output_len = snappy_max_compressed_length(input_len);
-    comp.resize(output_len);
-    char *output = comp.data();
-    if (snappy_compress(input, input_len, output, &output_len) != SNAPPY_OK) {
-        throw std::runtime_error("CQL frame Snappy compression failure");
+namespace {
+
+// Feeds the fragments of a bytes_ostream to the Snappy compressor.
+class fragmented_snappy_source : public snappy::Source {
+    bytes_ostream::fragment_iterator _it;
+    bytes_ostream::fragment_iterator _end;
+    size_t _offset = 0;
+    size_t _available;
+public:
+    explicit fragmented_snappy_source(const bytes_ostream& b)
+        : _it(b.begin())
+        , _end(b.end())
+        , _available(b.size())
+    { }
+    virtual size_t Available() const override {
+        return _available;
+    }
+    virtual const char* Peek(size_t* len) override {
+        while (_it != _end && (*_it).size() == _offset) {
+            ++_it;
+            _offset = 0;
+        }
+        if (_it == _end) {
+            *len = 0;
+            return nullptr;
+        }
+        auto fragment = *_it;
+        *len = fragment.size() - _offset;
+        return reinterpret_cast<const char*>(fragment.data()) + _offset;
+    }
+    virtual void Skip(size_t n) override {
+        _available -= n;
+        while (n) {
+            size_t len;
+            Peek(&len);
+            auto this_size = std::min(n, len);
+            _offset += this_size;
+            n -= this_size;
+        }
     }
-    comp.resize(output_len);
+};
+
+class bytes_ostream_snappy_sink : public snappy::Sink {
+    bytes_ostream& _out;
+public:
+    explicit bytes_ostream_snappy_sink(bytes_ostream& out) : _out(out) { }
+    virtual void Append(const char* data, size_t n) override {
+        _out.write(data, n);
+    }
+};
+
+}
+
+bytes_ostream cql_server::response::compress_snappy(const bytes_ostream& body)
+{
+    bytes_ostream comp;
+    fragmented_snappy_source source(body);
+    bytes_ostream_snappy_sink sink(comp);
+    snappy::Compress(&source, &sink);
     return comp;
 }
 
@@ -1594,28 +1550,28 @@ void cql_server::response::serialize(const event::schema_change& event, uint8_t
 
 void cql_server::response::write_byte(uint8_t b)
 {
-    _body.insert(_body.end(), b);
+    *_body.write_place_holder(1) = b;
 }
 
 void cql_server::response::write_int(int32_t n)
 {
     auto u = htonl(n);
     auto *s = reinterpret_cast<const char*>(&u);
-    _body.insert(_body.end(), s, s+sizeof(u));
+    _body.write(s, sizeof(u));
 }
 
 void cql_server::response::write_long(int64_t n)
 {
     auto u = htonq(n);
     auto *s = reinterpret_cast<const char*>(&u);
-    _body.insert(_body.end(), s, s+sizeof(u));
+    _body.write(s, sizeof(u));
 }
 
 void cql_server::response::write_short(uint16_t n)
 {
     auto u = htons(n);
     auto *s = reinterpret_cast<const char*>(&u);
-    _body.insert(_body.end(), s, s+sizeof(u));
+    _body.write(s, sizeof(u));
 }
 
 template<typename T>
@@ -1631,19 +1587,19 @@ T cast_if_fits(size_t v) {
 void cql_server::response::write_string(const sstring& s)
 {
     write_short(cast_if_fits<uint16_t>(s.size()));
-    _body.insert(_body.end(), s.begin(), s.end());
+    _body.write(s.begin(), s.size());
 }
 
 void cql_server::response::write_bytes_as_string(bytes_view s)
 {
     write_short(cast_if_fits<uint16_t>(s.size()));
-    _body.insert(_body.end(), s.begin(), s.end());
+    _body.write(s);
 }
 
 void cql_server::response::write_long_string(const sstring& s)
 {
     write_int(cast_if_fits<int32_t>(s.size()));
-    _body.insert(_body.end(), s.begin(), s.end());
+    _body.write(s.begin(), s.size());
 }
 
 void cql_server::response::write_string_list(std::vector<sstring> string_list)
@@ -1657,13 +1613,13 @@ void cql_server::response::write_string_list(std::vector<sstring> string_list)
 void cql_server::response::write_bytes(bytes b)
 {
     write_int(cast_if_fits<int32_t>(b.size()));
-    _body.insert(_body.end(), b.begin(), b.end());
+    _body.write(b);
 }
 
 void cql_server::response::write_short_bytes(bytes b)
 {
     write_short(cast_if_fits<uint16_t>(b.size()));
-    _body.insert(_body.end(), b.begin(), b.end());
+    _body.write(b);
 }
 
 void cql_server::response::write_inet(ipv4_addr inet)
@@ -1716,7 +1672,12 @@ void cql_server::response::write_value(bytes_opt value)
     }
 
     write_int(value->size());
-    _body.insert(_body.end(), value->begin(), value->end());
+    _body.write(*value);
+}
+
+void cql_server::response::write(const bytes_ostream& b)
+{
+    _body.append(b);
 }
 
 class type_codec {
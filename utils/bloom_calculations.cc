@@ -39,6 +39,7 @@
  * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cmath>
 #include "bloom_calculations.hh"
 
 namespace utils {
@@ -100,5 +101,36 @@ std::vector<int> initialize_opt_k() {
 }
 
 std::vector<int> opt_k_per_buckets = initialize_opt_k();
+
+/**
+ * The number of keys falling in a block of a blocked filter is Poisson
+ * distributed with mean bits_per_block / buckets_per_element, and a key
+ * whose block holds j keys is a false positive if each of the block's
+ * words has its bit set, the probability of a bit being set in a word
+ * after j insertions being 1 - (1 - 1/64)^j.
+ */
+double blocked_false_positive_rate(int buckets_per_element) {
+    assert(buckets_per_element >= 1);
+    constexpr int words = 8;
+    constexpr int bits_per_word = 64;
+    double lambda = double(words * bits_per_word) / buckets_per_element;
+    double fp = 0;
+    int last = int(lambda + 10 * std::sqrt(lambda)) + 20;
+    for (int j = 0; j <= last; j++) {
+        double p = std::exp(j * std::log(lambda) - lambda - std::lgamma(j + 1));
+        fp += p * std::pow(1 - std::pow(1 - 1.0 / bits_per_word, j), words);
+    }
+    return fp;
+}
+
+int blocked_buckets_per_element(double max_false_pos_prob) {
+    for (int buckets_per_element = min_buckets; buckets_per_element <= max_blocked_buckets; buckets_per_element++) {
+        if (blocked_false_positive_rate(buckets_per_element) <= max_false_pos_prob) {
+            return buckets_per_element;
+        }
+    }
+    throw exceptions::unsupported_operation_exception(sprint("Unable to satisfy %f with a blocked filter", max_false_pos_prob));
+}
+
 }
 }
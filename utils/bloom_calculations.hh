@@ -153,6 +153,24 @@ namespace bloom_calculations {
         }
         return std::min(probs.size() - 1, size_t(v));
     }
+
+    int constexpr max_blocked_buckets = 64;
+
+    /**
+     * The false positive rate of a blocked bloom filter (see
+     * utils::filter::blocked_bloom_filter), which always sets one bit in
+     * each of the 8 words of a 512-bit block, using the given number of
+     * buckets per element.
+     */
+    double blocked_false_positive_rate(int buckets_per_element);
+
+    /**
+     * The smallest number of buckets per element with which a blocked bloom
+     * filter gives less than the specified false positive rate.
+     *
+     * @throws unsupported_operation_exception if more than max_blocked_buckets would be needed
+     */
+    int blocked_buckets_per_element(double max_false_pos_prob);
 }
 
 }
@@ -49,6 +49,10 @@
 #include <cstdlib>
 #include "bloom_filter.hh"
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 namespace utils {
 namespace filter {
 
@@ -88,6 +92,51 @@ bool bloom_filter::is_present(const bytes_view& key) {
     return is_present(make_hashed_key(key));
 }
 
+// Odd multipliers which spread a 32-bit hash into the bit index, in the
+// top 6 bits of the product, of each word of a block.
+alignas(32) static const uint32_t block_salts[blocked_bloom_filter::words_per_block] = {
+    0x47b6137b, 0x44974d91, 0x8824ad5b, 0xa2b7289d, 0x705495c7, 0x2df1424b, 0x9efc4947, 0x5c6bfb31,
+};
+
+static inline uint64_t block_bit(uint32_t h, size_t word) {
+    return uint64_t(1) << ((h * block_salts[word]) >> 26);
+}
+
+bool blocked_bloom_filter::is_present(hashed_key key) {
+    auto h = key.hash();
+    const uint64_t* b = block_for(h[0]);
+#ifdef __AVX2__
+    // Only built with -mavx2, which neither the default build nor the
+    // tests use, so this path hasn't been exercised.
+    auto shifts = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(uint32_t(h[1])),
+            _mm256_load_si256(reinterpret_cast<const __m256i*>(block_salts))), 26);
+    auto ones = _mm256_set1_epi64x(1);
+    auto lo = _mm256_sllv_epi64(ones, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(shifts)));
+    auto hi = _mm256_sllv_epi64(ones, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(shifts, 1)));
+    // testc is set when all bits of the mask are set in the words.
+    return _mm256_testc_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b)), lo)
+        && _mm256_testc_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + 4)), hi);
+#else
+    uint64_t missing = 0;
+    for (size_t i = 0; i < words_per_block; ++i) {
+        missing |= block_bit(h[1], i) & ~b[i];
+    }
+    return !missing;
+#endif
+}
+
+void blocked_bloom_filter::add(const bytes_view& key) {
+    auto h = make_hashed_key(key).hash();
+    uint64_t* b = block_for(h[0]);
+    for (size_t i = 0; i < words_per_block; ++i) {
+        b[i] |= block_bit(h[1], i);
+    }
+}
+
+bool blocked_bloom_filter::is_present(const bytes_view& key) {
+    return is_present(make_hashed_key(key));
+}
+
 filter_ptr create_filter(int hash, large_bitset&& bitset) {
     return std::make_unique<murmur3_bloom_filter>(hash, std::move(bitset));
 }
@@ -98,5 +147,16 @@ filter_ptr create_filter(int hash, int64_t num_elements, int buckets_per) {
     large_bitset bitset(num_bits);
     return std::make_unique<murmur3_bloom_filter>(hash, std::move(bitset));
 }
+
+filter_ptr create_blocked_filter(large_bitset&& bitset) {
+    return std::make_unique<blocked_bloom_filter>(std::move(bitset));
+}
+
+filter_ptr create_blocked_filter(int64_t num_elements, int buckets_per) {
+    int64_t num_bits = std::max<int64_t>(num_elements * buckets_per, 1);
+    num_bits = align_up<int64_t>(num_bits, blocked_bloom_filter::bits_per_block);
+    large_bitset bitset(num_bits);
+    return std::make_unique<blocked_bloom_filter>(std::move(bitset));
+}
 }
 }
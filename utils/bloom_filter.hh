@@ -47,6 +47,7 @@
 #include "utils/large_bitset.hh"
 
 #include <vector>
+#include <cassert>
 
 namespace utils {
 namespace filter {
@@ -88,6 +89,60 @@ struct murmur3_bloom_filter: public bloom_filter {
 
 };
 
+// A bloom filter whose probes for a key all fall in one 64-byte block, so
+// that a lookup touches a single cache line however many probes it makes
+// (a "split block" bloom filter). The first half of the key's hash picks the
+// block, the second one sets one bit in each of the block's 8 words, so the
+// probes are independent, branch-free word operations, done with AVX2 when
+// available.
+//
+// For the same number of bits per element, its false positive rate is
+// higher than that of bloom_filter; see
+// bloom_calculations::blocked_false_positive_rate().
+class blocked_bloom_filter: public i_filter {
+public:
+    using bitmap = large_bitset;
+    static constexpr size_t words_per_block = 8;
+    static constexpr size_t bits_per_block = words_per_block * 64;
+    static constexpr int hash_count = words_per_block;
+private:
+    bitmap _bitset;
+    uint64_t _blocks;
+private:
+    bitmap::int_type* block_for(uint64_t h) {
+        // Maps h to [0, _blocks) without a division.
+        return _bitset.word_group<words_per_block>((unsigned __int128)h * _blocks >> 64);
+    }
+public:
+    static_assert(bitmap::storage_alignment() % (words_per_block * sizeof(bitmap::int_type)) == 0,
+            "blocks must not cross cache lines");
+
+    // bs.size() must be a multiple of bits_per_block.
+    explicit blocked_bloom_filter(bitmap&& bs)
+        : _bitset(std::move(bs))
+        , _blocks(_bitset.size() / bits_per_block) {
+        assert(!_blocks || reinterpret_cast<uintptr_t>(block_for(0)) % (words_per_block * sizeof(bitmap::int_type)) == 0);
+    }
+
+    bitmap& bits() { return _bitset; }
+
+    virtual void add(const bytes_view& key) override;
+
+    virtual bool is_present(const bytes_view& key) override;
+
+    virtual bool is_present(hashed_key key) override;
+
+    virtual void clear() override {
+        _bitset.clear();
+    }
+
+    virtual void close() override { }
+
+    virtual size_t memory_size() override {
+        return sizeof(_blocks) + _bitset.memory_size();
+    }
+};
+
 struct always_present_filter: public i_filter {
 
     virtual bool is_present(const bytes_view& key) override {
@@ -111,5 +166,7 @@ struct always_present_filter: public i_filter {
 
 filter_ptr create_filter(int hash, large_bitset&& bitset);
 filter_ptr create_filter(int hash, int64_t num_elements, int buckets_per);
+filter_ptr create_blocked_filter(large_bitset&& bitset);
+filter_ptr create_blocked_filter(int64_t num_elements, int buckets_per);
 }
 }
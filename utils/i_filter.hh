@@ -84,5 +84,10 @@ struct i_filter {
      *         probability for the given number of elements.
      */
     static filter_ptr get_filter(int64_t num_elements, int target_buckets_per_elem);
+    /**
+     * @return The smallest blocked_bloom_filter that can provide the given
+     *         false positive probability rate for the given number of elements.
+     */
+    static filter_ptr get_blocked_filter(int64_t num_elements, double max_false_pos_prob);
 };
 }
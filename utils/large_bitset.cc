@@ -21,6 +21,8 @@
 
 #include "large_bitset.hh"
 #include <algorithm>
+#include <new>
+#include <cstdlib>
 #include <seastar/core/align.hh>
 #include "seastarx.hh"
 
@@ -30,7 +32,12 @@ large_bitset::large_bitset(size_t nr_bits) : _nr_bits(nr_bits) {
     size_t nr_ints = align_up(nr_bits, bits_per_int()) / bits_per_int();
     while (nr_ints) {
         auto now = std::min(ints_per_block(), nr_ints);
-        _storage.push_back(std::make_unique<int_type[]>(now));
+        // posix_memalign(), unlike new, aligns small tail blocks as well.
+        void* p;
+        if (posix_memalign(&p, storage_alignment(), now * sizeof(int_type)) != 0) {
+            throw std::bad_alloc();
+        }
+        _storage.emplace_back(static_cast<int_type*>(p));
         std::fill_n(_storage.back().get(), now, 0);
         nr_ints -= now;
     }
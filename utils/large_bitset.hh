@@ -25,14 +25,26 @@
 #pragma once
 
 #include <memory>
+#include <cstdlib>
 #include <vector>
 #include <limits>
 #include <iterator>
 #include <algorithm>
 
 class large_bitset {
-    static constexpr size_t block_size() { return 128 * 1024; }
+public:
     using int_type = unsigned long;
+    // Storage blocks start on a cache line.
+    static constexpr size_t storage_alignment() { return 64; }
+private:
+    struct storage_deleter {
+        void operator()(int_type* p) const {
+            ::free(p);
+        }
+    };
+    using storage_block = std::unique_ptr<int_type[], storage_deleter>;
+private:
+    static constexpr size_t block_size() { return 128 * 1024; }
     static constexpr size_t bits_per_int() {
         return std::numeric_limits<int_type>::digits;
     }
@@ -43,7 +55,7 @@ class large_bitset {
         return ints_per_block() * bits_per_int();
     }
     size_t _nr_bits = 0;
-    std::vector<std::unique_ptr<int_type[]>> _storage;
+    std::vector<storage_block> _storage;
 public:
     explicit large_bitset(size_t nr_bits);
     large_bitset(large_bitset&&) = default;
@@ -82,6 +94,20 @@ class large_bitset {
         _storage[idx1][idx2] &= ~(int_type(1) << idx3);
     }
     void clear();
+    // Returns the idx-th of the aligned groups of N consecutive words. N
+    // divides the words of a storage block, so a group is never fragmented,
+    // and groups no larger than storage_alignment() don't cross its
+    // boundaries.
+    template <size_t N>
+    int_type* word_group(size_t idx) {
+        static_assert(ints_per_block() % N == 0, "word groups must not span storage blocks");
+        auto word = idx * N;
+        return _storage[word / ints_per_block()].get() + word % ints_per_block();
+    }
+    template <size_t N>
+    const int_type* word_group(size_t idx) const {
+        return const_cast<large_bitset*>(this)->word_group<N>(idx);
+    }
     // load data from host bitmap (in host byte order); returns end bit position
     template <typename IntegerIterator>
     size_t load(IntegerIterator start, IntegerIterator finish, size_t position = 0);
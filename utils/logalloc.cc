@@ -38,6 +38,7 @@
 #include "log.hh"
 #include "utils/dynamic_bitset.hh"
 #include "utils/log_heap.hh"
+#include "utils/estimated_histogram.hh"
 
 namespace bi = boost::intrusive;
 
@@ -84,7 +85,12 @@ class tracker::impl {
     seastar::metrics::metric_groups _metrics;
     bool _reclaiming_enabled = true;
     size_t _reclamation_step = 1;
+    size_t _idle_reserve_segments = 0;
     bool _abort_on_bad_alloc = false;
+    tracker::reclaim_stats _stats;
+    // Durations of reclamation cycles run synchronously from the allocator,
+    // in microseconds. Preallocated, since it is updated while reclaiming.
+    utils::estimated_histogram _sync_reclaim_duration;
 private:
     // Prevents tracker's reclaimer from running while live. Reclaimer may be
     // invoked synchronously with allocator. This guard ensures that this
@@ -109,6 +115,9 @@ class tracker::impl {
     void register_region(region::impl*);
     void unregister_region(region::impl*);
     size_t reclaim(size_t bytes);
+    size_t reclaim_locked(size_t bytes);
+    memory::reclaiming_result reclaim_sync();
+    reactor::idle_cpu_handler_result reclaim_on_idle(reactor::work_waiting_on_reactor check_for_work);
     reactor::idle_cpu_handler_result compact_on_idle(reactor::work_waiting_on_reactor check_for_work);
     size_t compact_and_evict(size_t bytes);
     size_t compact_and_evict_locked(size_t bytes);
@@ -118,6 +127,9 @@ class tracker::impl {
     occupancy_stats occupancy();
     void set_reclamation_step(size_t step_in_segments) { _reclamation_step = step_in_segments; }
     size_t reclamation_step() const { return _reclamation_step; }
+    void set_idle_reserve(size_t segments) { _idle_reserve_segments = segments; }
+    size_t idle_reserve() const { return _idle_reserve_segments; }
+    const tracker::reclaim_stats& stats() const { return _stats; }
     void enable_abort_on_bad_alloc() { _abort_on_bad_alloc = true; }
     bool should_abort_on_bad_alloc() const { return _abort_on_bad_alloc; }
 };
@@ -140,6 +152,10 @@ size_t tracker::reclaim(size_t bytes) {
     return _impl->reclaim(bytes);
 }
 
+reactor::idle_cpu_handler_result tracker::reclaim_on_idle(reactor::work_waiting_on_reactor check_for_work) {
+    return _impl->reclaim_on_idle(check_for_work);
+}
+
 reactor::idle_cpu_handler_result tracker::compact_on_idle(reactor::work_waiting_on_reactor check_for_work) {
     return _impl->compact_on_idle(check_for_work);
 }
@@ -1560,6 +1576,18 @@ size_t tracker::reclamation_step() const {
     return _impl->reclamation_step();
 }
 
+void tracker::set_idle_reserve(size_t segments) {
+    _impl->set_idle_reserve(segments);
+}
+
+size_t tracker::idle_reserve() const {
+    return _impl->idle_reserve();
+}
+
+const tracker::reclaim_stats& tracker::stats() const {
+    return _impl->stats();
+}
+
 void tracker::enable_abort_on_bad_alloc() {
     return _impl->enable_abort_on_bad_alloc();
 }
@@ -1569,9 +1597,7 @@ bool tracker::should_abort_on_bad_alloc() {
 }
 
 memory::reclaiming_result tracker::reclaim() {
-    return reclaim(_impl->reclamation_step() * segment::size)
-           ? memory::reclaiming_result::reclaimed_something
-           : memory::reclaiming_result::reclaimed_nothing;
+    return _impl->reclaim_sync();
 }
 
 bool
@@ -1755,6 +1781,42 @@ struct reclaim_timer {
     }
 };
 
+memory::reclaiming_result tracker::impl::reclaim_sync() {
+    if (!_reclaiming_enabled) {
+        return memory::reclaiming_result::reclaimed_nothing;
+    }
+    auto start = clock::now();
+    auto released = reclaim(_reclamation_step * segment::size);
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start);
+    _sync_reclaim_duration.add(duration.count());
+    _stats.sync_reclaims++;
+    _stats.sync_reclaimed_bytes += released;
+    return released ? memory::reclaiming_result::reclaimed_something
+                    : memory::reclaiming_result::reclaimed_nothing;
+}
+
+reactor::idle_cpu_handler_result tracker::impl::reclaim_on_idle(reactor::work_waiting_on_reactor check_for_work) {
+    if (!_reclaiming_enabled) {
+        return reactor::idle_cpu_handler_result::no_more_work;
+    }
+    reclaiming_lock rl(*this);
+    auto reserve = _idle_reserve_segments * segment::size;
+    // Reclaim in the same steps as the allocator would, so that we can
+    // yield to the reactor between steps.
+    while (memory::stats().free_memory() < reserve) {
+        if (check_for_work()) {
+            return reactor::idle_cpu_handler_result::interrupted_by_higher_priority_task;
+        }
+        auto released = reclaim_locked(_reclamation_step * segment::size);
+        if (!released) {
+            break;
+        }
+        _stats.idle_reclaims++;
+        _stats.idle_reclaimed_bytes += released;
+    }
+    return reactor::idle_cpu_handler_result::no_more_work;
+}
+
 reactor::idle_cpu_handler_result tracker::impl::compact_on_idle(reactor::work_waiting_on_reactor check_for_work) {
     if (!_reclaiming_enabled) {
         return reactor::idle_cpu_handler_result::no_more_work;
@@ -1798,6 +1860,10 @@ size_t tracker::impl::reclaim(size_t memory_to_release) {
         return 0;
     }
     reclaiming_lock rl(*this);
+    return reclaim_locked(memory_to_release);
+}
+
+size_t tracker::impl::reclaim_locked(size_t memory_to_release) {
     reclaim_timer timing_guard;
 
     size_t mem_released;
@@ -2027,6 +2093,21 @@ tracker::impl::impl() {
 
         sm::make_derive("segments_compacted", [this] { return shard_segment_pool.statistics().segments_compacted; },
                         sm::description("Counts a number of compacted segments.")),
+
+        sm::make_derive("sync_reclaims", [this] { return _stats.sync_reclaims; },
+                        sm::description("Counts a number of reclamation cycles run synchronously from the allocator.")),
+
+        sm::make_derive("sync_reclaimed_bytes", [this] { return _stats.sync_reclaimed_bytes; },
+                        sm::description("Counts a number of bytes reclaimed synchronously from the allocator.")),
+
+        sm::make_histogram("sync_reclaim_duration", sm::description("Holds a histogram of durations of synchronous reclamation cycles, in microseconds."),
+                           [this] { return _sync_reclaim_duration.get_histogram(10, 16); }),
+
+        sm::make_derive("idle_reclaims", [this] { return _stats.idle_reclaims; },
+                        sm::description("Counts a number of reclamation steps run to top up the free memory reserve when the cpu is idle.")),
+
+        sm::make_derive("idle_reclaimed_bytes", [this] { return _stats.idle_reclaimed_bytes; },
+                        sm::description("Counts a number of bytes reclaimed to top up the free memory reserve when the cpu is idle.")),
     });
 }
 
@@ -2052,6 +2133,22 @@ region* region_group::get_largest_region() {
     return _maximal_rg->_regions.top()->_region;
 }
 
+region* region_group::get_largest_region(const std::function<bool (region&)>& pred) {
+    region_impl* largest = nullptr;
+    std::function<void (region_group&)> visit = [&] (region_group& rg) {
+        for (region_impl* r : rg._regions) {
+            if ((!largest || region_evictable_occupancy_ascending_less_comparator()(largest, r)) && pred(*r->_region)) {
+                largest = r;
+            }
+        }
+        for (region_group* child : rg._subgroups) {
+            visit(*child);
+        }
+    };
+    visit(*this);
+    return largest ? largest->_region : nullptr;
+}
+
 void
 region_group::add(region_group* child) {
     child->_subgroup_heap_handle = _subgroups.push(child);
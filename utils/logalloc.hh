@@ -337,6 +337,10 @@ class region_group {
     // children.
     region* get_largest_region();
 
+    // Like get_largest_region(), but only considers the regions for which pred returns true.
+    // Returns nullptr if there is none. Visits every region below this group.
+    region* get_largest_region(const std::function<bool (region&)>& pred);
+
     // Shutdown is mandatory for every user who has set a threshold
     // Can be called at most once.
     future<> shutdown() {
@@ -418,6 +422,16 @@ class region_group {
 class tracker {
 public:
     class impl;
+
+    struct reclaim_stats {
+        // Reclamation cycles run synchronously from the allocator, on the
+        // critical path of whatever allocated.
+        uint64_t sync_reclaims = 0;
+        uint64_t sync_reclaimed_bytes = 0;
+        // Reclamation steps run by reclaim_on_idle().
+        uint64_t idle_reclaims = 0;
+        uint64_t idle_reclaimed_bytes = 0;
+    };
 private:
     std::unique_ptr<impl> _impl;
     memory::reclaimer _reclaimer;
@@ -442,6 +456,12 @@ class tracker {
     // or there are no more segments to compact.
     reactor::idle_cpu_handler_result compact_on_idle(reactor::work_waiting_on_reactor);
 
+    // Compacts and evicts, one reclamation step at a time, until the amount of
+    // free memory in the seastar allocator reaches the idle reserve, so that
+    // allocations made when the cpu is busy don't have to reclaim synchronously.
+    // Stops when work_waiting_on_reactor returns true.
+    reactor::idle_cpu_handler_result reclaim_on_idle(reactor::work_waiting_on_reactor);
+
     // Compacts as much as possible. Very expensive, mainly for testing.
     // Guarantees that every live object from reclaimable regions will be moved.
     // Invalidates references to objects in all compactible and evictable regions.
@@ -463,6 +483,14 @@ class tracker {
     // Returns the minimum number of segments reclaimed during single reclamation cycle.
     size_t reclamation_step() const;
 
+    // Set the number of segments worth of free memory reclaim_on_idle() keeps available.
+    void set_idle_reserve(size_t segments);
+
+    // Returns the number of segments worth of free memory reclaim_on_idle() keeps available.
+    size_t idle_reserve() const;
+
+    const reclaim_stats& stats() const;
+
     // Abort on allocation failure from LSA
     void enable_abort_on_bad_alloc();
 